@@ -104,18 +104,20 @@ public:
 			imgui::DragFloat("fast_mult", &fast_mult, 1.0f / 10);
 		}
 		{
-			save->begin(gui_name);
+			auto* c = save_cache;
 
-			save->value("pos_world", &pos_world);
-			save->angle("altazimuth", &altazimuth);
+			save->begin(gui_name, &c[0]);
 
-			save->angle("vfov", &vfov);
+			save->value("pos_world", &pos_world, &c[1]);
+			save->angle("altazimuth", &altazimuth, &c[2]);
 
-			save->value("clip_near", &clip_near);
-			save->value("clip_far", &clip_far);
+			save->angle("vfov", &vfov, &c[3]);
 
-			save->value("base_speed", &base_speed);
-			save->value("fast_mult", &fast_mult);
+			save->value("clip_near", &clip_near, &c[4]);
+			save->value("clip_far", &clip_far, &c[5]);
+
+			save->value("base_speed", &base_speed, &c[6]);
+			save->value("fast_mult", &fast_mult, &c[7]);
 
 			save->end();
 		}
@@ -180,6 +182,8 @@ public:
 
 private:
 	Screen_Rect _screen_rect;
+
+	Save::Cache save_cache[8]; // one per save call in update()
 public:
 	
 	void draw_to () {
@@ -11,6 +11,9 @@ namespace imgui = ImGui;
 
 #include <algorithm>
 
+#include "mylibs/profiler.hpp"
+#include "gpu_profiler.hpp"
+
 namespace ImGui {
 	IMGUI_API bool DragAngle (cstr label, float* v, float v_speed=deg(5)) {
 		float deg = to_deg(*v);
@@ -242,12 +245,27 @@ namespace engine {
 		{ "col_srgba",			RGBA8,	(int)offsetof(My_ImDrawVert, col_srgba) }
 	}};
 
+	// what end_imgui submitted last frame
+	struct Imgui_Render_Stats {
+		int		cmd_lists;
+		int		draw_cmds;
+		int		vertices;
+		int		indices;
+
+		int		binds; // use_shader, Gpu_Mesh::bind and bind_texture calls (each is several gl calls), only redone after user callbacks
+		int		scissor_calls;
+		int		draw_calls;
+	};
+	Imgui_Render_Stats imgui_render_stats = {};
+
 	void end_imgui (iv2 wnd_size_px) { // expect viewport to be set
 		if (!imgui_enabled) {
 			ImGui::EndFrame();
 			return;
 		}
 
+		PROFILE_SCOPED("imgui_render");
+
 		ImGui::Render();
 
 		glEnable(GL_BLEND);
@@ -308,44 +326,85 @@ namespace engine {
 
 		static auto stream_mesh = Gpu_Mesh::generate<My_ImDrawVert,ImDrawIdx>();
 
+		// all draw lists are merged into one buffer per frame, the indices stay relative to their list and are offset with the base vertex
+		static std::vector<ImDrawVert> vertices;
+		static std::vector<ImDrawIdx> indices;
+
+		vertices.clear();
+		indices.clear();
+		vertices.reserve(draw_data->TotalVtxCount);
+		indices.reserve(draw_data->TotalIdxCount);
+
 		for (int n = 0; n < draw_data->CmdListsCount; n++) {
 			auto* cmd_list = draw_data->CmdLists[n];
+			vertices.insert(vertices.end(), cmd_list->VtxBuffer.begin(), cmd_list->VtxBuffer.end());
+			indices.insert(indices.end(), cmd_list->IdxBuffer.begin(), cmd_list->IdxBuffer.end());
+		}
+
+		auto& stats = imgui_render_stats;
+		stats = {};
+		stats.cmd_lists = draw_data->CmdListsCount;
+		stats.vertices = (int)vertices.size();
+		stats.indices = (int)indices.size();
 
-			ImDrawVert* vtx_buffer = cmd_list->VtxBuffer.Data;  // vertex buffer generated by ImGui
-			ImDrawIdx* idx_buffer = cmd_list->IdxBuffer.Data;   // index buffer generated by ImGui
+		if (indices.size() == 0)
+			return;
+
+		stream_mesh.reupload(vertices.data(), (GLuint)vertices.size(), indices.data(), (GLuint)indices.size(), &My_ImDrawVert::layout, Gpu_Mesh::UNSIGNED_SHORT);
 
-			auto vertex_count = cmd_list->VtxBuffer.size();
-			auto index_count = cmd_list->IdxBuffer.size();
+		// shader, mesh and texture are only set up once, unless a user callback changed the gl state
+		Shader* shad = nullptr;
+		bool bound = false;
+		iv4 scissor = -1; // x, y, w, h
 
-			stream_mesh.reupload(vtx_buffer, vertex_count, idx_buffer, index_count, &My_ImDrawVert::layout, Gpu_Mesh::UNSIGNED_SHORT);
+		auto bind = [&] () {
+			shad = use_shader("imgui");
+			assert(shad);
+			stream_mesh.bind(*shad);
+			bind_texture(shad, "tex", 0, imgui_atlas);
+			bound = true;
+			stats.binds += 3;
+		};
 
-			ImDrawIdx* cur_idx_buffer = idx_buffer;
+		GLint vtx_offset = 0;
+		GLint idx_offset = 0;
+
+		for (int n = 0; n < draw_data->CmdListsCount; n++) {
+			auto* cmd_list = draw_data->CmdLists[n];
 
 			for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++) {
 				const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
+				stats.draw_cmds++;
+
 				if (pcmd->UserCallback) {
 					pcmd->UserCallback(cmd_list, pcmd);
+					bound = false;
+					scissor = -1;
 				} else {
 					
 					if (pcmd->TextureId != (ImTextureID)&imgui_atlas) {
 						assert(not_implemented);
 					}
 
-					auto shad = use_shader("imgui");
-					assert(shad);
+					if (!bound)
+						bind();
 
 					flt y0 = (flt)wnd_size_px.y -pcmd->ClipRect.w;
 					flt y1 = (flt)wnd_size_px.y -pcmd->ClipRect.y;
 
-					glScissor((int)pcmd->ClipRect.x, (int)y0, (int)(pcmd->ClipRect.z -pcmd->ClipRect.x), (int)(y1 -y0));
-
-					bind_texture(shad, "tex", 0, imgui_atlas);
+					iv4 r = iv4((int)pcmd->ClipRect.x, (int)y0, (int)(pcmd->ClipRect.z -pcmd->ClipRect.x), (int)(y1 -y0));
+					if (any(r != scissor)) { // consecutive commands usually share the clip rect of their window
+						glScissor(r.x, r.y, r.z, r.w);
+						scissor = r;
+						stats.scissor_calls++;
+					}
 
-					GLint first = (GLint)(cur_idx_buffer -idx_buffer); // in indecies (not bytes)
-					stream_mesh.draw(*shad, first, pcmd->ElemCount);
+					glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, GL_UNSIGNED_SHORT, (void*)(uptr)(idx_offset * sizeof(ImDrawIdx)), vtx_offset);
+					stats.draw_calls++;
 				}
-				cur_idx_buffer += pcmd->ElemCount;
+				idx_offset += pcmd->ElemCount;
 			}
+			vtx_offset += cmd_list->VtxBuffer.Size;
 		}
 	}
 
@@ -552,4 +611,58 @@ namespace engine {
 		}
 	}*/
 
+	void _imgui_profiler_zones (profiler::Thread_Zones const& tz, u32 indx) {
+		auto& n = tz.nodes[indx];
+
+		auto flags = ImGuiTreeNodeFlags_DefaultOpen | (n.children.size() == 0 ? ImGuiTreeNodeFlags_Leaf : 0);
+		bool open = ImGui::TreeNodeEx((void*)(uptr)indx, flags, "%-24s %8.3f ms  self %8.3f ms  calls %4u", n.name, n.avg_total_ms, n.avg_self_ms, n.calls);
+		if (open) {
+			for (u32 c : n.children)
+				_imgui_profiler_zones(tz, c);
+			ImGui::TreePop();
+		}
+	}
+	// aggregated zones per thread (averaged total and self time, calls of the last frame) and chrome trace recording
+	void imgui_profiler () {
+		auto& p = profiler::get_profiler();
+
+		if (!ImGui::CollapsingHeader("Profiler"))
+			return;
+
+		if (!p.recording) {
+			if (ImGui::Button("Record trace"))
+				p.start_recording();
+		} else {
+			if (ImGui::Button("Save trace")) {
+				if (!p.write_chrome_trace("profiler_trace.json"))
+					errprint("Profiler: could not write profiler_trace.json!\n");
+			}
+			ImGui::SameLine();
+			ImGui::Text("%llu events", (unsigned long long)p.recorded_events());
+		}
+
+		u64 dropped = p.dropped_events();
+		if (dropped > 0) {
+			ImGui::SameLine();
+			ImGui::Text("%llu events dropped!", (unsigned long long)dropped);
+		}
+
+		auto& is = imgui_render_stats;
+		ImGui::Text("imgui: %d lists %d cmds %d verts  gl: %d binds %d scissors %d draws", is.cmd_lists, is.draw_cmds, is.vertices, is.binds, is.scissor_calls, is.draw_calls);
+
+		for (uptr i=0; i<p.zones.size(); ++i) {
+			auto& tz = p.zones[i];
+			if (tz.nodes.size() == 0 || tz.nodes[0].children.size() == 0)
+				continue;
+
+			ImGui::PushID((int)i);
+			if (ImGui::TreeNodeEx("thread", ImGuiTreeNodeFlags_DefaultOpen, "%s  %8.3f ms", p.thread_name(i).c_str(), tz.nodes[0].avg_total_ms)) {
+				for (u32 c : tz.nodes[0].children)
+					_imgui_profiler_zones(tz, c);
+				ImGui::TreePop();
+			}
+			ImGui::PopID();
+		}
+	}
+
 }
@@ -15,7 +15,7 @@
 
 #include "dear_imgui.hpp"
 
-//#include "engine_options.hpp"
 #include "save_file.hpp"
+#include "options.hpp"
 
 #include "common_colors.hpp"
@@ -2,6 +2,10 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 
+#ifndef MSVC_PROJECT_NAME // the vcxprojs define it, other builds (eg. linux ci) can pass -DMSVC_PROJECT_NAME=\"name\"
+	#define MSVC_PROJECT_NAME "3d_lib"
+#endif
+
 // language includes
 #include <string>
 #include <vector>
@@ -21,15 +25,17 @@ using std::make_shared;
 
 #include "deps/glfw/include/GLFW/glfw3.h"
 
-#pragma push_macro("APIENTRY")
+#ifdef _WIN32 // for the win32 window placement in glfw_window.hpp
+	#pragma push_macro("APIENTRY")
 
-#define GLFW_EXPOSE_NATIVE_WIN32 1
-#include "deps/glfw/include/GLFW/glfw3native.h"
+	#define GLFW_EXPOSE_NATIVE_WIN32 1
+	#include "deps/glfw/include/GLFW/glfw3native.h"
 
-#pragma pop_macro("APIENTRY")
+	#pragma pop_macro("APIENTRY")
 
-#include "windows.h"
-#include "Shlobj.h"
+	#include "windows.h"
+	#include "Shlobj.h"
+#endif
 //
 
 // my includes
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "mylibs/basic_typedefs.hpp"
+#include "mylibs/float_precision.hpp"
+#include "mylibs/preprocessor_stuff.hpp"
+#include "mylibs/profiler.hpp"
+#include "gl_command_buffer.hpp"
+
+#include <cassert>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Two stage frame pipeline: the simulation and command building of frame N+1 run on a worker thread while the main thread submits frame N to gl
+//  the worker can not make gl calls (the context belongs to the main thread), so it records a Gl_Command_Buffer that the main thread submits in the next frame
+//  sync points (main thread):
+//   wait()		blocks until the worker finished the previous job, from here until kick() the worker is idle and all app state can be touched
+//   kick()		starts the job for the next frame, until the next wait() only the worker may touch the state the job uses
+//   submit()	submits the buffer the last finished job recorded
+//  this adds one frame of latency between frame() (input, ui) and what is on screen
+//  no gl or window includes, so the tests project can run it
+namespace engine {
+	using namespace basic_typedefs;
+	using namespace float_precision;
+
+	class Frame_Pipeline {
+		NO_MOVE_COPY_CLASS(Frame_Pipeline)
+
+		typedef std::function<void (Gl_Command_Buffer& cmds)> job_t;
+
+		std::thread				thread; // started on first kick
+		std::mutex				mutex;
+		std::condition_variable	cv;
+
+		job_t					job; // not started yet
+		bool					busy = false; // job kicked and not finished yet
+		bool					kicked = false; // since the last wait()
+		bool					shutdown = false;
+
+		Gl_Command_Buffer		lists[2]; // one is recorded by the worker, the other one submitted by the main thread
+		int						recording = 0;
+		int						ready = -1; // list to submit, recorded by the job that finished in the last wait()
+
+		void run () {
+			profiler::set_thread_name("frame pipeline");
+
+			std::unique_lock<std::mutex> lock(mutex);
+			for (;;) {
+				cv.wait(lock, [&] () { return job || shutdown; });
+				if (shutdown)
+					return;
+
+				auto j = std::move(job);
+				job = nullptr;
+				auto& list = lists[recording];
+				lock.unlock();
+
+				u64 begin = profiler::now_ns();
+				j(list);
+				u64 end = profiler::now_ns();
+
+				lock.lock();
+				job_ms = (flt)(end -begin) * 1e-6f;
+				busy = false;
+				cv.notify_all(); // wake wait()
+			}
+		}
+
+	public:
+		bool					enabled = false; // run jobs on the worker, otherwise run_serial is used
+
+		// last frame
+		flt						job_ms = 0; // worker time for the job
+		flt						wait_ms = 0; // main thread time blocked in wait(), > 0 means the worker is the bottleneck
+		flt						submit_ms = 0;
+		uptr					submitted_cmds = 0;
+		Gl_Submit_Stats			submit_stats;
+
+		~Frame_Pipeline () {
+			wait(); // a kicked job is finished first, even if the worker did not pick it up yet
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				shutdown = true;
+			}
+			cv.notify_all();
+			if (thread.joinable())
+				thread.join();
+		}
+
+		// sync point, blocks until the last kicked job finished, call before touching anything the job uses
+		void wait () {
+			u64 begin = profiler::now_ns();
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				if (!kicked) {
+					ready = -1; // nothing new to submit
+					wait_ms = 0;
+					return;
+				}
+				cv.wait(lock, [&] () { return !busy; });
+
+				kicked = false;
+				ready = recording;
+				recording ^= 1;
+			}
+			wait_ms = (flt)(profiler::now_ns() -begin) * 1e-6f;
+		}
+
+		// start job(cmds) on the worker, the recorded commands are submitted in the next frame (after wait())
+		void kick (job_t j) {
+			std::lock_guard<std::mutex> lock(mutex);
+			assert(!kicked); // wait() has to be called between kicks
+
+			lists[recording].clear(); // not the ready list, so that can still be submitted
+			job = std::move(j);
+			busy = true;
+			kicked = true;
+
+			if (!thread.joinable())
+				thread = std::thread(&Frame_Pipeline::run, this);
+			cv.notify_all();
+		}
+
+		// run job on this thread and submit it directly (the unpipelined frame)
+		template <typename BACKEND>
+		void run_serial (job_t const& j, BACKEND& gl) {
+			assert(!kicked);
+			auto& list = lists[recording];
+			list.clear();
+
+			u64 begin = profiler::now_ns();
+			j(list);
+			job_ms = (flt)(profiler::now_ns() -begin) * 1e-6f;
+			wait_ms = 0;
+
+			ready = recording;
+			submit(gl);
+		}
+
+		// submit the commands of the last finished job (nothing on the first pipelined frame), main thread only
+		template <typename BACKEND>
+		void submit (BACKEND& gl) {
+			u64 begin = profiler::now_ns();
+
+			submitted_cmds = 0;
+			if (ready >= 0) {
+				submitted_cmds = lists[ready].size();
+				lists[ready].submit(gl);
+				submit_stats = lists[ready].stats;
+				ready = -1; // submit() cleared it
+			}
+
+			submit_ms = (flt)(profiler::now_ns() -begin) * 1e-6f;
+		}
+	};
+}
@@ -0,0 +1,489 @@
+#pragma once
+
+#include "mylibs/basic_typedefs.hpp"
+#include "mylibs/vector.hpp"
+#include "mylibs/float_precision.hpp"
+#include "mylibs/string.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include "assert.h"
+
+// Deferred gl command buffer, the one recorded command type of the engine (the draw helpers in utils.hpp and Application::prepare() record into it)
+//  draws are recorded with their full render state, shader, textures, uniforms and mesh, and only executed on submit()
+//  submit() sorts them by (pass, shader, texture, depth) and goes through a Gl_State_Cache that shadows the gl state, so redundant state changes are skipped
+//  record() adds arbitrary gl work (uploads, non standard draws) as a closure, which runs in recording order, draws are only sorted between two of them
+//  this header makes no gl calls itself, submit() talks to a backend:
+//   Gl_Backend (utils.hpp) for real gl and Mock_Gl_Backend, which records the calls, to test the sorting and the cache without a gpu
+//  recording makes no gl calls either, so it can happen on any thread (Frame_Pipeline records on a worker), submit() runs on the thread that owns the context
+//   shaders and meshes can be given as lookup functions that run on submit (the helpers load their shaders and upload their meshes that way)
+//   the buffer only stores pointers to shaders and meshes, so they have to stay alive until submit()
+namespace engine {
+	using namespace basic_typedefs;
+	using namespace vector;
+	using namespace float_precision;
+
+	class Shader;
+	namespace vertex_layout {
+		struct Gpu_Mesh;
+	}
+	using namespace vertex_layout;
+
+	struct Render_State {
+		bool	blend			: 1; // blend func is always GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+		bool	depth_test		: 1;
+		bool	depth_write		: 1;
+		bool	cull			: 1;
+		bool	scissor_test	: 1;
+	};
+
+	enum e_gl_cap {
+		CAP_BLEND,
+		CAP_DEPTH_TEST,
+		CAP_CULL_FACE,
+		CAP_SCISSOR_TEST,
+	};
+
+	static constexpr int MAX_CACHED_TEXTURE_UNITS = 16;
+
+	struct Cmd_Uniform {
+		enum type_e {
+			FLT, FV2, FV3, FV4, INT_, MAT4,
+		};
+
+		cstr	name; // has to stay valid until submit() (string literals)
+		type_e	type;
+		union {
+			f32		flt_;
+			fv2		fv2_;
+			fv3		fv3_;
+			fv4		fv4_;
+			s32		int_;
+			fm4		fm4_;
+		};
+
+		Cmd_Uniform () {}
+
+		void set (f32	val) { type = FLT ;	flt_ = val; }
+		void set (fv2	val) { type = FV2 ;	fv2_ = val; }
+		void set (fv3	val) { type = FV3 ;	fv3_ = val; }
+		void set (fv4	val) { type = FV4 ;	fv4_ = val; }
+		void set (s32	val) { type = INT_;	int_ = val; }
+		void set (fm4	val) { type = MAT4;	fm4_ = val; }
+	};
+
+	struct Cmd_Texture {
+		int		unit;
+		u32		target; // GL_TEXTURE_2D etc.
+		u32		handle;
+	};
+
+	// called on submit on the gl thread, plain functions so they also identify the shader or mesh in the sort key before they ran
+	typedef Shader* (*shader_func_t) (); // nullptr skips the draw (eg. shader failed to compile)
+	typedef Gpu_Mesh const* (*mesh_func_t) ();
+
+	enum e_pass_order {
+		FRONT_TO_BACK, // opaque: sorted by state first, depth only breaks ties
+		BACK_TO_FRONT, // blended: sorted by depth first (farthest first), state only breaks ties
+	};
+
+	struct Gl_Submit_Stats {
+		int		draws = 0;
+		int		funcs = 0; // closures from record()
+
+		// issued and elided (redundant, skipped by the state cache) state changes, issued + elided is what setting the full state for every draw costs
+		int		raster = 0,		raster_elided = 0; // glEnable/glDisable, glDepthMask, glBlendFunc
+		int		shader = 0,		shader_elided = 0;
+		int		texture = 0,	texture_elided = 0;
+		int		mesh = 0,		mesh_elided = 0; // vbo/ebo/vertex attrib binds
+		int		uniforms = 0; // always issued
+
+		int issued () const { return raster +shader +texture +mesh; }
+		int elided () const { return raster_elided +shader_elided +texture_elided +mesh_elided; }
+
+		std::string to_string () const {
+			int total = issued() +elided();
+			return string::prints("%d draws, %d funcs, %d state changes, %d elided (%.0f%%): raster %d/%d shader %d/%d texture %d/%d mesh %d/%d, %d uniforms",
+				draws, funcs, issued(), elided(), total ? (flt)elided() / (flt)total * 100 : 0.0f,
+				raster, raster_elided, shader, shader_elided, texture, texture_elided, mesh, mesh_elided, uniforms);
+		}
+	};
+
+	// Shadow of the gl state, forwards only the changes to the backend
+	//  starts out unknown, since anything outside of submit() can change the gl state
+	template <typename BACKEND>
+	struct Gl_State_Cache {
+		BACKEND*			gl;
+		Gl_Submit_Stats*	stats;
+
+		bool				state_known = false;
+		Render_State		state = {};
+
+		Shader*				shader = nullptr;
+		Gpu_Mesh const*		mesh = nullptr;
+		Shader*				mesh_shader = nullptr; // vertex attrib locations depend on the shader
+		Cmd_Texture			textures[MAX_CACHED_TEXTURE_UNITS];
+
+		Gl_State_Cache (BACKEND* gl, Gl_Submit_Stats* stats): gl{gl}, stats{stats} {
+			reset();
+		}
+
+		void reset () {
+			state_known = false;
+			shader = nullptr;
+			mesh = nullptr;
+			mesh_shader = nullptr;
+			for (auto& t : textures)
+				t = { -1, 0, 0 };
+		}
+
+		void _cap (e_gl_cap cap, bool cur, bool want) {
+			if (state_known && cur == want) {
+				stats->raster_elided++;
+				return;
+			}
+			gl->set_cap(cap, want);
+			stats->raster++;
+		}
+
+		void set_state (Render_State s) {
+			_cap(CAP_BLEND,			state.blend,		s.blend);
+			_cap(CAP_DEPTH_TEST,	state.depth_test,	s.depth_test);
+			_cap(CAP_CULL_FACE,		state.cull,			s.cull);
+			_cap(CAP_SCISSOR_TEST,	state.scissor_test,	s.scissor_test);
+
+			if (state_known && state.depth_write == s.depth_write) {
+				stats->raster_elided++;
+			} else {
+				gl->set_depth_mask(s.depth_write);
+				stats->raster++;
+			}
+
+			if (state_known) {
+				stats->raster_elided++;
+			} else {
+				gl->set_blend_func_alpha();
+				stats->raster++;
+			}
+
+			state = s;
+			state_known = true;
+		}
+
+		void use_shader (Shader* s) {
+			if (s == shader) {
+				stats->shader_elided++;
+				return;
+			}
+			gl->use_shader(s);
+			shader = s;
+			stats->shader++;
+		}
+
+		void bind_texture (Cmd_Texture const& t) {
+			assert(t.unit >= 0 && t.unit < MAX_CACHED_TEXTURE_UNITS);
+			auto& cur = textures[t.unit];
+			if (cur.unit == t.unit && cur.target == t.target && cur.handle == t.handle) {
+				stats->texture_elided++;
+				return;
+			}
+			gl->bind_texture(t.unit, t.target, t.handle);
+			cur = t;
+			stats->texture++;
+		}
+
+		void bind_mesh (Gpu_Mesh const* m) {
+			if (m == mesh && shader == mesh_shader) {
+				stats->mesh_elided++;
+				return;
+			}
+			gl->bind_mesh(m, shader);
+			mesh = m;
+			mesh_shader = shader;
+			stats->mesh++;
+		}
+	};
+
+	class Gl_Command_Buffer {
+	public:
+		struct Draw_Cmd {
+			u32				pass;
+			flt				depth; // >= 0, distance to view_pos
+			u32				seq; // recording order, keeps the sort stable
+			u32				barrier; // number of closures recorded before, draws are not sorted across them
+
+			Render_State	state;
+			Shader*			shader; // or shader_func
+			shader_func_t	shader_func;
+			Gpu_Mesh const*	mesh; // or mesh_func
+			mesh_func_t		mesh_func;
+			u32				primitive; // GL_TRIANGLES etc.
+
+			u32				first_uniform, uniform_count;
+			u32				first_texture, texture_count;
+		};
+
+	private:
+		struct Sort_Entry {
+			u32		barrier;
+			u64		key;
+			u32		seq;
+		};
+
+		std::vector<Draw_Cmd>		cmds;
+		std::vector<Cmd_Uniform>	uniforms;
+		std::vector<Cmd_Texture>	textures;
+
+		std::vector< std::function<void ()> >	funcs;
+
+		std::vector<void const*>	shader_ids; // index is the shader part of the sort key, Shader* or shader_func_t
+		u32							back_to_front_passes = 0; // bitmask
+
+		std::vector<Sort_Entry>		order;
+
+		u32 _shader_id (void const* s) {
+			for (u32 i=0; i<(u32)shader_ids.size(); ++i)
+				if (shader_ids[i] == s)
+					return i;
+			shader_ids.push_back(s);
+			return (u32)shader_ids.size() -1;
+		}
+		static u32 _depth_bits (flt depth) { // positive floats sort like their bit patterns
+			depth = MAX(depth, 0.0f);
+			u32 bits;
+			memcpy(&bits, &depth, sizeof(bits));
+			return bits >> 8; // 24 bits
+		}
+
+	public:
+		v3							view_pos = 0; // helpers compute the depth of their draws relative to this
+		u32							cur_pass = 0; // helpers record into this pass
+
+		Gl_Submit_Stats				stats; // of the last submit()
+
+		// key layout (msb to lsb) front to back: pass 8 | shader 16 | texture 16 | depth 24
+		//                         back to front: pass 8 | inverted depth 24 | shader 16 | texture 16
+		u64 sort_key (Draw_Cmd const& c) {
+			u64 pass = (u64)(c.pass & 0xff);
+			u64 shad = (u64)(_shader_id(c.shader ? (void const*)c.shader : (void const*)c.shader_func) & 0xffff);
+			u64 tex = (u64)((c.texture_count ? textures[c.first_texture].handle : 0) & 0xffff);
+			u64 depth = (u64)_depth_bits(c.depth);
+
+			if (back_to_front_passes & (1u << (c.pass & 31)))
+				return pass << 56 | (~depth & 0xffffff) << 32 | shad << 16 | tex;
+			return pass << 56 | shad << 40 | tex << 24 | depth;
+		}
+
+		void set_pass_order (u32 pass, e_pass_order order) {
+			assert(pass < 32);
+			if (order == BACK_TO_FRONT)
+				back_to_front_passes |= 1u << pass;
+			else
+				back_to_front_passes &= ~(1u << pass);
+		}
+
+		uptr size () const { return cmds.size() +funcs.size(); }
+
+		void clear () {
+			cmds.clear();
+			uniforms.clear();
+			textures.clear();
+			funcs.clear();
+			shader_ids.clear();
+		}
+
+		// record gl work that runs on submit, after the draws recorded before it and before the ones recorded after it
+		//  captures everything it needs by value (snapshots of the data to upload), it runs after the recording thread moved on
+		template <typename FUNC>
+		void record (FUNC&& func) {
+			funcs.emplace_back(std::forward<FUNC>(func));
+		}
+
+		void _draw (Render_State state, Shader* shader, shader_func_t shader_func, Gpu_Mesh const* mesh, mesh_func_t mesh_func, u32 primitive, flt depth) {
+			Draw_Cmd c;
+			c.pass = cur_pass;
+			c.depth = depth;
+			c.seq = (u32)cmds.size();
+			c.barrier = (u32)funcs.size();
+			c.state = state;
+			c.shader = shader;
+			c.shader_func = shader_func;
+			c.mesh = mesh;
+			c.mesh_func = mesh_func;
+			c.primitive = primitive;
+			c.first_uniform = (u32)uniforms.size();
+			c.uniform_count = 0;
+			c.first_texture = (u32)textures.size();
+			c.texture_count = 0;
+			cmds.push_back(c);
+		}
+
+		// record a draw of the whole mesh into cur_pass, add its uniforms and textures right after
+		void draw (Render_State state, Shader* shader, Gpu_Mesh const* mesh, u32 primitive, flt depth=0) {
+			assert(shader && mesh);
+			_draw(state, shader, nullptr, mesh, nullptr, primitive, depth);
+		}
+		void draw (Render_State state, shader_func_t shader, Gpu_Mesh const* mesh, u32 primitive, flt depth=0) {
+			assert(shader && mesh);
+			_draw(state, nullptr, shader, mesh, nullptr, primitive, depth);
+		}
+		void draw (Render_State state, shader_func_t shader, mesh_func_t mesh, u32 primitive, flt depth=0) {
+			assert(shader && mesh);
+			_draw(state, nullptr, shader, nullptr, mesh, primitive, depth);
+		}
+		template <typename T>
+		void uniform (cstr name, T val) {
+			assert(cmds.size() > 0);
+			uniforms.emplace_back();
+			uniforms.back().name = name;
+			uniforms.back().set(val);
+			cmds.back().uniform_count++;
+		}
+		// bind texture handle to unit and set the sampler uniform to the unit
+		void texture (cstr sampler_uniform, int unit, u32 target, u32 handle) {
+			uniform(sampler_uniform, (s32)unit);
+			textures.push_back({ unit, target, handle });
+			cmds.back().texture_count++;
+		}
+
+		// sorts and executes everything recorded, then clears, on the thread that owns the gl context
+		template <typename BACKEND>
+		void submit (BACKEND& gl) {
+			stats = Gl_Submit_Stats();
+
+			order.resize(cmds.size());
+			for (uptr i=0; i<cmds.size(); ++i)
+				order[i] = { cmds[i].barrier, sort_key(cmds[i]), cmds[i].seq };
+			std::sort(order.begin(), order.end(), [] (Sort_Entry const& l, Sort_Entry const& r) {
+				if (l.barrier != r.barrier) return l.barrier < r.barrier;
+				return l.key != r.key ? l.key < r.key : l.seq < r.seq;
+			});
+
+			Gl_State_Cache<BACKEND> cache (&gl, &stats);
+
+			// the draws are sorted by shader, so each lookup runs once per run of draws with the same one
+			shader_func_t	looked_up_func = nullptr;
+			Shader*			looked_up = nullptr;
+
+			u32 next_func = 0;
+			auto run_funcs = [&] (u32 until) {
+				for (; next_func < until; ++next_func) {
+					funcs[next_func]();
+					cache.reset(); // can change any gl state
+					looked_up_func = nullptr;
+					stats.funcs++;
+				}
+			};
+
+			for (auto& o : order) {
+				auto& c = cmds[o.seq];
+
+				run_funcs(c.barrier);
+
+				Shader* shader = c.shader;
+				if (!shader) {
+					if (c.shader_func != looked_up_func) {
+						looked_up_func = c.shader_func;
+						looked_up = c.shader_func();
+					}
+					shader = looked_up;
+					if (!shader)
+						continue;
+				}
+				Gpu_Mesh const* mesh = c.mesh ? c.mesh : c.mesh_func();
+
+				cache.set_state(c.state);
+				cache.use_shader(shader);
+
+				for (u32 i=0; i<c.texture_count; ++i)
+					cache.bind_texture(textures[c.first_texture +i]);
+				for (u32 i=0; i<c.uniform_count; ++i)
+					gl.set_uniform(shader, uniforms[c.first_uniform +i]);
+				stats.uniforms += (int)c.uniform_count;
+
+				cache.bind_mesh(mesh);
+				gl.draw(mesh, c.primitive);
+				stats.draws++;
+			}
+			run_funcs((u32)funcs.size());
+
+			clear();
+		}
+	};
+
+	// Backend that records the calls instead of making them, and the effective state of every draw, for testing without a gpu
+	struct Mock_Gl_Backend {
+		struct Call {
+			enum type_e {
+				SET_CAP, DEPTH_MASK, BLEND_FUNC, USE_SHADER, BIND_TEXTURE, SET_UNIFORM, BIND_MESH, DRAW,
+			};
+			type_e			type;
+			u64				a = 0, b = 0, c = 0;
+		};
+		struct Draw {
+			Render_State	state;
+			Shader*			shader;
+			Gpu_Mesh const*	mesh;
+			Shader*			mesh_shader;
+			u32				primitive;
+			u32				textures[MAX_CACHED_TEXTURE_UNITS]; // handle per unit
+		};
+
+		std::vector<Call>	calls;
+		std::vector<Draw>	draws;
+
+		Draw				cur = {}; // effective state
+
+		void set_cap (e_gl_cap cap, bool enable) {
+			calls.push_back({ Call::SET_CAP, (u64)cap, enable });
+			switch (cap) {
+				case CAP_BLEND:			cur.state.blend = enable;			break;
+				case CAP_DEPTH_TEST:	cur.state.depth_test = enable;		break;
+				case CAP_CULL_FACE:		cur.state.cull = enable;			break;
+				case CAP_SCISSOR_TEST:	cur.state.scissor_test = enable;	break;
+			}
+		}
+		void set_depth_mask (bool enable) {
+			calls.push_back({ Call::DEPTH_MASK, enable });
+			cur.state.depth_write = enable;
+		}
+		void set_blend_func_alpha () {
+			calls.push_back({ Call::BLEND_FUNC });
+		}
+		void use_shader (Shader* s) {
+			calls.push_back({ Call::USE_SHADER, (u64)(uptr)s });
+			cur.shader = s;
+		}
+		void bind_texture (int unit, u32 target, u32 handle) {
+			calls.push_back({ Call::BIND_TEXTURE, (u64)unit, target, handle });
+			cur.textures[unit] = handle;
+		}
+		void set_uniform (Shader* s, Cmd_Uniform const& u) {
+			calls.push_back({ Call::SET_UNIFORM, (u64)(uptr)s, (u64)(uptr)u.name, u.type });
+		}
+		void bind_mesh (Gpu_Mesh const* m, Shader* s) {
+			calls.push_back({ Call::BIND_MESH, (u64)(uptr)m, (u64)(uptr)s });
+			cur.mesh = m;
+			cur.mesh_shader = s;
+		}
+		void draw (Gpu_Mesh const* m, u32 primitive) {
+			calls.push_back({ Call::DRAW, (u64)(uptr)m, primitive });
+			cur.primitive = primitive;
+			draws.push_back(cur);
+		}
+
+		int count (Call::type_e type) const {
+			int n = 0;
+			for (auto& c : calls)
+				n += c.type == type ? 1 : 0;
+			return n;
+		}
+		void clear () {
+			calls.clear();
+			draws.clear();
+			cur = {};
+		}
+	};
+}
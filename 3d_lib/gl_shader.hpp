@@ -21,6 +21,12 @@ class Shader {
 
 	GLuint prog_handle = 0;
 
+	struct Uniform_Location {
+		std::string	name;
+		GLint		loc; // -1 if the uniform does not exist (or was optimized out)
+	};
+	std::vector<Uniform_Location> uniform_locs; // resolved on first use, a reload swaps in a new Shader, which clears them
+
 public:
 	~Shader () {
 		if (prog_handle) // maybe this helps to optimize out destructing of unalloced shaders
@@ -33,9 +39,20 @@ public:
 	}
 
 	GLuint	get_prog_handle () const {	return prog_handle; }
+
+	// cached glGetUniformLocation, shaders have few uniforms so a linear search beats the gl call
+	GLint get_uniform_location (cstr name) {
+		for (auto& u : uniform_locs)
+			if (strcmp(u.name.c_str(), name) == 0)
+				return u.loc;
+		GLint loc = glGetUniformLocation(prog_handle, name);
+		uniform_locs.push_back({ name, loc });
+		return loc;
+	}
 };
 inline void swap (Shader& l, Shader& r) {
 	::std::swap(l.prog_handle, r.prog_handle);
+	::std::swap(l.uniform_locs, r.uniform_locs);
 }
 
 #define INLINE_SHADER_RELOADING 1
@@ -515,7 +532,7 @@ void gl_set_uniform (GLint loc, bv4 val) {		glUniform4i(	loc, (int)val.x,(int)va
 template <typename T> void set_uniform (Shader* shad, std::string const& name, T val) {
 	assert(_current_used_shader == shad);
 
-	GLint loc = glGetUniformLocation(shad->get_prog_handle(), name.c_str());
+	GLint loc = shad->get_uniform_location(name.c_str());
 	if (loc >= 0) gl_set_uniform(loc, val);
 }
 
@@ -607,7 +624,7 @@ struct Uniform_Sharer {
 		assert(_current_used_shader == shad);
 
 		for (auto& su : shared_uniforms) {
-			GLint loc = glGetUniformLocation(shad->get_prog_handle(), su.first.c_str());
+			GLint loc = shad->get_uniform_location(su.first.c_str());
 			if (loc != -1) gl_set_uniform(loc, su.second);
 		}
 	}
@@ -551,7 +551,7 @@ Texture2D upload_texture (srgba8 color) {
 void bind_texture (Shader* shad, std::string const& uniform_name, int tex_unit, Texture const& tex, GLenum target) {
 	assert(_current_used_shader == shad);
 
-	auto loc = glGetUniformLocation(shad->get_prog_handle(), uniform_name.c_str());
+	auto loc = shad->get_uniform_location(uniform_name.c_str());
 	if (loc >= 0) {
 		glUniform1i(loc, tex_unit);
 
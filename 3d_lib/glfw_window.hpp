@@ -5,8 +5,13 @@
 #include "gl_rendertarget.hpp"
 #include "mylibs/timer.hpp"
 #include "mylibs/exp_moving_avg.hpp"
+#include "mylibs/fixed_timestep.hpp"
+#include "headless.hpp"
+#include "frame_pipeline.hpp"
+#include "utils.hpp" // gl_backend
 
 #include "save_file.hpp"
+#include "options.hpp"
 
 namespace engine {
 	using namespace simple_file_io;
@@ -75,10 +80,12 @@ namespace engine {
 		}
 	};
 
+#ifdef _WIN32
 	RectI to_rect (RECT win32_rect) {
 		return {	iv2(win32_rect.left,	win32_rect.top),
 			iv2(win32_rect.right,	win32_rect.bottom) };
 	}
+#endif
 
 	enum e_vsync_mode {
 		VSYNC_ON,
@@ -92,11 +99,16 @@ namespace engine {
 
 		e_vsync_mode		vsync_mode;
 
+	#ifdef _WIN32
 		WINDOWPLACEMENT		win32_windowplacement = {}; // Zeroed
+	#else
+		RectI				windowed_rect = {}; // where to go back to when leaving fullscreen, not saved across launches
+	#endif
 
 		bool				is_fullscreen = false;
 		iv2					fullscreen_resolution = -1; // -1 => native res
 
+	#ifdef _WIN32
 		void get_win32_windowplacement () {
 			GetWindowPlacement(glfwGetWin32Window(window), &win32_windowplacement);
 		}
@@ -119,13 +131,22 @@ namespace engine {
 		bool load_window_positioning () {
 			return load_fixed_size_binary_file("saves/window_placement.bin", &win32_windowplacement, sizeof(win32_windowplacement));
 		}
+	#else
+		void get_windowed_rect () {
+			iv2 pos, size;
+			glfwGetWindowPos(window, &pos.x,&pos.y);
+			glfwGetWindowSize(window, &size.x,&size.y);
+			windowed_rect = { pos, pos +size };
+		}
+	#endif
 
 		static void glfw_error_proc (int err, cstr msg) {
 			errprint("GLFW Error! 0x%x '%s'\n", err, msg);
 		}
 		static void button_event (GLFWwindow* window, int button, int action, int mods) {
-			Input* inp = &((Window*)glfwGetWindowUserPointer(window))->inp;
-
+			input_button_event(&((Window*)glfwGetWindowUserPointer(window))->inp, button, action);
+		}
+		static void input_button_event (Input* inp, int button, int action) {
 			bool went_down = action == GLFW_PRESS;
 			bool went_up = action == GLFW_RELEASE;
 			bool repeat = action == GLFW_REPEAT;
@@ -184,20 +205,76 @@ namespace engine {
 			inp->events.push_back({ Input::Event::TYPING });
 			inp->events.back().Typing.codepoint = (utf32)codepoint;
 		}
-		
+
+		void apply_input_script () {
+			headless_opt.script->next_frame([this] (Input_Script::Action const& a) {
+				switch (a.type) {
+					case Input_Script::Action::BUTTON: {
+						input_button_event(&inp, a.glfw_button, a.glfw_action);
+					} break;
+					case Input_Script::Action::MOUSE_POS: {
+						inp.mousecursor.delta_screen += a.vec -inp.mousecursor.pos_screen;
+						inp.mousecursor.pos_screen = a.vec;
+					} break;
+					case Input_Script::Action::MOUSEWHEEL: {
+						inp._mousewheel.delta += a.vec.y;
+
+						inp.events.push_back({ Input::Event::MOUSEWHEEL });
+						inp.events.back().Mousewheel.delta = a.vec.y;
+					} break;
+					case Input_Script::Action::TYPING: {
+						inp.events.push_back({ Input::Event::TYPING });
+						inp.events.back().Typing.codepoint = a.codepoint;
+					} break;
+				}
+			});
+		}
+
+		void init_gl () {
+			gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+
+			// setting up some commonly needed opengl state
+			if (GLAD_GL_ARB_debug_output) {
+				glDebugMessageCallbackARB(ogl_debuproc, 0);
+				glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
+
+				// without GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB ogl_debuproc needs to be thread safe
+			}
+
+			bool gl_vaos_required = true; // Having a VAO bound is required in opengl 3.3
+
+			GLuint vao; // one global vao for everything
+
+			if (gl_vaos_required) {
+				glGenVertexArrays(1, &vao); // if the user (more like the rest of the engine) does not bother to use VAOs we get a blackscreen if we don't bind one global VAO
+				glBindVertexArray(vao);
+			}
+
+			glEnable(GL_FRAMEBUFFER_SRGB); // we dont want to user to forget this and have a gamma incorrect pipeline
+		}
+
 	public:
 
+		bool				headless = false; // opened with open_headless(), no os window or input
+		Headless_Options	headless_opt;
+
 		Input				inp;
 
 		void set_fullscreen (bool want_fullscreen) {
+			if (headless) return;
 			if (!is_fullscreen && !want_fullscreen) return; // going from windowed to windowed
 
 			bool was_windowed = !is_fullscreen;
 
 			if (want_fullscreen) {
 
-				if (was_windowed)
+				if (was_windowed) {
+				#ifdef _WIN32
 					get_win32_windowplacement();
+				#else
+					get_windowed_rect();
+				#endif
+				}
 
 				GLFWmonitor* fullscreen_monitor = nullptr;
 				GLFWvidmode const* fullscreen_vidmode = nullptr;
@@ -246,11 +323,17 @@ namespace engine {
 			} else { // want windowed
 				assert(!was_windowed);
 
+			#ifdef _WIN32
 				auto r = to_rect(win32_windowplacement.rcNormalPosition);
+			#else
+				auto r = windowed_rect;
+			#endif
 				auto sz = r.get_size();
 				glfwSetWindowMonitor(window, NULL, r.low.x,r.low.y, sz.x,sz.y, GLFW_DONT_CARE);
 
+			#ifdef _WIN32
 				set_win32_windowplacement(); // Still refuses to return to maximized mode ??
+			#endif
 
 				//if (win32_windowplacement.showCmd == SW_MAXIMIZE) {
 				//	glfwMaximizeWindow(window); // Still refuses to return to maximized mode ????
@@ -274,7 +357,11 @@ namespace engine {
 
 			assert(glfwInit() != 0); // do not support multiple windows at the moment
 
+		#ifdef _WIN32
 			bool placement_loaded = load_window_positioning();
+		#else
+			bool placement_loaded = false;
+		#endif
 
 			is_fullscreen = false; // always start in windowed mode
 
@@ -283,19 +370,23 @@ namespace engine {
 			glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 			glfwWindowHint(GLFW_SRGB_CAPABLE, GLFW_TRUE);
 
-			bool gl_vaos_required = true; // Having a VAO bound is required in opengl 3.3
-
 			glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, 1);
 
+		#ifdef _WIN32
 			s32v2 size = placement_loaded ? to_rect(win32_windowplacement.rcNormalPosition).get_size() : default_size;
+		#else
+			s32v2 size = default_size;
+		#endif
 
 			window = glfwCreateWindow(size.x,size.y, title.c_str(), NULL, NULL);
 
 			glfwSetWindowUserPointer(window, this);
 
+		#ifdef _WIN32
 			if (placement_loaded) {
 				set_win32_windowplacement();
 			}
+		#endif
 
 			glfwSetCursorPosCallback(window,		glfw_mouse_pos_event);
 			glfwSetMouseButtonCallback(window,		glfw_mouse_button_event);
@@ -305,29 +396,65 @@ namespace engine {
 
 			glfwMakeContextCurrent(window);
 
-			gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+			init_gl();
 
-			// setting up some commonly needed opengl state
-			if (GLAD_GL_ARB_debug_output) {
-				glDebugMessageCallbackARB(ogl_debuproc, 0);
-				glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
+			set_vsync(vsync_mode);
+		}
+		// gl context without a visible window, input comes from opt.script, does not touch any win32 handles or the saved window placement
+		bool open_headless (std::string const& title, Headless_Options const& opt) {
+			assert(window == nullptr);
 
-				// without GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB ogl_debuproc needs to be thread safe
+			headless = true;
+			headless_opt = opt;
+
+			glfwSetErrorCallback(glfw_error_proc);
+
+		#ifdef GLFW_PLATFORM_NULL // glfw 3.4: no display server needed at all
+			if (opt.context != HEADLESS_HIDDEN_WINDOW)
+				glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+		#endif
+
+			if (!glfwInit()) {
+				errprint("open_headless: glfwInit failed\n");
+				return false;
 			}
 
-			GLuint vao; // one global vao for everything
+			glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+			glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+			glfwWindowHint(GLFW_SRGB_CAPABLE, GLFW_TRUE);
+			glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, 1);
 
-			if (gl_vaos_required) {
-				glGenVertexArrays(1, &vao); // if the user (more like the rest of the engine) does not bother to use VAOs we get a blackscreen if we don't bind one global VAO
-				glBindVertexArray(vao);
+			if (opt.context == HEADLESS_OSMESA) {
+			#ifdef GLFW_OSMESA_CONTEXT_API // glfw 3.3
+				glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+			#else
+				errprint("open_headless: this glfw version has no OSMesa support, using the native context api\n");
+			#endif
+			} else if (opt.context == HEADLESS_EGL)
+				glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+
+			window = glfwCreateWindow(opt.size.x,opt.size.y, title.c_str(), NULL, NULL);
+			if (!window) {
+				errprint("open_headless: could not create the gl context\n");
+				glfwTerminate();
+				return false;
 			}
 
-			glEnable(GL_FRAMEBUFFER_SRGB); // we dont want to user to forget this and have a gamma incorrect pipeline
+			glfwSetWindowUserPointer(window, this);
+			glfwMakeContextCurrent(window);
 
-			set_vsync(vsync_mode);
+			init_gl();
+
+			set_vsync(VSYNC_OFF);
+			return true;
 		}
 		void close () {
-			save_window_positioning();
+		#ifdef _WIN32
+			if (!headless)
+				save_window_positioning();
+		#endif
 
 			glfwDestroyWindow(window);
 			window = nullptr;
@@ -352,27 +479,34 @@ namespace engine {
 
 			inp.events.clear();
 
-			glfwSetInputMode(window, GLFW_CURSOR, mouse_cursor_enabled ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED);
+			if (headless) {
+				if (headless_opt.script)
+					apply_input_script();
 
-			glfwPollEvents();
+				inp.wnd_size_px = headless_opt.size;
+			} else {
+				glfwSetInputMode(window, GLFW_CURSOR, mouse_cursor_enabled ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED);
 
-			glfwGetFramebufferSize(window, &inp.wnd_size_px.x,&inp.wnd_size_px.y);
-			set_shared_uniform("common", "window_size", (v2)inp.wnd_size_px);
+				glfwPollEvents();
+
+				glfwGetFramebufferSize(window, &inp.wnd_size_px.x,&inp.wnd_size_px.y);
 
-			{
 				double x,y;
 				glfwGetCursorPos(window, &x, &y);
 				inp.mousecursor.pos_screen = v2((flt)x,(flt)y);
-
-				set_shared_uniform("common", "mcursor_pos_window", inp.mouse_cursor_pos_px());
 			}
 
+			set_shared_uniform("common", "window_size", (v2)inp.wnd_size_px);
+			set_shared_uniform("common", "mcursor_pos_window", inp.mouse_cursor_pos_px());
+
 			inp.reset_blocked();
 
 			return inp;
 		}
 
 		bool wants_to_close () {
+			if (headless)
+				return false; // runs for a fixed frame count
 			return glfwWindowShouldClose(window) != 0; // also handles ALT+F4
 		}
 
@@ -392,7 +526,10 @@ namespace engine {
 		}
 
 		void swap_buffers () {
-			glfwSwapBuffers(window);
+			if (headless)
+				glFinish(); // nothing to present, but wait for the gpu so that the frame times include the rendering
+			else
+				glfwSwapBuffers(window);
 		}
 
 	};
@@ -412,8 +549,11 @@ namespace engine {
 			app->run_frame();
 		}
 		void run_frame () {
+			gpu_profiler::get_gpu_profiler().frame();
+			profiler::frame();
 			
 			{
+				PROFILE_SCOPED("poll_input");
 				_allow_run_frame_recursion++;
 
 				poll_input(this->inp.gui_input_enabled);
@@ -421,12 +561,18 @@ namespace engine {
 				_allow_run_frame_recursion--;
 			}
 
+			{
+				PROFILE_SCOPED("pipeline_wait");
+				pipeline.wait(); // the worker is idle from here until kick(), so loading Save and Options, the ui and fixed_step can touch the app state
+			}
+
 			if (inp.went_down(GLFW_KEY_F11))
 				toggle_fullscreen();
 
 			bool trigger_load = inp.alt_combo('L') || frame_i == 0;
 			bool trigger_save = inp.alt_combo('S');
 			save = save_file("saves/save.xml", trigger_load, trigger_save);
+			options.begin_frame(trigger_load);
 
 			static bool imgui_enabled = true;
 			if (inp.went_down(GLFW_KEY_F2))
@@ -436,6 +582,8 @@ namespace engine {
 
 			begin_imgui(&inp, dt, inp.gui_input_enabled, imgui_enabled);
 
+			flt real_dt = dt; // not clamped, for the fixed timestep
+
 			{
 				flt fps = 1.0f / dt;
 
@@ -447,7 +595,7 @@ namespace engine {
 					fps_avg.update(fps, dt);
 				}
 
-				ImGui::Text("%8.3f fps  %8.3f ms (%8.3f)", fps_avg.value, dt_avg.value * 1000, dt * 1000);
+				ImGui::Text("%8.3f fps  %8.3f ms (%8.3f)  gpu %8.3f ms", fps_avg.value, dt_avg.value * 1000, dt * 1000, gpu_profiler::get_gpu_profiler().avg_frame_ms());
 
 				{
 					static flt values_per_pixel = 0.5f;
@@ -501,6 +649,11 @@ namespace engine {
 				dt = MIN(dt, 1.0f / 20); // prevent big timestep when paused or frozen for whatever reason
 			}
 
+			imgui_profiler();
+			imgui_fixed_timestep();
+			imgui_frame_pipeline();
+			imgui_options();
+
 			//if (	(inp.buttons[GLFW_MOUSE_BUTTON_RIGHT].went_down && !ImGui::IsWindowHovered(ImGuiHoveredFlags_AnyWindow)) // unfocus imgui windows when right clicking outside of them
 			//	|| dsp->frame_i < 3 || !imgui_enabled || !inp.gui_input_enabled ) { // imgui steals focus on the third frame for some reason
 			//	ImGui::ClearActiveID();
@@ -531,25 +684,111 @@ namespace engine {
 
 			imgui::Separator();
 
-			frame();
+			auto sim_and_prepare = [this, real_dt] (Gl_Command_Buffer& cmds) {
+				{
+					PROFILE_SCOPED("tick");
+					fixed_step.frame(real_dt, [this] (flt dt) { tick(dt); });
+				}
+				{
+					PROFILE_SCOPED("prepare");
+					prepare(cmds);
+				}
+			};
+
+			if (pipeline.enabled) {
+				{
+					GPU_PROFILE_SCOPED("frame");
+					frame();
+				}
 
-			draw_to_screen(inp.wnd_size_px);
-			end_imgui(inp.wnd_size_px);
+				pipeline.kick(sim_and_prepare); // ticks and records the next frame while we submit this one
+
+				{
+					GPU_PROFILE_SCOPED("submit");
+					pipeline.submit(gl_backend);
+				}
+			} else {
+				{
+					PROFILE_SCOPED("tick");
+					fixed_step.frame(real_dt, [this] (flt dt) { tick(dt); });
+				}
+				{
+					GPU_PROFILE_SCOPED("frame");
+					frame();
+				}
+				{
+					GPU_PROFILE_SCOPED("prepare");
+					pipeline.run_serial([this] (Gl_Command_Buffer& cmds) { prepare(cmds); }, gl_backend);
+				}
+			}
+
+			{
+				GPU_PROFILE_SCOPED("imgui");
+				draw_to_screen(inp.wnd_size_px);
+				end_imgui(inp.wnd_size_px);
+			}
 
 			save->end_frame();
+			options.end_frame(trigger_save);
+
+			{
+				PROFILE_SCOPED("swap_buffers");
+				swap_buffers();
+			}
+
+			dt = headless ? headless_opt.dt : dt_measure.frame();
+		}
+
+		void imgui_fixed_timestep () {
+			if (!ImGui::CollapsingHeader("Fixed timestep"))
+				return;
+
+			auto& f = fixed_step;
+
+			bool fast = f.mode == AS_FAST_AS_POSSIBLE;
+			if (ImGui::Checkbox("as fast as possible", &fast))
+				f.mode = fast ? AS_FAST_AS_POSSIBLE : REAL_TIME;
+			ImGui::SameLine();
+			ImGui::Checkbox("paused", &f.paused);
 
-			swap_buffers();
+			ImGui::DragFloat("tick_rate", &f.tick_rate, 0.1f, 0.1f, 10000);
+			ImGui::DragFloat("time_scale", &f.time_scale, 0.01f, 0, 100);
+			ImGui::DragInt("max_ticks_per_frame", &f.max_ticks_per_frame, 0.1f, 1, 1000);
 
-			dt = dt_measure.frame();
+			ImGui::Text("sim time %.2f s  ticks %llu  this frame %d  dropped %llu", f.sim_time, (unsigned long long)f.tick_i, f.frame_ticks, (unsigned long long)f.dropped_ticks);
+		}
+
+		void imgui_frame_pipeline () {
+			if (!ImGui::CollapsingHeader("Frame pipeline"))
+				return;
+
+			auto& p = pipeline;
+
+			ImGui::Checkbox("pipelined (tick + prepare on a worker thread, one frame of latency)", &p.enabled);
+
+			ImGui::Text("tick+prepare %.3f ms  wait %.3f ms  submit %.3f ms (%llu cmds)", p.job_ms, p.wait_ms, p.submit_ms, (unsigned long long)p.submitted_cmds);
+			ImGui::TextWrapped("%s", p.submit_stats.to_string().c_str());
+		}
+
+		void imgui_options () {
+			if (options.count() == 0 || !ImGui::CollapsingHeader("Options"))
+				return;
+
+			options.imgui();
 		}
 
 	public:
 		
 		virtual ~Application () {}
 
-		flt					dt;
+		flt					dt; // frame time, clamped to 1/20 s
 		int					frame_i;
 
+		Fixed_Timestep		fixed_step; // calls tick()
+		Frame_Pipeline		pipeline; // enable to run tick() and prepare() of the next frame on a worker thread
+
+		Options				options {"saves/options"}; // add() the options once (as members of the app for ex.), loaded and saved with the same alt+L / alt+S as save
+
 		void run () {
 
 			// This still pauses when you move the window by clicking on the titlebar, but then don't move the mouse
@@ -557,6 +796,8 @@ namespace engine {
 			glfwSetWindowPosCallback(		window, [] (GLFWwindow* window, int x, int y) { glfw_resize_or_move_event(window); } );
 			glfwSetWindowRefreshCallback(	window, [] (GLFWwindow* window) {				glfw_resize_or_move_event(window); } );
 
+			profiler::set_thread_name("main");
+
 			dt = dt_measure.begin();
 
 			for (frame_i=0;; ++frame_i) {
@@ -566,9 +807,71 @@ namespace engine {
 				if (wants_to_close())
 					break;
 			}
+
+			pipeline.wait(); // the job uses the app, which is destroyed after we return
+		}
+
+		// open_headless(), run opt.frames frames with a fixed dt and input from opt.script, then print (and write) the Timing_Report
+		//  returns false if the gl context could not be created or the report or trace could not be written
+		bool run_headless (std::string const& title, Headless_Options const& opt) {
+			if (!open_headless(title, opt))
+				return false;
+
+			profiler::set_thread_name("main");
+
+			auto& prof = profiler::get_profiler();
+			if (opt.trace_filepath)
+				prof.start_recording();
+
+			Timing_Report report;
+
+			dt = opt.dt;
+
+			u64 frame_ns = 0;
+			for (frame_i=0; frame_i<opt.frames; ++frame_i) {
+				u64 begin = profiler::now_ns();
+
+				run_frame(); // profiler::frame() at its start collects the zones of the previous frame
+
+				if (frame_i > opt.warmup_frames)
+					report.add_frame(frame_ns, prof.zones);
+
+				frame_ns = profiler::now_ns() -begin;
+			}
+
+			pipeline.wait();
+
+			profiler::frame(); // zones of the last frame
+			if (opt.frames > opt.warmup_frames)
+				report.add_frame(frame_ns, prof.zones);
+
+			printf("%s: %d frames (+%d warmup) at dt %g, %dx%d\n%s", title.c_str(), report.frames, opt.frames -report.frames, opt.dt, opt.size.x, opt.size.y, report.to_text().c_str());
+
+			bool ok = true;
+			if (opt.report_filepath && !write_text_file(opt.report_filepath, report.to_json(opt))) {
+				errprint("run_headless: could not write report to %s\n", opt.report_filepath);
+				ok = false;
+			}
+			if (opt.trace_filepath && !prof.write_chrome_trace(opt.trace_filepath)) {
+				errprint("run_headless: could not write trace to %s\n", opt.trace_filepath);
+				ok = false;
+			}
+
+			close();
+			return ok;
 		}
 
 		virtual void frame () = 0;
+
+		// fixed_step.tick_rate times per second of sim time before frame(), dt is always fixed_step.tick_dt()
+		//  put simulations here so they do not depend on the frame rate, frame() can interpolate between ticks with fixed_step.alpha()
+		virtual void tick (flt dt) {}
+
+		// record the gl work of the frame into cmds, runs after frame() (and the ticks)
+		//  with pipeline.enabled this (and tick()) runs on a worker thread while the main thread submits the previous frame
+		//  so it must not make gl calls, use imgui or read inp, and frame() is the place to change the state it uses (the worker is idle during frame())
+		//  the draw helpers of utils.hpp can record into cmds, they look up their shaders and meshes on submit
+		virtual void prepare (Gl_Command_Buffer& cmds) {}
 	};
 
 }
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "engine_include.hpp"
+#include "mylibs/profiler.hpp"
+
+// GPU timing of render passes with GL_TIME_ELAPSED queries, the results show up in the profiler as a "gpu" track next to the cpu threads
+//  results are read LATENCY frames after the queries were issued, so we never stall waiting for the gpu
+//  use it at pass scope (Application times frame, prepare, submit and imgui), a query per draw call costs more than small draws themselves
+//  GL_TIME_ELAPSED queries can not nest, nested gpu zones are ignored (their cpu zone is still recorded)
+//  gpu and cpu clocks are not synchronized, so in the trace gpu zones are placed at the time they were submitted on the cpu (or right after the previous gpu zone)
+namespace engine {
+namespace gpu_profiler {
+
+	static constexpr int LATENCY = 4; // frames
+
+	struct Pending_Query {
+		cstr	name;
+		GLuint	query;
+		u64		cpu_begin; // profiler::now_ns() at submit
+	};
+
+	class Gpu_Profiler {
+		NO_MOVE_COPY_CLASS(Gpu_Profiler)
+
+		std::vector<GLuint>			free_queries;
+		std::vector<Pending_Query>	pending[LATENCY]; // queries issued per frame
+		int							cur_frame = 0; // into pending
+
+		bool						query_active = false;
+
+		profiler::Thread_Buffer*	track = nullptr;
+		u64							prev_end = 0; // of the last gpu zone on the trace timeline
+
+	public:
+		u64							results_not_ready = 0; // queries dropped because their results were still not available after LATENCY frames
+		u64							results_invalid = 0; // queries dropped because they took longer than the time since they were submitted (seen with the first query of a context on llvmpipe)
+
+		bool begin (cstr name) { // returns false if ignored
+			if (query_active)
+				return false;
+
+			GLuint q;
+			if (free_queries.size() > 0) {
+				q = free_queries.back();
+				free_queries.pop_back();
+			} else {
+				glGenQueries(1, &q);
+			}
+
+			glBeginQuery(GL_TIME_ELAPSED, q);
+			query_active = true;
+
+			pending[cur_frame].push_back({ name, q, profiler::now_ns() });
+			return true;
+		}
+		void end () {
+			glEndQuery(GL_TIME_ELAPSED);
+			query_active = false;
+		}
+
+		// call once per frame before profiler::frame()
+		void frame () {
+			if (!track)
+				track = profiler::get_profiler().register_track("gpu");
+
+			cur_frame = (cur_frame +1) % LATENCY;
+
+			u64 now = profiler::now_ns();
+
+			// read the queries of the oldest frame, which then get reused for this frame
+			for (auto& q : pending[cur_frame]) {
+				GLint available = 0;
+				glGetQueryObjectiv(q.query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+				if (!available) {
+					results_not_ready++;
+				} else {
+					GLuint64 elapsed_ns = 0;
+					glGetQueryObjectui64v(q.query, GL_QUERY_RESULT, &elapsed_ns);
+
+					if (elapsed_ns > now -q.cpu_begin) {
+						results_invalid++;
+						free_queries.push_back(q.query);
+						continue;
+					}
+
+					u64 begin = MAX(q.cpu_begin, prev_end);
+					track->push({ q.name, begin, begin +elapsed_ns, 0 });
+					prev_end = begin +elapsed_ns;
+				}
+
+				free_queries.push_back(q.query);
+			}
+			pending[cur_frame].clear();
+		}
+
+		// averaged gpu time of all zones per frame
+		flt avg_frame_ms () {
+			auto& zones = profiler::get_profiler().zones;
+			if (!track || track->indx >= zones.size() || zones[track->indx].nodes.size() == 0)
+				return 0;
+			return zones[track->indx].nodes[0].avg_total_ms;
+		}
+	};
+
+	Gpu_Profiler& get_gpu_profiler () {
+		static Gpu_Profiler p;
+		return p;
+	}
+
+	// cpu zone + gpu timer query
+	class Gpu_Zone {
+		profiler::Zone	cpu;
+		bool			gpu;
+
+	public:
+		Gpu_Zone (cstr name): cpu{name} {
+			gpu = get_gpu_profiler().begin(name);
+		}
+		~Gpu_Zone () {
+			if (gpu)
+				get_gpu_profiler().end();
+		}
+
+		Gpu_Zone (Gpu_Zone const&) = delete;
+		Gpu_Zone& operator= (Gpu_Zone const&) = delete;
+	};
+}
+}
+
+#define _GPU_PROFILE_SCOPED(name, counter) engine::gpu_profiler::Gpu_Zone CONCAT(_gpu_profile_zone, counter) (name)
+#define GPU_PROFILE_SCOPED(name) _GPU_PROFILE_SCOPED(name, __COUNTER__) // name has to be a string literal
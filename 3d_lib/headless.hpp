@@ -0,0 +1,254 @@
+#pragma once
+
+#include "engine_include.hpp"
+#include "mylibs/profiler.hpp"
+
+#include <functional>
+#include <algorithm>
+
+// Headless mode of Application (Application::run_headless), for benchmarks and CI
+//  no visible window, the gl context is created by glfw through OSMesa (software, no display needed) or EGL (surfaceless with glfw 3.4) or on a hidden window
+//  input comes from an Input_Script instead of the os, dt is fixed and a fixed number of frames is run, so runs are reproducible
+//  afterwards a Timing_Report of the whole frame and every profiler zone (min/avg/median/p95/max) is printed and optionally written as json
+namespace engine {
+
+	enum e_headless_context {
+		HEADLESS_OSMESA, // software rendering, works without any display or gpu
+		HEADLESS_EGL, // gpu rendering without a display server (glfw 3.4 null platform + EGL surfaceless)
+		HEADLESS_HIDDEN_WINDOW, // invisible native window, needs a display (eg. Xvfb)
+	};
+
+	// Input to feed into the app instead of the os input, actions are applied in poll_input() of the frame they are scheduled for
+	struct Input_Script {
+		struct Action {
+			enum type_e {
+				BUTTON,
+				MOUSE_POS,
+				MOUSEWHEEL,
+				TYPING,
+			};
+
+			int		frame;
+			type_e	type;
+
+			int		glfw_button;
+			int		glfw_action; // GLFW_PRESS or GLFW_RELEASE
+			v2		vec; // MOUSE_POS: position (top-down px), MOUSEWHEEL: y = delta
+			utf32	codepoint;
+		};
+
+		std::vector<Action>	actions; // ordered by frame
+		uptr				cur = 0; // next action to apply
+		int					frame = 0; // next frame to apply
+
+		// optional, called every frame before the actions of that frame are applied, to schedule input that depends on the app state
+		std::function<void (int frame, Input_Script& script)>	generate;
+
+		void add (Action const& a) {
+			auto it = std::upper_bound(actions.begin() +cur, actions.end(), a.frame, [] (int frame, Action const& r) { return frame < r.frame; });
+			actions.insert(it, a);
+		}
+
+		// press the button on frame and release it hold_frames later, glfw_button is a GLFW_KEY_* or GLFW_MOUSE_BUTTON_*
+		void button (int frame, int glfw_button, int hold_frames=1) {
+			Action a = {};
+			a.type = Action::BUTTON;
+			a.glfw_button = glfw_button;
+
+			a.frame = frame;
+			a.glfw_action = GLFW_PRESS;
+			add(a);
+
+			a.frame = frame +hold_frames;
+			a.glfw_action = GLFW_RELEASE;
+			add(a);
+		}
+		void mouse_pos (int frame, v2 pos_screen) {
+			Action a = {};
+			a.type = Action::MOUSE_POS;
+			a.frame = frame;
+			a.vec = pos_screen;
+			add(a);
+		}
+		void mousewheel (int frame, flt delta) {
+			Action a = {};
+			a.type = Action::MOUSEWHEEL;
+			a.frame = frame;
+			a.vec = v2(0, delta);
+			add(a);
+		}
+		void type_text (int frame, cstr ascii) {
+			for (; *ascii; ++ascii) {
+				Action a = {};
+				a.type = Action::TYPING;
+				a.frame = frame;
+				a.codepoint = (utf32)*ascii;
+				add(a);
+			}
+		}
+
+		// calls func for every action of the next frame
+		template <typename FUNC>
+		void next_frame (FUNC func) {
+			if (generate)
+				generate(frame, *this);
+
+			for (; cur < actions.size() && actions[cur].frame <= frame; ++cur)
+				func(actions[cur]);
+
+			frame++;
+		}
+	};
+
+	struct Headless_Options {
+		int					frames = 600;
+		int					warmup_frames = 10; // not counted in the report (shader compiles, first uploads etc.)
+		flt					dt = 1.0f / 60; // dt passed to the app every frame
+
+		iv2					size = iv2(1280,720); // framebuffer size
+		e_headless_context	context = HEADLESS_OSMESA;
+
+		Input_Script*		script = nullptr;
+
+		cstr				report_filepath = nullptr; // json timing report
+		cstr				trace_filepath = nullptr; // chrome trace of the whole run
+	};
+
+	static constexpr flt ZONE_NOT_RUN = -1; // Timing_Report::Series::ms of a frame the zone did not run in
+
+	// Per frame timings of the whole frame and all profiler zones (on all threads) of a headless run
+	struct Timing_Report {
+		struct Series {
+			std::string			name; // "frame" or "thread/zone/child zone"
+			std::vector<flt>	ms; // per frame, ZONE_NOT_RUN if the zone did not run in that frame
+		};
+
+		struct Stats {
+			flt		min, avg, median, p95, max;
+		};
+
+		int						frames = 0;
+		std::vector<Series>		series;
+
+		Series* get (std::string const& name) {
+			for (auto& s : series)
+				if (s.name == name)
+					return &s;
+			series.push_back({ name, std::vector<flt>(frames, ZONE_NOT_RUN) });
+			return &series.back();
+		}
+
+		void _add_zones (std::vector<profiler::Zone_Node> const& nodes, u32 node, std::string const& path) {
+			for (u32 c : nodes[node].children) {
+				std::string name = path +"/" +nodes[c].name;
+				get(name)->ms.back() = (flt)nodes[c].total_ns * 1e-6f;
+				_add_zones(nodes, c, name);
+			}
+		}
+
+		// zones have to be the ones of the frame (so call after the profiler::frame() following it)
+		void add_frame (u64 frame_ns, std::vector<profiler::Thread_Zones> const& zones) {
+			frames++;
+			for (auto& s : series)
+				s.ms.push_back(ZONE_NOT_RUN);
+
+			get("frame")->ms.back() = (flt)frame_ns * 1e-6f;
+
+			for (uptr t=0; t<zones.size(); ++t) {
+				if (zones[t].nodes.size() == 0)
+					continue;
+				_add_zones(zones[t].nodes, 0, profiler::get_profiler().thread_name(t));
+			}
+		}
+
+		// over the frames the zone ran in, a zone that only runs sometimes would otherwise have a min (and maybe median) of 0
+		static Stats stats (std::vector<flt> ms) {
+			ms.erase(std::remove(ms.begin(), ms.end(), ZONE_NOT_RUN), ms.end());
+
+			Stats s = {};
+			if (ms.size() == 0)
+				return s;
+
+			std::sort(ms.begin(), ms.end());
+
+			double sum = 0;
+			for (flt t : ms)
+				sum += t;
+
+			s.min = ms.front();
+			s.max = ms.back();
+			s.avg = (flt)(sum / (double)ms.size());
+			s.median = ms[ms.size() / 2];
+			s.p95 = ms[MIN((uptr)((double)ms.size() * 0.95), ms.size() -1)];
+			return s;
+		}
+
+		std::string to_text () {
+			std::string str = prints("%-48s %9s %9s %9s %9s %9s\n", "[ms]", "min", "avg", "median", "p95", "max");
+			for (auto& ser : series) {
+				auto s = stats(ser.ms);
+				prints(&str, "%-48s %9.3f %9.3f %9.3f %9.3f %9.3f\n", ser.name.c_str(), s.min, s.avg, s.median, s.p95, s.max);
+			}
+			return str;
+		}
+
+		std::string to_json (Headless_Options const& opt) {
+			std::string json = prints("{\"frames\":%d,\"dt\":%g,\"size\":[%d,%d],\"zones\":{\n", frames, opt.dt, opt.size.x, opt.size.y);
+			for (uptr i=0; i<series.size(); ++i) {
+				auto s = stats(series[i].ms);
+				prints(&json, "\"%s\":{\"min_ms\":%.4f,\"avg_ms\":%.4f,\"median_ms\":%.4f,\"p95_ms\":%.4f,\"max_ms\":%.4f}%s\n",
+					series[i].name.c_str(), s.min, s.avg, s.median, s.p95, s.max, i < series.size() -1 ? "," : "");
+			}
+			json += "}}\n";
+			return json;
+		}
+	};
+
+	// --headless [--frames N] [--warmup N] [--dt seconds] [--size WxH] [--context osmesa|egl|hidden] [--report file.json] [--trace file.json]
+	//  returns true if --headless was passed
+	bool parse_headless_args (int argc, char** argv, Headless_Options* opt) {
+		bool headless = false;
+
+		for (int i=1; i<argc; ++i) {
+			cstr arg = argv[i];
+			cstr val = i +1 < argc ? argv[i +1] : nullptr;
+
+			auto has_val = [&] () {
+				if (!val) {
+					errprint("parse_headless_args: %s needs a value\n", arg);
+					return false;
+				}
+				++i;
+				return true;
+			};
+
+			if (strcmp(arg, "--headless") == 0) {
+				headless = true;
+			} else if (strcmp(arg, "--frames") == 0) {
+				if (has_val()) opt->frames = atoi(val);
+			} else if (strcmp(arg, "--warmup") == 0) {
+				if (has_val()) opt->warmup_frames = atoi(val);
+			} else if (strcmp(arg, "--dt") == 0) {
+				if (has_val()) opt->dt = (flt)atof(val);
+			} else if (strcmp(arg, "--size") == 0) {
+				if (has_val() && sscanf(val, "%dx%d", &opt->size.x, &opt->size.y) != 2)
+					errprint("parse_headless_args: --size expects WxH, got '%s'\n", val);
+			} else if (strcmp(arg, "--context") == 0) {
+				if (has_val()) {
+					if (		strcmp(val, "osmesa") == 0)	opt->context = HEADLESS_OSMESA;
+					else if (	strcmp(val, "egl") == 0)	opt->context = HEADLESS_EGL;
+					else if (	strcmp(val, "hidden") == 0)	opt->context = HEADLESS_HIDDEN_WINDOW;
+					else errprint("parse_headless_args: unknown --context '%s'\n", val);
+				}
+			} else if (strcmp(arg, "--report") == 0) {
+				if (has_val()) opt->report_filepath = val;
+			} else if (strcmp(arg, "--trace") == 0) {
+				if (has_val()) opt->trace_filepath = val;
+			} else {
+				errprint("parse_headless_args: unknown argument '%s'\n", arg);
+			}
+		}
+
+		return headless;
+	}
+}
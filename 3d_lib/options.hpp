@@ -1,84 +1,414 @@
 #pragma once
 
 #include "engine_include.hpp"
-#include "engine_dear_imgui.hpp"
-#include "engine_options_graph.hpp"
+#include "dear_imgui.hpp"
+#include "save_file.hpp" // write_file_atomic
 
-// Convenient way to have variables that are tweakable per gui and saveable to disk 
+#include "deps/rapidxml/rapidxml.hpp"
+#include "deps/rapidxml/rapidxml_print.hpp"
+
+#include <tuple>
+#include <iterator>
+#include <unordered_map>
+
+// Convenient way to have variables that are tweakable per gui and saveable to disk
+//  options are registered once with add(), which returns a typed handle, type and unit are part of the handle type
+//  so reading or writing an option is just an index into a contiguous array of that type (no lookup by name, no switch over the type, no strings)
+//  the imgui and the file io go through a reflection view (Options::Info + Type_Ops), which is the only place that deals with the types at runtime
+//
+//  Options opt ("saves/options");
+//  auto vfov = opt.add<flt, ANGLE>("vfov", deg(75));
+//  ...
+//  cam.vfov = opt[vfov];
 
 namespace engine {
 namespace options {
+//
+
+enum type_e : u16 {
+	STRING=0,
+
+	INT_, IV2, IV3, IV4,
+	FLT, FV2, FV3, FV4,
+	BOOL, BV2, BV3, BV4,
+
+	TYPE_E_COUNT
+};
+enum unit_e : u16 {
+	DIMENSIONLESS=0,
+	ANGLE, // stored as radiants, but shown and saved in degrees
+};
+
+static cstr typename_ (type_e t) {
+	static cstr names[TYPE_E_COUNT] = { "string", "int","iv2","iv3","iv4", "flt","v2","v3","v4", "bool","bv2","bv3","bv4" };
+	return t < TYPE_E_COUNT ? names[t] : "-- error --";
+}
+
+// compile time type info, vectors are accessed as an array of their scalar type
+template <typename T> struct Option_Type;
+#define OPTION_TYPE(T, TYPE, SCALAR, COUNT) \
+	template<> struct Option_Type<T> { typedef SCALAR scalar; enum { COUNT_ = COUNT }; static type_e type () { return TYPE; } };
+
+OPTION_TYPE(std::string,	STRING,	char, 0)
+OPTION_TYPE(int,			INT_,	int, 1)
+OPTION_TYPE(iv2,			IV2,	int, 2)
+OPTION_TYPE(iv3,			IV3,	int, 3)
+OPTION_TYPE(iv4,			IV4,	int, 4)
+OPTION_TYPE(flt,			FLT,	flt, 1)
+OPTION_TYPE(v2,				FV2,	flt, 2)
+OPTION_TYPE(v3,				FV3,	flt, 3)
+OPTION_TYPE(v4,				FV4,	flt, 4)
+OPTION_TYPE(bool,			BOOL,	bool, 1)
+OPTION_TYPE(bv2,			BV2,	bool, 2)
+OPTION_TYPE(bv3,			BV3,	bool, 3)
+OPTION_TYPE(bv4,			BV4,	bool, 4)
+
+#undef OPTION_TYPE
+
+//// print value into text format
+std::string print_scalars (int const* v, int count, unit_e unit) {
+	std::string str;
+	for (int i=0; i<count; ++i)
+		prints(&str, "%d%s", v[i], i == (count -1) ? "":", ");
+	return str;
+}
+std::string print_scalars (flt const* v, int count, unit_e unit) {
+	std::string str;
+	for (int i=0; i<count; ++i)
+		if (unit == ANGLE)
+			prints(&str, "%g deg%s", to_deg(v[i]), i == (count -1) ? "":", ");
+		else
+			prints(&str, "%g%s", v[i], i == (count -1) ? "":", ");
+	return str;
+}
+std::string print_scalars (bool const* v, int count, unit_e unit) {
+	std::string str;
+	for (int i=0; i<count; ++i)
+		prints(&str, "%s%s", v[i] ? "true":"false", i == (count -1) ? "":", ");
+	return str;
+}
+
+template <typename T> std::string print_value (T const& v, unit_e unit) {
+	return print_scalars((typename Option_Type<T>::scalar const*)&v, Option_Type<T>::COUNT_, unit);
+}
+std::string print_value (std::string const& v, unit_e unit) {
+	return v;
+}
+
+//// parse value from text format, a single component is broadcast to all components
+template <typename T, typename F>
+bool _parse_vec (std::string const& s, T* out, int comp_count, F parse_scalar) {
+	T buf[4];
+	assert(comp_count <= ARRLEN(buf));
+
+	using namespace n_parse;
+	char* cur = (char*)s.c_str();
+
+	int i;
+	for (i=0; i<comp_count;) {
+		whitespace(&cur);
+
+		if (!parse_scalar(&cur, &buf[i]))
+			return false;
+
+		whitespace(&cur);
+
+		++i;
+		if (!character(&cur, ','))
+			break;
+	}
+
+	int comp_found = i;
+
+	if (!(comp_found == 1 || comp_found == comp_count))
+		return false;
+
+	if (!end_of_input(cur))
+		return false;
+
+	for (int i=0; i<comp_count; ++i) {
+		out[i] = buf[ comp_found == 1 ? 0 : i ];
+	}
+	return true;
+}
+bool parse_scalars (std::string const& s, int* out, int count, unit_e unit) {
+	return _parse_vec(s, out, count, n_parse::signed_int);
+}
+bool parse_scalars (std::string const& s, flt* out, int count, unit_e unit) {
+	return _parse_vec(s, out, count, [&] (char** pcur, flt* out) -> bool {
+			using namespace n_parse;
+			char* cur = *pcur;
+
+			flt f;
+
+			if (!float32(&cur, &f))
+				return false;
+
+			whitespace(&cur);
+
+			if (unit == ANGLE) {
+				if (identifier_ignore_case(&cur, "rad")) {
+					// alread in radiants
+				} else {
+					identifier_ignore_case(&cur, "deg"); // "deg" is optional
+
+					f = to_rad(f);
+				}
+			}
+
+			*out = f;
+			*pcur = cur;
+			return true;
+		});
+}
+bool parse_scalars (std::string const& s, bool* out, int count, unit_e unit) {
+	return _parse_vec(s, out, count, n_parse::bool_);
+}
+
+template <typename T> bool parse_value (std::string const& s, T* out, unit_e unit) {
+	T tmp; // dont modify out if parsing fails half way
+	if (!parse_scalars(s, (typename Option_Type<T>::scalar*)&tmp, Option_Type<T>::COUNT_, unit))
+		return false;
+	*out = tmp;
+	return true;
+}
+bool parse_value (std::string const& s, std::string* out, unit_e unit) {
+	*out = s;
+	return true;
+}
+
+//// imgui widget for value, returns true if it was changed
+bool imgui_scalars (cstr label, int* v, int count, unit_e unit) {
+	switch (count) {
+		case 1:		return imgui::DragInt(label, v, 1.0f / 20);
+		case 2:		return imgui::DragInt2(label, v, 1.0f / 20);
+		case 3:		return imgui::DragInt3(label, v, 1.0f / 20);
+		default:	return imgui::DragInt4(label, v, 1.0f / 20);
+	}
+}
+bool imgui_scalars (cstr label, flt* v, int count, unit_e unit) {
+	flt tmp[4];
+	flt* edit = v;
+	if (unit == ANGLE) { // edit in degrees
+		for (int i=0; i<count; ++i)
+			tmp[i] = to_deg(v[i]);
+		edit = tmp;
+	}
+
+	bool changed;
+	switch (count) {
+		case 1:		changed = imgui::DragFloat(label, edit, 1.0f / 100);	break;
+		case 2:		changed = imgui::DragFloat2(label, edit, 1.0f / 100);	break;
+		case 3:		changed = imgui::DragFloat3(label, edit, 1.0f / 100);	break;
+		default:	changed = imgui::DragFloat4(label, edit, 1.0f / 100);	break;
+	}
+
+	if (changed && unit == ANGLE) {
+		for (int i=0; i<count; ++i)
+			v[i] = to_rad(tmp[i]);
+	}
+	return changed;
+}
+bool imgui_scalars (cstr label, bool* v, int count, unit_e unit) {
+	bool changed = false;
+	imgui::PushID(label);
+	for (int i=0; i<count; ++i) {
+		imgui::PushID(i);
+		changed = imgui::Checkbox(i == (count -1) ? label : "", &v[i]) || changed;
+		imgui::PopID();
+		if (i != (count -1))
+			imgui::SameLine();
+	}
+	imgui::PopID();
+	return changed;
+}
+
+template <typename T> bool imgui_value (cstr label, T* v, unit_e unit) {
+	return imgui_scalars(label, (typename Option_Type<T>::scalar*)v, Option_Type<T>::COUNT_, unit);
+}
+bool imgui_value (cstr label, std::string* v, unit_e unit) {
+	char buf[1024];
+	strncpy(buf, v->c_str(), sizeof(buf) -1);
+	buf[sizeof(buf) -1] = '\0';
+
+	if (!imgui::InputText(label, buf, sizeof(buf)))
+		return false;
+	*v = buf;
+	return true;
+}
+
+class Options;
+
+// runtime view of a type, one static instance per type
+struct Type_Ops {
+	type_e		type;
+	void*		(*value_ptr) (Options* opts, u32 indx);
+	std::string	(*print) (void const* val, unit_e unit);
+	bool		(*parse) (std::string const& str, void* val, unit_e unit);
+	bool		(*imgui) (cstr label, void* val, unit_e unit);
+};
+template <typename T> Type_Ops const* type_ops ();
+
+// handle to an option
+template <typename T, unit_e UNIT=DIMENSIONLESS>
+struct Option {
+	u32		indx = (u32)-1; // into Options::pool<T>(), -1 if add() failed
+
+	bool valid () const { return indx != (u32)-1; }
+};
+
+// all values of one type
+template <typename T>
+struct Pool {
+	struct Slot { T val; }; // so std::vector<bool> does not pack bits (we need pointers to the values)
+
+	std::vector<Slot>	values;
+	std::vector<T>		defaults;
+};
 
 class Options {
 public:
-	
-	cstr			save_filepath;
+	struct Info {
+		std::string		name;
+		unit_e			unit;
+		u32				indx; // into the pool of its type
+		Type_Ops const*	ops;
+	};
 
-	Options_Graph	graph;
+	std::string		save_filepath;
 
-	bool trigger_load;
+	bool			trigger_load = false;
 
 	Options (cstr save_filepath): save_filepath{save_filepath} {}
-private:
-	
-	template <typename T> bool _value (Node* n, T* val, unit_e unit) {
-		if (trigger_load && n->matches(val)) {
-			n->get(val);
+
+	template <typename T> Pool<T>& pool () {
+		return std::get< Pool<T> >(pools);
+	}
+
+	// register an option, returns the existing one if it was already added with the same type and unit
+	//  if the file was loaded already the value from the file is used instead of default_val
+	//  adding a name again with another type or unit is a bug, this returns an invalid handle that asserts on access
+	template <typename T, unit_e UNIT=DIMENSIONLESS>
+	Option<T, UNIT> add (cstr name, T const& default_val) {
+		auto& p = pool<T>();
+
+		Option<T, UNIT> o;
+
+		auto existing = by_name.find(name);
+		if (existing != by_name.end()) {
+			auto& i = infos[existing->second];
+			if (i.ops == type_ops<T>() && i.unit == UNIT) {
+				o.indx = i.indx;
+			} else {
+				errprint("Options: \"%s\" was already added as %s, can not add it as %s!\n", name, typename_(i.ops->type), typename_(Option_Type<T>::type()));
+				assert(false);
+			}
+			return o;
 		}
-		
-		bool changed = false;//imgui(n->name, val, unit) || trigger_load;
-		
-		n->assign(*val, Value::get_type(val), unit);
-		
+
+		o.indx = (u32)p.values.size();
+		by_name.emplace(name, (u32)infos.size());
+		infos.push_back({ name, UNIT, o.indx, type_ops<T>() });
+
+		p.values.push_back({ default_val });
+		p.defaults.push_back(default_val);
+
+		auto val_str = loaded.find(name);
+		if (val_str != loaded.end()) {
+			if (!parse_value(val_str->second, &p.values.back().val, UNIT))
+				errprint("Options: Could not parse \"%s\" into %s for \"%s\"!\n", val_str->second.c_str(), typename_(Option_Type<T>::type()), name);
+			loaded.erase(val_str);
+		}
+
+		return o;
+	}
+	template <typename T, unit_e UNIT=DIMENSIONLESS>
+	Option<T, UNIT> add_angle (cstr name, T const& default_val) {
+		return add<T, ANGLE>(name, default_val);
+	}
+
+	// access value
+	template <typename T, unit_e UNIT>
+	T& operator[] (Option<T, UNIT> o) {
+		assert(o.valid());
+		return pool<T>().values[o.indx].val;
+	}
+	template <typename T, unit_e UNIT>
+	T const& get_default (Option<T, UNIT> o) {
+		assert(o.valid());
+		return pool<T>().defaults[o.indx];
+	}
+	template <typename T, unit_e UNIT>
+	void reset (Option<T, UNIT> o) {
+		(*this)[o] = get_default(o);
+	}
+
+	//// Reflection
+	uptr count () const {							return infos.size(); }
+	Info const& info (uptr i) const {				return infos[i]; }
+	void* value_ptr (uptr i) {						return infos[i].ops->value_ptr(this, infos[i].indx); }
+
+	std::string print (uptr i) {					return infos[i].ops->print(value_ptr(i), infos[i].unit); }
+	bool parse (uptr i, std::string const& s) {		return infos[i].ops->parse(s, value_ptr(i), infos[i].unit); }
+
+	// widgets for all options, returns true if any was changed
+	bool imgui () {
+		bool changed = false;
+		for (uptr i=0; i<infos.size(); ++i)
+			changed = infos[i].ops->imgui(infos[i].name.c_str(), value_ptr(i), infos[i].unit) || changed;
 		return changed;
 	}
-	template <typename T> T _value (Node* n, T default_val, unit_e unit) {
-		T val = default_val;
-		
-		if (n->matches(&val)) {
-			n->get(&val);
-		}
-		
-		//imgui(n->name, &val, unit);
-		
-		n->assign(val, Value::get_type(&val), unit);
-		
-		return val;
+
+	//// Serialization
+	// flat list of  <name type="flt">value</name>  (names have to be valid xml element names)
+	bool to_xml () {
+		rapidxml::xml_document<>	xml_doc;
+
+		auto append = [&] (cstr name, cstr type, std::string const& val) {
+			auto* n = xml_doc.allocate_node(rapidxml::node_element, name, xml_doc.allocate_string(val.c_str()));
+			n->append_attribute(xml_doc.allocate_attribute("type", type));
+			xml_doc.append_node(n);
+		};
+
+		for (uptr i=0; i<infos.size(); ++i)
+			append(infos[i].name.c_str(), typename_(infos[i].ops->type), print(i));
+		for (auto& l : loaded) // keep values of options that were not added (yet), so they are not lost
+			append(l.first.c_str(), "", l.second); // type unknown
+
+		std::string text;
+		rapidxml::print(std::back_inserter(text), xml_doc, 0);
+
+		return n_safe_file::write_file_atomic(save_filepath +".xml", text.data(), text.size());
 	}
+	bool from_xml () {
+		std::string text;
+		if (!load_text_file((save_filepath +".xml").c_str(), &text))
+			return false;
 
-	template <typename T> bool _value (cstr name, T* val, unit_e unit) {					return _value(graph.get_node(name			),	val, unit); }
-	template <typename T> bool _value (cstr name, int arr_indx, T* val, unit_e unit) {		return _value(graph.get_node(name, arr_indx	),	val, unit); }
-	template <typename T> T _value (cstr name, T default_val, unit_e unit) {				return _value(graph.get_node(name			),	default_val, unit); }
-	template <typename T> T _value (cstr name, int arr_indx, T default_val, unit_e unit) {	return _value(graph.get_node(name, arr_indx	),	default_val, unit); }
+		rapidxml::xml_document<>	xml_doc;
 
-public:
-	////
-	template <typename T> bool value (cstr name, T* val) {						return _value(name,				val, DIMENSIONLESS); }
-	template <typename T> bool value (cstr name, int arr_indx, T* val) {		return _value(name, arr_indx,	val, DIMENSIONLESS); }
-	// same as value(), just specifies that values is an angle (can be a vector of angles)
-	template <typename T> bool angle (cstr name, T* val) {						return _value(name,				val, ANGLE); }
-	template <typename T> bool angle (cstr name, int arr_indx, T* val) {		return _value(name, arr_indx,	val, ANGLE); }
-
-	template <typename T> T value (cstr name, T default_val) {					return _value(name,				default_val, DIMENSIONLESS); }
-	template <typename T> T value (cstr name, int arr_indx, T default_val) {	return _value(name, arr_indx,	default_val, DIMENSIONLESS); }
-	template <typename T> T angle (cstr name, T default_val) {					return _value(name,				default_val, ANGLE); }
-	template <typename T> T angle (cstr name, int arr_indx, T default_val) {	return _value(name, arr_indx,	default_val, ANGLE); }
-	
-	// like value(), but creates a value-less node and makes it the current parent (following value() nodes will be children of this node)
-	//  must always close a begin() with and end()
-	void begin (cstr name) {
-		graph.begin(name);
-	}
-	void end () {
-		graph.end();
-	}
-	
-	// like begin() / end(), but children will be array members, which means that they all should have the same name and must also be one node per array element (begin() / end())
-	int begin_array (cstr name) {
-		return graph.begin_array(name);
-	}
-	void end_array () {
-		graph.end_array();
+		try {
+			xml_doc.parse<0>(&text[0]);
+		} catch (rapidxml::parse_error e) {
+			errprint("rapidxml: \"%s\"\n", e.what());
+			return false;
+		}
+
+		for (auto* n = xml_doc.first_node(); n; n = n->next_sibling()) {
+			auto name = std::string(n->name(), n->name_size());
+			auto val = std::string(n->value(), n->value_size());
+
+			auto i = by_name.find(name);
+			if (i == by_name.end()) {
+				loaded[name] = val; // applied when the option is added
+				continue;
+			}
+
+			// a changed type in the code is fine, as long as the text still parses as the new type
+			if (!parse(i->second, val))
+				errprint("Options: Could not parse \"%s\" into %s for \"%s\"!\n", val.c_str(), typename_(infos[i->second].ops->type), name.c_str());
+		}
+		return true;
 	}
 
 	//
@@ -86,23 +416,42 @@ public:
 		this->trigger_load = trigger_load;
 
 		if (trigger_load) {
-			if (!from_xml(&graph, save_filepath)) {
-				errprint("Options: Could load from xml!\n");
+			if (!from_xml()) {
+				errprint("Options: Could not load from xml!\n");
 			}
 		}
-
-		graph.begin_frame();
 	}
 	void end_frame (bool trigger_save) {
-		graph.end_frame();
-
 		if (trigger_save)
-			if (!to_xml(graph, save_filepath))
+			if (!to_xml())
 				errprint("Options: Could not save to xml!\n");
 	}
 
+private:
+	std::tuple<	Pool<std::string>,
+				Pool<int>, Pool<iv2>, Pool<iv3>, Pool<iv4>,
+				Pool<flt>, Pool<v2>, Pool<v3>, Pool<v4>,
+				Pool<bool>, Pool<bv2>, Pool<bv3>, Pool<bv4> >	pools;
+
+	std::vector<Info>						infos; // in order of add()
+	std::unordered_map<std::string, u32>	by_name; // into infos, only used by add() and from_xml()
+
+	std::unordered_map<std::string, std::string>	loaded; // values from the file whose option was not added yet
 };
 
+template <typename T> Type_Ops const* type_ops () {
+	static Type_Ops ops = {
+		Option_Type<T>::type(),
+		[] (Options* opts, u32 indx) -> void* {							return &opts->pool<T>().values[indx].val; },
+		[] (void const* val, unit_e unit) -> std::string {				return print_value(*(T const*)val, unit); },
+		[] (std::string const& str, void* val, unit_e unit) -> bool {	return parse_value(str, (T*)val, unit); },
+		[] (cstr label, void* val, unit_e unit) -> bool {				return imgui_value(label, (T*)val, unit); },
+	};
+	return &ops;
+}
+
+//
 }
 using options::Options;
+using options::Option;
 }
@@ -3,6 +3,13 @@
 #include "deps/rapidxml/rapidxml.hpp"
 #include "deps/rapidxml/rapidxml_print.hpp"
 
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
 namespace engine {
 namespace n_safe_file {
 //
@@ -64,8 +71,7 @@ public:
 private:
 	type_e	type;
 	mode_e	mode;
-
-	type_e get_type () { return type; }
+	bool	loaded_typed = false; // loaded from a binary file and not yet read by value(), the typed counterpart of LOADED
 
 	union {
 		std::string		str		; // string is in an invalid state after default construction of Value class
@@ -92,7 +98,15 @@ private:
 	};
 
 public:
-	Value () {}
+	Value (): type{STRUCT}, mode{DIMENSIONLESS} {}
+	Value (Value const& r): type{STRUCT}, mode{DIMENSIONLESS} {
+		assign((void*)&r.int_, r.type, r.mode); // all union members start at the same address, so this also works for str
+	}
+	Value& operator= (Value const& r) {
+		if (this != &r)
+			assign((void*)&r.int_, r.type, r.mode);
+		return *this;
+	}
 	~Value () {
 		using std::string;
 		if (union_str_active(type))
@@ -100,9 +114,23 @@ public:
 
 	}
 
+	type_e get_type () const { return type; }
+	mode_e get_mode () const { return mode; }
+
 	bool is_array () const { return type == ARRAY; }
 	bool is_container () const { return type == STRUCT || type == ARRAY; }
 
+	// would assign() with these arguments leave the value unchanged?
+	bool equals (void const* val, Value::type_e t, Value::mode_e m) const {
+		if (type != t || mode != m)
+			return false;
+		if (is_container())
+			return true; // no value
+		if (union_str_active(type))
+			return str == *(std::string const*)val;
+		return memcmp(&int_, val, value_size(type)) == 0; // bitwise, so -0 vs 0 counts as a change, NaN does not
+	}
+
 	void assign (void* val, Value::type_e new_type, Value::mode_e new_mode=Value::DIMENSIONLESS) {
 		if (union_str_active(type) != union_str_active(new_type)) { // either was string and is not anymore or the reverse
 			using std::string;
@@ -116,6 +144,7 @@ public:
 
 		type = new_type;
 		mode = new_mode;
+		loaded_typed = false;
 
 		_assign(val);
 	}
@@ -272,8 +301,11 @@ public:
 	}
 
 	bool load (void* val, Value::type_e new_type, Value::mode_e new_mode) {
-		if (type != Value::LOADED)
-			return false; // when adding value and then starting app -> trigger_load true, but node was inserted after loading
+		if (type != Value::LOADED) {
+			if (loaded_typed)
+				return load_typed(val, new_type, new_mode);
+			return false; // not from the file (inserted this frame, or value() was called twice for the same node)
+		}
 		
 		if (new_type == Value::STRUCT || new_type == Value::ARRAY) {
 			if (str.size() != 0) {
@@ -340,51 +372,375 @@ public:
 			default: assert(not_implemented); return "--error--";
 		}
 	}
+
+	// read value (inverse of _assign)
+	void _read (void* val) const {
+		switch (type) {
+			case STRING	:
+			case LOADED	:	*(std::string	*)val = str		;	return;
+
+			case INT_	:	*(int			*)val = int_	;	return;
+			case IV2	:	*(iv2			*)val = iv2_	;	return;
+			case IV3	:	*(iv3			*)val = iv3_	;	return;
+			case IV4	:	*(iv4			*)val = iv4_	;	return;
+
+			case FLT	:	*(flt			*)val = flt_	;	return;
+			case FV2	:	*(v2			*)val = v2_		;	return;
+			case FV3	:	*(v3			*)val = v3_		;	return;
+			case FV4	:	*(v4			*)val = v4_		;	return;
+
+			case BOOL	:	*(bool			*)val = bool_	;	return;
+			case BV2	:	*(bv2			*)val = bv2_	;	return;
+			case BV3	:	*(bv3			*)val = bv3_	;	return;
+			case BV4	:	*(bv4			*)val = bv4_	;	return;
+
+			default: assert(not_implemented); return;
+		}
+	}
+
+	// load a value that was loaded already typed (from a binary file)
+	bool load_typed (void* val, Value::type_e new_type, Value::mode_e new_mode) {
+		if (is_container() || new_type == Value::STRUCT || new_type == Value::ARRAY)
+			return false; // no value to load, or node was inserted after loading (new nodes are STRUCT until assigned)
+
+		if (type == new_type) {
+			_read(val);
+			return true;
+		}
+
+		// type was changed in the code since the file was written, convert through the text form, just like the xml would have been parsed
+		auto s = print();
+		if (!parse(new_type, new_mode, s, val)) {
+			errprint("Could not parse \"%s\" into %s!\n", s.c_str(), typename_(new_type));
+			return false;
+		}
+		return true;
+	}
+
+	//// binary format, see Binary_Node
+	static uptr value_size (type_e t) {
+		switch (t) {
+			case INT_	:	return sizeof(int	);
+			case IV2	:	return sizeof(iv2	);
+			case IV3	:	return sizeof(iv3	);
+			case IV4	:	return sizeof(iv4	);
+
+			case FLT	:	return sizeof(flt	);
+			case FV2	:	return sizeof(v2	);
+			case FV3	:	return sizeof(v3	);
+			case FV4	:	return sizeof(v4	);
+
+			case BOOL	:	return sizeof(bool	);
+			case BV2	:	return sizeof(bv2	);
+			case BV3	:	return sizeof(bv3	);
+			case BV4	:	return sizeof(bv4	);
+
+			default:		return 0; // containers and strings
+		}
+	}
+
+	// returns the value for Binary_Node::value
+	u32 write_binary (std::vector<char>* data, std::vector<char>* strings) const {
+		if (union_str_active(type)) {
+			u32 offs = (u32)strings->size();
+			strings->insert(strings->end(), str.c_str(), str.c_str() +str.size() +1);
+			return offs;
+		}
+
+		uptr size = value_size(type);
+		auto* raw = (char const*)&int_; // all union members start at the same address
+
+		if (size <= sizeof(u32)) { // also containers (size 0)
+			u32 inline_val = 0;
+			memcpy(&inline_val, raw, size);
+			return inline_val;
+		}
+
+		u32 offs = (u32)data->size();
+		data->insert(data->end(), raw, raw +size);
+		data->resize((data->size() +3) & ~(uptr)3); // keep values 4 byte aligned
+		return offs;
+	}
+	// strings is null terminated at strings[strings_size -1]
+	bool read_binary (type_e new_type, mode_e new_mode, u32 const& bin_val, char const* data, u32 data_size, char const* strings, u32 strings_size) {
+		if (union_str_active(new_type)) {
+			if (bin_val >= strings_size)
+				return false;
+			std::string tmp = strings +bin_val;
+			assign(&tmp, new_type, new_mode);
+			loaded_typed = new_type != LOADED; // LOADED strings are parsed like the xml
+			return true;
+		}
+
+		uptr size = value_size(new_type);
+		char const* raw;
+		if (size <= sizeof(u32)) {
+			raw = (char const*)&bin_val;
+		} else {
+			if ((u64)bin_val +size > data_size || (bin_val % 4) != 0)
+				return false;
+			raw = data +bin_val;
+		}
+
+		if (new_type >= BOOL && new_type <= BV4) {
+			for (uptr i=0; i<size; ++i)
+				if ((u8)raw[i] > 1)
+					return false; // not a valid bool
+		}
+
+		assign((void*)raw, new_type, new_mode);
+		loaded_typed = true;
+		return true;
+	}
 	
 };
 
+struct _Cstr_Hash {
+	uptr operator() (cstr s) const {
+		uptr h = (uptr)14695981039346656037ull; // FNV-1a
+		for (; *s; ++s)
+			h = (h ^ (u8)*s) * (uptr)1099511628211ull;
+		return h;
+	}
+};
+struct _Cstr_Equal {
+	bool operator() (cstr l, cstr r) const {	return strcmp(l, r) == 0; }
+};
+
+// All node names are interned, so nodes can be compared and hashed by their name pointer
+//  looked up by cstr, so names that are already interned (every lookup after the first frame) do not allocate
+cstr intern_name (cstr name) {
+	static auto* names = new std::unordered_set<cstr, _Cstr_Hash, _Cstr_Equal>; // never shrinks, but names are few, never destructed since snapshots can still be written out during static destruction
+
+	auto it = names->find(name);
+	if (it != names->end())
+		return *it;
+
+	uptr size = strlen(name) +1;
+	char* copy = (char*)memcpy(new char[size], name, size);
+	names->insert(copy);
+	return copy;
+}
+
+// Immutable copy of a node and its subtree, shared between snapshots as long as nothing in the subtree changes
+//  so the background writer can serialize it while the frame thread keeps modifying the real tree
+struct Snapshot_Node {
+	cstr				name; // interned
+	Value				val;
+	std::vector< std::shared_ptr<Snapshot_Node const> >	children;
+};
+typedef std::vector< std::shared_ptr<Snapshot_Node const> > Snapshot; // the children of the root
+
+struct Node;
+
+// Hash index over the children of a (non-array) node, by interned name
+struct Child_Index {
+	std::unordered_map<cstr, Node*>	map;
+	bool							valid = false; // rebuilt on the next lookup after children were removed
+};
+
 struct Node {
-	std::string			name;
+	cstr				name; // interned
 
 	Value				val;
 
 	Node*				parent = nullptr;
 	
 	std::vector< unique_ptr<Node> >	children;
+	Child_Index			child_index;
+
+	std::shared_ptr<Snapshot_Node const>	snap; // null if this node or anything below it changed since the last snapshot (then all parents are null too)
+
+	// name and parent set externally, returns true if the node changed, nodes_deleted is set if children were deleted
+	bool update (void* val_, bool load, Value::type_e val_type, Value::mode_e val_mode, bool* nodes_deleted) {
+		*nodes_deleted = false;
 
-	void update (void* val_, bool load, Value::type_e val_type, Value::mode_e val_mode) { // name and parent set externally
 		if (load) {
 			val.load(val_, val_type, val_mode);
+		} else if (val.equals(val_, val_type, val_mode)) {
+			return false; // the common case, value did not change since last frame
 		}
 
 		val.assign(val_, val_type, val_mode);
 
-		if (!val.is_container()) {
+		if (!val.is_container() && children.size() != 0) {
 			children.clear(); // so we don't end up with both children and a value
+			child_index.valid = false;
+			*nodes_deleted = true;
 		}
+		return true;
 	}
 };
 
+//// Binary format
+// Same tree as the xml, but values are stored typed (no printing and parsing) and names are deduplicated in a string table
+// The nodes are fixed size and everything is addressed by offsets, so loading maps the file and decodes it into a Node tree directly, without any text parsing
+//  nodes are in breadth first order, so the children of a node are contiguous and directly follow the children of the previous node
+//  (the first root_child_count nodes are the children of the root, then the children of node 0, node 1 etc.)
+static constexpr u32 BINARY_VERSION = 1;
+
+struct Binary_Header {
+	char	magic[4]; // "SAVB"
+	u32		version;
+	u32		node_count;
+	u32		root_child_count;
+	u32		nodes_offset; // Binary_Node[node_count]
+	u32		data_offset; // raw values, 4 byte aligned
+	u32		data_size;
+	u32		strings_offset; // null terminated strings
+	u32		strings_size;
+};
+struct Binary_Node {
+	u32		name; // offset into strings
+	u8		type; // Value::type_e
+	u8		mode; // Value::mode_e
+	u16		_pad;
+	u32		value; // the value itself if it fits into 4 bytes, else offset into data, offset into strings for string values
+	u32		child_count;
+};
+
+// write into a temporary file and then rename it over the old one, so a crash while writing never leaves a half written file
+bool write_file_atomic (std::string const& filepath, void const* data, uptr size) {
+	auto tmp_filepath = filepath +".tmp";
+	if (!write_fixed_size_binary_file(tmp_filepath.c_str(), data, size))
+		return false;
+#ifdef _WIN32
+	return MoveFileExA(tmp_filepath.c_str(), filepath.c_str(), MOVEFILE_REPLACE_EXISTING|MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return rename(tmp_filepath.c_str(), filepath.c_str()) == 0;
+#endif
+}
+
 struct Save {
 	std::string filepath;
 
+	enum format_e {
+		XML, // human readable, can be edited by hand
+		BINARY, // much faster to load and save big files
+	};
+	format_e	format = XML; // file used by trigger_load and trigger_save, to_xml(), to_binary_file() etc. can be used to convert between them
+
 	// This represents the root node
 	std::vector< unique_ptr<Node> >	root_children;
+	Child_Index			root_index;
 
 	Node*				cur_parent = nullptr;
 
+	u64					generation = 1; // incremented whenever nodes are deleted, which invalidates all Caches
+
+	std::shared_ptr<Snapshot const>	root_snap; // null if anything changed since the last snapshot()
+
 	std::vector< unique_ptr<Node> >* get_children (Node* parent) {
 		return parent ? &parent->children : &root_children;
 	}
+	Child_Index* get_child_index (Node* parent) {
+		return parent ? &parent->child_index : &root_index;
+	}
+
+	// Optional cache for a call site of value()/begin() etc., remembers the node so the next frame does not have to look it up at all
+	//  (is checked against the current parent and name, so sharing one between calls is still correct, just slower)
+	struct Cache {
+		Node*	node = nullptr;
+		Node*	parent = nullptr;
+		u64		generation = 0;
+	};
 
 	bool		trigger_load;
 	bool		trigger_save;
 
+	bool		autosave = false; // save in the background whenever something changed, at most once every autosave_interval seconds
+	flt			autosave_interval = 2;
+	bool		dirty = false; // something changed since the file was last saved or loaded
+
+	// Writes snapshots on its own thread, so the frame thread never pays for formatting or disk io
+	//  only the latest submitted snapshot is written, the ones in between are skipped if the writer is busy or rate limited
+	class Background_Writer {
+		NO_MOVE_COPY_CLASS(Background_Writer)
+
+		std::thread				thread; // started on first submit
+		std::mutex				mutex;
+		std::condition_variable	cv;
+
+		std::shared_ptr<Snapshot const>	pending;
+		std::string				pending_filepath;
+		format_e				pending_format;
+		std::chrono::steady_clock::duration	min_interval;
+		bool					force = false;
+		bool					writing = false;
+		bool					shutdown = false;
+
+		std::chrono::steady_clock::time_point	last_write; // epoch, so the first write is not delayed
+
+		void run () {
+			std::unique_lock<std::mutex> lock(mutex);
+			for (;;) {
+				cv.wait(lock, [&] () { return pending || shutdown; });
+				if (!pending)
+					return; // shutdown, and everything is written
+
+				cv.wait_until(lock, last_write +min_interval, [&] () { return force || shutdown; }); // rate limit, submit() keeps replacing pending in the meantime
+
+				auto snap = std::move(pending);
+				pending = nullptr;
+				auto filepath = pending_filepath;
+				auto format = pending_format;
+				force = false;
+				writing = true;
+				lock.unlock();
+
+				if (!write_snapshot(*snap, filepath, format))
+					errprint("Save: Could not save to %s!\n", format == BINARY ? "binary" : "xml");
+				snap = nullptr; // free snapshot nodes no longer referenced by the tree here instead of while holding the lock
+
+				lock.lock();
+				writing = false;
+				last_write = std::chrono::steady_clock::now();
+				cv.notify_all(); // wake flush()
+			}
+		}
+
+	public:
+		~Background_Writer () { // writes the pending snapshot before returning
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				shutdown = true;
+			}
+			cv.notify_all();
+			if (thread.joinable())
+				thread.join();
+		}
+
+		// force: write as soon as possible, ignoring min_interval
+		void submit (std::shared_ptr<Snapshot const> snap, std::string const& filepath, format_e format, bool force_, flt min_interval_seconds) {
+			std::lock_guard<std::mutex> lock(mutex);
+			pending = std::move(snap);
+			pending_filepath = filepath;
+			pending_format = format;
+			min_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<flt>(min_interval_seconds));
+			force = force || force_;
+			if (!thread.joinable())
+				thread = std::thread(&Background_Writer::run, this);
+			cv.notify_all();
+		}
+
+		// blocks until everything submitted is written
+		void flush () {
+			std::unique_lock<std::mutex> lock(mutex);
+			if (pending) {
+				force = true;
+				cv.notify_all();
+			}
+			cv.wait(lock, [&] () { return !pending && !writing; });
+		}
+	};
+	Background_Writer	writer;
+
 	//
 	void begin_frame () {
 		if (trigger_load) {
-			if (!from_xml()) {
-				errprint("Save: Could load from xml!\n");
+			writer.flush(); // dont load an older file than what was saved last
+			if (!(format == BINARY ? from_binary_file() : from_xml())) {
+				errprint("Save: Could not load from %s!\n", format == BINARY ? "binary" : "xml");
 				trigger_load = false; // abort loading
 			}
 		}
@@ -394,9 +750,41 @@ struct Save {
 			errprint("Save: not few end() calls!\n");
 		cur_parent = nullptr;
 
-		if (trigger_save)
-			if (!to_xml())
-				errprint("Save: Could not save to xml!\n");
+		if (trigger_save || (autosave && dirty)) {
+			writer.submit(snapshot(), filepath, format, trigger_save, autosave_interval); // explicit saves are not rate limited
+			dirty = false;
+		}
+	}
+
+	// nodes that changed since the last snapshot need to be copied, everything else is shared with it
+	std::shared_ptr<Snapshot_Node const> _snapshot (Node* n) {
+		if (!n->snap) {
+			auto s = std::make_shared<Snapshot_Node>();
+			s->name = n->name;
+			s->val = n->val;
+			s->children.reserve(n->children.size());
+			for (auto& c : n->children)
+				s->children.push_back(_snapshot(c.get()));
+			n->snap = std::move(s);
+		}
+		return n->snap;
+	}
+	std::shared_ptr<Snapshot const> snapshot () {
+		if (!root_snap) {
+			auto s = std::make_shared<Snapshot>();
+			s->reserve(root_children.size());
+			for (auto& c : root_children)
+				s->push_back(_snapshot(c.get()));
+			root_snap = std::move(s);
+		}
+		return root_snap;
+	}
+
+	// n changed, or had children inserted or removed (nullptr for the root), so it and all its parents need new snapshots
+	void changed (Node* n) {
+		for (; n && n->snap; n = n->parent) // if a node has no snapshot its parents dont either
+			n->snap = nullptr;
+		root_snap = nullptr;
 	}
 
 	//
@@ -406,21 +794,33 @@ struct Save {
 		auto up = make_unique<Node>();
 		auto* n = up.get();
 
-		n->name = name;
+		n->name = intern_name(name);
 		n->parent = parent;
 		parent_children->emplace(parent_children->begin() +insert_indx, std::move(up));
 		
+		auto* index = get_child_index(parent);
+		if (index->valid)
+			index->map.emplace(n->name, n); // does not replace existing nodes of the same name, just like find_node
+
+		changed(parent);
+		dirty = true;
 		return n;
 	}
 
 	Node* find_node (cstr name) {
-		auto* cur_children = get_children(cur_parent);
+		auto* index = get_child_index(cur_parent);
+		if (!index->valid) {
+			index->map.clear();
+			for (auto& n : *get_children(cur_parent))
+				index->map.emplace(n->name, n.get()); // first node with a name wins if there are duplicates (from a hand edited file)
+			index->valid = true;
+		}
 
-		auto res = std::find_if(cur_children->begin(), cur_children->end(), [&] (unique_ptr<Node> const& n) { return n->name.compare(name) == 0; });
-		if (res == cur_children->end())
+		auto res = index->map.find(intern_name(name));
+		if (res == index->map.end())
 			return nullptr; // node not found
 
-		return res->get();
+		return res->second;
 	}
 	Node* find_array_node (cstr name, int indx) {
 		auto* cur_children = get_children(cur_parent);
@@ -430,7 +830,7 @@ struct Save {
 
 		auto* n = (*cur_children)[indx].get();
 
-		if (n->name.compare(name) != 0)
+		if (strcmp(n->name, name) != 0)
 			return nullptr;
 		
 		return n;
@@ -455,22 +855,42 @@ struct Save {
 		return n;
 	}
 
-	Node* get_node (cstr name) {
+	Node* get_node (cstr name, Cache* cache=nullptr) {
 		if (cur_parent && cur_parent->val.is_array()) {
 			return get_array_node(name, cur_array_indx.back()++);
-		} else {
-			return get_normal_node(name);
 		}
+
+		if (cache && cache->generation == generation && cache->parent == cur_parent && strcmp(cache->node->name, name) == 0)
+			return cache->node;
+
+		auto* n = get_normal_node(name);
+
+		if (cache) {
+			cache->node = n;
+			cache->parent = cur_parent;
+			cache->generation = generation;
+		}
+		return n;
 	}
 
-	Node* _node (cstr name, void* val, Value::type_e val_type, Value::mode_e val_mode) {
-		auto* n = get_node(name);
-		n->update(val, trigger_load, val_type, val_mode);
+	void _update (Node* n, void* val, Value::type_e val_type, Value::mode_e val_mode) {
+		bool deleted;
+		if (n->update(val, trigger_load, val_type, val_mode, &deleted)) {
+			changed(n);
+			if (!trigger_load || deleted) // loading only converts the values to their types
+				dirty = true;
+		}
+		if (deleted)
+			generation++;
+	}
+	Node* _node (cstr name, void* val, Value::type_e val_type, Value::mode_e val_mode, Cache* cache=nullptr) {
+		auto* n = get_node(name, cache);
+		_update(n, val, val_type, val_mode);
 		return n;
 	}
 	Node* _array_node (cstr name, int indx, void* val, Value::type_e val_type, Value::mode_e val_mode) {
 		auto* n = get_array_node(name, indx);
-		n->update(val, trigger_load, val_type, val_mode);
+		_update(n, val, val_type, val_mode);
 		return n;
 	}
 
@@ -488,11 +908,18 @@ struct Save {
 	template <typename T> inline void angle (cstr name, T* val, int arr_indx) { // same as value(), just specifies that values is an angle (can be a vector of angles)
 		_array_node(name, arr_indx, val, Value::get_type(val), Value::ANGLE);
 	}
+	// same as value() / angle(), but with a call site Cache, for ex.  static Save::Cache c;  save->value("x", &x, &c);
+	template <typename T> inline void value (cstr name, T* val, Cache* cache) {
+		_node(name, val, Value::get_type(val), Value::DIMENSIONLESS, cache);
+	}
+	template <typename T> inline void angle (cstr name, T* val, Cache* cache) {
+		_node(name, val, Value::get_type(val), Value::ANGLE, cache);
+	}
 
 	// like value(), but creates a value-less node and makes it the current parent (following value() nodes will be children of this node)
 	//  must always close a begin() with and end()
-	void begin (cstr name) {
-		auto* n = _node(name, nullptr, Value::STRUCT, Value::DIMENSIONLESS);
+	void begin (cstr name, Cache* cache=nullptr) {
+		auto* n = _node(name, nullptr, Value::STRUCT, Value::DIMENSIONLESS, cache);
 		cur_parent = n;
 	}
 	void end () {
@@ -520,7 +947,14 @@ struct Save {
 		int length = cur_array_indx.back();
 		cur_array_indx.pop_back();
 
-		get_children(cur_parent)->resize(length); // get rid of nodes not found by find_array_node() (array length change, wrong nodes because array was not an array before, etc.)
+		auto* children = get_children(cur_parent);
+		if ((int)children->size() > length) {
+			children->resize(length); // get rid of nodes not found by find_array_node() (array length change, wrong nodes because array was not an array before, etc.)
+			get_child_index(cur_parent)->valid = false;
+			generation++;
+			changed(cur_parent);
+			dirty = true;
+		}
 
 		end();
 	}
@@ -532,18 +966,20 @@ struct Save {
 			arr->resize(len);
 	}
 
-	//
-	void _to_rapid_xml_recurse (rapidxml::xml_document<>* doc, rapidxml::xml_node<>* parent_xml_node, Node const& node) {
+	//// Serialization works on Node and Snapshot_Node trees alike
+	template <typename NODE>
+	static void _to_rapid_xml_recurse (rapidxml::xml_document<>* doc, rapidxml::xml_node<>* parent_xml_node, NODE const& node) {
 
 		auto* value_str = node.val.is_container() ? "" : doc->allocate_string( node.val.print().c_str() );
 
-		auto xml_node = doc->allocate_node(rapidxml::node_type::node_element, node.name.c_str(), value_str);
+		auto xml_node = doc->allocate_node(rapidxml::node_type::node_element, node.name, value_str);
 		parent_xml_node->append_node(xml_node);
 
 		for (auto& n : node.children)
 			_to_rapid_xml_recurse(doc, xml_node, *n);
 	}
-	bool to_xml () {
+	template <typename PTR>
+	static std::string print_xml (std::vector<PTR> const& root_children) {
 
 		rapidxml::xml_document<>	xml_doc;
 
@@ -590,7 +1026,11 @@ struct Save {
 		if (text.size() > 0 && text[text.size() -1] == '\0')
 			text.resize(text.size() -1); // remove redundant null terminator
 
-		return write_text_file((filepath +".xml").c_str(), text);
+		return text;
+	}
+	bool to_xml () {
+		auto text = print_xml(root_children);
+		return write_file_atomic(filepath +".xml", text.data(), text.size());
 	}
 	
 	void _from_rapid_xml_recurse (rapidxml::xml_node<> const& node, Node* parent, std::vector< unique_ptr<Node> >* children) {
@@ -599,7 +1039,7 @@ struct Save {
 			if (cur->type() == rapidxml::node_element) {
 
 				auto n = make_unique<Node>();
-				n->name = std::string(cur->name(), cur->name_size());
+				n->name = intern_name(std::string(cur->name(), cur->name_size()).c_str());
 				n->parent = parent;
 			
 				auto val_str = std::string(cur->value(), cur->value_size());
@@ -633,12 +1073,186 @@ struct Save {
 
 		assert(cur_parent == nullptr);
 		root_children.clear(); // deletes all nodes
+		root_index.valid = false;
+		generation++;
+		root_snap = nullptr;
+		dirty = false;
 		
 		if (xml_doc.first_node())
 			_from_rapid_xml_recurse(xml_doc, cur_parent, &root_children);
 
 		return true;
 	}
+
+	//
+	template <typename PTR>
+	static void print_binary (std::vector<PTR> const& root_children, std::vector<char>* file) {
+		typedef typename std::remove_const<typename PTR::element_type>::type NODE;
+
+		std::vector<NODE const*>	nodes; // breadth first
+		std::vector<Binary_Node>	bin_nodes;
+		std::vector<char>			data;
+		std::vector<char>			strings;
+
+		std::unordered_map<cstr, u32> name_offsets; // names are interned, so they can be deduplicated by pointer
+
+		for (auto& n : root_children)
+			nodes.push_back(n.get());
+
+		for (uptr i=0; i<nodes.size(); ++i) {
+			auto& n = *nodes[i];
+
+			auto name = name_offsets.find(n.name);
+			if (name == name_offsets.end()) {
+				name = name_offsets.emplace(n.name, (u32)strings.size()).first;
+				strings.insert(strings.end(), n.name, n.name +strlen(n.name) +1);
+			}
+
+			Binary_Node b;
+			b.name = name->second;
+			b.type = (u8)n.val.get_type();
+			b.mode = (u8)n.val.get_mode();
+			b._pad = 0;
+			b.value = n.val.write_binary(&data, &strings);
+			b.child_count = (u32)n.children.size();
+			bin_nodes.push_back(b);
+
+			for (auto& c : n.children)
+				nodes.push_back(c.get());
+		}
+
+		Binary_Header h;
+		memcpy(h.magic, "SAVB", 4);
+		h.version = BINARY_VERSION;
+		h.node_count = (u32)bin_nodes.size();
+		h.root_child_count = (u32)root_children.size();
+		h.nodes_offset = (u32)sizeof(Binary_Header);
+		h.data_offset = h.nodes_offset +h.node_count * (u32)sizeof(Binary_Node);
+		h.data_size = (u32)data.size();
+		h.strings_offset = h.data_offset +h.data_size;
+		h.strings_size = (u32)strings.size();
+
+		file->resize(h.strings_offset +h.strings_size);
+		memcpy(&(*file)[0], &h, sizeof(h));
+		if (bin_nodes.size())	memcpy(&(*file)[h.nodes_offset], bin_nodes.data(), bin_nodes.size() * sizeof(Binary_Node));
+		if (data.size())		memcpy(&(*file)[h.data_offset], data.data(), data.size());
+		if (strings.size())		memcpy(&(*file)[h.strings_offset], strings.data(), strings.size());
+	}
+	void to_binary (std::vector<char>* file) {
+		print_binary(root_children, file);
+	}
+	// file needs to be 4 byte aligned
+	bool from_binary (void const* file, uptr size) {
+		auto* base = (char const*)file;
+		auto* h = (Binary_Header const*)file;
+
+		if (size < sizeof(Binary_Header) || memcmp(h->magic, "SAVB", 4) != 0) {
+			errprint("Save: not a binary save file!\n");
+			return false;
+		}
+		if (h->version != BINARY_VERSION) {
+			errprint("Save: binary save file has version %u, expected %u!\n", h->version, BINARY_VERSION);
+			return false;
+		}
+
+		auto in_file = [&] (u32 offs, u64 bytes) { return (u64)offs +bytes <= (u64)size; };
+
+		bool ok =	in_file(h->nodes_offset, (u64)h->node_count * sizeof(Binary_Node)) && (h->nodes_offset % alignof(Binary_Node)) == 0 &&
+					in_file(h->data_offset, h->data_size) && (h->data_offset % 4) == 0 &&
+					in_file(h->strings_offset, h->strings_size) && (h->strings_size == 0 || base[h->strings_offset +h->strings_size -1] == '\0') &&
+					h->root_child_count <= h->node_count;
+
+		if (!ok) {
+			errprint("Save: binary save file is corrupt!\n");
+			return false;
+		}
+
+		auto* bin_nodes = (Binary_Node const*)(base +h->nodes_offset);
+		auto* data = base +h->data_offset;
+		auto* strings = base +h->strings_offset;
+
+		// check that the child counts add up to a tree in breadth first order (every node is the child of exactly one earlier node), so we can not loop forever on a corrupt file
+		std::vector<u32> first_child (h->node_count);
+		u32 next_child = h->root_child_count;
+		for (u32 i=0; i<h->node_count; ++i) {
+			auto& b = bin_nodes[i];
+			ok =	b.name < h->strings_size && b.type <= Value::BV4 && b.mode <= Value::ANGLE &&
+					(b.child_count == 0 || (next_child > i && b.child_count <= h->node_count -next_child));
+			if (!ok)
+				break;
+			first_child[i] = next_child;
+			next_child += b.child_count;
+		}
+		ok = ok && next_child == h->node_count;
+
+		if (!ok) {
+			errprint("Save: binary save file is corrupt!\n");
+			return false;
+		}
+
+		std::vector< unique_ptr<Node> > new_root_children;
+		std::vector<Node*> node_ptrs (h->node_count);
+
+		auto create_children = [&] (Node* parent, std::vector< unique_ptr<Node> >* children, u32 first, u32 count) {
+			children->reserve(count);
+			for (u32 i=first; i<first +count; ++i) {
+				auto& b = bin_nodes[i];
+
+				auto n = make_unique<Node>();
+				n->name = intern_name(strings +b.name);
+				n->parent = parent;
+				if (!n->val.read_binary((Value::type_e)b.type, (Value::mode_e)b.mode, b.value, data, h->data_size, strings, h->strings_size))
+					return false;
+
+				node_ptrs[i] = n.get();
+				children->emplace_back(std::move(n));
+			}
+			return true;
+		};
+
+		ok = create_children(nullptr, &new_root_children, 0, h->root_child_count);
+		for (u32 i=0; ok && i<h->node_count; ++i) {
+			auto& b = bin_nodes[i];
+			ok = create_children(node_ptrs[i], &node_ptrs[i]->children, first_child[i], b.child_count);
+		}
+
+		if (!ok) {
+			errprint("Save: binary save file is corrupt!\n");
+			return false;
+		}
+
+		assert(cur_parent == nullptr);
+		root_children = std::move(new_root_children); // deletes all old nodes
+		root_index.valid = false;
+		generation++;
+		root_snap = nullptr;
+		dirty = false;
+
+		return true;
+	}
+
+	bool to_binary_file () {
+		std::vector<char> file;
+		to_binary(&file);
+		return write_file_atomic(filepath +".bin", file.data(), file.size());
+	}
+	bool from_binary_file () {
+		Mapped_File file; // page aligned, enough for Binary_Node
+		if (!map_file((filepath +".bin").c_str(), &file))
+			return false;
+		return from_binary(file.data, file.size);
+	}
+
+	static bool write_snapshot (Snapshot const& snap, std::string const& filepath, format_e format) {
+		if (format == BINARY) {
+			std::vector<char> file;
+			print_binary(snap, &file);
+			return write_file_atomic(filepath +".bin", file.data(), file.size());
+		} else {
+			auto text = print_xml(snap);
+			return write_file_atomic(filepath +".xml", text.data(), text.size());
+		}
+	}
 };
 
 Save* save_file (cstr filepath, bool trigger_load, bool trigger_save) {
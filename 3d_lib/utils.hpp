@@ -4,9 +4,75 @@
 #include "gl_shader.hpp"
 #include "gl_mesh.hpp"
 #include "gl_texture.hpp"
+#include "gpu_profiler.hpp"
+#include "gl_command_buffer.hpp"
 
 namespace engine {
 //
+	// Gl_Command_Buffer backend that makes the actual gl calls
+	struct Gl_Backend {
+		void set_cap (e_gl_cap cap, bool enable) {
+			static constexpr GLenum caps[] = { GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST };
+			if (enable)
+				glEnable(caps[cap]);
+			else
+				glDisable(caps[cap]);
+		}
+		void set_depth_mask (bool enable) {
+			glDepthMask(enable ? GL_TRUE : GL_FALSE);
+		}
+		void set_blend_func_alpha () {
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		}
+		void use_shader (Shader* s) {
+			engine::use_shader(s);
+			uniform_sharer.set_shared_uniforms_for_shader(s);
+		}
+		void bind_texture (int unit, u32 target, u32 handle) {
+			glActiveTexture(GL_TEXTURE0 +unit);
+			glBindTexture(target, handle);
+		}
+		void set_uniform (Shader* s, Cmd_Uniform const& u) {
+			GLint loc = s->get_uniform_location(u.name);
+			if (loc < 0)
+				return;
+			switch (u.type) {
+				case Cmd_Uniform::FLT :	gl_set_uniform(loc, u.flt_);	break;
+				case Cmd_Uniform::FV2 :	gl_set_uniform(loc, u.fv2_);	break;
+				case Cmd_Uniform::FV3 :	gl_set_uniform(loc, u.fv3_);	break;
+				case Cmd_Uniform::FV4 :	gl_set_uniform(loc, u.fv4_);	break;
+				case Cmd_Uniform::INT_:	gl_set_uniform(loc, u.int_);	break;
+				case Cmd_Uniform::MAT4:	gl_set_uniform(loc, u.fm4_);	break;
+				default: assert(not_implemented);
+			}
+		}
+		void bind_mesh (Gpu_Mesh const* m, Shader* s) {
+			m->bind(*s);
+		}
+		void draw (Gpu_Mesh const* m, u32 primitive) {
+			if (m->is_indexed())
+				glDrawElements(primitive, (GLsizei)m->index_count, m->index_type, (void*)0);
+			else
+				glDrawArrays(primitive, 0, (GLsizei)m->vertex_count);
+		}
+	};
+	Gl_Backend gl_backend;
+
+	// the draw helpers below record into a Gl_Command_Buffer, the overloads without one draw immediately
+	//  through a buffer with just that draw, so they still set their full state like before
+	//  they record their _xxx_shader and _xxx_mesh funcs, which only run on submit (gl thread), so recording works on the pipeline worker
+	template <typename FUNC>
+	void _draw_immediate (FUNC record) {
+		static Gl_Command_Buffer cmds;
+		record(cmds);
+		cmds.submit(gl_backend);
+	}
+
+	// render states of the helpers					blend	depth_test	depth_write	cull	scissor_test
+	static constexpr Render_State _state_2d =		{ true,	false,		true,		false,	false };
+	static constexpr Render_State _state_lines =	{ true,	true,		true,		false,	false };
+	static constexpr Render_State _state_3d =		{ true,	true,		true,		true,	false };
+	static constexpr Render_State _state_skybox =	{ false,	false,		false,		false,	false };
 
 	void clear (lrgb col) {
 		glClearColor(col.x,col.y,col.z, 1);
@@ -65,15 +131,7 @@ namespace engine {
 		{ "pos_model",			FV2,	(int)offsetof(Vertex_Draw_Rect, pos_model) },
 	}};
 
-	void draw_rect (v2 pos, v2 size, lrgba col=1) {
-		
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glDisable(GL_DEPTH_TEST);
-		glDepthMask(GL_TRUE);
-		glDisable(GL_CULL_FACE);
-		glDisable(GL_SCISSOR_TEST);
-
+	Shader* _draw_rect_shader () {
 		inline_shader("_simple_draw_rect.vert", R"_SHAD(
 			$include "common.vert"
 
@@ -97,17 +155,21 @@ namespace engine {
 			}
 		)_SHAD");
 
-		auto* s = use_shader("_simple_draw_rect");
-		if (s) {
-
-			hm model_to_world = translateH(v3(pos,1)) * scaleH(v3(size,1));
-
-			set_uniform(s, "model_to_world", model_to_world.m4());
-			set_uniform(s, "col", col);
+		return _get_shader("_simple_draw_rect");
+	}
+	Gpu_Mesh const* _draw_rect_mesh () {
+		static auto rect = engine::gen_rect<Vertex_Draw_Rect>([] (v2 p, v2 uv) { return Vertex_Draw_Rect{p}; }).upload();
+		return &rect;
+	}
+	void draw_rect (Gl_Command_Buffer& cmds, v2 pos, v2 size, lrgba col=1) {
+		hm model_to_world = translateH(v3(pos,1)) * scaleH(v3(size,1));
 
-			static auto rect = engine::gen_rect<Vertex_Draw_Rect>([] (v2 p, v2 uv) { return Vertex_Draw_Rect{p}; }).upload();
-			rect.draw(*s);
-		}
+		cmds.draw(_state_2d, _draw_rect_shader, _draw_rect_mesh, TRIANGLES);
+		cmds.uniform("model_to_world", model_to_world.m4());
+		cmds.uniform("col", col);
+	}
+	void draw_rect (v2 pos, v2 size, lrgba col=1) {
+		_draw_immediate([&] (Gl_Command_Buffer& cmds) { draw_rect(cmds, pos, size, col); });
 	}
 
 	struct Texture_Draw_Rect {
@@ -121,15 +183,7 @@ namespace engine {
 		{ "uv",					FV2,	(int)offsetof(Texture_Draw_Rect, uv) },
 	}};
 
-	void draw_rect (v2 pos, v2 size, flt rot, v2 uv_pos, v2 uv_size, Texture2D const& tex, lrgba tint=1) {
-		
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glDisable(GL_DEPTH_TEST);
-		glDepthMask(GL_TRUE);
-		glDisable(GL_CULL_FACE);
-		glDisable(GL_SCISSOR_TEST);
-
+	Shader* _draw_textured_rect_shader () {
 		inline_shader("_simple_draw_rect.vert", R"_SHAD(
 			$include "common.vert"
 
@@ -163,21 +217,24 @@ namespace engine {
 			}
 		)_SHAD");
 
-		auto* s = use_shader("_simple_draw_rect");
-		if (s) {
-
-			hm model_to_world = translateH(v3(pos,1)) * hm( rotate2(rot) * scale2(size) );
-
-			set_uniform(s, "model_to_world", model_to_world.m4());
-			set_uniform(s, "uv_remap_l", uv_pos);
-			set_uniform(s, "uv_remap_h", uv_pos +uv_size);
-			set_uniform(s, "tint", tint);
-
-			bind_texture(s, "tex", 0, tex);
-
-			static auto rect = engine::gen_rect<Texture_Draw_Rect>([] (v2 p, v2 uv) { return Texture_Draw_Rect{p, uv}; }).upload();
-			rect.draw(*s);
-		}
+		return _get_shader("_simple_draw_rect");
+	}
+	Gpu_Mesh const* _draw_textured_rect_mesh () {
+		static auto rect = engine::gen_rect<Texture_Draw_Rect>([] (v2 p, v2 uv) { return Texture_Draw_Rect{p, uv}; }).upload();
+		return &rect;
+	}
+	void draw_rect (Gl_Command_Buffer& cmds, v2 pos, v2 size, flt rot, v2 uv_pos, v2 uv_size, Texture2D const& tex, lrgba tint=1) {
+		hm model_to_world = translateH(v3(pos,1)) * hm( rotate2(rot) * scale2(size) );
+
+		cmds.draw(_state_2d, _draw_textured_rect_shader, _draw_textured_rect_mesh, TRIANGLES);
+		cmds.uniform("model_to_world", model_to_world.m4());
+		cmds.uniform("uv_remap_l", uv_pos);
+		cmds.uniform("uv_remap_h", uv_pos +uv_size);
+		cmds.uniform("tint", tint);
+		cmds.texture("tex", 0, GL_TEXTURE_2D, tex.get_handle());
+	}
+	void draw_rect (v2 pos, v2 size, flt rot, v2 uv_pos, v2 uv_size, Texture2D const& tex, lrgba tint=1) {
+		_draw_immediate([&] (Gl_Command_Buffer& cmds) { draw_rect(cmds, pos, size, rot, uv_pos, uv_size, tex, tint); });
 	}
 
 	void draw_rect (v2 pos, v2 size, flt rot, Texture2D const& tex, lrgba tint=1) {
@@ -187,7 +244,7 @@ namespace engine {
 		draw_rect(pos, size, 0, tex, tint);
 	}
 
-	void draw_sprite (v2 pos, v2 size, int rot, iv2 tile_pos, iv2 tiles_count, Texture2D const& atlas, lrgba tint=1) {
+	void draw_sprite (Gl_Command_Buffer& cmds, v2 pos, v2 size, int rot, iv2 tile_pos, iv2 tiles_count, Texture2D const& atlas, lrgba tint=1) {
 		// When using linear filtering we get tile bleeding on every tile edge, since the uvs start and end exactly between two texels -> simply offsetting the pixels is actually wrong
 		//  since then the border pixels are half as wide as they are supposed to be (?)
 		//  only proper solution is 1 (or a few) pixels border around each tile (?)
@@ -197,7 +254,10 @@ namespace engine {
 		v2 uv_pos = (v2)tile_pos / (v2)tiles_count + pixel_leak_fix;
 		v2 uv_size = 1 / (v2)tiles_count - pixel_leak_fix*2;
 
-		draw_rect(pos +0.5f, size, deg(90) * rot, uv_pos, uv_size, atlas, tint);
+		draw_rect(cmds, pos +0.5f, size, deg(90) * rot, uv_pos, uv_size, atlas, tint);
+	}
+	void draw_sprite (v2 pos, v2 size, int rot, iv2 tile_pos, iv2 tiles_count, Texture2D const& atlas, lrgba tint=1) {
+		_draw_immediate([&] (Gl_Command_Buffer& cmds) { draw_sprite(cmds, pos, size, rot, tile_pos, tiles_count, atlas, tint); });
 	}
 
 	struct Vertex_Draw_Lines {
@@ -209,15 +269,7 @@ namespace engine {
 		{ "pos_model",			FV3,	(int)offsetof(Vertex_Draw_Lines, pos_model) },
 	}};
 
-	void draw_lines (Gpu_Mesh const& lines, v3 pos, quat ori=quat::ident(), v3 size=1, lrgba col=1) {
-
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glEnable(GL_DEPTH_TEST);
-		glDepthMask(GL_TRUE);
-		glDisable(GL_CULL_FACE);
-		glDisable(GL_SCISSOR_TEST);
-
+	Shader* _draw_lines_shader () {
 		inline_shader("_simple_draw_rect.vert", R"_SHAD(
 			$include "common.vert"
 
@@ -241,18 +293,19 @@ namespace engine {
 			}
 		)_SHAD");
 
-		auto* s = use_shader("_simple_draw_rect");
-		if (s) {
-
-			hm model_to_world = translateH(pos) * convert_to_hm(ori) * scaleH(size);
-
-			set_uniform(s, "model_to_world", model_to_world.m4());
-			set_uniform(s, "col", col);
+		return _get_shader("_simple_draw_rect");
+	}
+	void draw_lines (Gl_Command_Buffer& cmds, Gpu_Mesh const& lines, v3 pos, quat ori=quat::ident(), v3 size=1, lrgba col=1) {
+		hm model_to_world = translateH(pos) * convert_to_hm(ori) * scaleH(size);
 
-			lines.draw(LINES, *s);
-		}
+		cmds.draw(_state_lines, _draw_lines_shader, &lines, LINES, length(pos -cmds.view_pos));
+		cmds.uniform("model_to_world", model_to_world.m4());
+		cmds.uniform("col", col);
+	}
+	void draw_lines (Gpu_Mesh const& lines, v3 pos, quat ori=quat::ident(), v3 size=1, lrgba col=1) {
+		_draw_immediate([&] (Gl_Command_Buffer& cmds) { draw_lines(cmds, lines, pos, ori, size, col); });
 	}
-	void draw_line (v3 a, v3 b, lrgba col=1) {
+	void draw_line (v3 a, v3 b, lrgba col=1) { // immediate only, the mesh is reuploaded every call
 		static Cpu_Mesh<Vertex_Draw_Lines> mesh;
 		mesh.vertices.clear();
 		mesh.vertices.push_back({ 0 });
@@ -260,7 +313,7 @@ namespace engine {
 		draw_lines(mesh.upload(), a, quat::ident(), 1, col);
 	}
 
-	void draw_box_outline (v3 pos, quat ori, v3 size, lrgba col=1) {
+	Gpu_Mesh const* _box_outline_mesh () {
 		static auto box = [] () {
 			Cpu_Mesh<Vertex_Draw_Lines> mesh;
 
@@ -286,19 +339,20 @@ namespace engine {
 
 			return mesh.upload();
 		} ();
-
-		draw_lines(box, pos, ori, size, col);
+		return &box;
 	}
+	void draw_box_outline (Gl_Command_Buffer& cmds, v3 pos, quat ori, v3 size, lrgba col=1) {
+		hm model_to_world = translateH(pos) * convert_to_hm(ori) * scaleH(size);
 
-	void draw_simple (Gpu_Mesh const& mesh, v3 pos_world, quat ori=quat::ident(), v3 scale=1, lrgba col=1) {
-
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glEnable(GL_DEPTH_TEST);
-		glDepthMask(GL_TRUE);
-		glEnable(GL_CULL_FACE);
-		glDisable(GL_SCISSOR_TEST);
+		cmds.draw(_state_lines, _draw_lines_shader, _box_outline_mesh, LINES, length(pos -cmds.view_pos));
+		cmds.uniform("model_to_world", model_to_world.m4());
+		cmds.uniform("col", col);
+	}
+	void draw_box_outline (v3 pos, quat ori, v3 size, lrgba col=1) {
+		_draw_immediate([&] (Gl_Command_Buffer& cmds) { draw_box_outline(cmds, pos, ori, size, col); });
+	}
 
+	Shader* _draw_simple_shader () {
 		inline_shader("_simple_draw_3d.vert", R"_SHAD(
 			$include "common.vert"
 
@@ -338,22 +392,32 @@ namespace engine {
 			}
 		)_SHAD");
 
-		auto* s = use_shader("_simple_draw_3d");
-		if (s) {
-
-			hm model_to_world = translateH(pos_world) * convert_to_hm(ori) * scaleH(scale);
-
-			set_uniform(s, "model_to_world", model_to_world.m4());
-			set_uniform(s, "albedo", col);
+		return _get_shader("_simple_draw_3d");
+	}
+	void draw_simple (Gl_Command_Buffer& cmds, Gpu_Mesh const& mesh, v3 pos_world, quat ori=quat::ident(), v3 scale=1, lrgba col=1) {
+		hm model_to_world = translateH(pos_world) * convert_to_hm(ori) * scaleH(scale);
 
-			mesh.draw(*s);
-		}
+		cmds.draw(_state_3d, _draw_simple_shader, &mesh, TRIANGLES, length(pos_world -cmds.view_pos));
+		cmds.uniform("model_to_world", model_to_world.m4());
+		cmds.uniform("albedo", col);
+	}
+	void draw_simple (Gpu_Mesh const& mesh, v3 pos_world, quat ori=quat::ident(), v3 scale=1, lrgba col=1) {
+		_draw_immediate([&] (Gl_Command_Buffer& cmds) { draw_simple(cmds, mesh, pos_world, ori, scale, col); });
 	}
 
-	void draw_simple (v3 pos_world, quat ori=quat::ident(), v3 scale=1, lrgba col=1) {
+	Gpu_Mesh const* _simple_cube_mesh () {
 		static auto cube = Default_Vertex_3d::gen_cube().upload();
+		return &cube;
+	}
+	void draw_simple (Gl_Command_Buffer& cmds, v3 pos_world, quat ori=quat::ident(), v3 scale=1, lrgba col=1) {
+		hm model_to_world = translateH(pos_world) * convert_to_hm(ori) * scaleH(scale);
 
-		draw_simple(cube, pos_world, ori, scale, col);
+		cmds.draw(_state_3d, _draw_simple_shader, _simple_cube_mesh, TRIANGLES, length(pos_world -cmds.view_pos));
+		cmds.uniform("model_to_world", model_to_world.m4());
+		cmds.uniform("albedo", col);
+	}
+	void draw_simple (v3 pos_world, quat ori=quat::ident(), v3 scale=1, lrgba col=1) {
+		_draw_immediate([&] (Gl_Command_Buffer& cmds) { draw_simple(cmds, pos_world, ori, scale, col); });
 	}
 
 	struct Vertex_Just_Pos {
@@ -365,15 +429,7 @@ namespace engine {
 		{ "pos_world",			FV3,	(int)offsetof(Vertex_Just_Pos, pos_world) },
 	}};
 
-	void draw_skybox_gradient () {
-
-		glDisable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glDisable(GL_DEPTH_TEST);
-		glDepthMask(GL_FALSE);
-		glDisable(GL_CULL_FACE);
-		glDisable(GL_SCISSOR_TEST);
-
+	Shader* _draw_skybox_gradient_shader () {
 		inline_shader("_draw_skybox_gradient.vert", R"_SHAD(
 			$include "common.vert"
 
@@ -412,13 +468,17 @@ namespace engine {
 			}
 		)_SHAD");
 
-		auto* s = use_shader("_draw_skybox_gradient");
-		if (s) {
-
-			static auto cube = engine::gen_cube<Vertex_Just_Pos>([] (v3 p, v3 n, v2 u, int f) { return Vertex_Just_Pos{p}; }).upload();
-			cube.draw(*s);
-		}
-
+		return _get_shader("_draw_skybox_gradient");
+	}
+	Gpu_Mesh const* _skybox_cube_mesh () {
+		static auto cube = engine::gen_cube<Vertex_Just_Pos>([] (v3 p, v3 n, v2 u, int f) { return Vertex_Just_Pos{p}; }).upload();
+		return &cube;
+	}
+	void draw_skybox_gradient (Gl_Command_Buffer& cmds) {
+		cmds.draw(_state_skybox, _draw_skybox_gradient_shader, _skybox_cube_mesh, TRIANGLES);
+	}
+	void draw_skybox_gradient () {
+		_draw_immediate([&] (Gl_Command_Buffer& cmds) { draw_skybox_gradient(cmds); });
 	}
 //
 }
@@ -6,6 +6,10 @@
 namespace imgui_file_browser {
 using namespace engine;
 
+// File tree that only lists the dirs that are open in the gui
+//  children are kept sorted by name, so lookups are binary searches and a reload merges the old and new lists in one pass (keeping open subdirs open)
+//  one Directory_Watcher for the lifetime of the tree watches only the open dirs (added when a dir is opened, dropped when it is closed)
+//  its changes are applied one by one as inserts and removes, a renamed dir is moved in the tree, so it stays open
 struct Dynamic_File_Tree {
 	
 	struct File_Or_Dir {
@@ -23,36 +27,71 @@ struct Dynamic_File_Tree {
 		Directory (): File_Or_Dir{true} {}
 		Directory (std::string filename): File_Or_Dir{true, filename} {}
 
+		Directory*	parent = nullptr; // nullptr for the root dir
+
 		bool	is_open = false; // dir needs to be open to be able to view files and subdirs in it (for performance reasons)
 		bool	is_valid = true; // os can throw errors on file queries -> invalid dir (no files and subdirs), non open dirs are always "valid"
 
-		std::vector<shared_ptr<Directory>>	dirs;
-		std::vector<shared_ptr<File>>		files;
-
-		unique_ptr<Directory_Watcher>		watcher = nullptr;
+		std::vector<shared_ptr<Directory>>	dirs; // sorted by filename (which has a trailing '/' for dirs)
+		std::vector<shared_ptr<File>>		files; // sorted by filename
 
 		bool is_empty () {
 			return dirs.size() == 0 && files.size() == 0;
 		}
 
-		std::vector<shared_ptr<File_Or_Dir>> get_files (bool sort_alphabethical, bool subdirs_always_first) {
-			std::vector<shared_ptr<File_Or_Dir>> list;
-			for (auto& d : dirs)	list.push_back(d);
-			for (auto& f : files)	list.push_back(f);
+		template <typename T>
+		static typename std::vector<shared_ptr<T>>::iterator lower_bound (std::vector<shared_ptr<T>>& list, std::string const& name) {
+			return std::lower_bound(list.begin(),list.end(), name, [] (shared_ptr<T> const& l, std::string const& r) { return l->filename < r; });
+		}
+		template <typename T>
+		static T* find (std::vector<shared_ptr<T>>& list, std::string const& name) {
+			auto it = lower_bound(list, name);
+			return it != list.end() && (*it)->filename == name ? it->get() : nullptr;
+		}
 
-			std::sort(list.begin(),list.end(), [&] (shared_ptr<File_Or_Dir> const& l, shared_ptr<File_Or_Dir> const& r) {
-				if (subdirs_always_first && (l->is_dir != r->is_dir))
-					return l->is_dir;
-				return std::less<std::string>()(l->filename, r->filename);
-			});
+		Directory* find_dir (std::string const& dirname) { // dirname with trailing '/'
+			return find(dirs, dirname);
+		}
 
-			return list;
+		// returns true if the dir changed
+		bool insert_dir (std::string const& dirname) {
+			auto it = lower_bound(dirs, dirname);
+			if (it != dirs.end() && (*it)->filename == dirname)
+				return false;
+			auto dir = make_shared<Directory>(dirname);
+			dir->parent = this;
+			dirs.insert(it, std::move(dir));
+			return true;
+		}
+		bool insert_file (std::string const& filename) {
+			auto it = lower_bound(files, filename);
+			if (it != files.end() && (*it)->filename == filename)
+				return false;
+			files.insert(it, make_shared<File>(filename));
+			return true;
+		}
+		bool remove_dir (std::string const& dirname) {
+			auto it = lower_bound(dirs, dirname);
+			if (it == dirs.end() || (*it)->filename != dirname)
+				return false;
+			dirs.erase(it);
+			return true;
+		}
+		bool remove_file (std::string const& filename) {
+			auto it = lower_bound(files, filename);
+			if (it == files.end() || (*it)->filename != filename)
+				return false;
+			files.erase(it);
+			return true;
 		}
 
-		void update (std::string const& path, std::string const& new_dirname, std::string const& file_filter) {
+		// full rescan of this dir (and its open subdirs), open dirs are added to the watcher
+		void update (std::string const& path, std::string const& new_dirname, std::string const& file_filter, Directory_Watcher& watcher) {
 			
 			auto old_dirs	= std::move(dirs);
 			auto old_files	= std::move(files);
+			dirs.clear();
+			files.clear();
 
 			if (filename != new_dirname) {
 				old_dirs.clear();
@@ -65,32 +104,35 @@ struct Dynamic_File_Tree {
 
 			std::string dirpath = path + filename;
 
+			watcher.watch_dir(dirpath); // before listing the files, so changes during the listing are not missed
+
 			std::vector<std::string> dirnames;
 			std::vector<std::string> filenames;
-			is_valid = n_find_files::find_files(dirpath, &dirnames, &filenames, file_filter);
-
-			watcher = make_unique<Directory_Watcher>(dirpath);
+			is_valid = n_find_files::find_files(dirpath, &dirnames, &filenames, file_filter); // sorted
 
 			if (is_valid) {
 				
 				// keep old Directory and File structures alive if we have the same dir/file in the old and the updated file tree -> this keeps directories open after a reload
+				//  both lists are sorted, so walk them in parallel
+				dirs.reserve(dirnames.size());
+				auto old_dir = old_dirs.begin();
 				for (auto& subdirname : dirnames) {
-					auto res = std::find_if(old_dirs.begin(),old_dirs.end(), [&] (shared_ptr<Directory>& d) { return d && d->filename == subdirname; });
-					auto dir = res != old_dirs.end() ? std::move(*res) : nullptr;
-
-					if (!dir)
-						dir = make_shared<Directory>(subdirname);
+					while (old_dir != old_dirs.end() && (*old_dir)->filename < subdirname)
+						++old_dir;
+					auto dir = old_dir != old_dirs.end() && (*old_dir)->filename == subdirname ? std::move(*old_dir++) : make_shared<Directory>(subdirname);
+					dir->parent = this;
 					
-					dir->update(dirpath, subdirname, file_filter);
+					dir->update(dirpath, subdirname, "*", watcher); // filter only counts on root dir
 
 					dirs.emplace_back(std::move(dir));
 				}
-				for (auto& filename : filenames) {
-					auto res = std::find_if(old_files.begin(),old_files.end(), [&] (shared_ptr<File>& f) { return f && f->filename == filename; });
-					auto file = res != old_files.end() ? std::move(*res) : nullptr;
 
-					if (!file)
-						file = make_shared<File>(filename);
+				files.reserve(filenames.size());
+				auto old_file = old_files.begin();
+				for (auto& filename : filenames) {
+					while (old_file != old_files.end() && (*old_file)->filename < filename)
+						++old_file;
+					auto file = old_file != old_files.end() && (*old_file)->filename == filename ? std::move(*old_file++) : make_shared<File>(filename);
 					
 					files.emplace_back(std::move(file));
 				}
@@ -98,29 +140,7 @@ struct Dynamic_File_Tree {
 			}
 		}
 
-		void poll_files_changed (std::string const& path, std::string const& new_filename, std::string const& file_filter) {
-			
-			if (!is_open)
-				return;
-
-			std::vector<Directory_Watcher::File_Change> file_changes;
-			bool files_changed = watcher->poll_file_changes(&file_changes);
-
-			std::string dirpath = path + new_filename;
-
-			if (files_changed) {
-
-				for (auto& dir : dirs)
-					dir->update(dirpath, dir->filename, file_filter);
-			} else {
-				
-				for (auto& dir : dirs)
-					dir->poll_files_changed(dirpath, dir->filename, file_filter);
-			}
-
-		}
-
-		void set_open (bool o, std::string const& path, std::string const& file_filter) {
+		void set_open (bool o, std::string const& path, std::string const& file_filter, Directory_Watcher& watcher) {
 			if (o == is_open) return;
 
 			is_open = o;
@@ -128,11 +148,12 @@ struct Dynamic_File_Tree {
 			if (!is_open) {
 				dirs.clear();
 				files.clear();
-				watcher = nullptr;
 
 				is_valid = true;
+
+				watcher.unwatch_dir(path + filename); // and its subdirs
 			} else {
-				update(path, filename, file_filter);
+				update(path, filename, file_filter, watcher);
 			}
 		}
 	};
@@ -143,13 +164,132 @@ struct Dynamic_File_Tree {
 
 	std::string				file_filter;
 
+	Directory_Watcher		watcher; // watches the open dirs, without their subdirs
+	std::string				watched_root; // base_path + root dirname the watches are for
+
 	bool root_dir_is_valid () { return root_dir->is_valid; }
 
 	void update (std::string const& new_dirname) {
-		root_dir->update(base_path, new_dirname, file_filter);
+		std::string root_path = base_path + new_dirname;
+		if (root_path != watched_root) { // the open dirs get watched again under their new paths by the update
+			watcher.unwatch_all();
+			watched_root = root_path;
+		}
+		root_dir->update(base_path, new_dirname, file_filter, watcher);
+	}
+
+	// applies the changes the watcher reported, returns true if the tree changed
+	bool poll_files_changed () {
+		std::vector<Directory_Watcher::File_Change> file_changes;
+		if (!watcher.poll_file_changes(&file_changes))
+			return false;
+
+		bool changed = false;
+		for (uptr i=0; i<file_changes.size(); ++i) {
+			auto& c = file_changes[i];
+			if (c.change == FILE_RENAMED_OLD_NAME && i +1 < file_changes.size() && file_changes[i +1].change == FILE_RENAMED_NEW_NAME) {
+				changed = apply_rename(c, file_changes[i +1]) || changed;
+				++i;
+			} else {
+				changed = apply_change(c) || changed;
+			}
+		}
+		return changed;
+	}
+
+	// the dir a file is in if its contents are loaded, changes in dirs that are not open can be ignored
+	Directory* find_loaded_dir (std::string const& filepath, std::string* name) {
+		std::string root_path = base_path + root_dir->filename;
+
+		if (filepath.compare(0, root_path.size(), root_path) != 0)
+			return nullptr;
+
+		Directory* dir = root_dir.get();
+		uptr pos = root_path.size();
+		for (;;) {
+			if (!dir->is_open || !dir->is_valid)
+				return nullptr;
+
+			auto slash = filepath.find('/', pos);
+			if (slash == filepath.npos)
+				break;
+
+			dir = dir->find_dir(filepath.substr(pos, slash +1 -pos));
+			if (!dir)
+				return nullptr;
+			pos = slash +1;
+		}
+
+		*name = filepath.substr(pos);
+		if (name->size() == 0)
+			return nullptr;
+
+		if (dir == root_dir.get() && !n_find_files::match_filter(name->c_str(), file_filter.c_str()))
+			return nullptr;
+		return dir;
+	}
+
+	// a renamed dir is moved in the tree, so it stays open together with its open subdirs, files (and dirs we can not move) are removed and added
+	bool apply_rename (Directory_Watcher::File_Change const& old_name, Directory_Watcher::File_Change const& new_name) {
+		std::string from, to;
+		Directory* from_dir = find_loaded_dir(old_name.filepath, &from);
+		Directory* to_dir = find_loaded_dir(new_name.filepath, &to);
+
+		bool is_dir = false;
+		Directory* moved = nullptr;
+		if (from_dir && to_dir && n_find_files::file_exists(new_name.filepath, &is_dir) && is_dir)
+			moved = from_dir->find_dir(from +'/');
+
+		if (!moved || !moved->is_open) {
+			bool changed = apply_change(old_name);
+			return apply_change(new_name) || changed;
+		}
+
+		auto it = Directory::lower_bound(from_dir->dirs, from +'/');
+		auto dir = std::move(*it);
+		from_dir->dirs.erase(it);
+
+		to_dir->remove_file(to);
+		to_dir->remove_dir(to +'/');
+
+		dir->parent = to_dir;
+		dir->filename = to +'/';
+		to_dir->dirs.insert(Directory::lower_bound(to_dir->dirs, dir->filename), dir);
+
+		// the watcher dropped the watches of the old path, this watches it (and its open subdirs) again and picks up what changed in it in the meantime
+		dir->update(get_path(dir.get()), dir->filename, "*", watcher);
+		return true;
+	}
+
+	bool apply_change (Directory_Watcher::File_Change const& change) {
+		auto& filepath = change.filepath;
+
+		std::string name;
+		Directory* dir = find_loaded_dir(filepath, &name);
+		if (!dir)
+			return false;
+
+		// events do not say if it was a file or a dir (and the file could have been removed again since), so look at what is there now
+		bool is_dir = false;
+		bool exists = change.change != FILE_REMOVED && change.change != FILE_RENAMED_OLD_NAME && n_find_files::file_exists(filepath, &is_dir);
+
+		bool changed = false;
+		if (!exists || !is_dir)		changed = dir->remove_dir(name +'/') || changed;
+		if (!exists || is_dir)		changed = dir->remove_file(name) || changed;
+		if (exists)					changed = (is_dir ? dir->insert_dir(name +'/') : dir->insert_file(name)) || changed;
+		return changed;
 	}
-	void poll_files_changed (std::string const& dirname) {
-		root_dir->poll_files_changed(base_path, dirname, file_filter);
+
+	// base_path + names of all the parent dirs
+	std::string get_path (Directory const* dir) {
+		std::vector<Directory const*> parents;
+		for (auto* d = dir->parent; d; d = d->parent)
+			parents.push_back(d);
+
+		std::string path = base_path;
+		for (auto it=parents.rbegin(); it!=parents.rend(); ++it)
+			path += (*it)->filename;
+		return path;
 	}
 
 	std::string const& get_root_dirname () {
@@ -227,9 +367,10 @@ struct Dynamic_File_Tree {
 		split_path(std::move(path), parent_path, dirname);
 	}
 	
-	void make_dir_root_dir (shared_ptr<Directory>& dir, std::string const& new_basepath) {
+	void make_dir_root_dir (shared_ptr<Directory> dir, std::string const& new_basepath) {
 		base_path = new_basepath;
-		root_dir = dir;
+		root_dir = std::move(dir);
+		root_dir->parent = nullptr;
 	}
 	void make_parent_dir_root_dir () {
 
@@ -242,6 +383,7 @@ struct Dynamic_File_Tree {
 
 		auto new_root_dir = make_shared<Directory>(new_root_dirname);
 		new_root_dir->dirs.push_back( root_dir );
+		root_dir->parent = new_root_dir.get();
 		new_root_dir->is_open = true; // need to set this to open or else the existing subdirs will be thrown away and recreated
 
 		base_path = std::move(new_base_path);
@@ -263,6 +405,28 @@ struct Imgui_File_Browser {
 
 	bool				trigger_folder_changed;
 
+	// the open part of the tree flattened into rows, so that ImGuiListClipper only has to draw the rows that are on screen
+	struct Row {
+		Dynamic_File_Tree::File_Or_Dir*	entry; // nullptr for the <empty> of an empty dir
+		int								depth;
+	};
+	std::vector<Row>	rows;
+	bool				rows_dirty = true;
+
+	void add_rows (Dynamic_File_Tree::Directory* dir, int depth) {
+		rows.push_back({ dir, depth });
+		if (!dir->is_open)
+			return;
+
+		for (auto& d : dir->dirs) // subdirs first
+			add_rows(d.get(), depth +1);
+		for (auto& f : dir->files)
+			rows.push_back({ f.get(), depth +1 });
+
+		if (dir->is_empty())
+			rows.push_back({ nullptr, depth +1 });
+	}
+
 	Imgui_File_Browser (std::string initial_file_pattern) {
 		file_pattern = std::move(initial_file_pattern);
 	}
@@ -278,16 +442,12 @@ struct Imgui_File_Browser {
 		std::string new_basepath, new_dirname, new_file_filter;
 		Dynamic_File_Tree::path_from_pattern(file_pattern, &new_basepath, &new_dirname, &new_file_filter);
 
-		std::vector<std::string> changed_files;
-
 		imgui::SameLine();
 		bool folder_changed =	imgui::Button("Reload")
 							||	trigger_folder_changed
 							||	file_tree.base_path				!= new_basepath
 							||	file_tree.get_root_dirname()	!= new_dirname
-							||	file_tree.file_filter			!= new_file_filter
-				//(watcher && watcher->poll_file_changes(&changed_files))
-				; // directory watcher reports changes in all subdirs (even if we dont have those folders open), but just update the file tree anyway for now
+							||	file_tree.file_filter			!= new_file_filter; // changes inside the folder are applied by poll_files_changed
 		if (folder_changed) {
 			file_tree.base_path = new_basepath;
 			file_tree.file_filter = new_file_filter;
@@ -296,7 +456,8 @@ struct Imgui_File_Browser {
 			//assert(file_tree.root_dir_is_valid() == watcher->directory_is_valid());
 		}
 
-		file_tree.poll_files_changed(new_dirname);
+		if (file_tree.poll_files_changed())
+			rows_dirty = true;
 
 		trigger_folder_changed = false;
 
@@ -306,97 +467,120 @@ struct Imgui_File_Browser {
 
 				file_pattern = file_tree.base_path + file_tree.get_root_dirname();
 				trigger_folder_changed = true;
+				rows_dirty = true;
 
 				// TODO: imgui keeps overwriting our cahnge of the file_pattern
 			}
 		}
 
-		struct Recurse {
-			Imgui_File_Browser* this_;
-			bool	folder_changed;
-			bool*	trigger_folder_changed;
-			Input& inp;
-			
-			void recurse (shared_ptr<Dynamic_File_Tree::Directory> dir, std::string const& path, int depth = 0) {
-				
-				bool default_open = depth == 0;
-				bool open = dir->is_open || (default_open && folder_changed);
-
-				imgui::SetNextTreeNodeOpen(open);
+		if (folder_changed) {
+			file_tree.root_dir->set_open(true, file_tree.base_path, file_tree.file_filter, file_tree.watcher); // root dir is open by default
+			rows_dirty = true;
+		}
 
-				if (!dir->is_valid) imgui::PushStyleColor(ImGuiCol_Text, ImVec4(1,0,0,1));
+		if (rows_dirty) {
+			rows.clear();
+			add_rows(file_tree.root_dir.get(), 0);
+			rows_dirty = false;
+		}
 
-				open = imgui::TreeNode(dir->filename.c_str());
+		// changing the tree would free entries that rows still point to, so do it after drawing
+		Dynamic_File_Tree::Directory* toggle_dir = nullptr;
+		Dynamic_File_Tree::Directory* enter_dir = nullptr;
+		bool exit_dir = false;
 
-				if (!dir->is_valid) imgui::PopStyleColor();
+		ImGuiListClipper clipper;
+		clipper.Begin((int)rows.size());
+		while (clipper.Step()) {
+			for (int i=clipper.DisplayStart; i<clipper.DisplayEnd; ++i) {
+				auto& row = rows[i];
 
-				dir->set_open(open, path, depth == 0 ? this_->file_tree.file_filter : "*"); // only apply filter on root dir
+				flt indent = (flt)row.depth * imgui::GetStyle().IndentSpacing;
+				if (indent > 0) imgui::Indent(indent); // Indent(0) would indent by the default amount
 
-				if (depth == 0 && this_->file_tree.file_filter != "*") { // filter only counts on root dir
-					imgui::SameLine();
-					imgui::PushStyleColor(ImGuiCol_Text, ImVec4(0.3f,0.7f,0.3f,1));
-					imgui::Text(prints("<%s>", this_->file_tree.file_filter.c_str()).c_str());
+				if (!row.entry) {
+					imgui::PushStyleColor(ImGuiCol_Text, ImVec4(0.3f,0.3f,0.3f,1));
+					imgui::Text("<empty>");
 					imgui::PopStyleColor();
-				}
 
-				if (depth == 0) {
-					if (this_->file_tree.has_parent_dir()) {
-						imgui::PushStyleVar(ImGuiStyleVar_FrameRounding, 5);
+				} else if (row.entry->is_dir) {
+					auto* dir = (Dynamic_File_Tree::Directory*)row.entry;
+					imgui::PushID(dir);
 
-						imgui::SameLine();
-						if (imgui::SmallButton(prints(" .. ###%s", dir->filename.c_str()).c_str())) { // exit directory
-							this_->file_tree.make_parent_dir_root_dir();
+					imgui::SetNextTreeNodeOpen(dir->is_open);
 
-							this_->file_pattern = this_->file_tree.base_path + this_->file_tree.get_root_dirname();
-							*trigger_folder_changed = true;
-						}
+					if (!dir->is_valid) imgui::PushStyleColor(ImGuiCol_Text, ImVec4(1,0,0,1));
 
-						imgui::PopStyleVar();
-					}
-				} else {
-					imgui::PushStyleVar(ImGuiStyleVar_FrameRounding, 5);
+					bool open = imgui::TreeNodeEx("##dir", ImGuiTreeNodeFlags_NoTreePushOnOpen, "%s", dir->filename.c_str()); // rows do the indentation
+					if (open != dir->is_open)
+						toggle_dir = dir;
 
-					imgui::SameLine();
-					if (imgui::SmallButton(prints(" -> ###%s", dir->filename.c_str()).c_str())) { // enter directory (make it root of of the Imgui_File_Tree)
-						this_->file_tree.make_dir_root_dir(dir, path);
+					if (!dir->is_valid) imgui::PopStyleColor();
 
-						this_->file_pattern = this_->file_tree.base_path + this_->file_tree.get_root_dirname();
-						*trigger_folder_changed = true;
+					if (row.depth == 0 && file_tree.file_filter != "*") { // filter only counts on root dir
+						imgui::SameLine();
+						imgui::PushStyleColor(ImGuiCol_Text, ImVec4(0.3f,0.7f,0.3f,1));
+						imgui::Text("<%s>", file_tree.file_filter.c_str());
+						imgui::PopStyleColor();
 					}
 
-					imgui::PopStyleVar();
-				}
+					if (row.depth == 0) {
+						if (file_tree.has_parent_dir()) {
+							imgui::PushStyleVar(ImGuiStyleVar_FrameRounding, 5);
 
-				//if (!dir.valid && imgui::IsItemHovered()) imgui::SetTooltip("reason for invalid dir");
-				
-				if (open) {	
-					for (auto& f : dir->get_files(false, true)) {
-						if (f->is_dir) {
-							auto subdir = std::static_pointer_cast<Dynamic_File_Tree::Directory>(f);
-							recurse(subdir, path + dir->filename, depth +1);
-						} else {
-							auto file = std::static_pointer_cast<Dynamic_File_Tree::File>(f);
-							
-							auto filepath = path + file->filename;
-
-							bool selected = false;
-							bool selected_changed = imgui::Selectable(file->filename.c_str(), &selected);
+							imgui::SameLine();
+							if (imgui::SmallButton(" .. ")) // exit directory
+								exit_dir = true;
 
+							imgui::PopStyleVar();
 						}
+					} else {
+						imgui::PushStyleVar(ImGuiStyleVar_FrameRounding, 5);
+
+						imgui::SameLine();
+						if (imgui::SmallButton(" -> ")) // enter directory (make it root of of the Imgui_File_Tree)
+							enter_dir = dir;
+
+						imgui::PopStyleVar();
 					}
-		
-					if (dir->is_empty()) {
-						imgui::PushStyleColor(ImGuiCol_Text, ImVec4(0.3f,0.3f,0.3f,1));
-						imgui::Text("<empty>");
-						imgui::PopStyleColor();
-					}
-		
-					imgui::TreePop();
+
+					//if (!dir.valid && imgui::IsItemHovered()) imgui::SetTooltip("reason for invalid dir");
+
+					imgui::PopID();
+				} else {
+					imgui::PushID(row.entry);
+
+					bool selected = false;
+					bool selected_changed = imgui::Selectable(row.entry->filename.c_str(), &selected);
+
+					imgui::PopID();
 				}
+
+				if (indent > 0) imgui::Unindent(indent);
 			}
-		};
-		
-		Recurse{this, folder_changed, &trigger_folder_changed, inp}.recurse(file_tree.root_dir, file_tree.base_path);
+		}
+
+		if (toggle_dir) {
+			bool is_root = toggle_dir == file_tree.root_dir.get();
+			toggle_dir->set_open(!toggle_dir->is_open, file_tree.get_path(toggle_dir), is_root ? file_tree.file_filter : "*", file_tree.watcher); // only apply filter on root dir
+			rows_dirty = true;
+		}
+		if (exit_dir) {
+			file_tree.make_parent_dir_root_dir();
+
+			file_pattern = file_tree.base_path + file_tree.get_root_dirname();
+			trigger_folder_changed = true;
+			rows_dirty = true;
+		}
+		if (enter_dir) {
+			auto path = file_tree.get_path(enter_dir);
+			auto dir = *Dynamic_File_Tree::Directory::lower_bound(enter_dir->parent->dirs, enter_dir->filename);
+			file_tree.make_dir_root_dir(std::move(dir), path);
+
+			file_pattern = file_tree.base_path + file_tree.get_root_dirname();
+			trigger_folder_changed = true;
+			rows_dirty = true;
+		}
 
 		/*
 		
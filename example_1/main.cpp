@@ -10,6 +10,14 @@ using namespace vector;
 
 using engine::Input;
 using engine::Camera2D;
+using engine::Options;
+using engine::Option;
+
+// registered once, shown with opt.imgui(), alt+L / alt+S loads and saves saves/options.xml
+Options opt ("saves/options");
+
+auto bg_color	= opt.add<lrgb>("bg_color", srgb8(7,14,32).to_lrgb());
+auto pos		= opt.add<iv2>("pos", iv2(4, 12));
 
 void game (Input& inp) {
 
@@ -20,18 +28,84 @@ void game (Input& inp) {
 	cam.update(inp, 1.0f / 60);
 	cam.draw_to();
 
-	static auto bg_color = srgb8(7,14,32).to_lrgb();
-	engine::clear(bg_color);
+	engine::clear(opt[bg_color]);
 
-	static iv2 pos=iv2(4, 12);
-	imgui::DragInt2("pos", &pos.x, 1.0f / 20);
+	opt.imgui();
 
 	for (auto p : { iv2(-1,0), iv2(0,0), iv2(+1,0), iv2(0,-1) })
-		engine::draw_rect((v2)(pos +p) +0.5f, 1, 1);
+		engine::draw_rect((v2)(opt[pos] +p) +0.5f, 1, 1);
 }
 
-int main () {
-	
+// reading options every frame:  Save::value by name vs with a call site cache vs an Options handle
+//  example_1.exe --bench
+int benchmark () {
+	const int N = 2500, FRAMES = 200; // options per type, so 4*N = 10k options
+
+	std::vector<std::string> names; // 4 per i: _f _v _i _b
+	for (int i=0; i<N; ++i)
+		for (cstr suffix : { "_f", "_v", "_i", "_b" })
+			names.push_back("opt" + std::to_string(i) + suffix);
+
+	volatile flt sink = 0;
+
+	Options o ("saves/bench_options");
+	std::vector<Option<flt>> hf; std::vector<Option<v3>> hv; std::vector<Option<int>> hi; std::vector<Option<bool>> hb;
+	for (int i=0; i<N; ++i) {
+		hf.push_back(o.add<flt>(names[i*4 +0].c_str(), (flt)i));
+		hv.push_back(o.add<v3>(names[i*4 +1].c_str(), v3((flt)i)));
+		hi.push_back(o.add<int>(names[i*4 +2].c_str(), i));
+		hb.push_back(o.add<bool>(names[i*4 +3].c_str(), (i & 1) != 0));
+	}
+
+	u64 begin = profiler::now_ns();
+	for (int frame=0; frame<FRAMES; ++frame) {
+		flt sum = 0;
+		for (int i=0; i<N; ++i)
+			sum += o[hf[i]] + o[hv[i]].y + (flt)o[hi[i]] + (o[hb[i]] ? 1.0f : 0.0f);
+		sink = sink + sum;
+	}
+	flt options_us = (flt)(profiler::now_ns() -begin) * 1e-3f / FRAMES;
+
+	std::vector<flt> f (N); std::vector<v3> v (N); std::vector<int> n (N); std::vector<bool> b (N);
+	std::vector<engine::Save::Cache> cache (N * 4);
+
+	engine::Save s;
+	s.filepath = "saves/bench_save";
+	s.trigger_load = false;
+	s.trigger_save = false;
+
+	flt save_us[2];
+	for (int cached=0; cached<2; ++cached) {
+		u64 begin = profiler::now_ns();
+		for (int frame=0; frame<FRAMES; ++frame) {
+			s.begin_frame();
+			flt sum = 0;
+			for (int i=0; i<N; ++i) {
+				auto* c = cached ? &cache[i * 4] : nullptr;
+				bool bi = b[i];
+				s.value(names[i*4 +0].c_str(), &f[i], c ? c +0 : nullptr);
+				s.value(names[i*4 +1].c_str(), &v[i], c ? c +1 : nullptr);
+				s.value(names[i*4 +2].c_str(), &n[i], c ? c +2 : nullptr);
+				s.value(names[i*4 +3].c_str(), &bi, c ? c +3 : nullptr);
+				sum += f[i] + v[i].y + (flt)n[i] + (bi ? 1.0f : 0.0f);
+			}
+			s.end_frame();
+			sink = sink + sum;
+		}
+		save_us[cached] = (flt)(profiler::now_ns() -begin) * 1e-3f / FRAMES;
+	}
+
+	printf("reading %d options per frame:\n", N * 4);
+	printf("  Save::value by name         %8.2f us\n", save_us[0]);
+	printf("  Save::value call site cache %8.2f us\n", save_us[1]);
+	printf("  Options handle              %8.2f us\n", options_us);
+	return 0;
+}
+
+int main (int argc, char** argv) {
+	if (argc >= 2 && strcmp(argv[1], "--bench") == 0)
+		return benchmark();
+
 	engine::Window wnd;
 	wnd.open(MSVC_PROJECT_NAME);
 
@@ -45,6 +119,8 @@ int main () {
 		if (wnd.inp.went_down(GLFW_KEY_F11))
 			wnd.toggle_fullscreen();
 
+		opt.begin_frame(wnd.inp.alt_combo('L') || frame_i == 0);
+
 		engine::begin_imgui(&wnd.inp, dt);
 
 		game(wnd.inp);
@@ -52,6 +128,8 @@ int main () {
 		engine::draw_to_screen(wnd.inp.wnd_size_px);
 		engine::end_imgui(wnd.inp.wnd_size_px);
 
+		opt.end_frame(wnd.inp.alt_combo('S'));
+
 		wnd.swap_buffers();
 
 		dt = dt_measure.frame();
@@ -1,43 +1,311 @@
 #pragma once
 
-#include "windows.h"
+#ifdef _WIN32
+	#include "windows.h"
+#else
+	#include <sys/inotify.h>
+	#include <unistd.h>
+	#include <errno.h>
+#endif
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+#include <set>
+
+#include "mylibs/float_precision.hpp"
 #include "mylibs/string.hpp"
 #include "mylibs/containers.hpp"
+#include "mylibs/find_files.hpp"
 
 namespace n_directory_watcher {
 //
 using namespace basic_typedefs;
+using namespace float_precision;
 using namespace string;
 
 enum file_change_e {
 	FILE_ADDED,
 	FILE_MODIFIED,
-	FILE_RENAMED_NEW_NAME,
+	FILE_RENAMED_OLD_NAME, // always reported right before the FILE_RENAMED_NEW_NAME of the same rename (unless debouncing held back one of them)
+	FILE_RENAMED_NEW_NAME, // without a FILE_RENAMED_OLD_NAME before it the file was moved in from a dir that is not watched
 	FILE_REMOVED,
 };
 
+// Backends: ReadDirectoryChangesW on windows, inotify (one watch per subdir) everywhere else
+// Either watches one dir (and its subdirs), or when default constructed only the dirs passed to watch_dir(), for ex. the dirs that are open in a file browser
+// The os events are drained into a pending queue on every poll, which grows as needed, so bursts of changes are never dropped by us
+// We keep the set of all files and dirs we know of, if the os itself drops events (its buffer/queue overflowed) we rescan the whole directory and diff it against that set,
+//  so added and removed files are reported, everything that still exists is reported as FILE_MODIFIED since we can not tell, at worst more is reloaded than needed
+// A removed (or moved away) dir reports everything that was in it as removed, an added (or moved in) dir everything in it as added
+// The first change of a file is reported on the next poll, only if it keeps changing after that the changes are coalesced until it has not changed for debounce_seconds,
+//  so an editor doing several writes (or write temp file + rename) triggers at most one more reload
 class Directory_Watcher {
 	NO_MOVE_COPY_CLASS(Directory_Watcher)	// WARNING: Cannot copy or move
 
-	std::string	directory_path;
-	
-	HANDLE		dir = INVALID_HANDLE_VALUE;
-	OVERLAPPED	ovl = {};					// WARNING: Cannot copy or move, since a pointer to this passed into overlapped ReadDirectoryChangesW
+	typedef std::chrono::steady_clock clock;
 
-	char buf[1024];							// WARNING: Cannot copy or move, since a pointer to this passed into overlapped ReadDirectoryChangesW
+	std::string	directory_path; // empty when default constructed, then the dirs passed to watch_dir() are used as they are
 
-	bool watch_subdirs;
+	bool		watch_subdirs = false;
+	flt			debounce_seconds = 0.05f;
 
-	bool do_ReadDirectoryChanges () {
-		memset(buf, 0, sizeof(buf)); // ReadDirectoryChangesW does not null terminate the filenames?? This seems to fix the problem for now (filenames were overwriting each other aaa.txt overwrote the previous filename bbbbbbbbbbb.txt, which then read aaa.txtbbbb.txt)
+	std::vector<std::string> roots; // dirs relative to directory_path that we were asked to watch (with trailing slash), "" when constructed with a directory_path
 
-		auto res = ReadDirectoryChangesW(dir, buf,sizeof(buf), watch_subdirs ? TRUE : FALSE,
+	struct Pending_Change {
+		file_change_e		change;
+		u64					order; // to report changes in the order they first happened
+		clock::time_point	last_change;
+		u64					poll; // poll_count when this was first pushed
+		bool				held; // changed over more than one poll, wait until it has not changed for debounce_seconds
+		bool				reported; // kept until it has not changed for debounce_seconds, so we notice if it keeps changing
+	};
+	std::unordered_map<std::string, Pending_Change> pending; // key is the filepath relative to directory_path
+	u64			pending_order = 0;
+	u64			poll_count = 0;
+
+	std::set<std::string> known; // all files and dirs relative to directory_path (dirs without trailing slash), sorted so everything in a dir is one range
+
+	void push_change (std::string const& rel_path, file_change_e change, clock::time_point now) {
+		if (change == FILE_REMOVED) {
+			known.erase(rel_path);
+			remove_known_children(rel_path, now);
+		} else if (change == FILE_RENAMED_OLD_NAME) {
+			known.erase(rel_path); // push_rename removes its children
+		} else {
+			known.insert(rel_path);
+		}
+
+		if (rel_path.find_first_of('~') != std::string::npos) { // string contains a tilde '~' character
+			// tilde characters are often used for temporary files, for ex. MSVC writes source code changes by creating a temp file with a tilde in it's name and then swaps the old and new file by renaming them
+			//  so filter those files here since the user of Directory_Watcher _probably_ does not want those files
+			return;
+		}
+
+		auto it = pending.find(rel_path);
+		if (it == pending.end()) {
+			pending.emplace(rel_path, Pending_Change{ change, pending_order++, now, poll_count, false, false });
+			return;
+		}
+
+		auto& p = it->second;
+		if (change == FILE_RENAMED_OLD_NAME || change == FILE_RENAMED_NEW_NAME)
+			p.order = pending_order++; // keep the two names of a rename next to each other
+		if (p.reported) {
+			// changed again shortly after it was reported, coalesce the rest of this burst
+			p.change = change;
+			p.order = pending_order++;
+			p.held = true;
+			p.reported = false;
+		} else {
+			if (change == FILE_MODIFIED && (p.change == FILE_ADDED || p.change == FILE_RENAMED_NEW_NAME)) {
+				// still a new file
+			} else if ((p.change == FILE_REMOVED || p.change == FILE_RENAMED_OLD_NAME) && change != FILE_REMOVED && change != FILE_RENAMED_OLD_NAME) {
+				p.change = FILE_MODIFIED; // file was replaced
+			} else {
+				p.change = change;
+			}
+			if (p.poll != poll_count)
+				p.held = true; // still changing since the last poll
+		}
+		p.last_change = now;
+	}
+
+	// both names first, so they are reported next to each other, then what was in it if it was a dir
+	void push_rename (std::string const& old_path, std::string const& new_path, clock::time_point now) {
+		push_change(old_path, FILE_RENAMED_OLD_NAME, now);
+		push_change(new_path, FILE_RENAMED_NEW_NAME, now);
+		remove_known_children(old_path, now);
+	}
+
+	// a removed dir takes everything in it with it, the os does not report that if the dir was moved away
+	void remove_known_children (std::string const& rel_path, clock::time_point now) {
+		std::string prefix = rel_path +'/';
+
+		auto begin = known.lower_bound(prefix);
+		auto end = begin;
+		while (end != known.end() && end->compare(0, prefix.size(), prefix) == 0)
+			++end;
+		if (begin == end)
+			return;
+
+		std::vector<std::string> children (begin, end);
+		known.erase(begin, end);
+
+		for (auto& c : children)
+			push_change(c, FILE_REMOVED, now);
+	}
+
+	// the files of a dir that was added or moved in
+	void add_tree (std::string const& rel_path, clock::time_point now) {
+		std::vector<std::string> found;
+		watch_tree(rel_path +'/', &found);
+
+		for (auto& f : found)
+			push_change(f, FILE_ADDED, now);
+	}
+
+	// os dropped events, diff the watched dirs against what we know (and on linux watch all dirs again)
+	void rescan (clock::time_point now) {
+		errprint("Directory_Watcher: change events were lost for \"%s\", rescanning directory\n", directory_path.c_str());
+
+	#ifndef _WIN32
+		// dirs could have been moved away while we were not listening, their watches would report the old paths
+		for (auto& w : watches)
+			inotify_rm_watch(fd, w.first);
+		watches.clear();
+	#endif
+
+		std::vector<std::string> found;
+		for (auto& r : roots)
+			watch_tree(r, &found);
+
+		std::set<std::string> old;
+		std::swap(old, known);
+
+		for (auto& f : found)
+			push_change(f, old.find(f) != old.end() ? FILE_MODIFIED : FILE_ADDED, now);
+		for (auto& f : old)
+			if (known.find(f) == known.end())
+				push_change(f, FILE_REMOVED, now);
+	}
+
+	// start watching rel_dir (with its subdirs if watch_subdirs), its files are known from now on
+	void watch_root (std::string const& rel_dir) {
+		roots.push_back(rel_dir);
+	#ifdef _WIN32
+		if (!open_handle(rel_dir))
+			return;
+	#endif
+		std::vector<std::string> found;
+		watch_tree(rel_dir, &found);
+		known.insert(found.begin(), found.end());
+	}
+
+	void remove_roots (std::string const& rel_dir) {
+		roots.erase(std::remove_if(roots.begin(), roots.end(), [&] (std::string const& r) { return r.compare(0, rel_dir.size(), rel_dir) == 0; }), roots.end());
+	}
+
+	// stop watching rel_dir and everything below it, without reporting its files
+	void unwatch (std::string const& rel_dir) {
+		auto below = [&] (std::string const& path) { return path.compare(0, rel_dir.size(), rel_dir) == 0; };
+
+	#ifdef _WIN32
+		remove_handles(rel_dir);
+	#else
+		remove_watches(rel_dir);
+	#endif
+
+		for (auto it=known.lower_bound(rel_dir); it!=known.end() && below(*it);)
+			it = known.erase(it);
+		for (auto it=pending.begin(); it!=pending.end();) {
+			if (below(it->first))	it = pending.erase(it);
+			else					++it;
+		}
+	}
+
+	// list all files and dirs in directory_path + rel_dir (dirs without trailing slash, recursively if watch_subdirs), and on linux add watches for it and all its subdirs
+	void watch_tree (std::string const& rel_dir, std::vector<std::string>* found) {
+	#ifdef _WIN32
+		if (watch_subdirs) {
+			auto tree = n_find_files::scan_files(directory_path + rel_dir);
+
+			for (u32 i=1; i<(u32)tree.nodes.size(); ++i) {
+				std::string path = tree.get_path(i).substr(directory_path.size()); // relative to directory_path
+				if (tree.nodes[i].is_dir)
+					path.pop_back(); // events for dirs have no trailing slash
+				found->push_back(std::move(path));
+			}
+			return;
+		}
+	#else
+		// add the watch before listing the dir, so files created while we list it are not missed (at worst reported twice, which coalesces)
+		add_watch(rel_dir);
+	#endif
+
+		n_find_files::Directory dir;
+		n_find_files::find_files(directory_path + rel_dir, &dir);
+
+		for (auto& d : dir.dirnames) {
+			found->push_back(rel_dir + d.substr(0, d.size() -1));
+		#ifndef _WIN32
+			if (watch_subdirs)
+				watch_tree(rel_dir + d, found);
+		#endif
+		}
+		for (auto& f : dir.filenames)
+			found->push_back(rel_dir + f);
+	}
+
+#ifdef _WIN32
+	// one overlapped ReadDirectoryChangesW per root
+	struct Dir_Handle {
+		NO_MOVE_COPY_CLASS(Dir_Handle)	// WARNING: Cannot copy or move, since pointers to ovl and buf are passed into overlapped ReadDirectoryChangesW
+	public:
+
+		std::string	rel_dir;
+		HANDLE		dir = INVALID_HANDLE_VALUE;
+		OVERLAPPED	ovl = {};
+
+		// WARNING: Cannot be resized while a read is pending
+		std::vector<char> buf = std::vector<char>(64 * 1024); // 64KB is the max for network drives, only grown past that once it overflowed
+
+		bool		read_pending = false;
+
+		~Dir_Handle () {
+			if (dir != INVALID_HANDLE_VALUE) {
+				if (read_pending) {
+					CancelIo(dir);
+					DWORD bytes_returned;
+					GetOverlappedResult(dir, &ovl, &bytes_returned, TRUE); // buf has to stay alive until the read was actually cancelled
+				}
+				CloseHandle(dir);
+			}
+			if (ovl.hEvent != NULL)
+				CloseHandle(ovl.hEvent);
+		}
+	};
+	std::vector<std::unique_ptr<Dir_Handle>> handles;
+
+	std::vector<std::string> unwatch_later; // dirs that were removed or moved away, their handles are closed after reading all handles
+
+	// handles of rel_dir and all dirs below it
+	void remove_handles (std::string const& rel_dir) {
+		remove_roots(rel_dir);
+		handles.erase(std::remove_if(handles.begin(), handles.end(), [&] (std::unique_ptr<Dir_Handle> const& h) {
+			return h->rel_dir.compare(0, rel_dir.size(), rel_dir) == 0;
+		}), handles.end());
+	}
+
+	static constexpr uptr MAX_BUF_SIZE = 1024 * 1024;
+
+	bool open_handle (std::string const& rel_dir) {
+		auto h = std::make_unique<Dir_Handle>();
+		h->rel_dir = rel_dir;
+
+		std::string path = directory_path + rel_dir;
+		h->dir = CreateFileW(utf8_to_wchar(path).c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OVERLAPPED, NULL);
+		auto dir_err = GetLastError();
+
+		h->ovl.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+		if (h->dir == INVALID_HANDLE_VALUE || h->ovl.hEvent == NULL) {
+			errprint("Directory_Watcher init failed with directory_path=\"%s\" (%s), won't monitor file changes!\n", path.c_str(), dir_err == ERROR_FILE_NOT_FOUND ? "ERROR_FILE_NOT_FOUND" : "unknown error");
+			return false;
+		}
+
+		h->read_pending = do_ReadDirectoryChanges(*h); // before listing the files, so nothing is missed
+		handles.push_back(std::move(h));
+		return true;
+	}
+
+	bool do_ReadDirectoryChanges (Dir_Handle& h) {
+		auto res = ReadDirectoryChangesW(h.dir, h.buf.data(), (DWORD)h.buf.size(), watch_subdirs ? TRUE : FALSE,
 											FILE_NOTIFY_CHANGE_FILE_NAME|
 											FILE_NOTIFY_CHANGE_DIR_NAME|
 											FILE_NOTIFY_CHANGE_SIZE|
 											FILE_NOTIFY_CHANGE_LAST_WRITE|
 											FILE_NOTIFY_CHANGE_CREATION,
-											NULL, &ovl, NULL);
+											NULL, &h.ovl, NULL);
 		if (!res) {
 			auto err = GetLastError();
 			if (err != ERROR_IO_PENDING)
@@ -46,129 +314,329 @@ class Directory_Watcher {
 		return true;
 	}
 
-public:
-	
-	bool is_initialized () { return directory_path.size() != 0; }
-	bool directory_is_valid () { return dir != INVALID_HANDLE_VALUE && ovl.hEvent != NULL; }
-	
-	Directory_Watcher (std::string const& directory_path, bool watch_subdirs=true) { // must end in slash, since is is prepended in front of the filenames, so that changed_files contains "directory_path/subdir/filename"
-		this->directory_path = directory_path;
+	void read_changes (clock::time_point now) {
+		for (auto& h : handles)
+			read_changes(*h, now);
 
-		dir = CreateFileW(utf8_to_wchar(directory_path).c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OVERLAPPED, NULL);
-		auto dir_err = GetLastError();
+		for (auto& d : unwatch_later)
+			remove_handles(d);
+		unwatch_later.clear();
+	}
+	void read_changes (Dir_Handle& h, clock::time_point now) {
+		while (h.read_pending) {
+			DWORD bytes_returned;
+			auto res = GetOverlappedResult(h.dir, &h.ovl, &bytes_returned, FALSE);
+			if (!res) {
+				auto err = GetLastError();
+				if (err != ERROR_IO_INCOMPLETE) {
+					// Error ?
+				}
+				return;
+			}
+			h.read_pending = false;
+
+			if (bytes_returned == 0) {
+				// buffer overflowed, the changes are lost
+				if (h.buf.size() < MAX_BUF_SIZE)
+					h.buf.resize(h.buf.size() * 2);
+				rescan(now);
+			} else {
+				parse_changes(h, (uptr)bytes_returned, now);
+			}
 
-		ovl.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+			ResetEvent(h.ovl.hEvent);
 
-		if (dir == INVALID_HANDLE_VALUE || ovl.hEvent == NULL) {
-			errprint("Directory_Watcher init failed with directory_path=\"%s\" (%s), won't monitor file changes!\n", directory_path.c_str(), dir_err == ERROR_FILE_NOT_FOUND ? "ERROR_FILE_NOT_FOUND" : "unknown error");
+			h.read_pending = do_ReadDirectoryChanges(h);
+			if (!h.read_pending)
+				errprint("Directory_Watcher: ReadDirectoryChangesW failed for \"%s%s\", won't monitor file changes anymore!\n", directory_path.c_str(), h.rel_dir.c_str());
 		}
-
-		do_ReadDirectoryChanges();
 	}
 
-	~Directory_Watcher () {
-		if (dir != INVALID_HANDLE_VALUE)
-			CloseHandle(dir);
-		if (ovl.hEvent != NULL)
-			CloseHandle(ovl.hEvent);
-	}
+	void parse_changes (Dir_Handle& h, uptr bytes_returned, clock::time_point now) {
+		char const* cur = h.buf.data();
 
-	struct File_Change {
-		std::string		filepath;
-		file_change_e	change;
-	};
-	bool poll_file_changes (std::vector<File_Change>* changed_files=nullptr) {
-		if (!directory_is_valid())
-			return false;
+		std::string renamed_from; // FILE_ACTION_RENAMED_OLD_NAME waits for the FILE_ACTION_RENAMED_NEW_NAME that follows it
 
-		DWORD bytes_returned;
-		auto res = GetOverlappedResult(dir, &ovl, &bytes_returned, FALSE);
-		if (!res) {
-			auto err = GetLastError();
-			if (err != ERROR_IO_INCOMPLETE) {
-				// Error ?
+		for (;;) {
+			auto remaining_bytes = bytes_returned -(uptr)(cur -h.buf.data());
+			if (remaining_bytes == 0)
+				break; // all changes processed
+
+			assert(remaining_bytes >= sizeof(FILE_NOTIFY_INFORMATION));
+			FILE_NOTIFY_INFORMATION* info = (FILE_NOTIFY_INFORMATION*)cur;
+
+			assert(remaining_bytes >= offsetof(FILE_NOTIFY_INFORMATION, FileName) +info->FileNameLength);
+
+			// FileName is not null terminated
+			std::string filepath = wchar_to_utf8(std::basic_string<wchar_t>(info->FileName, info->FileNameLength / sizeof(WCHAR)));
+			std::replace(filepath.begin(), filepath.end(), '\\', '/'); // same paths as on linux and as find_files gives us
+			filepath = h.rel_dir + filepath;
+
+			if (renamed_from.size() > 0 && info->Action != FILE_ACTION_RENAMED_NEW_NAME) {
+				push_change(renamed_from, FILE_REMOVED, now); // should not happen, but do not lose it
+				renamed_from.clear();
 			}
-			return false;
-		} else {
-			
-			std::vector<File_Change> tmp_changed_files;
-			if (!changed_files)
-				changed_files = &tmp_changed_files;
 
-			char const* cur = buf;
+			switch (info->Action) {
+				case FILE_ACTION_ADDED:				push_change(filepath, FILE_ADDED, now);				break; // file was added, report it
+				case FILE_ACTION_MODIFIED:			push_change(filepath, FILE_MODIFIED, now);			break; // file was modified, report it
+				case FILE_ACTION_REMOVED:			push_change(filepath, FILE_REMOVED, now);			break; // file was deleted, report it
+				case FILE_ACTION_RENAMED_OLD_NAME:	renamed_from = filepath;							break; // file was renamed and this is the old name, reported together with the new name
 
-			for (;;) {
-				auto remaining_bytes = (uptr)bytes_returned -(uptr)(cur -buf);
-				if (remaining_bytes == 0)
-					break; // all changes processed
+				case FILE_ACTION_RENAMED_NEW_NAME: { // file was renamed and this is the new name, report it
+					if (renamed_from.size() > 0)	push_rename(renamed_from, filepath, now);
+					else							push_change(filepath, FILE_RENAMED_NEW_NAME, now);
+					renamed_from.clear();
+				} break;
 
-				assert(remaining_bytes >= sizeof(FILE_NOTIFY_INFORMATION));
-				FILE_NOTIFY_INFORMATION* info = (FILE_NOTIFY_INFORMATION*)cur;
+				default:
+					break;
+			}
 
-				assert(remaining_bytes >= offsetof(FILE_NOTIFY_INFORMATION, FileName) +info->FileNameLength); // bytes_returned does not include a null terminator after info->FileName ??
+			if (info->Action == FILE_ACTION_REMOVED || info->Action == FILE_ACTION_RENAMED_OLD_NAME)
+				unwatch_later.push_back(filepath +'/'); // if it was a watched dir (or one below it was) the handle now points to the new name or a deleted dir
 
-				std::string filepath = wchar_to_utf8(info->FileName);
+			bool is_dir;
+			if ((info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_RENAMED_NEW_NAME) && watch_subdirs &&
+					n_find_files::file_exists(directory_path + filepath, &is_dir) && is_dir) {
+				add_tree(filepath, now); // a dir moved in only reports itself
+			}
 
-				#if 0
-				cstr action_str = nullptr;
-				switch (info->Action) {
-					case FILE_ACTION_ADDED:				action_str = "FILE_ACTION_ADDED             ";	break;
-					case FILE_ACTION_MODIFIED:			action_str = "FILE_ACTION_MODIFIED          ";	break;
-					case FILE_ACTION_RENAMED_NEW_NAME:	action_str = "FILE_ACTION_RENAMED_NEW_NAME  ";	break;
-					case FILE_ACTION_REMOVED:			action_str = "FILE_ACTION_REMOVED           ";	break;
-					case FILE_ACTION_RENAMED_OLD_NAME:	action_str = "FILE_ACTION_RENAMED_OLD_NAME  ";	break;
+			if (info->NextEntryOffset == 0)
+				break; // all changes processed
 
-					default:							action_str = "unknown"; break;
-				}
+			cur += info->NextEntryOffset;
+		}
 
-				printf("%s to \"%s\" detected.\n", action_str, filepath.c_str());
-				#endif
+		if (renamed_from.size() > 0)
+			push_change(renamed_from, FILE_REMOVED, now);
+	}
+#else
+	int			fd = -1;
+	std::unordered_map<int, std::string> watches; // watch descriptor -> dir path relative to directory_path, with trailing slash
+
+	static constexpr u32 WATCH_MASK = IN_CREATE|IN_MODIFY|IN_CLOSE_WRITE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|IN_ONLYDIR|IN_EXCL_UNLINK;
+
+	bool init_inotify () {
+		fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+		if (fd < 0)
+			errprint("Directory_Watcher init failed with directory_path=\"%s\" (inotify_init1 failed [%d]), won't monitor file changes!\n", directory_path.c_str(), errno);
+		return fd >= 0;
+	}
+
+	void add_watch (std::string const& rel_dir) {
+		int wd = inotify_add_watch(fd, (directory_path + rel_dir).c_str(), WATCH_MASK);
+		if (wd < 0) {
+			if (errno == ENOSPC) {
+				errprint("Directory_Watcher: out of inotify watches (see /proc/sys/fs/inotify/max_user_watches), won't monitor \"%s%s\"!\n", directory_path.c_str(), rel_dir.c_str());
+			} else if (errno != ENOENT) { // dir was already deleted again
+				errprint("Directory_Watcher: inotify_add_watch failed for \"%s%s\" [%d]!\n", directory_path.c_str(), rel_dir.c_str(), errno);
+			}
+			return;
+		}
+		watches[wd] = rel_dir;
+	}
+
+	// watches of rel_dir and all dirs below it
+	void remove_watches (std::string const& rel_dir) {
+		remove_roots(rel_dir);
+		for (auto it=watches.begin(); it!=watches.end();) {
+			if (it->second.compare(0, rel_dir.size(), rel_dir) == 0) {
+				inotify_rm_watch(fd, it->first);
+				it = watches.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	void read_changes (clock::time_point now) {
+		alignas(inotify_event) char buf[64 * 1024];
+
+		bool overflowed = false;
+
+		// IN_MOVED_FROM waits for the IN_MOVED_TO with the same cookie (which directly follows it) to report both as a rename, without one it was moved out of the watched dirs
+		std::string moved_from;
+		u32 moved_from_cookie = 0;
+		auto moved_away = [&] () {
+			if (moved_from.size() > 0)
+				push_change(moved_from, FILE_REMOVED, now);
+			moved_from.clear();
+		};
+
+		for (;;) {
+			auto size = read(fd, buf, sizeof(buf));
+			if (size <= 0) {
+				if (size < 0 && errno != EAGAIN && errno != EINTR)
+					errprint("Directory_Watcher: read on inotify fd failed for \"%s\" [%d]!\n", directory_path.c_str(), errno);
+				break; // EAGAIN: no more events
+			}
 
-				file_change_e mode;
+			for (char* cur = buf; cur < buf +size;) {
+				auto* ev = (inotify_event*)cur;
+				cur += sizeof(inotify_event) +ev->len;
 
-				switch (info->Action) {
-					case FILE_ACTION_ADDED:				mode = FILE_ADDED;				break;
-					case FILE_ACTION_MODIFIED:			mode = FILE_MODIFIED;			break;
-					case FILE_ACTION_RENAMED_NEW_NAME:	mode = FILE_RENAMED_NEW_NAME;	break;
-					case FILE_ACTION_REMOVED:			mode = FILE_REMOVED;			break;
+				if (ev->mask & IN_Q_OVERFLOW) {
+					overflowed = true;
+					continue;
 				}
 
-				switch (info->Action) {
-					case FILE_ACTION_ADDED:				// file was added, report it
-					case FILE_ACTION_MODIFIED:			// file was modified, report it
-					case FILE_ACTION_RENAMED_NEW_NAME:	// file was renamed and this is the new name (its like a file with the new name was added), report it
-					case FILE_ACTION_REMOVED:			// file was deleted, report it
-					{
-						// all assets with dependencies on this file should be reloaded
-						
-						if (filepath.find_first_of('~') != std::string::npos) { // string contains a tilde '~' character
-							// tilde characters are often used for temporary files, for ex. MSVC writes source code changes by creating a temp file with a tilde in it's name and then swaps the old and new file by renaming them
-							//  so filter those files here since the user of Directory_Watcher _probably_ does not want those files
-						} else {
-							filepath.insert(0, directory_path);
-							
-							changed_files->push_back( File_Change{ std::move(filepath), mode } );
-						}
-					} break;
-
-					case FILE_ACTION_RENAMED_OLD_NAME:	// file was renamed and this is the old name (its like the file with the old name was deleted), don't report it
-					default:
-						// do not try to reload assets with dependencies on files that are deleted or renamed (old name no longer exists), instead just keep the asset loaded
-						break;
+				auto it = watches.find(ev->wd);
+				if (it == watches.end())
+					continue;
+				if (ev->mask & IN_IGNORED) { // dir was deleted
+					roots.erase(std::remove(roots.begin(), roots.end(), it->second), roots.end());
+					watches.erase(it);
+					continue;
 				}
+				if (ev->len == 0)
+					continue; // event about the watched dir itself, its parent reports those
 
-				if (info->NextEntryOffset == 0)
-					break; // all changes processed
+				std::string filepath = it->second + ev->name;
+				bool is_dir = (ev->mask & IN_ISDIR) != 0;
 
-				cur += info->NextEntryOffset;
+				bool renamed = (ev->mask & IN_MOVED_TO) && moved_from.size() > 0 && ev->cookie == moved_from_cookie;
+				if (renamed) {
+					push_rename(moved_from, filepath, now);
+					moved_from.clear();
+				}
+				moved_away();
+
+				if (ev->mask & IN_CREATE)				push_change(filepath, FILE_ADDED, now);
+				if ((ev->mask & IN_MOVED_TO) && !renamed)	push_change(filepath, FILE_RENAMED_NEW_NAME, now);
+				if (ev->mask & (IN_MODIFY|IN_CLOSE_WRITE))	push_change(filepath, FILE_MODIFIED, now);
+				if (ev->mask & IN_DELETE)				push_change(filepath, FILE_REMOVED, now);
+				if (ev->mask & IN_MOVED_FROM) {
+					moved_from = filepath;
+					moved_from_cookie = ev->cookie;
+				}
+
+				if (is_dir && (ev->mask & IN_MOVED_FROM)) {
+					// the dir keeps its watches wherever it went, drop them, if it was moved somewhere below directory_path the IN_MOVED_TO watches it again
+					remove_watches(filepath +'/');
+				}
+				if (is_dir && (ev->mask & (IN_CREATE|IN_MOVED_TO)) && watch_subdirs) {
+					// watch the new dir, files could have been created in it before the watch existed, so report everything in it
+					add_tree(filepath, now);
+				}
 			}
+		}
+
+		moved_away();
+
+		if (overflowed)
+			rescan(now);
+	}
+#endif
+
+public:
+
+	bool is_initialized () { return directory_path.size() != 0; }
+#ifdef _WIN32
+	bool directory_is_valid () { return handles.size() != 0; }
+#else
+	bool directory_is_valid () { return fd >= 0 && watches.size() != 0; }
+#endif
+
+	// must end in slash, since is is prepended in front of the filenames, so that changed_files contains "directory_path/subdir/filename"
+	Directory_Watcher (std::string const& directory_path, bool watch_subdirs=true, flt debounce_seconds=0.05f) {
+		this->directory_path = directory_path;
+		if (!(this->directory_path.size() == 0 || this->directory_path.back() == '/'))
+			this->directory_path.append("/");
+		this->watch_subdirs = watch_subdirs;
+		this->debounce_seconds = debounce_seconds;
+
+	#ifndef _WIN32
+		if (!init_inotify())
+			return;
+	#endif
+
+		watch_root("");
+
+	#ifndef _WIN32
+		if (watches.size() == 0)
+			errprint("Directory_Watcher init failed with directory_path=\"%s\", won't monitor file changes!\n", directory_path.c_str());
+	#endif
+	}
 
-			ResetEvent(ovl.hEvent);
+	~Directory_Watcher () {
+	#ifdef _WIN32
+		handles.clear(); // cancels the pending reads
+	#else
+		if (fd >= 0)
+			close(fd);
+	#endif
+	}
 
-			do_ReadDirectoryChanges();
+	// for a default constructed Directory_Watcher, watches dir (not its subdirs), changes of its files are reported from the next poll on
+	//  changed_files contains  dir + filename  (dir with trailing slash), does nothing if dir is already watched
+	void watch_dir (std::string dir) {
+		assert(directory_path.size() == 0 && !watch_subdirs);
+		if (dir.size() == 0 || dir.back() != '/')
+			dir.push_back('/');
+		if (contains(roots, dir))
+			return;
+
+	#ifndef _WIN32
+		if (fd < 0 && !init_inotify())
+			return;
+	#endif
+		watch_root(dir);
+	}
+	// stops watching dir and all watched dirs below it, changes that were not reported yet are dropped
+	void unwatch_dir (std::string dir) {
+		if (dir.size() == 0 || dir.back() != '/')
+			dir.push_back('/');
+		unwatch(dir);
+	}
+	void unwatch_all () {
+		unwatch("");
+	}
 
-			return changed_files->size() != 0;
+	struct File_Change {
+		std::string		filepath;
+		file_change_e	change;
+	};
+	// appends to changed_files, files that keep changing over several polls are held back until they have not changed for debounce_seconds
+	bool poll_file_changes (std::vector<File_Change>* changed_files=nullptr) {
+		if (!directory_is_valid())
+			return false;
+
+		auto now = clock::now();
+
+		poll_count++;
+		read_changes(now);
+
+		if (pending.size() == 0)
+			return false;
+
+		std::vector<File_Change> tmp_changed_files;
+		if (!changed_files)
+			changed_files = &tmp_changed_files;
+
+		auto debounce = std::chrono::duration_cast<clock::duration>(std::chrono::duration<flt>(debounce_seconds));
+
+		std::vector<std::pair<u64, File_Change>> ready;
+		for (auto it=pending.begin(); it!=pending.end();) {
+			auto& p = it->second;
+			bool quiet = now -p.last_change >= debounce;
+
+			if (!p.reported && (!p.held || quiet)) {
+				ready.push_back({ p.order, File_Change{ directory_path + it->first, p.change } });
+				p.reported = true;
+			}
+
+			if (p.reported && quiet)	it = pending.erase(it);
+			else						++it;
 		}
+
+		std::sort(ready.begin(), ready.end(), [] (std::pair<u64, File_Change> const& l, std::pair<u64, File_Change> const& r) {
+			return l.first < r.first;
+		});
+		for (auto& r : ready)
+			changed_files->push_back(std::move(r.second));
+
+		return ready.size() != 0;
 	}
 
 	bool poll_file_changes_ignore_removed (std::vector<std::string>* changed_files=nullptr) { // appends to changed_files
@@ -176,7 +644,7 @@ public:
 		bool res = poll_file_changes(&changes);
 
 		for (auto& c : changes)
-			if (c.change != FILE_REMOVED && !contains(*changed_files, c.filepath)) // do not report a file as changed twice
+			if (c.change != FILE_REMOVED && c.change != FILE_RENAMED_OLD_NAME && !contains(*changed_files, c.filepath)) // do not report a file as changed twice
 				changed_files->push_back(c.filepath);
 
 		return res;
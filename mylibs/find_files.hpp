@@ -2,12 +2,26 @@
 
 #include "basic_typedefs.hpp"
 #include "string.hpp"
+#include "defer.hpp"
+#include "parallel.hpp"
 
 #include <string>
 #include <vector>
+#include <deque>
+#include <algorithm>
+#include "assert.h"
 
-#define WIN32_LEAN_AND_MEAN 1
-#include "windows.h"
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN 1
+	#include "windows.h"
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <errno.h>
+	#include <sys/stat.h>
+	#include <sys/syscall.h>
+	#include <dirent.h> // for DT_DIR etc.
+#endif
 
 namespace n_find_files {
 	using namespace basic_typedefs;
@@ -28,23 +42,46 @@ namespace n_find_files {
 
 	};
 
-	bool find_files (std::string const& dir_path, std::vector<std::string>* dirnames, std::vector<std::string>* filenames, std::string const& file_filter="*") { // strings can be utf8
-		dirnames->clear();
-		filenames->clear();
+	// '*' matches any number of chars, '?' matches one char, like the FindFirstFile patterns we use
+	bool match_filter (cstr name, cstr filter) {
+		cstr star = nullptr; // last '*' we saw, and where in name we were when we saw it, to backtrack to
+		cstr star_name = nullptr;
 
-		WIN32_FIND_DATAW data;
+		while (*name) {
+			if (*filter == '*') {
+				star = filter++;
+				star_name = name;
+			} else if (*filter == '?' || *filter == *name) {
+				filter++;
+				name++;
+			} else if (star) {
+				filter = star +1;
+				name = ++star_name;
+			} else {
+				return false;
+			}
+		}
+		while (*filter == '*')
+			filter++;
+		return *filter == '\0';
+	}
 
+	//// Platform backends
+	// calls  func(cstr name, bool is_dir)  for every entry in dir_path (which needs a trailing '/'), without "." and ".."
+	// returns false if the directory could not be read
+
+#ifdef _WIN32
+	template <typename FUNC>
+	bool _read_dir (std::string const& dir_path, FUNC func) {
 		assert(dir_path.size() > 0 && dir_path.back() == '/');
-		assert(file_filter.find_first_of('*') != file_filter.npos);
 
-		std::string search_str = dir_path + file_filter;
+		std::string search_str = dir_path + "*";
 
-		HANDLE hFindFile = FindFirstFileW(utf8_to_wchar(search_str).c_str(), &data);
-		auto err = GetLastError();
+		WIN32_FIND_DATAW data;
 
-		defer {
-			FindClose(hFindFile);
-		};
+		// FindExInfoBasic skips the 8.3 short names, LARGE_FETCH makes it read more entries per syscall
+		HANDLE hFindFile = FindFirstFileExW(utf8_to_wchar(search_str).c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+		auto err = GetLastError();
 
 		if (hFindFile == INVALID_HANDLE_VALUE) {
 			if (err == ERROR_FILE_NOT_FOUND) {
@@ -58,19 +95,21 @@ namespace n_find_files {
 			return false; // fail
 		}
 
+		defer {
+			FindClose(hFindFile);
+		};
+
 		for (;;) {
 			
 			auto filename = wchar_to_utf8(std::basic_string<wchar_t>(data.cFileName));
 
-			if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-				if (	strcmp(filename.c_str(), ".") == 0 ||
-						strcmp(filename.c_str(), "..") == 0 ) {
-					// found directory represents the current directory or the parent directory, don't include this in the output
-				} else {
-					dirnames->emplace_back(std::move( filename +'/' ));
-				}
+			if (	strcmp(filename.c_str(), ".") == 0 ||
+					strcmp(filename.c_str(), "..") == 0 ) {
+				// found directory represents the current directory or the parent directory, don't include this in the output
 			} else {
-				filenames->emplace_back(filename);
+				// junctions and directory symlinks are reparse points, count them as files like symlinks on linux, so a junction to a parent can not make us loop forever
+				bool is_dir = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && !(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT);
+				func(filename.c_str(), is_dir);
 			}
 
 			auto ret = FindNextFileW(hFindFile, &data);
@@ -82,17 +121,97 @@ namespace n_find_files {
 					// TODO: in which cases would this happen?
 					assert(false);
 					fprintf(stderr, "find_files: FindNextFile failed! [%x]", err);
+					return false; // fail
+				}
+			}
+		}
+
+		return true; // success
+	}
+#else
+	struct _Linux_Dirent64 { // what getdents64 writes, glibc has no wrapper for it before 2.30
+		u64				d_ino;
+		s64				d_off;
+		unsigned short	d_reclen;
+		unsigned char	d_type;
+		char			d_name[1];
+	};
 
-					dirnames->clear();
-					filenames->clear();
+	template <typename FUNC>
+	bool _read_dir (std::string const& dir_path, FUNC func) {
+		assert(dir_path.size() > 0 && dir_path.back() == '/');
 
-					return false; // fail
+		int fd = openat(AT_FDCWD, dir_path.c_str(), O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+		if (fd < 0) {
+			fprintf(stderr, "find_files: Could not open \"%s\"! [%d]\n", dir_path.c_str(), errno);
+			return false; // fail
+		}
+		defer {
+			close(fd);
+		};
+
+		alignas(8) char buf[32 * 1024]; // readdir would use a similar buffer, but go through DIR* and its locking
+
+		for (;;) {
+			long size = syscall(SYS_getdents64, fd, buf, sizeof(buf));
+			if (size == 0)
+				break;
+			if (size < 0) {
+				fprintf(stderr, "find_files: getdents64 failed on \"%s\"! [%d]\n", dir_path.c_str(), errno);
+				return false; // fail
+			}
+
+			for (long offs=0; offs<size;) {
+				auto* d = (_Linux_Dirent64*)(buf +offs);
+				offs += d->d_reclen;
+
+				cstr name = d->d_name;
+				if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+					continue; // current directory or the parent directory
+
+				bool is_dir;
+				if (d->d_type == DT_UNKNOWN) { // some filesystems do not fill in d_type
+					struct stat st;
+					is_dir = fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+				} else {
+					is_dir = d->d_type == DT_DIR; // symlinks to dirs count as files, so we never loop
 				}
+
+				func(name, is_dir);
 			}
 		}
 
 		return true; // success
 	}
+#endif
+
+	bool find_files (std::string const& dir_path, std::vector<std::string>* dirnames, std::vector<std::string>* filenames, std::string const& file_filter="*") { // strings can be utf8
+		dirnames->clear();
+		filenames->clear();
+
+		assert(dir_path.size() > 0 && dir_path.back() == '/');
+		assert(file_filter.find_first_of('*') != file_filter.npos);
+
+		bool ok = _read_dir(dir_path, [&] (cstr name, bool is_dir) {
+			if (!match_filter(name, file_filter.c_str()))
+				return;
+
+			if (is_dir)	dirnames->emplace_back(std::string(name) +'/');
+			else		filenames->emplace_back(name);
+		});
+
+		if (!ok) {
+			dirnames->clear();
+			filenames->clear();
+			return false; // fail
+		}
+
+		// getdents returns entries in hash order, FindFirstFile on ntfs is sorted, sort so we get the same everywhere
+		std::sort(dirnames->begin(), dirnames->end());
+		std::sort(filenames->begin(), filenames->end());
+
+		return true; // success
+	}
 
 	// 
 	bool find_files (std::string dir_path, Directory* dir, std::string const& file_filter="*") {
@@ -102,27 +221,233 @@ namespace n_find_files {
 		return find_files(dir_path, &dir->dirnames, &dir->filenames, file_filter);
 	}
 
-	bool find_files_recursive (std::string dir_path, std::string dir_name, Directory_Tree* dir, std::string const& file_filter="*") {
+	// returns false if nothing exists at path, symlinks count as files like in find_files
+	bool file_exists (std::string const& path, bool* is_dir=nullptr) {
+	#ifdef _WIN32
+		DWORD attrib = GetFileAttributesW(utf8_to_wchar(path).c_str());
+		if (attrib == INVALID_FILE_ATTRIBUTES)
+			return false;
+		if (is_dir) *is_dir = (attrib & FILE_ATTRIBUTE_DIRECTORY) && !(attrib & FILE_ATTRIBUTE_REPARSE_POINT);
+	#else
+		struct stat st;
+		if (fstatat(AT_FDCWD, path.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0)
+			return false;
+		if (is_dir) *is_dir = S_ISDIR(st.st_mode);
+	#endif
+		return true;
+	}
+
+	//// Parallel recursive scan into a flat table
+
+	static constexpr u32 NULL_NODE = (u32)-1;
+
+	// All files and dirs of a tree in one array, names in one char arena
+	// children of a dir are contiguous, first its dirs then its files, each sorted by name
+	// so iterating a dir is just  for (u32 i=n.first_child; i<n.first_child +n.dir_count +n.file_count; ++i)
+	struct File_Tree {
+		struct Node {
+			u32		name; // offset into names, null terminated, dirs have no trailing '/'
+			u32		parent; // NULL_NODE for the root
+			u32		first_child;
+			u32		dir_count;
+			u32		file_count;
+			bool	is_dir;
+			bool	valid; // dirs only, could be not found, but also stuff like access denied
+		};
+
+		std::string			root_path; // the path that was scanned, with trailing '/'
+		std::vector<Node>	nodes; // nodes[0] is the root dir
+		std::vector<char>	names;
+
+		cstr get_name (u32 node) const {
+			return &names[nodes[node].name];
+		}
+
+		// root_path + path relative to root, dirs get a trailing '/'
+		std::string get_path (u32 node) const {
+			std::vector<u32> chain;
+			for (u32 n=node; n != 0 && n != NULL_NODE; n = nodes[n].parent)
+				chain.push_back(n);
+
+			std::string path = root_path;
+			for (auto it=chain.rbegin(); it!=chain.rend(); ++it) {
+				path.append(get_name(*it));
+				if (nodes[*it].is_dir)
+					path.push_back('/');
+			}
+			return path;
+		}
+	};
+
+	struct _Scanned_Dir {
+		struct Entry {
+			u32		name; // offset into names
+			bool	is_dir;
+			u32		scan; // dirs: index of its _Scanned_Dir
+		};
+
+		std::string			path; // with trailing '/'
+		bool				valid = false;
+		std::vector<char>	names;
+		std::vector<Entry>	entries;
+
+		void scan () {
+			valid = _read_dir(path, [&] (cstr name, bool is_dir) {
+				uptr len = strlen(name);
+				entries.push_back({ (u32)names.size(), is_dir, NULL_NODE });
+				names.insert(names.end(), name, name +len +1);
+			});
+
+			std::sort(entries.begin(), entries.end(), [&] (Entry const& l, Entry const& r) {
+				if (l.is_dir != r.is_dir) return l.is_dir; // dirs first
+				return strcmp(&names[l.name], &names[r.name]) < 0;
+			});
+		}
+	};
+
+	// Scan dir_path recursively, every dir is read by whatever worker thread is free, so deep and wide trees both get spread over all threads
+	File_Tree scan_files (std::string dir_path, int threads=parallel::thread_count()) {
 		if (!(dir_path.size() == 0 || dir_path.back() == '/'))
 			dir_path.append("/");
-		if (dir_name.back() != '/')
-			dir_name.append("/");
-		
-		dir->name = dir_name;
 
-		std::vector<std::string>	dirnames;
+		std::deque<_Scanned_Dir>	scans; // deque, so references stay valid while other threads append to it
+		std::vector<u32>			jobs; // indices into scans, used as a stack, which keeps it small
+		int							busy = 0;
+		std::mutex					mutex;
+		std::condition_variable		cv;
+
+		scans.emplace_back();
+		scans[0].path = dir_path;
+		jobs.push_back(0);
+
+		auto worker = [&] () {
+			std::vector<_Scanned_Dir> new_dirs;
 
-		std::string dir_full = dir_path+dir_name;
+			std::unique_lock<std::mutex> lock(mutex);
+			for (;;) {
+				cv.wait(lock, [&] () { return !jobs.empty() || busy == 0; });
+				if (jobs.empty())
+					return; // nobody is working and nothing is left, so nothing new can come in
 
-		dir->valid = find_files(dir_full, &dirnames, &dir->filenames, file_filter);
+				_Scanned_Dir* dir = &scans[jobs.back()];
+				jobs.pop_back();
+				busy++;
 
+				lock.unlock();
+
+				dir->scan();
+
+				new_dirs.clear();
+				for (auto& e : dir->entries) {
+					if (e.is_dir) {
+						new_dirs.emplace_back();
+						new_dirs.back().path = dir->path + &dir->names[e.name] +'/';
+					}
+				}
+
+				lock.lock();
+
+				uptr i = 0;
+				for (auto& e : dir->entries) {
+					if (e.is_dir) {
+						e.scan = (u32)scans.size();
+						scans.emplace_back(std::move(new_dirs[i++]));
+						jobs.push_back(e.scan);
+					}
+				}
+
+				busy--;
+				cv.notify_all();
+			}
+		};
+
+		{
+			std::vector<std::thread> workers;
+			for (int i=1; i<threads; ++i)
+				workers.emplace_back(worker);
+			worker();
+			for (auto& w : workers)
+				w.join();
+		}
+
+		// flatten breadth first, that way the children of every dir end up contiguous
+		File_Tree tree;
+		tree.root_path = dir_path;
+
+		uptr total_entries = 0, total_names = 1;
+		for (auto& s : scans) {
+			total_entries += s.entries.size();
+			total_names += s.names.size();
+		}
+		tree.nodes.reserve(total_entries +1);
+		tree.names.reserve(total_names);
+
+		std::vector<u32> node_scan; // _Scanned_Dir of each dir node
+		node_scan.reserve(total_entries +1);
+
+		tree.names.push_back('\0'); // root has an empty name
+		tree.nodes.push_back({ 0, NULL_NODE, NULL_NODE, 0, 0, true, false });
+		node_scan.push_back(0);
+
+		for (u32 i=0; i<(u32)tree.nodes.size(); ++i) {
+			if (!tree.nodes[i].is_dir)
+				continue;
+
+			auto& s = scans[node_scan[i]];
+
+			u32 first = (u32)tree.nodes.size();
+			u32 dirs = 0;
+
+			for (auto& e : s.entries) {
+				cstr name = &s.names[e.name];
+				u32 name_offs = (u32)tree.names.size();
+				tree.names.insert(tree.names.end(), name, name +strlen(name) +1);
+
+				tree.nodes.push_back({ name_offs, i, NULL_NODE, 0, 0, e.is_dir, e.is_dir });
+				node_scan.push_back(e.scan);
+
+				if (e.is_dir) dirs++;
+			}
+
+			auto& n = tree.nodes[i];
+			n.valid = s.valid;
+			n.first_child = first;
+			n.dir_count = dirs;
+			n.file_count = (u32)s.entries.size() -dirs;
+		}
+
+		return tree;
+	}
+
+	// Compatibility with the old nested Directory_Tree, only files matching file_filter are included
+	void to_directory_tree (File_Tree const& tree, u32 node, std::string const& name, Directory_Tree* dir, std::string const& file_filter="*") {
+		auto& n = tree.nodes[node];
+
+		dir->name = name;
+		dir->valid = n.valid;
 		dir->dirs.clear();
+		dir->filenames.clear();
+
+		dir->dirs.resize(n.dir_count);
+		for (u32 i=0; i<n.dir_count; ++i) {
+			u32 child = n.first_child +i;
+			to_directory_tree(tree, child, std::string(tree.get_name(child)) +'/', &dir->dirs[i], file_filter);
+		}
 
-		for (auto& d : dirnames) {
-			Directory_Tree subdir;
-			find_files_recursive(dir_full, d, &subdir);
-			dir->dirs.emplace_back( std::move(subdir) );
+		for (u32 i=n.first_child +n.dir_count; i<n.first_child +n.dir_count +n.file_count; ++i) {
+			if (match_filter(tree.get_name(i), file_filter.c_str()))
+				dir->filenames.emplace_back(tree.get_name(i));
 		}
+	}
+
+	bool find_files_recursive (std::string dir_path, std::string dir_name, Directory_Tree* dir, std::string const& file_filter="*") {
+		if (!(dir_path.size() == 0 || dir_path.back() == '/'))
+			dir_path.append("/");
+		if (dir_name.back() != '/')
+			dir_name.append("/");
+		
+		auto tree = scan_files(dir_path + dir_name);
+		to_directory_tree(tree, 0, dir_name, dir, file_filter);
 
 		return dir->valid;
 	}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "basic_typedefs.hpp"
+#include "float_precision.hpp"
+
+#include <chrono>
+#include "assert.h"
+
+// Fixed timestep scheduler, decouples simulations from the frame rate
+//  every tick advances the sim by exactly tick_dt(), so it behaves the same at any frame rate and can run faster than real time
+//  REAL_TIME: frame time (times time_scale) is accumulated and used up in whole ticks, the leftover is alpha(), to interpolate the rendering between the last two tick states
+//   if the ticks can not keep up with real time, at most max_ticks_per_frame run per frame and the rest of the time is dropped (the sim slows down instead of spiraling)
+//  AS_FAST_AS_POSSIBLE: ticks run back to back for max_frame_seconds of wall time per frame, to run a sim faster than real time while still rendering it
+//  run_headless(): a fixed number of ticks without any frames, for batch simulation
+namespace fixed_timestep {
+	using namespace basic_typedefs;
+	using namespace float_precision;
+
+	enum mode_e {
+		REAL_TIME,
+		AS_FAST_AS_POSSIBLE,
+	};
+
+	struct Fixed_Timestep {
+		mode_e	mode = REAL_TIME;
+		flt		tick_rate = 60; // ticks per second of sim time
+		flt		time_scale = 1; // sim seconds per real second (REAL_TIME only)
+		bool	paused = false;
+
+		int		max_ticks_per_frame = 8; // REAL_TIME: catch up limit
+		flt		max_frame_seconds = 1.0f / 60; // AS_FAST_AS_POSSIBLE: wall time spent ticking per frame
+
+		double	accumulator = 0; // sim seconds not simulated yet
+		double	sim_time = 0; // sim seconds simulated
+		u64		tick_i = 0; // ticks run in total
+		int		frame_ticks = 0; // ticks run in the last frame
+		u64		dropped_ticks = 0; // ticks skipped because of max_ticks_per_frame
+
+		flt tick_dt () const { return 1.0f / tick_rate; }
+
+		// how far we are between the previous and the current tick state [0,1]
+		flt alpha () const {
+			if (mode != REAL_TIME)
+				return 1; // always show the newest state
+			return (flt)MIN(accumulator * tick_rate, 1.0);
+		}
+
+		// drop the time that was not simulated yet, call when restarting a sim
+		void reset () {
+			accumulator = 0;
+		}
+
+		template <typename TICK>
+		void _tick (TICK& tick) {
+			tick(tick_dt());
+			tick_i++;
+			frame_ticks++;
+			sim_time += (double)tick_dt();
+		}
+
+		// call once per frame with the real frame time, calls  tick(flt dt)  0-n times, returns the number of ticks
+		template <typename TICK>
+		int frame (flt real_dt, TICK tick) {
+			assert(tick_rate > 0);
+			frame_ticks = 0;
+
+			if (paused)
+				return 0;
+
+			if (mode == AS_FAST_AS_POSSIBLE) {
+				accumulator = 0;
+
+				typedef std::chrono::steady_clock clock;
+				auto end = clock::now() +std::chrono::duration_cast<clock::duration>(std::chrono::duration<flt>(max_frame_seconds));
+				do {
+					_tick(tick);
+				} while (clock::now() < end);
+
+				return frame_ticks;
+			}
+
+			double dt = (double)tick_dt();
+
+			accumulator += (double)real_dt * time_scale;
+
+			while (accumulator >= dt) {
+				if (frame_ticks >= max_ticks_per_frame) {
+					u64 drop = (u64)(accumulator / dt);
+					dropped_ticks += drop;
+					accumulator -= (double)drop * dt;
+					break;
+				}
+
+				_tick(tick);
+				accumulator -= dt;
+			}
+
+			return frame_ticks;
+		}
+
+		// run ticks without frames, as fast as possible
+		template <typename TICK>
+		void run_headless (u64 ticks, TICK tick) {
+			frame_ticks = 0;
+			for (u64 i=0; i<ticks; ++i)
+				_tick(tick);
+		}
+	};
+
+	// the state of the last two ticks, to render in between them with Fixed_Timestep::alpha()
+	template <typename T>
+	struct Interpolated {
+		T	prev;
+		T	cur;
+
+		Interpolated (T val=T()): prev{val}, cur{val} {}
+
+		void set (T val) { // call once per tick
+			prev = cur;
+			cur = val;
+		}
+		void teleport (T val) { // jump to val without interpolating from the old value
+			prev = val;
+			cur = val;
+		}
+
+		T get (flt alpha) const {
+			return prev +(cur -prev) * alpha;
+		}
+	};
+}
+using namespace fixed_timestep;
@@ -1,75 +1,365 @@
 #pragma once
 
 #include "string.h"
+#include <algorithm>
 #include "mylibs/vector.hpp"
 #include "mylibs/basic_typedefs.hpp"
+#include "mylibs/parallel.hpp"
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+	#define IMAGE_PROCESSING_SSE2 1
+	#include "emmintrin.h"
+#else
+	#define IMAGE_PROCESSING_SSE2 0
+#endif
 
 namespace image_processing {
 	using namespace vector;
 	using namespace basic_typedefs;
-	
+
+	// All functions take tightly packed images (row stride == width * pixel_size)
+	// pixel sizes 1,2,3,4,6,8,12,16 get typed kernels (1, 3 and 4 byte pixels also get sse2 transpose kernels, 1 and 4 byte pixels sse2 reverse kernels), other sizes fall back to a memcpy per pixel
+	//  16 byte pixels get no sse2 kernel, their typed copy already moves one register per pixel and the transpose is bound by memory bandwidth
+
+	static constexpr int	TILE_SIZE = 32; // 32x32 tiles of 16 byte pixels are 16KB for src + 16KB for dst, so a tile of the strided side stays in L1/L2 while we walk it
+	static constexpr uptr	PARALLEL_MIN_BYTES = 1024 * 1024; // dont spawn threads for less work than this
+
+	template <uptr SIZE> struct Pixel {
+		u8	b[SIZE];
+	};
+
+	template <typename FUNC>
+	bool _dispatch_pixel_size (uptr pixel_size, FUNC func) {
+		switch (pixel_size) {
+			case  1: func(Pixel< 1>());	return true;
+			case  2: func(Pixel< 2>());	return true;
+			case  3: func(Pixel< 3>());	return true;
+			case  4: func(Pixel< 4>());	return true;
+			case  6: func(Pixel< 6>());	return true;
+			case  8: func(Pixel< 8>());	return true;
+			case 12: func(Pixel<12>());	return true;
+			case 16: func(Pixel<16>());	return true;
+			default: return false;
+		}
+	}
+
+	sptr _min_items_per_thread (uptr bytes_per_item) {
+		return (sptr)std::max(PARALLEL_MIN_BYTES / std::max(bytes_per_item, (uptr)1), (uptr)1);
+	}
+
+	//// Swapping and reversing
+
+	void _swap_memory (void* a, void* b, uptr size) {
+		u8 tmp[4096]; // swap through a small buffer in L1 so memcpy can do the actual work with wide loads/stores
+		for (uptr i=0; i<size; i += sizeof(tmp)) {
+			uptr n = std::min(sizeof(tmp), size -i);
+			memcpy(tmp, (u8*)a +i, n);
+			memcpy((u8*)a +i, (u8*)b +i, n);
+			memcpy((u8*)b +i, tmp, n);
+		}
+	}
+
+	// swap px[i] with px[count -1 -i] for i in [begin,end), end <= count/2
+	template <typename PX>
+	void _reverse_pixels (PX* px, uptr count, uptr begin, uptr end) {
+		for (uptr i=begin; i<end; ++i)
+			std::swap(px[i], px[count -1 -i]);
+	}
+#if IMAGE_PROCESSING_SSE2
+	inline __m128i _reverse_u32x4 (__m128i v) {
+		return _mm_shuffle_epi32(v, _MM_SHUFFLE(0,1,2,3));
+	}
+	inline __m128i _reverse_u8x16 (__m128i v) {
+		v = _reverse_u32x4(v);
+		v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2,3,0,1)); // swap the u16s in each u32
+		v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2,3,0,1));
+		return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)); // swap the bytes in each u16
+	}
+
+	// front and back blocks never overlap since end <= count/2
+	inline void _reverse_pixels (Pixel<4>* px, uptr count, uptr begin, uptr end) {
+		uptr i = begin;
+		for (; i+4 <= end; i += 4) {
+			__m128i* a = (__m128i*)(px +i);
+			__m128i* b = (__m128i*)(px +count -4 -i);
+			__m128i va = _mm_loadu_si128(a);
+			__m128i vb = _mm_loadu_si128(b);
+			_mm_storeu_si128(a, _reverse_u32x4(vb));
+			_mm_storeu_si128(b, _reverse_u32x4(va));
+		}
+		for (; i<end; ++i)
+			std::swap(px[i], px[count -1 -i]);
+	}
+	inline void _reverse_pixels (Pixel<1>* px, uptr count, uptr begin, uptr end) {
+		uptr i = begin;
+		for (; i+16 <= end; i += 16) {
+			__m128i* a = (__m128i*)(px +i);
+			__m128i* b = (__m128i*)(px +count -16 -i);
+			__m128i va = _mm_loadu_si128(a);
+			__m128i vb = _mm_loadu_si128(b);
+			_mm_storeu_si128(a, _reverse_u8x16(vb));
+			_mm_storeu_si128(b, _reverse_u8x16(va));
+		}
+		for (; i<end; ++i)
+			std::swap(px[i], px[count -1 -i]);
+	}
+#endif
+
+	void _reverse_pixels_any (u8* pixels, uptr pixel_size, uptr count, uptr begin, uptr end) {
+		for (uptr i=begin; i<end; ++i)
+			_swap_memory(pixels +i * pixel_size, pixels +(count -1 -i) * pixel_size, pixel_size);
+	}
+
+	//// Flips
+
 	void flip_vertical_inplace (void* rows, uptr row_size, uptr rows_count) {
-		for (uptr row=0; row<rows_count/2; ++row) {
-			char* row_a = (char*)rows +row_size * row;
-			char* row_b = (char*)rows +row_size * (rows_count -1 -row);
-			for (uptr i=0; i<row_size; ++i) {
-				std::swap(row_a[i], row_b[i]);
+		parallel_for((sptr)(rows_count / 2), [&] (sptr begin, sptr end) {
+			for (uptr row=(uptr)begin; row<(uptr)end; ++row) {
+				char* row_a = (char*)rows +row_size * row;
+				char* row_b = (char*)rows +row_size * (rows_count -1 -row);
+				_swap_memory(row_a, row_b, row_size);
 			}
-		}
+		}, _min_items_per_thread(row_size * 2));
 	}
 	void flip_vertical_copy (void* dst_rows, void* src_rows, uptr row_size, uptr rows_count) {
-		for (uptr row=0; row<rows_count; ++row) {
-			char* dst = (char*)dst_rows +row_size * row;
-			char* src = (char*)src_rows +row_size * (rows_count -1 -row);
-			memcpy(dst, src, row_size);
-		}
+		parallel_for((sptr)rows_count, [&] (sptr begin, sptr end) {
+			for (uptr row=(uptr)begin; row<(uptr)end; ++row) {
+				char* dst = (char*)dst_rows +row_size * row;
+				char* src = (char*)src_rows +row_size * (rows_count -1 -row);
+				memcpy(dst, src, row_size);
+			}
+		}, _min_items_per_thread(row_size));
 	}
 
+	void flip_horizontal_inplace (void* pixels, uptr pixel_size, s32v2 size_px) {
+		uptr row_size = (uptr)size_px.x * pixel_size;
+		uptr w = (uptr)size_px.x;
+
+		parallel_for((sptr)size_px.y, [&] (sptr begin, sptr end) {
+			for (sptr y=begin; y<end; ++y) {
+				u8* row = (u8*)pixels +(uptr)y * row_size;
+
+				bool ok = _dispatch_pixel_size(pixel_size, [&] (auto px) {
+					_reverse_pixels((decltype(px)*)row, w, 0, w / 2);
+				});
+				if (!ok)
+					_reverse_pixels_any(row, pixel_size, w, 0, w / 2);
+			}
+		}, _min_items_per_thread(row_size));
+	}
+
+	//// Rotations
+
+	// rotating by 180 is just reversing the order of all pixels in the image
 	void inplace_rotate_180 (void* pixels, uptr pixel_size, s32v2 size_px) {
-		uptr row = 0;
-		for (; row < size_px.y / 2; ++row) {
-			
-			uptr reverse_row = size_px.y -1 -row;
-
-			for (uptr x=0; x<size_px.x; ++x) {
-				uptr reverse_x = size_px.x -1 -x;
-
-				char* px_a = (char*)pixels +(row * size_px.x * pixel_size) +(x * pixel_size);
-				char* px_b = (char*)pixels +(reverse_row * size_px.x * pixel_size) +(reverse_x * pixel_size);
-				
-				for (uptr i=0; i<pixel_size; ++i) {
-					std::swap(px_a[i], px_b[i]);
-				}
+		uptr count = (uptr)size_px.x * (uptr)size_px.y;
+
+		parallel_for((sptr)(count / 2), [&] (sptr begin, sptr end) {
+			bool ok = _dispatch_pixel_size(pixel_size, [&] (auto px) {
+				_reverse_pixels((decltype(px)*)pixels, count, (uptr)begin, (uptr)end);
+			});
+			if (!ok)
+				_reverse_pixels_any((u8*)pixels, pixel_size, count, (uptr)begin, (uptr)end);
+		}, _min_items_per_thread(pixel_size * 2));
+	}
+
+	// transpose-like copies, src is size_px, dst is size_px.yx:
+	//  dst(x,y) = src(FLIP_SX ? w-1-y : y,  FLIP_SY ? h-1-x : x)
+	//   <false,false> transpose
+	//   <false,true>  rotate 90
+	//   <true,false>  rotate 270
+	template <bool FLIP_SX, bool FLIP_SY, typename PX>
+	void _transpose_tile_scalar (PX const* src, PX* dst, s32v2 size_px, int x0, int y0, int x1, int y1) {
+		int w = size_px.x, h = size_px.y;
+		for (int y=y0; y<y1; ++y) {
+			int sx = FLIP_SX ? w -1 -y : y;
+			PX* d = dst +(uptr)y * h;
+			for (int x=x0; x<x1; ++x) {
+				int sy = FLIP_SY ? h -1 -x : x;
+				d[x] = src[(uptr)sy * w +sx];
 			}
 		}
-		if (size_px.y % 2 == 1) { // is odd (has middle row)
+	}
+	template <bool FLIP_SX, bool FLIP_SY, typename PX>
+	void _transpose_tile (PX const* src, PX* dst, s32v2 size_px, int x0, int y0, int x1, int y1) {
+		_transpose_tile_scalar<FLIP_SX, FLIP_SY>(src, dst, size_px, x0, y0, x1, y1);
+	}
 
-			for (uptr x=0; x < size_px.x / 2; ++x) {
-				uptr reverse_x = size_px.x -1 -x;
+	void _transpose_tile_any (u8 const* src, u8* dst, uptr pixel_size, s32v2 size_px, bool flip_sx, bool flip_sy, int x0, int y0, int x1, int y1) {
+		int w = size_px.x, h = size_px.y;
+		for (int y=y0; y<y1; ++y) {
+			int sx = flip_sx ? w -1 -y : y;
+			for (int x=x0; x<x1; ++x) {
+				int sy = flip_sy ? h -1 -x : x;
+				memcpy(dst +((uptr)y * h +x) * pixel_size, src +((uptr)sy * w +sx) * pixel_size, pixel_size);
+			}
+		}
+	}
 
-				char* px_a = (char*)pixels +(row * size_px.x * pixel_size) +(x * pixel_size);
-				char* px_b = (char*)pixels +(row * size_px.x * pixel_size) +(reverse_x * pixel_size);
+#if IMAGE_PROCESSING_SSE2
+	// Load the N src rows that make up the N dst columns of the block, transpose in registers, then the flip in x just selects which transposed row goes to which dst row
+	// (flip in y is handled by which src rows we load), so no extra shuffles needed for rotations
 
-				for (uptr i=0; i<pixel_size; ++i) {
-					std::swap(px_a[i], px_b[i]);
-				}
-			}
+	FORCEINLINE __m128i _load_x4 (Pixel<4> const* p) {
+		return _mm_loadu_si128((__m128i const*)p);
+	}
+	FORCEINLINE void _store_x4 (Pixel<4>* p, __m128i v) {
+		_mm_storeu_si128((__m128i*)p, v);
+	}
+
+	// 4 pixels of 3 bytes (12 bytes, never reads past them) into the low 3 bytes of the u32 lanes
+	FORCEINLINE __m128i _load_x4 (Pixel<3> const* p) {
+		int tail;
+		memcpy(&tail, (u8 const*)p +8, 4);
+		__m128i v = _mm_unpacklo_epi64(_mm_loadl_epi64((__m128i const*)p), _mm_cvtsi32_si128(tail));
+
+		__m128i p01 = _mm_unpacklo_epi32(v, _mm_srli_si128(v, 3));
+		__m128i p23 = _mm_unpacklo_epi32(_mm_srli_si128(v, 6), _mm_srli_si128(v, 9));
+		return _mm_unpacklo_epi64(p01, p23);
+	}
+	// the top byte of the lanes is ignored
+	FORCEINLINE void _store_x4 (Pixel<3>* p, __m128i v) {
+		__m128i even = _mm_and_si128(v, _mm_set_epi32(0, 0x00ffffff, 0, 0x00ffffff));
+		__m128i odd = _mm_and_si128(v, _mm_set_epi32(0x00ffffff, 0, 0x00ffffff, 0));
+		__m128i v6 = _mm_or_si128(even, _mm_srli_epi64(odd, 8)); // 2 pixels in the low 6 bytes of both halves
+		__m128i r = _mm_or_si128(_mm_move_epi64(v6), _mm_slli_si128(_mm_srli_si128(v6, 8), 6));
+
+		_mm_storel_epi64((__m128i*)p, r);
+		int tail = _mm_cvtsi128_si32(_mm_srli_si128(r, 8));
+		memcpy((u8*)p +8, &tail, 4);
+	}
+
+	template <bool FLIP_SX, bool FLIP_SY, typename PX>
+	FORCEINLINE void _transpose_block_4x4 (PX const* src, PX* dst, s32v2 size_px, int x, int y) {
+		int w = size_px.x, h = size_px.y;
+		int sx = FLIP_SX ? w -4 -y : y;
+
+		__m128i r[4];
+		for (int j=0; j<4; ++j) {
+			int sy = FLIP_SY ? h -1 -(x +j) : x +j;
+			r[j] = _load_x4(src +(uptr)sy * w +sx);
 		}
+
+		__m128i t0 = _mm_unpacklo_epi32(r[0], r[1]);
+		__m128i t1 = _mm_unpacklo_epi32(r[2], r[3]);
+		__m128i t2 = _mm_unpackhi_epi32(r[0], r[1]);
+		__m128i t3 = _mm_unpackhi_epi32(r[2], r[3]);
+
+		__m128i c[4];
+		c[0] = _mm_unpacklo_epi64(t0, t1);
+		c[1] = _mm_unpackhi_epi64(t0, t1);
+		c[2] = _mm_unpacklo_epi64(t2, t3);
+		c[3] = _mm_unpackhi_epi64(t2, t3);
+
+		for (int i=0; i<4; ++i)
+			_store_x4(dst +(uptr)(y +i) * h +x, c[FLIP_SX ? 3 -i : i]);
 	}
-	
-	void copy_rotate_90 (void* src_pixels, void* dst_pixels, uptr pixel_size, s32v2 size_px) {
-		for (int y=0; y<size_px.y; ++y) {
-			for (int x=0; x<size_px.x; ++x) {
-				
-				int src_x = y;
-				int src_y = size_px.x -1 -x;
 
-				char* src_px = (char*)src_pixels +(src_y * size_px.y * pixel_size) +(src_x * pixel_size);
-				char* dst_px = (char*)dst_pixels +(y * size_px.y * pixel_size) +(x * pixel_size);
+	template <bool FLIP_SX, bool FLIP_SY>
+	FORCEINLINE void _transpose_block_8x8 (Pixel<1> const* src, Pixel<1>* dst, s32v2 size_px, int x, int y) {
+		int w = size_px.x, h = size_px.y;
+		int sx = FLIP_SX ? w -8 -y : y;
 
-				memcpy(dst_px, src_px, pixel_size);
-			}
+		__m128i r[8];
+		for (int j=0; j<8; ++j) {
+			int sy = FLIP_SY ? h -1 -(x +j) : x +j;
+			r[j] = _mm_loadl_epi64((__m128i const*)(src +(uptr)sy * w +sx));
 		}
+
+		__m128i a0 = _mm_unpacklo_epi8(r[0], r[1]);
+		__m128i a1 = _mm_unpacklo_epi8(r[2], r[3]);
+		__m128i a2 = _mm_unpacklo_epi8(r[4], r[5]);
+		__m128i a3 = _mm_unpacklo_epi8(r[6], r[7]);
+
+		__m128i b0 = _mm_unpacklo_epi16(a0, a1);
+		__m128i b1 = _mm_unpackhi_epi16(a0, a1);
+		__m128i b2 = _mm_unpacklo_epi16(a2, a3);
+		__m128i b3 = _mm_unpackhi_epi16(a2, a3);
+
+		__m128i c[4]; // each holds two transposed rows of 8 bytes
+		c[0] = _mm_unpacklo_epi32(b0, b2);
+		c[1] = _mm_unpackhi_epi32(b0, b2);
+		c[2] = _mm_unpacklo_epi32(b1, b3);
+		c[3] = _mm_unpackhi_epi32(b1, b3);
+
+		for (int i=0; i<8; ++i) {
+			int k = FLIP_SX ? 7 -i : i;
+			__m128i v = k & 1 ? _mm_srli_si128(c[k / 2], 8) : c[k / 2];
+			_mm_storel_epi64((__m128i*)(dst +(uptr)(y +i) * h +x), v);
+		}
+	}
+
+	template <int N, bool FLIP_SX, bool FLIP_SY, typename PX, typename BLOCK>
+	FORCEINLINE void _transpose_tile_blocked (PX const* src, PX* dst, s32v2 size_px, int x0, int y0, int x1, int y1, BLOCK block) {
+		int xb = x0 +((x1 -x0) / N) * N;
+		int yb = y0 +((y1 -y0) / N) * N;
+
+		for (int y=y0; y<yb; y += N)
+			for (int x=x0; x<xb; x += N)
+				block(src, dst, size_px, x, y);
+
+		_transpose_tile_scalar<FLIP_SX, FLIP_SY>(src, dst, size_px, xb, y0, x1, yb); // right edge
+		_transpose_tile_scalar<FLIP_SX, FLIP_SY>(src, dst, size_px, x0, yb, x1, y1); // bottom edge
+	}
+
+	template <bool FLIP_SX, bool FLIP_SY>
+	void _transpose_tile (Pixel<4> const* src, Pixel<4>* dst, s32v2 size_px, int x0, int y0, int x1, int y1) {
+		_transpose_tile_blocked<4, FLIP_SX, FLIP_SY>(src, dst, size_px, x0, y0, x1, y1, [] (Pixel<4> const* s, Pixel<4>* d, s32v2 sz, int x, int y) {
+			_transpose_block_4x4<FLIP_SX, FLIP_SY>(s, d, sz, x, y);
+		});
+	}
+	template <bool FLIP_SX, bool FLIP_SY>
+	void _transpose_tile (Pixel<3> const* src, Pixel<3>* dst, s32v2 size_px, int x0, int y0, int x1, int y1) {
+		_transpose_tile_blocked<4, FLIP_SX, FLIP_SY>(src, dst, size_px, x0, y0, x1, y1, [] (Pixel<3> const* s, Pixel<3>* d, s32v2 sz, int x, int y) {
+			_transpose_block_4x4<FLIP_SX, FLIP_SY>(s, d, sz, x, y);
+		});
+	}
+	template <bool FLIP_SX, bool FLIP_SY>
+	void _transpose_tile (Pixel<1> const* src, Pixel<1>* dst, s32v2 size_px, int x0, int y0, int x1, int y1) {
+		_transpose_tile_blocked<8, FLIP_SX, FLIP_SY>(src, dst, size_px, x0, y0, x1, y1, [] (Pixel<1> const* s, Pixel<1>* d, s32v2 sz, int x, int y) {
+			_transpose_block_8x8<FLIP_SX, FLIP_SY>(s, d, sz, x, y);
+		});
+	}
+#endif
+
+	template <bool FLIP_SX, bool FLIP_SY>
+	void _copy_transposed (void const* src_pixels, void* dst_pixels, uptr pixel_size, s32v2 size_px) {
+		int dst_w = size_px.y;
+		int dst_h = size_px.x;
+		int bands = (dst_h +TILE_SIZE -1) / TILE_SIZE;
+
+		parallel_for(bands, [&] (sptr begin, sptr end) {
+			int y_begin = (int)begin * TILE_SIZE;
+			int y_end = std::min((int)end * TILE_SIZE, dst_h);
+
+			// walk dst in TILE_SIZE^2 tiles, so the src columns we read from stay in cache for the whole tile
+			for (int ty=y_begin; ty<y_end; ty += TILE_SIZE) {
+				int ty1 = std::min(ty +TILE_SIZE, y_end);
+				for (int tx=0; tx<dst_w; tx += TILE_SIZE) {
+					int tx1 = std::min(tx +TILE_SIZE, dst_w);
+
+					bool ok = _dispatch_pixel_size(pixel_size, [&] (auto px) {
+						typedef decltype(px) PX;
+						_transpose_tile<FLIP_SX, FLIP_SY>((PX const*)src_pixels, (PX*)dst_pixels, size_px, tx, ty, tx1, ty1);
+					});
+					if (!ok)
+						_transpose_tile_any((u8 const*)src_pixels, (u8*)dst_pixels, pixel_size, size_px, FLIP_SX, FLIP_SY, tx, ty, tx1, ty1);
+				}
+			}
+		}, _min_items_per_thread((uptr)TILE_SIZE * dst_w * pixel_size));
+	}
+
+	// size_px is the size of src, dst has to be size_px.y x size_px.x pixels
+	void copy_transpose (void const* src_pixels, void* dst_pixels, uptr pixel_size, s32v2 size_px) {
+		_copy_transposed<false, false>(src_pixels, dst_pixels, pixel_size, size_px);
+	}
+	// dst(x,y) = src(y, h-1-x)
+	void copy_rotate_90 (void const* src_pixels, void* dst_pixels, uptr pixel_size, s32v2 size_px) {
+		_copy_transposed<false, true>(src_pixels, dst_pixels, pixel_size, size_px);
+	}
+	// dst(x,y) = src(w-1-y, x)
+	void copy_rotate_270 (void const* src_pixels, void* dst_pixels, uptr pixel_size, s32v2 size_px) {
+		_copy_transposed<true, false>(src_pixels, dst_pixels, pixel_size, size_px);
 	}
 
 }
@@ -3,6 +3,17 @@
 #include "vector.hpp"
 #include "float_precision.hpp"
 
+#include <vector>
+#include <algorithm>
+#include "assert.h"
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+	#define INTERSECT_SSE2 1
+	#include "emmintrin.h"
+#else
+	#define INTERSECT_SSE2 0
+#endif
+
 namespace intersect {
 	using namespace vector;
 	using namespace float_precision;
@@ -111,55 +122,393 @@ namespace intersect {
 		iv3(0,0,+1),
 		iv3(0,0,-1),
 	};
-	template <typename GET_VOXEL>
-	bool raycast_voxels (GET_VOXEL raycast_voxel, v3 ray_pos, v3 ray_dir, flt max_ray_dist=INF, iv3* out_hit_voxel=0, v3* out_hit_pos=0, int* out_hit_face=0) { // if ray starts inside block then the next block will be the first
-		
-		ray_dir = normalize(ray_dir);
-
-		iv3 step_delta = iv3(	(int)normalize(ray_dir.x),
+	// DDA state of one ray, shared by all the raycast_voxels variants so that they step through exactly the same voxels
+	struct _Voxel_Ray {
+		v3		ray_pos;
+		v3		ray_dir;
+
+		iv3		step_delta; // step direction in our voxel grid (we step one axis at a time)
+		v3		step; // how far along the ray we need to step to move by 1 voxel for each axis
+		iv3		cur_block; // voxel we consider the ray to start in
+		v3		next; // next holds the distances along the ray of the next axis plane intersection (ie. voxel change) for each axis
+		int		prev_axis; // axis through which the cur_block was entered
+
+		_Voxel_Ray (v3 pos, v3 dir) {
+			ray_pos = pos;
+			ray_dir = normalize(dir);
+
+			step_delta = iv3(	(int)normalize(ray_dir.x),
 								(int)normalize(ray_dir.y),
-								(int)normalize(ray_dir.z) ); // step direction in our voxel grid (we step one axis at a time) 
-		
-		v3 step = v3(			length(ray_dir / abs(ray_dir.x)),
+								(int)normalize(ray_dir.z) );
+
+			step = v3(			length(ray_dir / abs(ray_dir.x)),
 								length(ray_dir / abs(ray_dir.y)),
-								length(ray_dir / abs(ray_dir.z)) ); // how far along the ray we need to step to move by 1 voxel for each axis
-		step = select(ray_dir != 0, step, INF); // fix nan
+								length(ray_dir / abs(ray_dir.z)) );
+			step = select(ray_dir != 0, step, INF); // fix nan
 
-		iv3 cur_block = (iv3)floor(ray_pos); // voxel we consider the ray to start in
+			cur_block = (iv3)floor(ray_pos);
 
-		v3 pos_in_block	= ray_pos -(v3)cur_block;
+			v3 pos_in_block	= ray_pos -(v3)cur_block;
 
-		v3 next = step * select(ray_dir > 0, 1 -pos_in_block, pos_in_block); // next holds the distances along the ray of the next axis plane intersection (ie. voxel change) for each axis
+			next = step * select(ray_dir > 0, 1 -pos_in_block, pos_in_block);
+			next = select(ray_dir != 0, next, INF); // INF * 0 is nan when the ray starts on a voxel boundary, which would get stepped along forever
 
-		auto find_next_axis = [&] (v3 next) { // the smallest element in next is the axis we change voxels along (ie. the closest axis plane intersection alogn the ray)
-			return smallest_comp(next);
-		};
+			prev_axis = biggest_comp(next -step); // we want the biggest element in the vector, since we need the latest intersection
+		}
+
+		// position of the ray at distance t relative to block
+		v3 pos_in_block (flt t, iv3 block) const {
+			return (ray_pos + t * ray_dir) -(v3)block;
+		}
+		int hit_face (int axis) const { // face index corresponding to face_normals array
+			return axis * 2 +(ray_dir[axis] < 0 ? 0 : 1);
+		}
+	};
 
-		int prev_axis = biggest_comp(next -step); // axis through which the cur_block was entered ( we want the biggest element in the vector, since we need the latest intersection)
+	template <typename GET_VOXEL>
+	bool raycast_voxels (GET_VOXEL raycast_voxel, v3 ray_pos, v3 ray_dir, flt max_ray_dist=INF, iv3* out_hit_voxel=0, v3* out_hit_pos=0, int* out_hit_face=0) { // if ray starts inside block then the next block will be the first
+		
+		_Voxel_Ray r (ray_pos, ray_dir);
+
+		v3 pos_in_block	= r.ray_pos -(v3)r.cur_block;
 
 		for (;;) {
 			
-			int axis = find_next_axis(next); // find which axis plane we intersect next
+			int axis = smallest_comp(r.next); // find which axis plane we intersect next (the closest axis plane intersection along the ray)
 
 			v3 hit_pos = pos_in_block;
-			int hit_face = prev_axis * 2 +(ray_dir[prev_axis] < 0 ? 0 : 1); // face index corresponding to face_normals array
+			int hit_face = r.hit_face(r.prev_axis);
 
-			if (raycast_voxel(cur_block, hit_pos, hit_face)) { // call user handler for each voxel, user returns if this should be the final voxel hit
-				if (out_hit_voxel)	*out_hit_voxel = cur_block; // out params hold info of last voxel hit
+			if (raycast_voxel(r.cur_block, hit_pos, hit_face)) { // call user handler for each voxel, user returns if this should be the final voxel hit
+				if (out_hit_voxel)	*out_hit_voxel = r.cur_block; // out params hold info of last voxel hit
 				if (out_hit_pos)	*out_hit_pos = hit_pos;
 				if (out_hit_face)	*out_hit_face = hit_face;
 				return true;
 			}
 		
-			if (next[axis] > max_ray_dist) // stop if the next voxel cannot be hit within a distace of max_ray_dist
+			if (r.next[axis] > max_ray_dist) // stop if the next voxel cannot be hit within a distace of max_ray_dist
+				return false;
+
+			r.cur_block[axis] += r.step_delta[axis]; // step through voxels
+
+			pos_in_block = r.pos_in_block(r.next[axis], r.cur_block); // calculate the position of the next hit relative to the next voxel
+			r.prev_axis = axis;
+
+			r.next[axis] += r.step[axis]; // step along ray
+		}
+	}
+
+	//// Raycasts against an occupancy bitfield, for when there are many rays (picking, shadows, AO)
+
+	// 1 bit per voxel, plus an optional coarse mip with 1 bit per BRICK^3 voxels that lets rays step through empty bricks without lookups
+	struct Voxel_Occupancy {
+		static constexpr int BRICK_SHIFT = 2;
+		static constexpr int BRICK = 1 << BRICK_SHIFT;
+
+		iv3					size = 0;
+		iv3					bricks = 0; // size in bricks
+		std::vector<u64>	bits; // x fastest, then y, then z
+		std::vector<u64>	brick_bits; // empty if the mip is disabled
+
+		void init (iv3 new_size, bool coarse_mip=true) {
+			size = new_size;
+			bricks = (size +BRICK -1) / BRICK;
+			bits.assign(((uptr)size.x * size.y * size.z +63) / 64, 0);
+			brick_bits.assign(coarse_mip ? ((uptr)bricks.x * bricks.y * bricks.z +63) / 64 : 0, 0);
+		}
+
+		bool in_bounds (iv3 p) const {
+			return all(p >= 0 && p < size);
+		}
+		static bool _get_bit (std::vector<u64> const& v, uptr i) {
+			return (v[i >> 6] >> (i & 63)) & 1;
+		}
+		uptr _index (iv3 p) const {
+			return ((uptr)p.z * size.y + p.y) * size.x + p.x;
+		}
+		uptr _brick_index (iv3 p) const {
+			return ((uptr)(p.z >> BRICK_SHIFT) * bricks.y + (p.y >> BRICK_SHIFT)) * bricks.x + (p.x >> BRICK_SHIFT);
+		}
+
+		// clearing voxels does not clear their brick, call update_mip() after clearing lots of voxels
+		void set (iv3 p, bool occupied) {
+			assert(in_bounds(p));
+			uptr i = _index(p);
+			if (occupied) {
+				bits[i >> 6] |= 1ull << (i & 63);
+				if (brick_bits.size() > 0) {
+					uptr b = _brick_index(p);
+					brick_bits[b >> 6] |= 1ull << (b & 63);
+				}
+			} else {
+				bits[i >> 6] &= ~(1ull << (i & 63));
+			}
+		}
+		void update_mip () {
+			if (brick_bits.size() == 0)
+				return;
+			std::fill(brick_bits.begin(), brick_bits.end(), 0);
+
+			iv3 p;
+			for (p.z=0; p.z<size.z; ++p.z)
+				for (p.y=0; p.y<size.y; ++p.y)
+					for (p.x=0; p.x<size.x; ++p.x)
+						if (_get_bit(bits, _index(p))) {
+							uptr b = _brick_index(p);
+							brick_bits[b >> 6] |= 1ull << (b & 63);
+						}
+		}
+
+		bool get (iv3 p) const { // outside of the grid is empty
+			if (!in_bounds(p))
+				return false;
+			return _get_bit(bits, _index(p));
+		}
+		bool brick_empty (iv3 p) const { // p has to be in bounds, always false without the mip
+			return brick_bits.size() > 0 && !_get_bit(brick_bits, _brick_index(p));
+		}
+	};
+
+	struct Voxel_Hit {
+		bool	hit;
+		iv3		voxel;
+		v3		pos; // relative to voxel
+		int		face; // index into face_normals
+	};
+
+	// the ray has left the grid if it is outside on the axis it just stepped along and moving away from it
+	inline bool _left_grid (Voxel_Occupancy const& occ, _Voxel_Ray const& r, int axis) {
+		int c = r.cur_block[axis];
+		return (c < 0 && r.step_delta[axis] < 0) || (c >= occ.size[axis] && r.step_delta[axis] > 0);
+	}
+
+	// Steps the ray through the empty brick its cur_block is in, up to the last voxel before it leaves the brick (or the grid), so that the next step leaves it
+	//  gives exactly the state that stepping voxel by voxel would (same float additions per axis, same tie rule as smallest_comp), just without the lookups
+	inline void _to_brick_exit (Voxel_Occupancy const& occ, _Voxel_Ray& r) {
+		int k[3]; // number of steps on each axis until the ray leaves the brick
+		v3 t_exit; // distance of the last of those steps
+		for (int a=0; a<3; ++a) {
+			int c = r.cur_block[a];
+			int in_brick = c & (Voxel_Occupancy::BRICK -1);
+			k[a] = r.step_delta[a] > 0 ? MIN(Voxel_Occupancy::BRICK -in_brick, occ.size[a] -c) : in_brick +1;
+			t_exit[a] = r.next[a];
+			for (int j=1; j<k[a]; ++j)
+				t_exit[a] += r.step[a];
+		}
+
+		int exit_axis = smallest_comp(t_exit);
+		flt t = t_exit[exit_axis];
+
+		// take every step that comes before the one out of the brick
+		for (int a=0; a<3; ++a) {
+			for (int j=1; j<k[a] && (a == exit_axis || r.next[a] < t || (r.next[a] == t && a < exit_axis)); ++j) {
+				r.cur_block[a] += r.step_delta[a];
+				r.next[a] += r.step[a];
+			}
+		}
+	}
+
+	// same as raycast_voxels with  [&] (iv3 voxel, v3, int) { return occ.get(voxel); }  but also stops once the ray has left the grid
+	bool raycast_voxels (Voxel_Occupancy const& occ, v3 ray_pos, v3 ray_dir, flt max_ray_dist, Voxel_Hit* out) {
+		_Voxel_Ray r (ray_pos, ray_dir);
+
+		bool entered = false; // stepped at least once
+		flt t_enter = 0;
+
+		out->hit = false;
+
+		for (;;) {
+			if (occ.in_bounds(r.cur_block) && occ.brick_empty(r.cur_block)) {
+				_to_brick_exit(occ, r);
+			} else if (occ.get(r.cur_block)) {
+				out->hit = true;
+				out->voxel = r.cur_block;
+				out->pos = entered ? r.pos_in_block(t_enter, r.cur_block) : r.ray_pos -(v3)r.cur_block;
+				out->face = r.hit_face(r.prev_axis);
+				return true;
+			}
+
+			int axis = smallest_comp(r.next);
+
+			if (r.next[axis] > max_ray_dist)
 				return false;
 
-			cur_block[axis] += step_delta[axis]; // step through voxels
+			r.cur_block[axis] += r.step_delta[axis];
+			if (_left_grid(occ, r, axis))
+				return false;
+
+			entered = true;
+			t_enter = r.next[axis];
+			r.prev_axis = axis;
+
+			r.next[axis] += r.step[axis];
+		}
+	}
+
+	// Traces up to 4 rays together (coherent rays like a block of pixels work best), results are exactly the same as tracing them one by one
+	//  the DDA steps of all rays are done at once in SSE registers, the occupancy lookups are done per ray
+	void raycast_voxels_packet (Voxel_Occupancy const& occ, v3 const* ray_pos, v3 const* ray_dir, flt const* max_ray_dist, Voxel_Hit* out, int count=4) {
+		assert(count >= 0 && count <= 4);
+		if (count == 0)
+			return;
+#if INTERSECT_SSE2
+		alignas(16) flt nx[4], ny[4], nz[4], sx[4], sy[4], sz[4], maxd[4];
+		alignas(16) s32 cx[4], cy[4], cz[4], dx[4], dy[4], dz[4];
+
+		int last = count -1; // unused lanes trace a copy of the last ray, but are never active
+		_Voxel_Ray rays[4] = {	_Voxel_Ray(ray_pos[0], ray_dir[0]),
+								_Voxel_Ray(ray_pos[MIN(1, last)], ray_dir[MIN(1, last)]),
+								_Voxel_Ray(ray_pos[MIN(2, last)], ray_dir[MIN(2, last)]),
+								_Voxel_Ray(ray_pos[MIN(3, last)], ray_dir[MIN(3, last)]) };
+
+		int active = (1 << count) -1;
+		for (int l=0; l<4; ++l) {
+			if (l < count)
+				out[l].hit = false;
+			auto& r = rays[l];
+			nx[l] = r.next.x;		ny[l] = r.next.y;		nz[l] = r.next.z;
+			sx[l] = r.step.x;		sy[l] = r.step.y;		sz[l] = r.step.z;
+			cx[l] = r.cur_block.x;	cy[l] = r.cur_block.y;	cz[l] = r.cur_block.z;
+			dx[l] = r.step_delta.x;	dy[l] = r.step_delta.y;	dz[l] = r.step_delta.z;
+			maxd[l] = max_ray_dist[MIN(l, last)];
+		}
+
+		__m128 next_x = _mm_load_ps(nx), next_y = _mm_load_ps(ny), next_z = _mm_load_ps(nz);
+		__m128 step_x = _mm_load_ps(sx), step_y = _mm_load_ps(sy), step_z = _mm_load_ps(sz);
+		__m128 max_dist = _mm_load_ps(maxd);
+		__m128i cur_x = _mm_load_si128((__m128i*)cx), cur_y = _mm_load_si128((__m128i*)cy), cur_z = _mm_load_si128((__m128i*)cz);
+		__m128i delta_x = _mm_load_si128((__m128i*)dx), delta_y = _mm_load_si128((__m128i*)dy), delta_z = _mm_load_si128((__m128i*)dz);
+
+		__m128i prev_axis = _mm_setr_epi32(rays[0].prev_axis, rays[1].prev_axis, rays[2].prev_axis, rays[3].prev_axis);
+		__m128 t_enter = _mm_setzero_ps();
+		__m128i entered = _mm_setzero_si128();
+
+		__m128i zero = _mm_setzero_si128();
+		__m128i size_x = _mm_set1_epi32(occ.size.x), size_y = _mm_set1_epi32(occ.size.y), size_z = _mm_set1_epi32(occ.size.z);
+
+		// lanes that stepped out of the grid (moving away) on the axis selected by mask
+		auto left_grid = [&] (__m128i cur, __m128i delta, __m128i size, __m128i mask) {
+			__m128i below = _mm_and_si128(_mm_cmplt_epi32(cur, zero), _mm_cmplt_epi32(delta, zero));
+			__m128i above = _mm_and_si128(_mm_cmpgt_epi32(cur, _mm_sub_epi32(size, _mm_set1_epi32(1))), _mm_cmpgt_epi32(delta, zero));
+			return _mm_and_si128(_mm_or_si128(below, above), mask);
+		};
+
+		while (active) {
+			_mm_store_si128((__m128i*)cx, cur_x);
+			_mm_store_si128((__m128i*)cy, cur_y);
+			_mm_store_si128((__m128i*)cz, cur_z);
+
+			int hits = 0, empty = 0;
+			for (int l=0; l<4; ++l) {
+				if (!(active & (1 << l)))
+					continue;
+				iv3 p = iv3(cx[l], cy[l], cz[l]);
+				if (occ.in_bounds(p) && occ.brick_empty(p))
+					empty |= 1 << l;
+				else if (occ.get(p))
+					hits |= 1 << l;
+			}
 
-			pos_in_block = (ray_pos + next[axis] * ray_dir) -(v3)cur_block; // calculate the position of the next hit relative to the next voxel
-			prev_axis = axis;
+			if (hits) {
+				alignas(16) s32 prev[4], ent[4];
+				alignas(16) flt te[4];
+				_mm_store_si128((__m128i*)prev, prev_axis);
+				_mm_store_si128((__m128i*)ent, entered);
+				_mm_store_ps(te, t_enter);
+
+				for (int l=0; l<4; ++l) {
+					if (!(hits & (1 << l)))
+						continue;
+					iv3 block = iv3(cx[l], cy[l], cz[l]);
+					out[l].hit = true;
+					out[l].voxel = block;
+					out[l].pos = ent[l] ? rays[l].pos_in_block(te[l], block) : rays[l].ray_pos -(v3)block;
+					out[l].face = rays[l].hit_face(prev[l]);
+				}
+				active &= ~hits;
+			}
+
+			if (empty) { // _to_brick_exit for the lanes in empty bricks
+				__m128i lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+				__m128i lanes = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(empty), lane_bits), lane_bits);
+
+				__m128i brick = _mm_set1_epi32(Voxel_Occupancy::BRICK);
+				__m128i one = _mm_set1_epi32(1);
+				auto steps_to_exit = [&] (__m128i cur, __m128i delta, __m128i size) {
+					__m128i in_brick = _mm_and_si128(cur, _mm_set1_epi32(Voxel_Occupancy::BRICK -1));
+					__m128i to_brick = _mm_sub_epi32(brick, in_brick), to_grid = _mm_sub_epi32(size, cur);
+					__m128i nearer = _mm_cmplt_epi32(to_grid, to_brick);
+					__m128i pos = _mm_or_si128(_mm_and_si128(nearer, to_grid), _mm_andnot_si128(nearer, to_brick));
+					__m128i neg = _mm_add_epi32(in_brick, one);
+					__m128i is_pos = _mm_cmpgt_epi32(delta, zero);
+					return _mm_or_si128(_mm_and_si128(is_pos, pos), _mm_andnot_si128(is_pos, neg));
+				};
+				__m128i kx = steps_to_exit(cur_x, delta_x, size_x), ky = steps_to_exit(cur_y, delta_y, size_y), kz = steps_to_exit(cur_z, delta_z, size_z);
+
+				__m128 tx = next_x, ty = next_y, tz = next_z;
+				for (int j=1; j<Voxel_Occupancy::BRICK; ++j) {
+					__m128i jv = _mm_set1_epi32(j);
+					tx = _mm_add_ps(tx, _mm_and_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(kx, jv)), step_x));
+					ty = _mm_add_ps(ty, _mm_and_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(ky, jv)), step_y));
+					tz = _mm_add_ps(tz, _mm_and_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(kz, jv)), step_z));
+				}
+
+				__m128 ex = _mm_and_ps(_mm_cmple_ps(tx, ty), _mm_cmple_ps(tx, tz));
+				__m128 ey = _mm_andnot_ps(ex, _mm_cmple_ps(ty, tz));
+				__m128 ez = _mm_andnot_ps(_mm_or_ps(ex, ey), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+				__m128 t = _mm_or_ps(_mm_or_ps(_mm_and_ps(ex, tx), _mm_and_ps(ey, ty)), _mm_and_ps(ez, tz));
+
+				// step of one axis if it comes before the one out of the brick, exit_later is the exit axis being a later axis than this one
+				auto advance = [&] (__m128i& cur, __m128& next, __m128i delta, __m128 step, __m128i k, __m128i jv, __m128 is_exit, __m128 exit_later) {
+					__m128 before = _mm_or_ps(_mm_cmplt_ps(next, t), _mm_and_ps(_mm_cmpeq_ps(next, t), exit_later));
+					__m128 m = _mm_and_ps(_mm_or_ps(is_exit, before), _mm_castsi128_ps(_mm_and_si128(lanes, _mm_cmpgt_epi32(k, jv))));
+					cur = _mm_add_epi32(cur, _mm_and_si128(_mm_castps_si128(m), delta));
+					next = _mm_add_ps(next, _mm_and_ps(m, step));
+				};
+				for (int j=1; j<Voxel_Occupancy::BRICK; ++j) {
+					__m128i jv = _mm_set1_epi32(j);
+					advance(cur_x, next_x, delta_x, step_x, kx, jv, ex, _mm_or_ps(ey, ez));
+					advance(cur_y, next_y, delta_y, step_y, ky, jv, ey, ez);
+					advance(cur_z, next_z, delta_z, step_z, kz, jv, ez, _mm_setzero_ps());
+				}
+			}
+
+			// smallest_comp(next)
+			__m128 mx = _mm_and_ps(_mm_cmple_ps(next_x, next_y), _mm_cmple_ps(next_x, next_z));
+			__m128 my = _mm_andnot_ps(mx, _mm_cmple_ps(next_y, next_z));
+			__m128 mz = _mm_andnot_ps(_mm_or_ps(mx, my), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+
+			__m128 t = _mm_or_ps(_mm_or_ps(_mm_and_ps(mx, next_x), _mm_and_ps(my, next_y)), _mm_and_ps(mz, next_z));
+
+			active &= ~_mm_movemask_ps(_mm_cmpgt_ps(t, max_dist));
 
-			next[axis] += step[axis]; // step along ray
+			__m128i imx = _mm_castps_si128(mx), imy = _mm_castps_si128(my), imz = _mm_castps_si128(mz);
+			cur_x = _mm_add_epi32(cur_x, _mm_and_si128(imx, delta_x));
+			cur_y = _mm_add_epi32(cur_y, _mm_and_si128(imy, delta_y));
+			cur_z = _mm_add_epi32(cur_z, _mm_and_si128(imz, delta_z));
+
+			__m128i left = _mm_or_si128(_mm_or_si128(	left_grid(cur_x, delta_x, size_x, imx),
+														left_grid(cur_y, delta_y, size_y, imy)),
+														left_grid(cur_z, delta_z, size_z, imz));
+			active &= ~_mm_movemask_ps(_mm_castsi128_ps(left));
+
+			entered = _mm_set1_epi32(-1);
+			t_enter = t;
+			prev_axis = _mm_or_si128(_mm_and_si128(imy, _mm_set1_epi32(1)), _mm_and_si128(imz, _mm_set1_epi32(2)));
+
+			next_x = _mm_add_ps(next_x, _mm_and_ps(mx, step_x));
+			next_y = _mm_add_ps(next_y, _mm_and_ps(my, step_y));
+			next_z = _mm_add_ps(next_z, _mm_and_ps(mz, step_z));
 		}
+#else
+		for (int l=0; l<count; ++l)
+			raycast_voxels(occ, ray_pos[l], ray_dir[l], max_ray_dist[l], &out[l]);
+#endif
+	}
+
+	// traces count rays in packets of 4, neighbouring rays should be coherent
+	void raycast_voxels (Voxel_Occupancy const& occ, v3 const* ray_pos, v3 const* ray_dir, flt const* max_ray_dist, Voxel_Hit* out, uptr count) {
+		for (uptr i=0; i<count; i += 4)
+			raycast_voxels_packet(occ, ray_pos +i, ray_dir +i, max_ray_dist +i, out +i, (int)MIN(count -i, (uptr)4));
 	}
 }
@@ -135,10 +135,14 @@ INL M3 operator* (M3 l, M3 r) {
 
 INL V4 operator* (M4 m, V4 v) {
 	V4 ret;
+#if VECTOR_SIMD
+	f4_store(&ret.x, f4_mat4_mul(f4_load(&m.arr[0].x), f4_load(&m.arr[1].x), f4_load(&m.arr[2].x), f4_load(&m.arr[3].x), &v.x));
+#else
 	ret.x = m.arr[0].x * v.x  +m.arr[1].x * v.y  +m.arr[2].x * v.z  +m.arr[3].x * v.w;
 	ret.y = m.arr[0].y * v.x  +m.arr[1].y * v.y  +m.arr[2].y * v.z  +m.arr[3].y * v.w;
 	ret.z = m.arr[0].z * v.x  +m.arr[1].z * v.y  +m.arr[2].z * v.z  +m.arr[3].z * v.w;
 	ret.w = m.arr[0].w * v.x  +m.arr[1].w * v.y  +m.arr[2].w * v.z  +m.arr[3].w * v.w;
+#endif
 	return ret;
 }
 INL M4 operator* (M4 l, M4 r) {
@@ -150,6 +154,7 @@ INL M4 operator* (M4 l, M4 r) {
 	return ret;
 }
 
+// single HM ops stay scalar even with VECTOR_SIMD, the 3 float columns cost more to get in and out of registers than the math saves, use transform_points for many points
 INL V3 operator* (HM m, V3 v) { // the common case of wanting to translate/rotate/scale some v3 -> if you just want to rotate/scale, instead of doing this: "some_hm * v4(some_v3,0)" -> just do: "some_hm.m3() * some_v3"
 	return m.mat * v +m.transl;
 }
@@ -193,6 +198,49 @@ INL HM& HM::operator*= (HM r) {
 	return *this = *this * r;
 }
 
+//// Batch transforms, in and out can be the same array
+
+// out[i] = m * in[i]  (w = 1)
+INL void transform_points (HM const& m, V3 const* in, V3* out, uptr count) {
+	uptr i = 0;
+#if VECTOR_SIMD
+	static_assert(sizeof(V3) == 3 * sizeof(T), "");
+
+	f4 m00 = f4_set1(m.mat.arr[0].x), m01 = f4_set1(m.mat.arr[1].x), m02 = f4_set1(m.mat.arr[2].x), t0 = f4_set1(m.transl.x);
+	f4 m10 = f4_set1(m.mat.arr[0].y), m11 = f4_set1(m.mat.arr[1].y), m12 = f4_set1(m.mat.arr[2].y), t1 = f4_set1(m.transl.y);
+	f4 m20 = f4_set1(m.mat.arr[0].z), m21 = f4_set1(m.mat.arr[1].z), m22 = f4_set1(m.mat.arr[2].z), t2 = f4_set1(m.transl.z);
+
+	for (; i +4 <= count; i += 4) { // 4 points at a time, one register per component
+		f4 x, y, z;
+		f4_load_soa3(&in[i].x, &x, &y, &z);
+
+		f4 ox = f4_madd(m00, x, f4_madd(m01, y, f4_madd(m02, z, t0)));
+		f4 oy = f4_madd(m10, x, f4_madd(m11, y, f4_madd(m12, z, t1)));
+		f4 oz = f4_madd(m20, x, f4_madd(m21, y, f4_madd(m22, z, t2)));
+
+		f4_store_soa3(&out[i].x, ox, oy, oz);
+	}
+#endif
+	for (; i<count; ++i)
+		out[i] = m * in[i];
+}
+// out[i] = m.m3() * in[i]  (w = 0, no translation)
+INL void transform_directions (HM const& m, V3 const* in, V3* out, uptr count) {
+	HM rot = HM(m.mat);
+	transform_points(rot, in, out, count);
+}
+// out[i] = m * in[i]
+INL void transform (M4 const& m, V4 const* in, V4* out, uptr count) {
+#if VECTOR_SIMD
+	f4 c0 = f4_load(&m.arr[0].x), c1 = f4_load(&m.arr[1].x), c2 = f4_load(&m.arr[2].x), c3 = f4_load(&m.arr[3].x);
+	for (uptr i=0; i<count; ++i)
+		f4_store(&out[i].x, f4_mat4_mul(c0,c1,c2,c3, &in[i].x));
+#else
+	for (uptr i=0; i<count; ++i)
+		out[i] = m * in[i];
+#endif
+}
+
 INL M2 inverse (M2 m) {
 	T inv_det = T(1) / ( (m.arr[0].x * m.arr[1].y) -(m.arr[1].x * m.arr[0].y) );
 
@@ -203,7 +251,120 @@ INL M2 inverse (M2 m) {
 	ret.arr[1].y = m.arr[0].x * +inv_det;
 	return ret;
 }
-// TODO: m3 and m4 inverse, but i try to program in such a way, that in never need to calc a inverse
+
+INL M3 transpose (M3 m) {
+	return M3::rows(m.arr[0], m.arr[1], m.arr[2]);
+}
+INL M4 transpose (M4 m) {
+	return M4::rows(m.arr[0], m.arr[1], m.arr[2], m.arr[3]);
+}
+
+// singular matricies give inf/nan, like inverse(M2)
+INL M3 inverse (M3 m) {
+	V3 a = m.arr[0], b = m.arr[1], c = m.arr[2];
+
+	// rows of the inverse are the cross products of the other two columns
+	V3 r0 = cross(b, c);
+	V3 r1 = cross(c, a);
+	V3 r2 = cross(a, b);
+
+	T inv_det = T(1) / dot(a, r0);
+
+	return M3::rows(r0 * inv_det, r1 * inv_det, r2 * inv_det);
+}
+INL M4 inverse (M4 m) {
+	// Eric Lengyel, Foundations of Game Engine Development Vol 1, 1.7.5
+	V3 a = m.arr[0].xyz(), b = m.arr[1].xyz(), c = m.arr[2].xyz(), d = m.arr[3].xyz();
+	T x = m.arr[0].w, y = m.arr[1].w, z = m.arr[2].w, w = m.arr[3].w;
+
+	V3 s = cross(a, b);
+	V3 t = cross(c, d);
+	V3 u = a * y -b * x;
+	V3 v = c * w -d * z;
+
+	T inv_det = T(1) / (dot(s, v) +dot(t, u));
+	s *= inv_det;
+	t *= inv_det;
+	u *= inv_det;
+	v *= inv_det;
+
+	V3 r0 = cross(b, v) +t * y;
+	V3 r1 = cross(v, a) -t * x;
+	V3 r2 = cross(d, u) +s * w;
+	V3 r3 = cross(u, c) -s * z;
+
+	return M4::rows(	V4(r0, -dot(b, t)),
+						V4(r1, +dot(a, t)),
+						V4(r2, -dot(d, s)),
+						V4(r3, +dot(c, s)) );
+}
+// affine, so this only needs the 3x3 inverse
+INL HM inverse (HM m) {
+	M3 inv = inverse(m.mat);
+	return HM(inv, inv * -m.transl);
+}
+// for M4 that are known to be affine (last row 0 0 0 1)
+INL M4 inverse_affine (M4 m) {
+	return inverse(HM::columns(m.arr[0].xyz(), m.arr[1].xyz(), m.arr[2].xyz(), m.arr[3].xyz())).m4();
+}
+// only rotation and translation (no scale), the inverse rotation is just the transpose
+INL HM inverse_rigid (HM m) {
+	M3 inv = transpose(m.mat);
+	return HM(inv, inv * -m.transl);
+}
+
+// out[i] = inverse(in[i]), in and out can be the same array
+INL void inverse (HM const* in, HM* out, uptr count) {
+	uptr i = 0;
+#if VECTOR_SIMD
+	static_assert(sizeof(HM) == 12 * sizeof(T), "");
+
+	for (; i +4 <= count; i += 4) { // 4 matricies at a time, one register per matrix element
+		T const* src = &in[i].mat.arr[0].x;
+		f4 e[12];
+		for (int j=0; j<12; j += 4) {
+			e[j+0] = f4_load(src +j);
+			e[j+1] = f4_load(src +j +12);
+			e[j+2] = f4_load(src +j +24);
+			e[j+3] = f4_load(src +j +36);
+			f4_transpose4(&e[j+0], &e[j+1], &e[j+2], &e[j+3]);
+		}
+		// e: a.xyz b.xyz c.xyz transl.xyz
+
+		auto cross4 = [] (f4 const* l, f4 const* r, f4* res) {
+			res[0] = f4_sub(f4_mul(l[1], r[2]), f4_mul(l[2], r[1]));
+			res[1] = f4_sub(f4_mul(l[2], r[0]), f4_mul(l[0], r[2]));
+			res[2] = f4_sub(f4_mul(l[0], r[1]), f4_mul(l[1], r[0]));
+		};
+		f4 r[9]; // rows of the inverse
+		cross4(e+3, e+6, r+0);
+		cross4(e+6, e+0, r+3);
+		cross4(e+0, e+3, r+6);
+
+		f4 inv_det = f4_div(f4_set1(1), f4_madd(e[0], r[0], f4_madd(e[1], r[1], f4_mul(e[2], r[2]))));
+
+		f4 o[12]; // columns of the inverse
+		for (int row=0; row<3; ++row) {
+			for (int col=0; col<3; ++col)
+				o[col*3 +row] = f4_mul(r[row*3 +col], inv_det);
+
+			// -(inv * transl)
+			o[9 +row] = f4_sub(f4_set1(0), f4_madd(o[0*3 +row], e[9], f4_madd(o[1*3 +row], e[10], f4_mul(o[2*3 +row], e[11]))));
+		}
+
+		T* dst = &out[i].mat.arr[0].x;
+		for (int j=0; j<12; j += 4) {
+			f4_transpose4(&o[j+0], &o[j+1], &o[j+2], &o[j+3]);
+			f4_store(dst +j,      o[j+0]);
+			f4_store(dst +j +12,  o[j+1]);
+			f4_store(dst +j +24,  o[j+2]);
+			f4_store(dst +j +36,  o[j+3]);
+		}
+	}
+#endif
+	for (; i<count; ++i)
+		out[i] = inverse(in[i]);
+}
 
 INL M2 scale2 (V2 v) {
 	return M2::columns(	V2(v.x,0),
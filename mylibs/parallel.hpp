@@ -0,0 +1,191 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+#include "basic_typedefs.hpp"
+#include "preprocessor_stuff.hpp"
+
+namespace parallel {
+	using namespace basic_typedefs;
+
+	int thread_count () {
+		static int count = std::max((int)std::thread::hardware_concurrency(), 1); // hardware_concurrency can return 0 if it does not know
+		return count;
+	}
+
+	// Worker threads for parallel_for, started on first use and kept until the program exits, so a parallel_for does not pay for spawning threads
+	//  the calling thread always works on its own job too, so a job finishes even if all workers are busy (nested or concurrent parallel_for calls)
+	class Thread_Pool {
+		NO_MOVE_COPY_CLASS(Thread_Pool)
+	public:
+		struct Job {
+			void				(*run) (void* ctx, sptr range);
+			void*				ctx;
+			sptr				ranges;
+			std::atomic<sptr>	next {0}; // next range to be claimed
+			int					active = 0; // workers that took the job from the queue and did not leave it yet, protected by the mutex
+		};
+
+	private:
+		std::mutex					mutex;
+		std::condition_variable		work_cv; // workers wait for jobs
+		std::condition_variable		done_cv; // callers wait for the workers to leave their job
+		std::deque<Job*>			queue; // one entry per worker that should help
+		std::vector<std::thread>	workers;
+		bool						shutdown = false;
+
+		static void _run_ranges (Job* job) {
+			for (;;) {
+				sptr i = job->next.fetch_add(1);
+				if (i >= job->ranges)
+					return;
+				job->run(job->ctx, i);
+			}
+		}
+
+		void _worker () {
+			std::unique_lock<std::mutex> lock(mutex);
+			for (;;) {
+				work_cv.wait(lock, [&] () { return !queue.empty() || shutdown; });
+				if (shutdown)
+					return;
+
+				Job* job = queue.front();
+				queue.pop_front();
+				job->active++;
+
+				lock.unlock();
+				_run_ranges(job);
+				lock.lock();
+
+				if (--job->active == 0)
+					done_cv.notify_all();
+			}
+		}
+
+	public:
+		Thread_Pool (int threads) {
+			workers.reserve(threads);
+			for (int i=0; i<threads; ++i)
+				workers.emplace_back(&Thread_Pool::_worker, this);
+		}
+		~Thread_Pool () {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				shutdown = true;
+			}
+			work_cv.notify_all();
+			for (auto& w : workers)
+				w.join();
+		}
+
+		// runs all ranges of job on the calling thread and up to helpers workers, returns once all of them are done
+		void run (Job* job, int helpers) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				for (int i=0; i<helpers; ++i)
+					queue.push_back(job);
+			}
+			work_cv.notify_all();
+
+			_run_ranges(job);
+
+			std::unique_lock<std::mutex> lock(mutex);
+			queue.erase(std::remove(queue.begin(), queue.end(), job), queue.end()); // no more ranges left, so workers that did not pick it up yet dont need to
+			done_cv.wait(lock, [&] () { return job->active == 0; });
+		}
+	};
+
+	Thread_Pool& thread_pool () {
+		static Thread_Pool pool (thread_count() -1); // the calling thread is the remaining one
+		return pool;
+	}
+
+	// Split [0,count) into contiguous ranges and call  func(sptr begin, sptr end)  once per range, the ranges run on the calling thread and the workers of thread_pool()
+	// min_per_thread: dont split into ranges smaller than this, handing work to other threads is not free so small jobs should just run on the calling thread
+	// func has to be safe to call concurrently on disjoint ranges
+	template <typename FUNC>
+	void parallel_for (sptr count, FUNC func, sptr min_per_thread=1) {
+		if (count <= 0)
+			return;
+
+		sptr threads = std::min((sptr)thread_count(), count / std::max(min_per_thread, (sptr)1));
+		if (threads <= 1) {
+			func((sptr)0, count);
+			return;
+		}
+
+		struct Ctx {
+			FUNC*	func;
+			sptr	count;
+			sptr	threads;
+		};
+		Ctx ctx = { &func, count, threads };
+
+		Thread_Pool::Job job;
+		job.run = [] (void* p, sptr i) {
+			auto& c = *(Ctx*)p;
+			(*c.func)(c.count * i / c.threads, c.count * (i +1) / c.threads);
+		};
+		job.ctx = &ctx;
+		job.ranges = threads;
+
+		thread_pool().run(&job, (int)threads -1);
+	}
+
+	// Thread safe fifo with a max size, for connecting stages of a pipeline
+	// push blocks while the queue is full, pop blocks while it is empty
+	// once the producers are done they call close(), after which pop returns false as soon as the queue is drained
+	template <typename T>
+	class Bounded_Queue {
+		NO_MOVE_COPY_CLASS(Bounded_Queue)
+
+		std::mutex				mutex;
+		std::condition_variable	not_full;
+		std::condition_variable	not_empty;
+		std::deque<T>			queue;
+		uptr					capacity = 1;
+		bool					closed = false;
+
+	public:
+		Bounded_Queue (uptr capacity): capacity{std::max(capacity, (uptr)1)} {}
+
+		bool push (T val) { // returns false if the queue was closed, val is dropped then
+			std::unique_lock<std::mutex> lock(mutex);
+			not_full.wait(lock, [&] () { return queue.size() < capacity || closed; });
+			if (closed)
+				return false;
+
+			queue.push_back(std::move(val));
+			not_empty.notify_one();
+			return true;
+		}
+
+		bool pop (T* val) {
+			std::unique_lock<std::mutex> lock(mutex);
+			not_empty.wait(lock, [&] () { return !queue.empty() || closed; });
+			if (queue.empty())
+				return false;
+
+			*val = std::move(queue.front());
+			queue.pop_front();
+			not_full.notify_one();
+			return true;
+		}
+
+		void close () {
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+			not_full.notify_all();
+			not_empty.notify_all();
+		}
+	};
+}
+using parallel::parallel_for;
+using parallel::Bounded_Queue;
@@ -0,0 +1,407 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+
+#include "basic_typedefs.hpp"
+#include "float_precision.hpp"
+#include "preprocessor_stuff.hpp"
+#include "string.hpp"
+#include "simple_file_io.hpp"
+
+// Scoped zone profiler
+//  { PROFILE_SCOPED("meshify"); ... }  records a zone on the calling thread, zones nest
+//  every thread writes into its own ring buffer without locking, profiler::frame() (called once per frame on the main thread) collects them
+//  into a per thread tree of zones with call count, total and self time of the last frame and a smoothed average
+//  recorded frames can be written out as a chrome trace json (open in chrome://tracing or ui.perfetto.dev)
+namespace profiler {
+	using namespace basic_typedefs;
+	using namespace float_precision;
+	using string::prints;
+
+	u64 now_ns () {
+		return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	struct Event {
+		cstr	name; // only the pointer is recorded, so it has to stay valid (string literals)
+		u64		begin; // ns
+		u64		end;
+		u32		depth; // nesting level on its thread
+		u32		tid; // set by push(), a buffer is reused by other threads over time, so the events have to remember which one recorded them
+	};
+
+	// Single producer (the owning thread) single consumer (Profiler::frame) ring buffer, pushing never blocks, events are dropped if the buffer is full
+	struct Thread_Buffer {
+		static constexpr u32 CAPACITY = 1 << 13; // power of two
+
+		Event				events[CAPACITY];
+		std::atomic<u64>	head {0}; // only written by the producer
+		std::atomic<u64>	tail {0}; // only written by the consumer
+		std::atomic<u64>	dropped {0};
+
+		u32					depth = 0; // only used by the owning thread
+
+		u32					indx; // into Profiler::zones
+		u32					tid; // of the thread currently owning the buffer, unique over the lifetime of the profiler, tid in the trace
+		std::string			name;
+		bool				in_use; // buffers of exited threads get reused, so spawning threads over and over does not keep allocating buffers
+
+		void push (Event const& e) {
+			u64 h = head.load(std::memory_order_relaxed);
+			if (h -tail.load(std::memory_order_acquire) >= CAPACITY) {
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			auto& slot = events[h & (CAPACITY -1)];
+			slot = e;
+			slot.tid = tid;
+			head.store(h +1, std::memory_order_release);
+		}
+
+		template <typename FUNC>
+		void drain (FUNC func) {
+			u64 t = tail.load(std::memory_order_relaxed);
+			u64 h = head.load(std::memory_order_acquire);
+			for (; t != h; ++t)
+				func(events[t & (CAPACITY -1)]);
+			tail.store(t, std::memory_order_release);
+		}
+	};
+
+	// Aggregated zones of one thread, children are identified by their parent and name
+	struct Zone_Node {
+		cstr				name;
+		std::vector<u32>	children;
+
+		// last frame
+		u32					calls = 0;
+		u64					total_ns = 0;
+		u64					self_ns = 0;
+
+		// exponential moving average over frames
+		flt					avg_total_ms = 0;
+		flt					avg_self_ms = 0;
+	};
+	struct Thread_Zones {
+		std::vector<Zone_Node>	nodes; // [0] is the root (whole thread)
+		u32						tid = (u32)-1; // thread the zones are of
+
+		u32 get_child (u32 parent, cstr name) {
+			for (u32 c : nodes[parent].children)
+				if (nodes[c].name == name || strcmp(nodes[c].name, name) == 0)
+					return c;
+			u32 indx = (u32)nodes.size();
+			nodes[parent].children.push_back(indx);
+			nodes.emplace_back();
+			nodes.back().name = name;
+			return indx;
+		}
+	};
+
+	u32 thread_buffer_tid ();
+
+	class Profiler {
+		NO_MOVE_COPY_CLASS(Profiler)
+
+		std::mutex									threads_mutex; // protects the list and the names, not the buffers
+		std::vector< std::unique_ptr<Thread_Buffer> >	threads; // never freed, only reused
+		std::vector<std::string>					tid_names; // [tid], names of exited threads are kept for the trace
+
+		std::vector<Event>							frame_events; // temp
+
+		struct Frame_Marker {
+			u64		t;
+			u32		tid; // thread that called frame()
+		};
+		std::vector<Event>							trace;
+		std::vector<Frame_Marker>					trace_frames;
+
+	public:
+		std::vector<Thread_Zones>					zones; // per thread, only touched by frame() and readers on the same thread
+
+		flt											avg_alpha = 0.05f; // weight of the newest frame in the averages
+		bool										recording = false;
+		uptr										max_trace_events = 4 << 20; // recording stops if reached
+
+		Thread_Buffer* register_thread () {
+			std::lock_guard<std::mutex> lock(threads_mutex);
+
+			Thread_Buffer* buf = nullptr;
+			for (auto& t : threads) {
+				if (!t->in_use) {
+					buf = t.get(); // events of the previous thread that are still in the buffer keep its tid
+					break;
+				}
+			}
+			if (!buf) {
+				threads.emplace_back(new Thread_Buffer);
+				buf = threads.back().get();
+				buf->indx = (u32)threads.size() -1;
+			}
+
+			buf->in_use = true;
+			buf->depth = 0;
+			buf->tid = (u32)tid_names.size();
+			buf->name = prints("thread %u", buf->tid);
+			tid_names.push_back(buf->name);
+			return buf;
+		}
+		// a track that is not a thread, for events that are measured elsewhere (gpu timings), events have to be pushed by one thread only
+		Thread_Buffer* register_track (cstr name) {
+			auto* buf = register_thread(); // never released
+			set_thread_name(buf, name);
+			return buf;
+		}
+		void release_thread (Thread_Buffer* buf) {
+			std::lock_guard<std::mutex> lock(threads_mutex);
+			buf->in_use = false;
+		}
+
+		// frame marker, collects the events of all threads recorded since the last call
+		void frame () {
+			u64 now = now_ns();
+
+			u32 frame_tid = thread_buffer_tid();
+
+			std::vector<Thread_Buffer*> bufs;
+			std::vector<u32> tids;
+			{
+				std::lock_guard<std::mutex> lock(threads_mutex);
+				for (auto& t : threads) {
+					bufs.push_back(t.get());
+					tids.push_back(t->tid);
+				}
+			}
+
+			while (zones.size() < bufs.size())
+				zones.emplace_back();
+
+			for (uptr i=0; i<bufs.size(); ++i) {
+				if (zones[i].tid != tids[i]) { // buffer was reused by another thread, start a new tree
+					zones[i] = Thread_Zones();
+					zones[i].tid = tids[i];
+				}
+
+				frame_events.clear();
+				bufs[i]->drain([&] (Event const& e) {
+					if (recording)
+						trace.push_back(e);
+					if (e.tid == tids[i]) // leftovers of the previous owner only go into the trace
+						frame_events.push_back(e);
+				});
+
+				_aggregate(&zones[i], &frame_events);
+			}
+
+			if (recording) {
+				trace_frames.push_back({ now, frame_tid });
+				if (trace.size() >= max_trace_events)
+					recording = false;
+			}
+		}
+
+		void _aggregate (Thread_Zones* tz, std::vector<Event>* events) {
+			if (tz->nodes.size() == 0) {
+				tz->nodes.emplace_back();
+				tz->nodes[0].name = "";
+			}
+
+			for (auto& n : tz->nodes) {
+				n.calls = 0;
+				n.total_ns = 0;
+				n.self_ns = 0;
+			}
+
+			// events are pushed when zones end, so children come before their parents, restore begin order (parents first on ties)
+			std::sort(events->begin(), events->end(), [] (Event const& l, Event const& r) {
+				return l.begin != r.begin ? l.begin < r.begin : l.depth < r.depth;
+			});
+
+			struct Open { u32 node; u32 depth; };
+			std::vector<Open> stack;
+
+			for (auto& e : *events) {
+				while (stack.size() > 0 && stack.back().depth >= e.depth)
+					stack.pop_back();
+				u32 parent = stack.size() > 0 ? stack.back().node : 0; // zones whose parent started in an earlier frame end up at the root
+
+				u32 n = tz->get_child(parent, e.name);
+				auto& node = tz->nodes[n];
+
+				u64 dur = e.end -e.begin;
+				node.calls++;
+				node.total_ns += dur;
+				node.self_ns += dur;
+				if (parent != 0)
+					tz->nodes[parent].self_ns -= std::min(dur, tz->nodes[parent].self_ns); // parent sorts first, so it was already added
+
+				stack.push_back({ n, e.depth });
+			}
+
+			auto& root = tz->nodes[0];
+			root.total_ns = 0;
+			for (u32 c : root.children)
+				root.total_ns += tz->nodes[c].total_ns;
+
+			for (auto& n : tz->nodes) {
+				n.avg_total_ms += ((flt)n.total_ns * 1e-6f -n.avg_total_ms) * avg_alpha;
+				n.avg_self_ms += ((flt)n.self_ns * 1e-6f -n.avg_self_ms) * avg_alpha;
+			}
+		}
+
+		void set_thread_name (Thread_Buffer* buf, cstr name) {
+			std::lock_guard<std::mutex> lock(threads_mutex);
+			buf->name = name;
+			tid_names[buf->tid] = name;
+		}
+		std::string thread_name (uptr thread) {
+			std::lock_guard<std::mutex> lock(threads_mutex);
+			return threads[thread]->name;
+		}
+		u64 dropped_events () {
+			std::lock_guard<std::mutex> lock(threads_mutex);
+			u64 count = 0;
+			for (auto& t : threads)
+				count += t->dropped.load(std::memory_order_relaxed);
+			return count;
+		}
+
+		//// chrome trace
+		static void _json_escape (std::string* out, cstr s) {
+			for (; *s; ++s) {
+				char c = *s;
+				if (c == '"' || c == '\\') {
+					*out += '\\';
+					*out += c;
+				} else if ((unsigned char)c < 0x20) {
+					prints(out, "\\u%04x", (unsigned)c);
+				} else {
+					*out += c;
+				}
+			}
+		}
+
+		void start_recording () {
+			trace.clear();
+			trace_frames.clear();
+			recording = true;
+		}
+		uptr recorded_events () { return trace.size(); }
+
+		// writes everything recorded since start_recording() and stops recording
+		bool write_chrome_trace (cstr filepath) {
+			recording = false;
+
+			u64 t0 = (u64)-1;
+			for (auto& f : trace_frames)
+				t0 = std::min(t0, f.t);
+			for (auto& e : trace)
+				t0 = std::min(t0, e.begin);
+
+			std::string json = "{\"traceEvents\":[\n";
+
+			{
+				std::lock_guard<std::mutex> lock(threads_mutex);
+				for (u32 tid=0; tid<(u32)tid_names.size(); ++tid) {
+					prints(&json, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"", tid);
+					_json_escape(&json, tid_names[tid].c_str());
+					json += "\"}},\n";
+				}
+			}
+
+			for (uptr i=0; i<trace_frames.size(); ++i)
+				prints(&json, "{\"name\":\"frame %llu\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":%u,\"ts\":%.3f},\n",
+					(unsigned long long)i, trace_frames[i].tid, (double)(trace_frames[i].t -t0) / 1000);
+
+			for (auto& e : trace) {
+				json += "{\"name\":\"";
+				_json_escape(&json, e.name);
+				prints(&json, "\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f},\n",
+					e.tid, (double)(e.begin -t0) / 1000, (double)(e.end -e.begin) / 1000);
+			}
+
+			if (json.back() == '\n' && json[json.size() -2] == ',')
+				json.erase(json.size() -2, 1); // no trailing comma in json
+			json += "]}\n";
+
+			return simple_file_io::write_text_file(filepath, json);
+		}
+	};
+
+	Profiler& get_profiler () {
+		static Profiler p;
+		return p;
+	}
+
+	struct _Thread_Buffer_Owner {
+		Thread_Buffer* buf = nullptr;
+		~_Thread_Buffer_Owner () { // on thread exit
+			if (buf)
+				get_profiler().release_thread(buf);
+		}
+	};
+
+	Thread_Buffer* thread_buffer () {
+		thread_local _Thread_Buffer_Owner owner;
+		if (!owner.buf)
+			owner.buf = get_profiler().register_thread();
+		return owner.buf;
+	}
+
+	// tid of the calling thread in the trace
+	u32 thread_buffer_tid () {
+		return thread_buffer()->tid;
+	}
+
+	// name shown in the profiler and the trace for the calling thread
+	void set_thread_name (cstr name) {
+		get_profiler().set_thread_name(thread_buffer(), name);
+	}
+
+	// call once per frame on the main thread
+	void frame () {
+		get_profiler().frame();
+	}
+
+	// RAII zone, can be ended early with end(), which returns the duration (so it can replace a Timer)
+	class Zone {
+		Thread_Buffer*	buf;
+		cstr			name;
+		u64				begin;
+		u32				depth;
+		bool			ended = false;
+
+	public:
+		Zone (cstr name): buf{thread_buffer()}, name{name} {
+			depth = buf->depth++;
+			begin = now_ns();
+		}
+		~Zone () {
+			end();
+		}
+
+		Zone (Zone const&) = delete;
+		Zone& operator= (Zone const&) = delete;
+
+		flt end () { // returns seconds
+			if (ended)
+				return 0;
+			ended = true;
+
+			u64 e = now_ns();
+			buf->depth--;
+			buf->push({ name, begin, e, depth, 0 }); // tid is filled in by push()
+			return (flt)(e -begin) * 1e-9f;
+		}
+	};
+}
+
+#define _PROFILE_SCOPED(name, counter) profiler::Zone CONCAT(_profile_zone, counter) (name)
+#define PROFILE_SCOPED(name) _PROFILE_SCOPED(name, __COUNTER__) // name has to be a string literal
@@ -5,38 +5,123 @@
 #include "float_precision.hpp"
 
 #include <random>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
 
-#include "time.h"
 #include "assert.h"
 
-namespace random {
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+	#define RANDOM_SSE2 1
+	#include "emmintrin.h"
+#else
+	#define RANDOM_SSE2 0
+#endif
+
+// xoshiro256** generator (http://prng.di.unimi.it/), small state, fast and no std::*_distribution objects per call
+//  independent streams:
+//   per thread: split() hands out non-overlapping subsequences (2^128 numbers apart)
+//   per chunk etc.: Generator(seed, stream) gives a reproducible stream per key, independent of the order the keys are visited in
+//  fill_uniform / fill_normal generate whole buffers 4 lanes at a time with SSE2
+// n_ like n_find_files, posix stdlib.h declares a global random() that a namespace random would clash with
+namespace n_random {
 	using namespace basic_typedefs;
 	using namespace vector;
 	using namespace float_precision;
 
+	inline u64 _splitmix64 (u64* x) {
+		u64 z = (*x += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+	inline u64 _rotate_left (u64 x, int k) {
+		return (x << k) | (x >> (64 -k));
+	}
+
 	struct Generator {
-		std::default_random_engine generator;
+		u64		s[4];
 
-		Generator (): generator{ get_rand_seed() } {} // random seed
-		Generator (uint seed): generator{seed} {} // seed with value
-		Generator (int seed): Generator((uint)seed) {} // seed with value
+		flt		normal_spare; // box-muller generates normals in pairs
+		bool	has_normal_spare = false;
+
+		Generator (): Generator((u64)get_rand_seed()) {} // random seed
+		Generator (u64 seed, u64 stream=0) { // seed with value (any integer type), different streams of the same seed are independent
+			u64 x = stream;
+			x = seed ^ _splitmix64(&x);
+			for (int i=0; i<4; ++i)
+				s[i] = _splitmix64(&x);
+		}
 
 		static int get_rand_seed () {
-			//return (int)time(NULL); // only ticks every second!!
+			static std::atomic<u64> counter {0}; // so generators seeded in the same clock tick still differ
+			u64 x = (u64)std::chrono::high_resolution_clock::now().time_since_epoch().count() ^ (counter++ << 32);
+			return (int)_splitmix64(&x);
+		}
+
+		u64 next () {
+			u64 result = _rotate_left(s[1] * 5, 7) * 9;
+			u64 t = s[1] << 17;
+
+			s[2] ^= s[0];
+			s[3] ^= s[1];
+			s[1] ^= s[2];
+			s[0] ^= s[3];
+			s[2] ^= t;
+			s[3] = _rotate_left(s[3], 45);
+
+			return result;
+		}
+
+		u32 next_u32 () {
+			return (u32)(next() >> 32);
+		}
+		flt next_flt () { // [0,1)
+			return (flt)(next() >> 40) * (1.0f / (1 << 24));
+		}
 
-			LARGE_INTEGER li;
-			QueryPerformanceCounter(&li);
-			return (int)li.QuadPart;
+		// advance by 2^128 numbers
+		void jump () {
+			static constexpr u64 JUMP[] = { 0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c };
+			_jump(JUMP);
+		}
+		// advance by 2^192 numbers
+		void long_jump () {
+			static constexpr u64 JUMP[] = { 0x76e15d3efefdcbbf, 0xc5004e441c522fb3, 0x77710069854ee241, 0x39109bb02acbe635 };
+			_jump(JUMP);
+		}
+		void _jump (u64 const* poly) {
+			u64 t[4] = {};
+			for (int i=0; i<4; ++i) {
+				for (int b=0; b<64; ++b) {
+					if (poly[i] & (1ull << b)) {
+						t[0] ^= s[0];
+						t[1] ^= s[1];
+						t[2] ^= s[2];
+						t[3] ^= s[3];
+					}
+					next();
+				}
+			}
+			memcpy(s, t, sizeof(s));
+		}
+
+		// returns a generator for another thread, the streams of successive splits do not overlap
+		Generator split () {
+			Generator g = *this;
+			g.has_normal_spare = false;
+			jump();
+			return g;
 		}
 	};
 
-	Generator global_generator = Generator();
+	Generator global_generator = Generator(); // not thread safe, use split() or Generator(seed, stream) for threads
 
 	// chance
 	int chance (Generator& generator, flt prob=0.5f) {
-		std::bernoulli_distribution	distribution (prob);
-
-		return distribution(generator.generator);
+		return generator.next_flt() < prob;
 	}
 	bool chance (flt prob=0.5f) {							return chance(global_generator, prob) ? 1 : 0; }
 
@@ -44,9 +129,15 @@ namespace random {
 	int uniform (Generator& generator, int min, int max) {
 		assert(max > min);
 
-		std::uniform_int_distribution<int>	distribution (min, max -1);
-
-		return distribution(generator.generator);
+		// multiply-shift range reduction with rejection of the biased values (Lemire)
+		u32 range = (u32)max -(u32)min;
+		u64 m = (u64)generator.next_u32() * range;
+		if ((u32)m < range) {
+			u32 threshold = (0u -range) % range;
+			while ((u32)m < threshold)
+				m = (u64)generator.next_u32() * range;
+		}
+		return (int)((u32)min +(u32)(m >> 32));
 	}
 	int uniform (int min, int max) {						return uniform(global_generator, min,max); }
 
@@ -60,9 +151,8 @@ namespace random {
 	flt uniform (Generator& generator, flt min, flt max) {
 		assert(max > min);
 
-		std::uniform_real_distribution<flt>	distribution (min, max);
-
-		return distribution(generator.generator);
+		flt f = min +generator.next_flt() * (max -min);
+		return f < max ? f : std::nextafter(max, min); // the multiply-add can round up to max for next_flt() close to 1
 	}
 	flt uniform (flt min, flt max) {						return uniform(global_generator, min,max); }
 
@@ -71,16 +161,140 @@ namespace random {
 
 	v2 uniform (Generator& generator, v2 min, v2 max) {		return v2(	uniform(generator, min.x, max.x), uniform(generator, min.y, max.y) ); }
 	v2 uniform (v2 min, v2 max) {							return uniform(global_generator, min,max); }
-	
+
 	//
+	inline void _box_muller (flt u0, flt u1, flt* n0, flt* n1) { // u0,u1 in [0,1)
+		flt r = std::sqrt(-2 * std::log(1 -u0)); // 1-u0 in (0,1]
+		flt a = u1 * (2 * PI);
+		*n0 = r * std::cos(a);
+		*n1 = r * std::sin(a);
+	}
+
 	flt normal (Generator& generator, flt stddev, flt mean=0) {
-		std::normal_distribution<flt>	distribution (mean, stddev);
+		if (generator.has_normal_spare) {
+			generator.has_normal_spare = false;
+			return generator.normal_spare * stddev +mean;
+		}
 
-		return distribution(generator.generator);
+		flt n0, n1;
+		_box_muller(generator.next_flt(), generator.next_flt(), &n0, &n1);
+		generator.normal_spare = n1;
+		generator.has_normal_spare = true;
+		return n0 * stddev +mean;
 	}
 	flt normal (flt stddev, flt mean=0) {					return normal(global_generator, stddev,mean); }
 
 	v2 normal (Generator& generator, v2 stddev, v2 mean=0) {	return v2( normal(generator, stddev.x,mean.x), normal(generator, stddev.y,mean.y) ); }
 	v2 normal (v2 stddev, v2 mean=0) {							return normal(global_generator, stddev,mean); }
 
+	//// Batch generation
+
+	// 4 xoshiro256** generators run in lockstep, seeded from the generator passed to fill_*, so the output only depends on that generator
+	struct _Lanes {
+		static constexpr int LANES = 4;
+		static constexpr int BLOCK = LANES * 2; // floats per step, each u64 gives two 24 bit floats
+
+	#if RANDOM_SSE2
+		__m128i	s[4][2]; // [state word][lanes 0-1, lanes 2-3]
+
+		_Lanes (Generator& g) {
+			alignas(16) u64 tmp[4][LANES];
+			for (int l=0; l<LANES; ++l) {
+				u64 x = g.next();
+				for (int i=0; i<4; ++i)
+					tmp[i][l] = _splitmix64(&x);
+			}
+			for (int i=0; i<4; ++i) {
+				s[i][0] = _mm_load_si128((__m128i*)&tmp[i][0]);
+				s[i][1] = _mm_load_si128((__m128i*)&tmp[i][2]);
+			}
+		}
+
+		static __m128i _rotate_left (__m128i x, int k) {
+			return _mm_or_si128(_mm_slli_epi64(x, k), _mm_srli_epi64(x, 64 -k));
+		}
+		static __m128i _next (__m128i* s0, __m128i* s1, __m128i* s2, __m128i* s3) {
+			__m128i x5 = _mm_add_epi64(_mm_slli_epi64(*s1, 2), *s1); // *5, SSE2 has no 64 bit multiply
+			__m128i r = _rotate_left(x5, 7);
+			__m128i result = _mm_add_epi64(_mm_slli_epi64(r, 3), r); // *9
+			__m128i t = _mm_slli_epi64(*s1, 17);
+
+			*s2 = _mm_xor_si128(*s2, *s0);
+			*s3 = _mm_xor_si128(*s3, *s1);
+			*s1 = _mm_xor_si128(*s1, *s2);
+			*s0 = _mm_xor_si128(*s0, *s3);
+			*s2 = _mm_xor_si128(*s2, t);
+			*s3 = _rotate_left(*s3, 45);
+
+			return result;
+		}
+
+		// writes BLOCK floats in [min,max], clamped to below_max (the largest flt < max), since the multiply-add can round up to max
+		void next_block (flt* out, flt min, flt scale, flt below_max) {
+			__m128 scale4 = _mm_set1_ps(scale);
+			__m128 offs = _mm_set1_ps(min);
+			__m128 upper = _mm_set1_ps(below_max);
+			for (int h=0; h<2; ++h) {
+				__m128i r = _next(&s[0][h], &s[1][h], &s[2][h], &s[3][h]);
+				__m128 f = _mm_cvtepi32_ps(_mm_srli_epi32(r, 8)); // top 24 bits of both u32 halves
+				_mm_storeu_ps(out +h*4, _mm_min_ps(_mm_add_ps(_mm_mul_ps(f, scale4), offs), upper));
+			}
+		}
+	#else
+		Generator	g[LANES];
+
+		_Lanes (Generator& gen) {
+			for (int l=0; l<LANES; ++l) {
+				u64 x = gen.next();
+				for (int i=0; i<4; ++i)
+					g[l].s[i] = _splitmix64(&x);
+			}
+		}
+
+		void next_block (flt* out, flt min, flt scale, flt below_max) {
+			for (int l=0; l<LANES; ++l) {
+				u64 r = g[l].next();
+				int h = l / 2, i = (l % 2) * 2; // same layout as the sse version
+				out[h*4 +i +0] = std::min((flt)((u32)(r      ) >> 8) * scale +min, below_max);
+				out[h*4 +i +1] = std::min((flt)((u32)(r >> 32) >> 8) * scale +min, below_max);
+			}
+		}
+	#endif
+	};
+
+	// fill out[count] with uniform floats in [min,max)
+	void fill_uniform (Generator& generator, flt* out, uptr count, flt min=0, flt max=1) {
+		assert(max > min);
+
+		_Lanes lanes (generator);
+
+		flt scale = (max -min) * (1.0f / (1 << 24));
+		flt below_max = std::nextafter(max, min);
+
+		uptr i = 0;
+		for (; i +_Lanes::BLOCK <= count; i += _Lanes::BLOCK)
+			lanes.next_block(out +i, min, scale, below_max);
+
+		if (i < count) {
+			flt tmp[_Lanes::BLOCK];
+			lanes.next_block(tmp, min, scale, below_max);
+			memcpy(out +i, tmp, (count -i) * sizeof(flt));
+		}
+	}
+	void fill_uniform (flt* out, uptr count, flt min=0, flt max=1) {	fill_uniform(global_generator, out, count, min, max); }
+
+	// fill out[count] with normal distributed floats
+	void fill_normal (Generator& generator, flt* out, uptr count, flt stddev=1, flt mean=0) {
+		fill_uniform(generator, out, count & ~(uptr)1);
+
+		for (uptr i=0; i +1 < count; i += 2) {
+			flt n0, n1;
+			_box_muller(out[i], out[i +1], &n0, &n1);
+			out[i   ] = n0 * stddev +mean;
+			out[i +1] = n1 * stddev +mean;
+		}
+		if (count % 2)
+			out[count -1] = normal(generator, stddev, mean);
+	}
+	void fill_normal (flt* out, uptr count, flt stddev=1, flt mean=0) {	fill_normal(global_generator, out, count, stddev, mean); }
 }
@@ -7,6 +7,16 @@
 #include "basic_typedefs.hpp"
 #include "defer.hpp"
 
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN 1
+	#include "windows.h"
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
 namespace simple_file_io {
 	using namespace basic_typedefs;
 
@@ -78,6 +88,79 @@ namespace simple_file_io {
 		return true;
 	}
 
+	// Read only mapping of a whole file, to use it in place instead of reading it into a Blob first
+	class Mapped_File {
+		MOVE_ONLY_CLASS(Mapped_File)
+
+	public:
+		void const*	data = nullptr; // page aligned
+		uptr		size = 0;
+
+		~Mapped_File () {
+			if (data) {
+			#ifdef _WIN32
+				UnmapViewOfFile(data);
+			#else
+				munmap((void*)data, size);
+			#endif
+			}
+		}
+	};
+	void swap (Mapped_File& l, Mapped_File& r) {
+		std::swap(l.data, r.data);
+		std::swap(l.size, r.size);
+	}
+
+	// fails for empty files, since those can not be mapped
+	bool map_file (cstr filepath, Mapped_File* file) {
+		Mapped_File tmp;
+
+	#ifdef _WIN32
+		HANDLE f = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (f == INVALID_HANDLE_VALUE)
+			return false;
+		defer {
+			CloseHandle(f); // the view keeps the file and the mapping alive
+		};
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(f, &size) || size.QuadPart == 0)
+			return false;
+
+		HANDLE mapping = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (!mapping)
+			return false;
+		defer {
+			CloseHandle(mapping);
+		};
+
+		tmp.data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!tmp.data)
+			return false;
+		tmp.size = (uptr)size.QuadPart;
+	#else
+		int fd = open(filepath, O_RDONLY|O_CLOEXEC);
+		if (fd < 0)
+			return false;
+		defer {
+			close(fd); // the mapping keeps the file alive
+		};
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0)
+			return false;
+
+		void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED)
+			return false;
+		tmp.data = data;
+		tmp.size = (uptr)st.st_size;
+	#endif
+
+		*file = std::move(tmp);
+		return true;
+	}
+
 	bool load_fixed_size_binary_file (cstr filepath, void* data, uptr sz) {
 
 		FILE* f = fopen(filepath, "rb");
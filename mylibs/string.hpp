@@ -17,7 +17,10 @@ namespace string {
 	inline void vprints (std::string* s, cstr format, va_list vl) { // print 
 		size_t old_size = s->size();
 		for (;;) {
-			auto ret = vsnprintf(&(*s)[old_size], s->size() -old_size +1, format, vl); // i think i'm technically not allowed to overwrite the null terminator
+			va_list vl_copy; // vl can only be used once on some platforms (gcc x64), but we might need two tries
+			va_copy(vl_copy, vl);
+			auto ret = vsnprintf(&(*s)[old_size], s->size() -old_size +1, format, vl_copy); // i think i'm technically not allowed to overwrite the null terminator
+			va_end(vl_copy);
 			ret = MAX(0, ret);
 			bool was_bienough = (u32)ret < (s->size() -old_size +1);
 			s->resize(old_size +(u32)ret);
@@ -60,6 +63,7 @@ namespace string {
 		return is_lower(c) ? c +('A' -'a') : c;
 	}
 
+	#ifdef _WIN32 // needs windows.h
 	std::basic_string<wchar_t> utf8_to_wchar (std::string const& utf8) {
 
 		// overallocate, this might be more performant than having to process the utf8 twice
@@ -105,4 +109,5 @@ namespace string {
 				
 		*/
 	}
+	#endif
 }
@@ -2,41 +2,31 @@
 
 #include "basic_typedefs.hpp"
 #include "float_precision.hpp"
-#include "windows.h"
-#include "assert.h"
 
-namespace QPC {
+#include <chrono>
+
+// steady_clock is QueryPerformanceCounter on windows and clock_gettime(CLOCK_MONOTONIC) on linux
+namespace timer {
 	using namespace basic_typedefs;
 	using namespace float_precision;
 
-	u64 get_freq () {
-		u64 val;
-		assert(QueryPerformanceFrequency((LARGE_INTEGER*)&val));
-		return val;
-	}
-	u64 get_timestemp () {
-		u64 val;
-		assert(QueryPerformanceCounter((LARGE_INTEGER*)&val));
-		return val;
-	}
+	typedef std::chrono::steady_clock clock;
 
-	u64 freq = get_freq();
+	inline flt seconds_between (clock::time_point a, clock::time_point b) {
+		return std::chrono::duration<flt>(b -a).count();
+	}
 
 	struct Timer {
 
-		u64 begin;
+		clock::time_point begin;
 		flt seconds;
 
 		void start () {
-			begin = get_timestemp();
+			begin = clock::now();
 		}
 
 		flt end () {
-			u64 now = get_timestemp();
-
-			u64 delta = now -begin;
-
-			seconds = (flt)delta / (flt)freq;
+			seconds = seconds_between(begin, clock::now());
 			return seconds;
 		}
 
@@ -44,19 +34,17 @@ namespace QPC {
 
 	struct Delta_Time_Measure {
 
-		u64 prev_frame_end;
+		clock::time_point prev_frame_end;
 
 		flt begin () { // call one before frame loop
-			prev_frame_end = get_timestemp();
+			prev_frame_end = clock::now();
 			return 0; // zero dt on first frame, timestep calc should be able to handle this
 		}
 
 		flt frame () { // call after first frame
-			u64 now = get_timestemp();
-
-			u64 dt_ticks = now -prev_frame_end;
+			auto now = clock::now();
 
-			flt dt = (flt)dt_ticks / (flt)freq;
+			flt dt = seconds_between(prev_frame_end, now);
 
 			prev_frame_end = now;
 			return dt;
@@ -64,5 +52,5 @@ namespace QPC {
 
 	};
 }
-using QPC::Timer;
-using QPC::Delta_Time_Measure;
+using timer::Timer;
+using timer::Delta_Time_Measure;
@@ -2,6 +2,7 @@
 #include "basic_typedefs.hpp"
 #include "math.hpp"
 #include "preprocessor_stuff.hpp" // for BOOL_XOR
+#include "vector_simd.hpp"
 
 namespace vector {
 	using namespace basic_typedefs;
@@ -209,13 +210,23 @@ namespace vector {
 
 	INL HM convert_to_hm (QUAT q) { return HM(convert_to_m3(q)); }
 
-	INL V3 operator* (QUAT q, V3 v) { // not tested
+	INL V3 operator* (QUAT q, V3 v) { // q has to be normalized
+	#if VECTOR_SIMD
+		f4 qv = f4_load(&q.x);
+		f4 vv = f4_load3(&v.x);
+		f4 uv = f4_cross3(qv, vv);
+		f4 uuv = f4_cross3(qv, uv);
 
+		V3 ret;
+		f4_store3(&ret.x, f4_madd(f4_madd(uv, f4_splat_w(qv), uuv), f4_set1(2), vv));
+		return ret;
+	#else
 		V3 l_vec = q.xyz();
 		V3 uv = cross(l_vec, v);
 		V3 uuv = cross(l_vec, uv);
 
 		return v + (uv * q.w +uuv) * 2;
+	#endif
 	}
 
 	INL QUAT operator* (QUAT l, QUAT r) {
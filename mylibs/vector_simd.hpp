@@ -0,0 +1,169 @@
+#pragma once
+
+// Opt-in SIMD implementation of M4 * V4 (and so M4 * M4), quat * V3 and the batch transforms / inverses in matricies.hpp
+//  the other ops (HM, quat * quat, elementwise vector ops) measured no faster than what the compiler makes of the scalar code, so they stay scalar
+//  #define VECTOR_SIMD 1  before including vector.hpp (or in the project settings) to enable it, SSE on x86, NEON on arm
+//  with AVX2 or FMA enabled in the compiler settings multiply-adds are fused (results can differ from the scalar code in the last bit)
+//  the vector and matrix types keep their layout (no alignment requirements), so values are loaded and stored unaligned
+//  the helpers only work on float pointers so that they can be defined before the vector types
+
+#ifndef VECTOR_SIMD
+	#define VECTOR_SIMD 0
+#endif
+
+#define VECTOR_SIMD_SSE		0
+#define VECTOR_SIMD_NEON	0
+#define VECTOR_SIMD_FMA		0
+
+#if VECTOR_SIMD
+	#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+		#undef VECTOR_SIMD_SSE
+		#define VECTOR_SIMD_SSE 1
+		#if defined(__FMA__) || defined(__AVX2__)
+			#undef VECTOR_SIMD_FMA
+			#define VECTOR_SIMD_FMA 1
+			#include "immintrin.h"
+		#else
+			#include "emmintrin.h"
+		#endif
+	#elif defined(__ARM_NEON) || defined(_M_ARM64)
+		#undef VECTOR_SIMD_NEON
+		#define VECTOR_SIMD_NEON 1
+		#include "arm_neon.h"
+	#else
+		#undef VECTOR_SIMD
+		#define VECTOR_SIMD 0 // not supported on this platform, use the scalar code
+	#endif
+#endif
+
+#if VECTOR_SIMD
+namespace vector {
+
+#if VECTOR_SIMD_SSE
+	typedef __m128 f4;
+
+	FORCEINLINE f4 f4_load (float const* p) {			return _mm_loadu_ps(p); }
+	FORCEINLINE f4 f4_load3 (float const* p) {			return _mm_movelh_ps(_mm_loadl_pi(_mm_setzero_ps(), (__m64 const*)p), _mm_load_ss(p +2)); } // w = 0, does not read p[3]
+	FORCEINLINE void f4_store (float* p, f4 v) {		_mm_storeu_ps(p, v); }
+	FORCEINLINE void f4_store3 (float* p, f4 v) {		_mm_storel_pi((__m64*)p, v); _mm_store_ss(p +2, _mm_movehl_ps(v, v)); } // does not write p[3]
+	FORCEINLINE f4 f4_set1 (float f) {					return _mm_set1_ps(f); }
+
+	FORCEINLINE f4 f4_add (f4 l, f4 r) {				return _mm_add_ps(l, r); }
+	FORCEINLINE f4 f4_sub (f4 l, f4 r) {				return _mm_sub_ps(l, r); }
+	FORCEINLINE f4 f4_mul (f4 l, f4 r) {				return _mm_mul_ps(l, r); }
+	FORCEINLINE f4 f4_div (f4 l, f4 r) {				return _mm_div_ps(l, r); }
+	#if VECTOR_SIMD_FMA
+	FORCEINLINE f4 f4_madd (f4 a, f4 b, f4 c) {		return _mm_fmadd_ps(a, b, c); } // a * b + c
+	#else
+	FORCEINLINE f4 f4_madd (f4 a, f4 b, f4 c) {		return _mm_add_ps(_mm_mul_ps(a, b), c); }
+	#endif
+
+	FORCEINLINE f4 f4_yzxw (f4 v) {					return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3,0,2,1)); }
+	FORCEINLINE f4 f4_splat_w (f4 v) {					return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3,3,3,3)); }
+
+	FORCEINLINE void f4_transpose4 (f4* r0, f4* r1, f4* r2, f4* r3) {
+		_MM_TRANSPOSE4_PS(*r0, *r1, *r2, *r3);
+	}
+
+	// 4 tightly packed 3d vectors <-> one register per component
+	FORCEINLINE void f4_load_soa3 (float const* p, f4* x, f4* y, f4* z) {
+		f4 a = _mm_loadu_ps(p +0); // x0 y0 z0 x1
+		f4 b = _mm_loadu_ps(p +4); // y1 z1 x2 y2
+		f4 c = _mm_loadu_ps(p +8); // z2 x3 y3 z3
+
+		f4 zx = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2,1,3,2)); // z0 x1 z1 x2
+		f4 zz = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1,0,2,1)); // z1 x2 z2 x3
+		f4 ya = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0,0,1,1)); // y0 y0 y1 y1
+		f4 yb = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2,2,3,3)); // y2 y2 y3 y3
+
+		*x = _mm_shuffle_ps(a, zz, _MM_SHUFFLE(3,1,3,0));
+		*y = _mm_shuffle_ps(ya, yb, _MM_SHUFFLE(2,0,2,0));
+		*z = _mm_shuffle_ps(zx, c, _MM_SHUFFLE(3,0,2,0));
+	}
+	FORCEINLINE void f4_store_soa3 (float* p, f4 x, f4 y, f4 z) {
+		f4 xy = _mm_unpacklo_ps(x, y);						// x0 y0 x1 y1
+		f4 zx = _mm_shuffle_ps(z, x, _MM_SHUFFLE(1,1,0,0)); // z0 z0 x1 x1
+		f4 yz = _mm_shuffle_ps(y, z, _MM_SHUFFLE(1,1,1,1)); // y1 y1 z1 z1
+		f4 xy2 = _mm_shuffle_ps(x, y, _MM_SHUFFLE(2,2,2,2)); // x2 x2 y2 y2
+		f4 zx3 = _mm_shuffle_ps(z, x, _MM_SHUFFLE(3,3,2,2)); // z2 z2 x3 x3
+		f4 yz3 = _mm_shuffle_ps(y, z, _MM_SHUFFLE(3,3,3,3)); // y3 y3 z3 z3
+
+		_mm_storeu_ps(p +0, _mm_shuffle_ps(xy, zx, _MM_SHUFFLE(2,0,1,0)));
+		_mm_storeu_ps(p +4, _mm_shuffle_ps(yz, xy2, _MM_SHUFFLE(2,0,2,0)));
+		_mm_storeu_ps(p +8, _mm_shuffle_ps(zx3, yz3, _MM_SHUFFLE(2,0,2,0)));
+	}
+
+#elif VECTOR_SIMD_NEON
+	typedef float32x4_t f4;
+
+	FORCEINLINE f4 f4_load (float const* p) {			return vld1q_f32(p); }
+	FORCEINLINE f4 f4_load3 (float const* p) {			return vcombine_f32(vld1_f32(p), vld1_lane_f32(p +2, vdup_n_f32(0), 0)); }
+	FORCEINLINE void f4_store (float* p, f4 v) {		vst1q_f32(p, v); }
+	FORCEINLINE void f4_store3 (float* p, f4 v) {		vst1_f32(p, vget_low_f32(v)); vst1q_lane_f32(p +2, v, 2); }
+	FORCEINLINE f4 f4_set1 (float f) {					return vdupq_n_f32(f); }
+
+	FORCEINLINE f4 f4_add (f4 l, f4 r) {				return vaddq_f32(l, r); }
+	FORCEINLINE f4 f4_sub (f4 l, f4 r) {				return vsubq_f32(l, r); }
+	FORCEINLINE f4 f4_mul (f4 l, f4 r) {				return vmulq_f32(l, r); }
+	#if defined(__aarch64__) || defined(_M_ARM64)
+	FORCEINLINE f4 f4_div (f4 l, f4 r) {				return vdivq_f32(l, r); }
+	#else
+	FORCEINLINE f4 f4_div (f4 l, f4 r) { // armv7 has no divide, refine the reciprocal estimate
+		f4 inv = vrecpeq_f32(r);
+		inv = vmulq_f32(inv, vrecpsq_f32(r, inv));
+		inv = vmulq_f32(inv, vrecpsq_f32(r, inv));
+		return vmulq_f32(l, inv);
+	}
+	#endif
+	FORCEINLINE f4 f4_madd (f4 a, f4 b, f4 c) {		return vmlaq_f32(c, a, b); } // a * b + c
+
+	FORCEINLINE f4 f4_yzxw (f4 v) {
+		f4 yzwx = vextq_f32(v, v, 1);
+		return vcombine_f32(vget_low_f32(yzwx), vrev64_f32(vget_high_f32(yzwx)));
+	}
+	FORCEINLINE f4 f4_splat_w (f4 v) {					return vdupq_lane_f32(vget_high_f32(v), 1); }
+
+	FORCEINLINE void f4_transpose4 (f4* r0, f4* r1, f4* r2, f4* r3) {
+		float32x4x2_t a = vtrnq_f32(*r0, *r1); // a0 b0 a2 b2 | a1 b1 a3 b3
+		float32x4x2_t b = vtrnq_f32(*r2, *r3); // c0 d0 c2 d2 | c1 d1 c3 d3
+		*r0 = vcombine_f32(vget_low_f32(a.val[0]), vget_low_f32(b.val[0]));
+		*r1 = vcombine_f32(vget_low_f32(a.val[1]), vget_low_f32(b.val[1]));
+		*r2 = vcombine_f32(vget_high_f32(a.val[0]), vget_high_f32(b.val[0]));
+		*r3 = vcombine_f32(vget_high_f32(a.val[1]), vget_high_f32(b.val[1]));
+	}
+
+	FORCEINLINE void f4_load_soa3 (float const* p, f4* x, f4* y, f4* z) {
+		float32x4x3_t v = vld3q_f32(p);
+		*x = v.val[0];
+		*y = v.val[1];
+		*z = v.val[2];
+	}
+	FORCEINLINE void f4_store_soa3 (float* p, f4 x, f4 y, f4 z) {
+		float32x4x3_t v;
+		v.val[0] = x;
+		v.val[1] = y;
+		v.val[2] = z;
+		vst3q_f32(p, v);
+	}
+#endif
+
+	// a.xyz * b.xyz  ->  a.yzx * b.zxy - a.zxy * b.yzx  ==  (a * b.yzx - a.yzx * b).yzx
+	FORCEINLINE f4 f4_cross3 (f4 a, f4 b) {
+		return f4_yzxw( f4_sub(f4_mul(a, f4_yzxw(b)), f4_mul(f4_yzxw(a), b)) );
+	}
+
+	// columns * (x,y,z,w)
+	FORCEINLINE f4 f4_mat4_mul (f4 c0, f4 c1, f4 c2, f4 c3, float const* v) {
+		f4 r = f4_mul(c0, f4_set1(v[0]));
+		r = f4_madd(c1, f4_set1(v[1]), r);
+		r = f4_madd(c2, f4_set1(v[2]), r);
+		return f4_madd(c3, f4_set1(v[3]), r);
+	}
+	// columns * (x,y,z) + t
+	FORCEINLINE f4 f4_mat3_mul (f4 c0, f4 c1, f4 c2, f4 t, float const* v) {
+		f4 r = f4_madd(c0, f4_set1(v[0]), t);
+		r = f4_madd(c1, f4_set1(v[1]), r);
+		return f4_madd(c2, f4_set1(v[2]), r);
+	}
+}
+#endif
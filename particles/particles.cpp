@@ -21,9 +21,10 @@ struct Particles {
 	
 	int						count = 2000;
 	std::vector<Particle>	particles;
+	std::vector<Interpolated<v2>>	render_pos; // pos after the last two ticks, drawn in between with fixed_step.alpha()
 	flt						size = 0.5f;
 
-	random::Generator		rand;
+	n_random::Generator		rand;
 	bool					random_seed = true;
 	int						seed = 0;
 
@@ -36,16 +37,17 @@ struct Particles {
 
 	void respawn_particles () {
 		if (random_seed)
-			seed = random::Generator::get_rand_seed();
+			seed = n_random::Generator::get_rand_seed();
 
-		rand = random::Generator(seed);
+		rand = n_random::Generator(seed);
 
 		particles.clear();
+		render_pos.clear();
 	}
 	Particle spawn_particle (v2 world_size) {
 		Particle p;
-		p.pos = random::uniform(rand, -world_size/2, +world_size/2);
-		p.vel = random::normal(rand, v2(1)) * size * 10;
+		p.pos = n_random::uniform(rand, -world_size/2, +world_size/2);
+		p.vel = n_random::normal(rand, v2(1)) * size * 10;
 		return p;
 	}
 
@@ -62,9 +64,12 @@ struct Particles {
 		
 		int old_count = (int)particles.size();
 		particles.resize(MAX(count, 0));
+		render_pos.resize(particles.size());
 
-		for (int i=old_count; i<count; ++i)
+		for (int i=old_count; i<count; ++i) {
 			particles[i] = spawn_particle(world_size);
+			render_pos[i].teleport(particles[i].pos);
+		}
 		
 	}
 };
@@ -106,18 +111,19 @@ bool predict_collision (v2 a_pos, v2 a_vel, flt a_radius, v2 b_pos, v2 b_vel, fl
 
 struct Particle_Sim {
 
-	flt		dt_multiplier = 1;
-	bool	paused = false;
+	void update (Fixed_Timestep& fixed_step, Input& inp) {
 
-	void update (Particles& p, Input& inp, flt dt) {
+		imgui::Checkbox("paused", &fixed_step.paused);
+		if (inp.went_down('P'))	fixed_step.paused = !fixed_step.paused;
+		imgui::DragFloat("dt_multiplier", &fixed_step.time_scale, 1.0f/100);
+	}
 
-		imgui::Checkbox("paused", &paused);
-		if (inp.went_down('P'))	paused = !paused;
-		imgui::DragFloat("dt_multiplier", &dt_multiplier, 1.0f/100);
+	void tick (Particles& ps, flt dt) {
 
-		flt use_dt = paused ? 0 : dt_multiplier * dt;
+		flt use_dt = dt;
 
-		for (auto& p : p.particles) {
+		for (uptr i=0; i<ps.particles.size(); ++i) {
+			auto& p = ps.particles[i];
 
 			//flt earliest_coll_t = INF;
 			//Particle* other_p = nullptr;
@@ -144,6 +150,7 @@ struct Particle_Sim {
 			//}
 
 			p.pos += p.vel * use_dt;
+			ps.render_pos[i].set(p.pos);
 		}
 	}
 };
@@ -167,7 +174,7 @@ struct Particle_Renderer {
 		
 	}
 
-	void draw (Particles const& p, Camera2D& cam) {
+	void draw (std::vector<Particle> const& particles, flt size, Camera2D& cam) {
 		if (!vbo.instanced_mesh)
 			gen_vbo();
 		
@@ -242,10 +249,10 @@ struct Particle_Renderer {
 		)_SHAD");
 
 		auto* s = use_shader("draw_particles");
-		if (s) {
-			vbo.instance_data.reupload(&p.particles[0], (GLuint)p.particles.size(), nullptr,0, &Particle::layout);
+		if (s && particles.size() > 0) {
+			vbo.instance_data.reupload(&particles[0], (GLuint)particles.size(), nullptr,0, &Particle::layout);
 
-			set_uniform(s, "particle_size", p.size);
+			set_uniform(s, "particle_size", size);
 			set_uniform(s, "particle_col", col);
 
 			set_uniform(s, "px_size_world", cam.size_world.x / (flt)cam.get_subrect().size_px.x);
@@ -286,14 +293,36 @@ class App : public Application {
 
 		//
 		particles.update(world_size, inp);
-		sim.update(particles, inp,dt);
+		sim.update(fixed_step, inp);
 
 		renderer.update();
-		renderer.draw(particles, cam);
+	}
+
+	void tick (flt dt) {
+		sim.tick(particles, dt);
+	}
+
+	void prepare (Gl_Command_Buffer& cmds) {
+		// snapshot of the particles, so the next ticks can run while this is uploaded
+		//  interpolated between the last two ticks, else they would visibly stutter whenever the frame rate is not a multiple of the tick rate
+		flt alpha = fixed_step.alpha();
+		std::vector<Particle> ps = particles.particles;
+		for (uptr i=0; i<ps.size(); ++i)
+			ps[i].pos = particles.render_pos[i].get(alpha);
+
+		cmds.record([this, ps = std::move(ps), size = particles.size] () {
+			renderer.draw(ps, size, cam);
+		});
 	}
 } app;
 
-int main () {
+int main (int argc, char** argv) {
+	app.pipeline.enabled = true; // tick() only touches particles and prepare() records a snapshot of them
+
+	Headless_Options headless;
+	if (parse_headless_args(argc, argv, &headless))
+		return app.run_headless(MSVC_PROJECT_NAME, headless) ? 0 : 1;
+
 	app.open(MSVC_PROJECT_NAME);
 	app.run();
 	return 0;
@@ -30,8 +30,9 @@ struct Generator {
 	iv3	size = iv3(32,32,16);
 
 	bool imgui (Voxels* voxels) {
-		save->begin("Generator");
-		save->value("size", &size);
+		static Save::Cache c[2];
+		save->begin("Generator", &c[0]);
+		save->value("size", &size, &c[1]);
 		save->end();
 
 		if (!imgui::CollapsingHeader("Generator", ImGuiTreeNodeFlags_DefaultOpen))
@@ -40,6 +41,7 @@ struct Generator {
 		regen = imgui::DragInt3("size", &size.x, 1.0f / 20) || regen;
 
 		if (regen) {
+			PROFILE_SCOPED("gen_voxels");
 			*voxels = gen_voxels();
 			regen = false;
 			return true;
@@ -184,12 +186,11 @@ struct App : public Application {
 		regen_voxels = imgui::DragFloat("isolevel", &isolevel, 1.0f / 30) || regen_voxels;
 
 		if (regen_voxels) {
-			Timer t;
-			t.start();
+			profiler::Zone z ("regen_voxels");
 
 			mesh = meshify(voxels, isolevel);
 
-			regen_seconds = t.end();
+			regen_seconds = z.end();
 		}
 		regen_voxels = false;
 
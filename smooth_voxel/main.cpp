@@ -14,10 +14,36 @@ flt smoothstep_n (flt x, int n) {
 #include "marching_cubes.hpp"
 
 struct App : public Application {
+	// prepare() uses these on the pipeline worker, frame() only touches them while the worker is idle
+	flt					voxels[16][32][32];
+
+	bool				regen_voxels = true;
+	bool				regen_every_frame = false; // cpu heavy scene, to see the pipeline overlap the meshing with the submit
+	flt					regen_seconds = -1;
+
+	bool				fixed_seed = true;
+	int					current_voxel_example = 0;
+	flt					settings[7] = {
+		0.5f,
+		0.2f,
+		-1,
+		1.5f,
+		0.7f,
+		8.14f,
+		4.5f,
+	};
+	bool				binary_density = true;
+	bool				show_smooth = true;
+
+	// main thread only, created by the upload commands prepare() records
+	Gpu_Mesh			blocky;
+	Gpu_Mesh			smooth;
+
 	void frame () {
 	
 		static bool wireframe_enable = false;
-		save->value("wireframe_enable", &wireframe_enable);
+		static Save::Cache wireframe_cache;
+		save->value("wireframe_enable", &wireframe_enable, &wireframe_cache);
 		imgui::Checkbox("wireframe_enable", &wireframe_enable);
 		engine::set_shared_uniform("wireframe", "enable", wireframe_enable);
 
@@ -33,21 +59,13 @@ struct App : public Application {
 		using namespace engine;
 		using namespace imgui;
 
-		static flt voxels[16][32][32];
-		static Gpu_Mesh blocky;
-		static Gpu_Mesh smooth;
-
-		static bool regen_voxels = true;
-		static flt regen_seconds = -1;
-	
 		regen_voxels = Button("regen_voxels") || regen_voxels;
 		SameLine();
 		Text("%8.3f ms", regen_seconds * 1000);
 
-		static bool fixed_seed = true;
+		Checkbox("regen_every_frame", &regen_every_frame);
 		Checkbox("fixed_seed", &fixed_seed);
 
-		static int current_voxel_example = 0;
 		regen_voxels = imgui::Combo("voxel_example", &current_voxel_example,
 				"rand_50%\0"
 				"rand_20%\0"
@@ -57,238 +75,253 @@ struct App : public Application {
 				"rand_gradient_sphere%\0"
 				"rand_gradient_torus%\0"
 			) || regen_voxels;
-		save->value("current_voxel_example", &current_voxel_example);
-
-		static flt settings[] = {
-			0.5f,
-			0.2f,
-			-1,
-			1.5f,
-			0.7f,
-			8.14f,
-			4.5f,
-		};
+		static Save::Cache example_cache;
+		save->value("current_voxel_example", &current_voxel_example, &example_cache);
 
 		regen_voxels = imgui::DragFloat("setting", &settings[current_voxel_example], 1.0f / 300) || regen_voxels;
 
-		flt setting = settings[current_voxel_example];
-
-		static bool binary_density = true;
 		regen_voxels = Checkbox("binary_density", &binary_density) || regen_voxels;
 
-		if (regen_voxels) {
-			Timer t;
-			t.start();
+		//
+		engine::draw_to_screen(inp.wnd_size_px);
+		engine::clear(0);
 
-			static random::Generator gen;
+		draw_skybox_gradient();
 
-			if (fixed_seed)
-				gen = random::Generator(0);
+		imgui::Checkbox("show_smooth", &show_smooth);
+	}
 
-			iv3 voxel_area = iv3(32,32,16);
+	// voxelize and mesh on the cpu, the meshes are uploaded by the commands prepare() records
+	void regen (Cpu_Mesh<Default_Vertex_3d,GLuint>* blocky_mesh, Cpu_Mesh<Default_Vertex_3d>* smooth_mesh) {
+		flt setting = settings[current_voxel_example];
 
-			auto voxelize = [&] (flt (*func)(v3 pos, float setting), flt setting) {
-				iv3 p;
-				for (p.z=0; p.z<voxel_area.z; ++p.z) {
-					for (p.y=0; p.y<voxel_area.y; ++p.y) {
-						for (p.x=0; p.x<voxel_area.x; ++p.x) {
-							flt tmp = clamp( func( (v3)p, setting ), 0.0f,1.0f);
-							if (binary_density)
-								tmp = tmp >= 0.5f ? 1.0f : 0.0f;
-							voxels[p.z][p.y][p.x] = tmp;
-						}
+		static n_random::Generator gen; // static, the density funcs are plain function pointers
+
+		if (fixed_seed)
+			gen = n_random::Generator(0);
+
+		iv3 voxel_area = iv3(32,32,16);
+
+		auto voxelize = [&] (flt (*func)(v3 pos, float setting), flt setting) {
+			iv3 p;
+			for (p.z=0; p.z<voxel_area.z; ++p.z) {
+				for (p.y=0; p.y<voxel_area.y; ++p.y) {
+					for (p.x=0; p.x<voxel_area.x; ++p.x) {
+						flt tmp = clamp( func( (v3)p, setting ), 0.0f,1.0f);
+						if (binary_density)
+							tmp = tmp >= 0.5f ? 1.0f : 0.0f;
+						voxels[p.z][p.y][p.x] = tmp;
 					}
 				}
-			};
-			auto rand = [&] (float percent_filled) {
-				voxelize([] (v3 pos, float percent_filled) -> flt {
-					flt prob = percent_filled;
-					return map(random::uniform(gen, 0.0f,1.0f), prob -0.05f, prob +0.05f); 
-				}, percent_filled);
-			};
-			//auto rand_gradient = [&] (float (*gradient)(v3 pos, float setting)) {
-			//	voxelize([] (v3 pos, float setting) -> flt {
-			//		flt prob = gradient((v3)p, setting);
-			//		return map(random::rand_float(0,1), prob -0.05f, prob +0.05f); 
-			//	}, setting);
-			//};
-			auto gradient = [&] (float (*dens_gradient)(v3 pos, float setting)) {
-				voxelize(dens_gradient, setting);
-			};
-
-			switch (current_voxel_example) {
-				case 0:
-					rand(setting);
-					break;
-				case 1:
-					rand(setting);
-					break;
-				case 2:
-					//rand_gradient([] (v3 pos, float setting) -> flt { return 1 -(pos.z / 15); });
-					break;
-				case 3:
-					//rand_gradient([] (v3 pos, float setting) -> flt { return pow(1 -(pos.z / 15),setting); });
-					break;
-				case 4:
-					//rand_gradient([] (v3 pos, float setting) -> flt { return smoothstep_n(1 -(pos.z / 15), (int)lerp(1, 10, setting)); });
-					break;
-				case 5:
-					gradient([] (v3 pos, float setting) -> flt {
-						flt r = length(pos -v3(16,16,8));
-						flt sphere_r = setting;
-						return map(r, sphere_r +0.5f, sphere_r -0.5f); 
-					});
-					break;
-				case 6:
-					gradient([] (v3 pos, float setting) -> flt {
-						v3 torus_center = v3(16,16,8);
-						flt torus_radius_ring = 12;
-						flt torus_radius_inner = setting;
-
-						flt dist_r = length( length(pos.xy() -torus_center.xy()) -torus_radius_ring);
-						flt dist_h = length(pos.z -torus_center.z);
-
-						flt r = length(v2(dist_r,dist_h));
-
-						return map(r, torus_radius_inner +0.5f, torus_radius_inner -0.5f); 
-					});
-					break;
-				default:
-					break;
 			}
+		};
+		auto rand = [&] (float percent_filled) {
+			voxelize([] (v3 pos, float percent_filled) -> flt {
+				flt prob = percent_filled;
+				return map(n_random::uniform(gen, 0.0f,1.0f), prob -0.05f, prob +0.05f); 
+			}, percent_filled);
+		};
+		//auto rand_gradient = [&] (float (*gradient)(v3 pos, float setting)) {
+		//	voxelize([] (v3 pos, float setting) -> flt {
+		//		flt prob = gradient((v3)p, setting);
+		//		return map(n_random::rand_float(0,1), prob -0.05f, prob +0.05f); 
+		//	}, setting);
+		//};
+		auto gradient = [&] (float (*dens_gradient)(v3 pos, float setting)) {
+			voxelize(dens_gradient, setting);
+		};
 
-			auto meshify_blocky = [&] () {
-				Cpu_Mesh<Default_Vertex_3d,GLuint> cpu_mesh;
+		switch (current_voxel_example) {
+			case 0:
+				rand(setting);
+				break;
+			case 1:
+				rand(setting);
+				break;
+			case 2:
+				//rand_gradient([] (v3 pos, float setting) -> flt { return 1 -(pos.z / 15); });
+				break;
+			case 3:
+				//rand_gradient([] (v3 pos, float setting) -> flt { return pow(1 -(pos.z / 15),setting); });
+				break;
+			case 4:
+				//rand_gradient([] (v3 pos, float setting) -> flt { return smoothstep_n(1 -(pos.z / 15), (int)lerp(1, 10, setting)); });
+				break;
+			case 5:
+				gradient([] (v3 pos, float setting) -> flt {
+					flt r = length(pos -v3(16,16,8));
+					flt sphere_r = setting;
+					return map(r, sphere_r +0.5f, sphere_r -0.5f); 
+				});
+				break;
+			case 6:
+				gradient([] (v3 pos, float setting) -> flt {
+					v3 torus_center = v3(16,16,8);
+					flt torus_radius_ring = 12;
+					flt torus_radius_inner = setting;
+
+					flt dist_r = length( length(pos.xy() -torus_center.xy()) -torus_radius_ring);
+					flt dist_h = length(pos.z -torus_center.z);
+
+					flt r = length(v2(dist_r,dist_h));
+
+					return map(r, torus_radius_inner +0.5f, torus_radius_inner -0.5f); 
+				});
+				break;
+			default:
+				break;
+		}
 
-				for (int z=0; z<voxel_area.z; ++z) {
-					for (int y=0; y<voxel_area.y; ++y) {
-						for (int x=0; x<voxel_area.x; ++x) {
+		auto meshify_blocky = [&] () {
+			Cpu_Mesh<Default_Vertex_3d,GLuint> cpu_mesh;
 
-							v3 pos_world = (v3)iv3(x,y,z);
+			for (int z=0; z<voxel_area.z; ++z) {
+				for (int y=0; y<voxel_area.y; ++y) {
+					for (int x=0; x<voxel_area.x; ++x) {
 
-							if (voxels[z][y][x] >= 0.5f) {
-								auto cube = gen_cube<engine::Default_Vertex_3d>([] (v3 p, v3 n, v2 uv, int face) {
-									Default_Vertex_3d v;
-									v.pos_model = p;
-									v.normal_model = n;
-									v.uv = uv;
-									return v;
-								}, 0.5f, pos_world);
+						v3 pos_world = (v3)iv3(x,y,z);
+
+						if (voxels[z][y][x] >= 0.5f) {
+							auto cube = gen_cube<engine::Default_Vertex_3d>([] (v3 p, v3 n, v2 uv, int face) {
+								Default_Vertex_3d v;
+								v.pos_model = p;
+								v.normal_model = n;
+								v.uv = uv;
+								return v;
+							}, 0.5f, pos_world);
 
-								cpu_mesh.add(cube);
-							}
+							cpu_mesh.add(cube);
 						}
 					}
 				}
+			}
 
-				return Gpu_Mesh::upload(cpu_mesh);
-			};
-
-			auto meshify_smooth = [&] () {
-			
-				Cpu_Mesh<Default_Vertex_3d> mesh;
-
-				//iv3 start = 0;
-				//iv3 end = voxel_area -1;
-				iv3 start = -1;
-				iv3 end = voxel_area;
-
-				iv3 p;
-				for (p.z=start.z; p.z<end.z; ++p.z) {
-					for (p.y=start.y; p.y<end.y; ++p.y) {
-						for (p.x=start.x; p.x<end.x; ++p.x) {
-						
-							using namespace marching_cubes;
-
-							Triangle tris[5];
-
-							Gridcell gridcell;
-						
-							iv3 corners[] = {
-								iv3(0,1,0),
-								iv3(1,1,0),
-								iv3(1,0,0),
-								iv3(0,0,0),
-								iv3(0,1,1),
-								iv3(1,1,1),
-								iv3(1,0,1),
-								iv3(0,0,1),
-							};
-
-							for (int i=0; i<8; ++i) {
-								iv3 corner_pos = p +corners[i];
-								gridcell.p[i] = (v3)corner_pos;
-
-								flt density; // 1: mass  0: air (surface has normals facing air)
-
-								if (all(corner_pos >= 0 && corner_pos < voxel_area))
-									density = (flt)voxels[corner_pos.z][corner_pos.y][corner_pos.x];
-								else
-									density = 0;
-
-								gridcell.val[i] = 1 -density;
-							}
-
-							int tri_count = Polygonise(gridcell, 0.5f, tris);
-
-							auto vert = [&] (v3 pos, v3 normal) {
-								Default_Vertex_3d v;
-								v.pos_model = pos;
-								v.normal_model = normal;
-								mesh.vertecies.push_back(v);
-							};
-
-							for (int i=0; i<tri_count; ++i) {
-								v3 a = tris[i].p[0];
-								v3 b = tris[i].p[1];
-								v3 c = tris[i].p[2];
-
-								v3 ab = b -a;
-								v3 ac = c -a;
-
-								v3 normal = normalize_or_zero( cross(ab, ac) );
-
-								if (length(a -b) < 0.01f)
-									printf("degenerate triangle!\n");
-								if (length(b -c) < 0.01f)
-									printf("degenerate triangle!\n");
-								if (length(c -a) < 0.01f)
-									printf("degenerate triangle!\n");
-								if (length(normal) < 0.01f)
-									printf("normal zero!\n");
-
-								vert(a, normal);
-								vert(b, normal);
-								vert(c, normal);
-							}
+			return cpu_mesh;
+		};
+
+		auto meshify_smooth = [&] () {
+		
+			Cpu_Mesh<Default_Vertex_3d> mesh;
+
+			//iv3 start = 0;
+			//iv3 end = voxel_area -1;
+			iv3 start = -1;
+			iv3 end = voxel_area;
+
+			iv3 p;
+			for (p.z=start.z; p.z<end.z; ++p.z) {
+				for (p.y=start.y; p.y<end.y; ++p.y) {
+					for (p.x=start.x; p.x<end.x; ++p.x) {
+					
+						using namespace marching_cubes;
+
+						Triangle tris[5];
+
+						Gridcell gridcell;
+					
+						iv3 corners[] = {
+							iv3(0,1,0),
+							iv3(1,1,0),
+							iv3(1,0,0),
+							iv3(0,0,0),
+							iv3(0,1,1),
+							iv3(1,1,1),
+							iv3(1,0,1),
+							iv3(0,0,1),
+						};
+
+						for (int i=0; i<8; ++i) {
+							iv3 corner_pos = p +corners[i];
+							gridcell.p[i] = (v3)corner_pos;
+
+							flt density; // 1: mass  0: air (surface has normals facing air)
+
+							if (all(corner_pos >= 0 && corner_pos < voxel_area))
+								density = (flt)voxels[corner_pos.z][corner_pos.y][corner_pos.x];
+							else
+								density = 0;
+
+							gridcell.val[i] = 1 -density;
+						}
+
+						int tri_count = Polygonise(gridcell, 0.5f, tris);
+
+						auto vert = [&] (v3 pos, v3 normal) {
+							Default_Vertex_3d v;
+							v.pos_model = pos;
+							v.normal_model = normal;
+							mesh.vertecies.push_back(v);
+						};
+
+						for (int i=0; i<tri_count; ++i) {
+							v3 a = tris[i].p[0];
+							v3 b = tris[i].p[1];
+							v3 c = tris[i].p[2];
+
+							v3 ab = b -a;
+							v3 ac = c -a;
+
+							v3 normal = normalize_or_zero( cross(ab, ac) );
+
+							if (length(a -b) < 0.01f)
+								printf("degenerate triangle!\n");
+							if (length(b -c) < 0.01f)
+								printf("degenerate triangle!\n");
+							if (length(c -a) < 0.01f)
+								printf("degenerate triangle!\n");
+							if (length(normal) < 0.01f)
+								printf("normal zero!\n");
+
+							vert(a, normal);
+							vert(b, normal);
+							vert(c, normal);
 						}
 					}
 				}
+			}
 
-				return Gpu_Mesh::upload(mesh);
-			};
-
-			blocky = meshify_blocky();
-			smooth = meshify_smooth();
+			return mesh;
+		};
 
-			regen_seconds = t.end();
+		{
+			PROFILE_SCOPED("meshify_blocky");
+			*blocky_mesh = meshify_blocky();
 		}
-		regen_voxels = false;
+		{
+			PROFILE_SCOPED("meshify_smooth");
+			*smooth_mesh = meshify_smooth();
+		}
+	}
 
-		//
-		engine::draw_to_screen(inp.wnd_size_px);
-		engine::clear(0);
+	void prepare (Gl_Command_Buffer& cmds) {
+		if (regen_voxels || regen_every_frame) {
+			profiler::Zone z ("regen_voxels");
 
-		draw_skybox_gradient();
+			Cpu_Mesh<Default_Vertex_3d,GLuint> blocky_mesh;
+			Cpu_Mesh<Default_Vertex_3d> smooth_mesh;
+			regen(&blocky_mesh, &smooth_mesh);
 
-		static bool show_smooth = true;
-		imgui::Checkbox("show_smooth", &show_smooth);
+			cmds.record([this, blocky_mesh = std::move(blocky_mesh), smooth_mesh = std::move(smooth_mesh)] () {
+				PROFILE_SCOPED("upload_voxel_meshes");
+				blocky = Gpu_Mesh::upload(blocky_mesh);
+				smooth = Gpu_Mesh::upload(smooth_mesh);
+			});
 
-		draw_simple(show_smooth ? smooth : blocky, 0);
+			regen_seconds = z.end();
+		}
+		regen_voxels = false;
+
+		draw_simple(cmds, show_smooth ? smooth : blocky, 0); // only the pointer is recorded, the upload above runs before the draw
 	}
 } app;
 
-int main () {
+int main (int argc, char** argv) {
+	app.pipeline.enabled = true; // the voxel regen in prepare() runs on the worker, it only uses the members above and records the uploads
+
+	Headless_Options headless;
+	if (parse_headless_args(argc, argv, &headless))
+		return app.run_headless(MSVC_PROJECT_NAME, headless) ? 0 : 1;
+
 	app.open(MSVC_PROJECT_NAME);
 	app.run();
 	return 0;
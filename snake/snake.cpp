@@ -5,6 +5,7 @@ namespace imgui = ImGui;
 using namespace engine;
 
 #include "mylibs/random.hpp"
+#include "snake_env.hpp"
 
 Input* _inp; // only for debugging
 
@@ -250,27 +251,27 @@ struct Snake_Game : engine::Application {
 
 	void init () {
 		_inp = &this->inp;
+		timer.apply_rate(fixed_step); // before the first frame, not after it ran at the default rate
 	}
 	void game_tick () {
 		
 		snake.move(world, apple, has_won());
 	}
 
-	struct Game_Timer {
+	struct Game_Timer { // the game ticks are run by the engine fixed_step, this sets its rate
 		flt tick_interval = 1.0f / 3;
-		flt next_tick_timer = tick_interval;
 
 		flt elapsed = 0;
 		int ticks_count = 0;
 
-		void restart () {
-			next_tick_timer = tick_interval;
+		void restart (Fixed_Timestep& fixed_step) {
+			fixed_step.reset();
 
 			elapsed = 0;
 			ticks_count = 0;
 		}
 
-		void imgui () {
+		void imgui (Fixed_Timestep& fixed_step) {
 			if (imgui::CollapsingHeader("Game_Timer", ImGuiTreeNodeFlags_DefaultOpen)) {
 
 				flt tick_frequency = 1.0f / tick_interval;
@@ -278,25 +279,20 @@ struct Snake_Game : engine::Application {
 					tick_interval = 1.0f / tick_frequency;
 
 				imgui::DragFloat("tick_interval", &tick_interval, 0.001f);
-				imgui::Value("next_tick_timer", next_tick_timer);
+				imgui::Value("next_tick_timer", tick_interval -(flt)fixed_step.accumulator);
 
 				imgui::Value("elapsed", elapsed);
 				imgui::Value("ticks_count", ticks_count);
 			}
+
+			apply_rate(fixed_step);
+		}
+		void apply_rate (Fixed_Timestep& fixed_step) {
+			fixed_step.tick_rate = 1.0f / tick_interval;
 		}
-		bool tick (flt dt) {
-			next_tick_timer -= dt;
+		void tick (flt dt) {
 			elapsed += dt;
-
-			bool do_tick = next_tick_timer <= 0;
-
-			if (do_tick) {
-				ticks_count++;
-
-				next_tick_timer += tick_interval;
-			}
-
-			return do_tick;
+			ticks_count++;
 		}
 	};
 
@@ -324,7 +320,7 @@ struct Snake_Game : engine::Application {
 			snake = Snake();
 			apple = Apple::spawn_in_random_pos(snake, world);
 
-			timer.restart();
+			timer.restart(fixed_step);
 		}
 		
 		imgui::TextColored(ImVec4(0,1,0,1), "Snake size: %d", (int)snake.body.size());
@@ -333,8 +329,12 @@ struct Snake_Game : engine::Application {
 			snake.set_move_dir(inp_dir);
 		}
 
-		timer.imgui();
-		if (!snake.dead && timer.tick(dt))
+		timer.imgui(fixed_step);
+	}
+
+	void tick (flt dt) {
+		timer.tick(dt);
+		if (!snake.dead)
 			game_tick();
 	}
 
@@ -487,7 +487,7 @@ Snake_Game::Apple Snake_Game::Apple::spawn_in_random_pos (Snake& snake, World& w
 		return apple;
 	}
 
-	apple.pos = snakeless_cells[ random::uniform((int)snakeless_cells.size()) ];
+	apple.pos = snakeless_cells[ n_random::uniform((int)snakeless_cells.size()) ];
 	return apple;
 }
 
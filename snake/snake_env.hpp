@@ -0,0 +1,244 @@
+#pragma once
+
+#include "mylibs/basic_typedefs.hpp"
+#include "mylibs/vector.hpp"
+#include "mylibs/float_precision.hpp"
+#include "mylibs/random.hpp"
+
+#include <vector>
+#include <cstring>
+#include "assert.h"
+
+// Headless snake for AI training, steps a whole batch of independent games at once
+//  the state of all games is stored as arrays over the games (struct of arrays), step() is one loop over the batch doing O(1) work per game
+//   the body is a ring buffer of cell indices, moving writes the new head and drops the tail instead of shifting the whole body
+//   an occupancy bitset per game answers the body collision test
+//   the free cells are an indexed free list (list of free cells + the index of every cell in that list), so a cell is added or removed in O(1)
+//    and an apple is placed by picking a random entry of the list, without scanning the world
+//  the rules are the ones of snake.cpp: moving backwards is ignored, hitting a wall or the body kills, eating an apple grows the snake by one
+//  finished games (died, won or no apple for max_steps_without_apple steps) are reset at the end of the step they finished in
+namespace snake {
+	using namespace basic_typedefs;
+	using namespace vector;
+	using namespace float_precision;
+
+	enum dir_e : u8 {
+		LEFT	=0,
+		RIGHT	=1,
+		DOWN	=2,
+		UP		=3, // dir ^ 1 is the opposite direction
+	};
+	static constexpr iv2 dir_vecs[4] = { iv2(-1,0), iv2(+1,0), iv2(0,-1), iv2(0,+1) };
+
+	constexpr u16 NO_APPLE = 0xffff;
+
+	class Snake_Batch {
+		NO_MOVE_COPY_CLASS(Snake_Batch)
+	public:
+		iv2						size; // world size in cells
+		int						cells;
+		int						games;
+		int						words; // u64 per occupancy bitset
+
+		u32						max_steps_without_apple; // finish games that loop forever
+
+		// per game state, indexed [game] or [game * cells +i] or [game * words +i]
+		std::vector<u16>		body; // ring buffer of the body cells, body[head] is the head, the tail is length -1 entries before it
+		std::vector<u16>		head;
+		std::vector<u16>		length;
+		std::vector<iv2>		head_pos;
+		std::vector<u8>			dir; // of the last move
+		std::vector<u64>		occupied; // bit set for every body cell
+		std::vector<u16>		free_cells; // the first free_count entries are the cells without snake, in no order
+		std::vector<u16>		free_index; // index of every free cell in free_cells
+		std::vector<u16>		free_count;
+		std::vector<u16>		apple; // cell of the apple, NO_APPLE if the world is full
+		std::vector<u32>		steps_since_apple;
+		std::vector<n_random::Generator>	rand;
+
+		// results of the last step
+		std::vector<flt>		reward; // +1 ate apple, -1 died
+		std::vector<u8>			done; // game finished in the last step and was reset
+
+		// totals
+		u64						total_steps = 0;
+		u64						total_games = 0; // finished games
+		u64						total_apples = 0;
+
+		Snake_Batch (int games, iv2 size=16, u64 seed=0): size{size}, cells{size.x * size.y}, games{games} {
+			assert(all(size >= 8) && cells < NO_APPLE);
+
+			words = (cells +63) / 64;
+			max_steps_without_apple = (u32)cells * 4;
+
+			body		.resize((uptr)games * cells);
+			head		.resize(games);
+			length		.resize(games);
+			head_pos	.resize(games);
+			dir			.resize(games);
+			occupied	.resize((uptr)games * words);
+			free_cells	.resize((uptr)games * cells);
+			free_index	.resize((uptr)games * cells);
+			free_count	.resize(games);
+			apple		.resize(games);
+			steps_since_apple.resize(games);
+			reward		.resize(games);
+			done		.resize(games);
+
+			rand.reserve(games);
+			for (int g=0; g<games; ++g)
+				rand.emplace_back(seed, (u64)g); // one stream per game, so a game does not depend on the batch size
+
+			for (int g=0; g<games; ++g) {
+				u16* list = &free_cells[(uptr)g * cells];
+				u16* index = &free_index[(uptr)g * cells];
+				for (int i=0; i<cells; ++i) {
+					list[i] = (u16)i;
+					index[i] = (u16)i;
+				}
+				free_count[g] = (u16)cells;
+				length[g] = 0;
+
+				reset(g);
+			}
+		}
+
+		u16 cell (iv2 pos) const {					return (u16)(pos.y * size.x + pos.x); }
+		iv2 cell_pos (int cell) const {				return iv2(cell % size.x, cell / size.x); }
+
+		bool is_occupied (int g, int cell) const {
+			return (occupied[(uptr)g * words +(cell >> 6)] >> (cell & 63)) & 1;
+		}
+
+		// i=0 is the head, i=length-1 the tail
+		iv2 body_pos (int g, int i) const {
+			int r = (int)head[g] -i;
+			if (r < 0) r += cells;
+			return cell_pos(body[(uptr)g * cells +r]);
+		}
+
+		void _take_free (int g, u16 cell) {
+			u16* list = &free_cells[(uptr)g * cells];
+			u16* index = &free_index[(uptr)g * cells];
+
+			u16 i = index[cell];
+			u16 last = list[--free_count[g]];
+			list[i] = last; // move last entry into the hole
+			index[last] = i;
+
+			occupied[(uptr)g * words +(cell >> 6)] |= (u64)1 << (cell & 63);
+		}
+		void _add_free (int g, u16 cell) {
+			u16 i = free_count[g]++;
+			free_cells[(uptr)g * cells +i] = cell;
+			free_index[(uptr)g * cells +cell] = i;
+
+			occupied[(uptr)g * words +(cell >> 6)] &= ~((u64)1 << (cell & 63));
+		}
+
+		void _spawn_apple (int g) {
+			if (free_count[g] == 0) {
+				apple[g] = NO_APPLE;
+				return;
+			}
+			apple[g] = free_cells[(uptr)g * cells +n_random::uniform(rand[g], (int)free_count[g])];
+		}
+
+		// O(length) instead of O(cells), only the body cells are returned to the free list
+		void reset (int g) {
+			u16* ring = &body[(uptr)g * cells];
+
+			for (int i=0; i<(int)length[g]; ++i) {
+				int r = (int)head[g] -i;
+				if (r < 0) r += cells;
+				_add_free(g, ring[r]);
+			}
+
+			// same start as snake.cpp (head at 5,5 in a 16x16 world), moving left
+			iv2 start = size / 2 -3;
+
+			for (int i=0; i<3; ++i) { // tail first
+				u16 c = cell(start +iv2(2 -i, 0));
+				ring[i] = c;
+				_take_free(g, c);
+			}
+			head[g] = 2;
+			length[g] = 3;
+			head_pos[g] = start;
+			dir[g] = LEFT;
+			steps_since_apple[g] = 0;
+
+			_spawn_apple(g);
+		}
+
+		// actions: one dir_e per game, values > 3 keep the current direction
+		void step (u8 const* actions) {
+			for (int g=0; g<games; ++g) {
+				u16* ring = &body[(uptr)g * cells];
+
+				u8 d = dir[g];
+				u8 a = actions[g];
+				if (a < 4 && a != (d ^ 1)) // can not move backwards into the body
+					d = a;
+				dir[g] = d;
+
+				iv2 pos = head_pos[g] +dir_vecs[d];
+
+				flt r = 0;
+				bool finished = false;
+
+				if (any(pos < 0 || pos >= size)) {
+					r = -1;
+					finished = true;
+				} else {
+					u16 c = cell(pos);
+					bool eat = c == apple[g];
+
+					if (!eat) { // drop the tail first, the head can move into the cell the tail leaves
+						int t = (int)head[g] -((int)length[g] -1);
+						if (t < 0) t += cells;
+						_add_free(g, ring[t]);
+						length[g]--;
+					}
+
+					if (is_occupied(g, c)) {
+						r = -1;
+						finished = true;
+					} else {
+						_take_free(g, c);
+
+						u16 h = head[g] +1;
+						if (h == cells) h = 0;
+						ring[h] = c;
+						head[g] = h;
+						length[g]++;
+						head_pos[g] = pos;
+
+						steps_since_apple[g]++;
+
+						if (eat) {
+							r = 1;
+							total_apples++;
+							steps_since_apple[g] = 0;
+
+							_spawn_apple(g);
+							finished = apple[g] == NO_APPLE; // won
+						}
+
+						finished = finished || steps_since_apple[g] >= max_steps_without_apple;
+					}
+				}
+
+				reward[g] = r;
+				done[g] = finished;
+
+				if (finished) {
+					reset(g);
+					total_games++;
+				}
+			}
+
+			total_steps += games;
+		}
+	};
+}
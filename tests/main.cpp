@@ -0,0 +1,91 @@
+
+// Tests and benchmarks of the parts of mylibs and 3d_lib that need no window or gl context
+//  tests.exe							run all tests, exit code 1 if any check failed
+//  tests.exe image_processing ...		run only these
+//  tests.exe --bench [names...]		run the benchmarks instead (build in release)
+//  builds with gcc/clang too:  g++ -std=c++14 -O2 -I.. main.cpp stb_image.cpp -o tests -lpthread
+//  the simd paths of vector.hpp are tested by default, -DVECTOR_SIMD=0 tests the scalar code instead
+#ifndef VECTOR_SIMD
+	#define VECTOR_SIMD 1
+#endif
+
+#include "tests.hpp"
+
+#include "test_parallel.hpp"
+#include "test_image_processing.hpp"
+#include "test_texture_filter.hpp"
+#include "test_find_files.hpp"
+#include "test_directory_watcher.hpp"
+#include "test_profiler.hpp"
+#include "test_random.hpp"
+#include "test_vector_simd.hpp"
+#include "test_matricies.hpp"
+#include "test_intersect.hpp"
+#include "test_frame_pipeline.hpp"
+#include "test_gl_command_buffer.hpp"
+#include "test_save_file.hpp"
+#include "test_tetris_bitboard.hpp"
+#include "test_snake_env.hpp"
+#include "test_lsystem.hpp"
+#include "test_fixed_timestep.hpp"
+
+using namespace basic_typedefs;
+using namespace float_precision;
+
+struct Test {
+	cstr	name;
+	void	(*test) ();
+	void	(*bench) ();
+};
+
+Test all_tests[] = {
+	{ "parallel",			tests::test_parallel,			tests::bench_parallel },
+	{ "image_processing",	tests::test_image_processing,	tests::bench_image_processing },
+	{ "texture_filter",		tests::test_texture_filter,		tests::bench_texture_filter },
+	{ "find_files",			tests::test_find_files,			tests::bench_find_files },
+	{ "directory_watcher",	tests::test_directory_watcher,	tests::bench_directory_watcher },
+	{ "profiler",			tests::test_profiler,			tests::bench_profiler },
+	{ "random",				tests::test_random,				tests::bench_random },
+	{ "vector_simd",		tests::test_vector_simd,		tests::bench_vector_simd },
+	{ "matricies",			tests::test_matricies,			tests::bench_matricies },
+	{ "intersect",			tests::test_intersect,			tests::bench_intersect },
+	{ "frame_pipeline",		tests::test_frame_pipeline,		tests::bench_frame_pipeline },
+	{ "gl_command_buffer",	tests::test_gl_command_buffer,	tests::bench_gl_command_buffer },
+	{ "save_file",			tests::test_save_file,			tests::bench_save_file },
+	{ "tetris_bitboard",	tests::test_tetris_bitboard,	tests::bench_tetris_bitboard },
+	{ "snake_env",			tests::test_snake_env,			tests::bench_snake_env },
+	{ "lsystem",			tests::test_lsystem,			tests::bench_lsystem },
+	{ "fixed_timestep",		tests::test_fixed_timestep,		tests::bench_fixed_timestep },
+};
+
+int main (int argc, char** argv) {
+	bool bench = false;
+	std::vector<cstr> names;
+
+	for (int i=1; i<argc; ++i) {
+		if (strcmp(argv[i], "--bench") == 0)
+			bench = true;
+		else
+			names.push_back(argv[i]);
+	}
+
+	for (auto& t : all_tests) {
+		if (names.size() > 0 && std::none_of(names.begin(), names.end(), [&] (cstr n) { return strcmp(n, t.name) == 0; }))
+			continue;
+
+		if (bench) {
+			t.bench();
+		} else {
+			int failures = tests::failures;
+			u64 begin = profiler::now_ns();
+
+			t.test();
+
+			printf("%-20s %s  (%.0f ms)\n", t.name, tests::failures == failures ? "ok" : "FAILED", (flt)(profiler::now_ns() -begin) * 1e-6f);
+		}
+	}
+
+	if (!bench)
+		printf("%d of %d checks failed\n", tests::failures, tests::checks);
+	return tests::failures ? 1 : 0;
+}
@@ -0,0 +1,5 @@
+// the stb implementations, texture_filter_cpu.hpp only includes the declarations
+#define STB_IMAGE_IMPLEMENTATION
+#include "deps/stb/stb_image.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "deps/stb/stb_image_write.h"
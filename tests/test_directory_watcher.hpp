@@ -0,0 +1,221 @@
+#pragma once
+
+#include "tests.hpp"
+#include "mylibs/directory_watcher.hpp"
+
+#include <map>
+#include <thread>
+
+namespace tests {
+
+	void _sleep_ms (int ms) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+	}
+
+	// poll until nothing new came in for a few polls, returns the last change of every file and counts how often each file was reported
+	std::map<std::string, file_change_e> _drain (Directory_Watcher& w, std::map<std::string, int>* counts=nullptr) {
+		std::map<std::string, file_change_e> last;
+		for (int empty=0; empty<3;) {
+			std::vector<Directory_Watcher::File_Change> changes;
+			w.poll_file_changes(&changes);
+			for (auto& c : changes) {
+				last[c.filepath] = c.change;
+				if (counts) (*counts)[c.filepath]++;
+			}
+			empty = changes.empty() ? empty +1 : 0;
+			_sleep_ms(100);
+		}
+		return last;
+	}
+
+	template <typename FUNC>
+	int _count_if (std::vector<std::string> const& files, FUNC func) {
+		return (int)std::count_if(files.begin(), files.end(), func);
+	}
+
+	// stress test: bursts into new subdirs while polling, repeated writes, overflowing the os event queue, removing and moving dirs away
+	void test_directory_watcher () {
+		std::string root = "tests_tmp_directory_watcher/";
+		std::string outside = "tests_tmp_directory_watcher_outside/";
+		remove_tree(root);
+		remove_tree(outside);
+		make_dir(root);
+		make_dir(outside);
+		make_dir(root + "pre/");
+
+		{ // first change of a file is reported right away, even with a long debounce, only when it keeps changing it is held back
+			Directory_Watcher w (root, true, 0.5f);
+			CHECK(w.directory_is_valid());
+
+			write_file(root + "single.txt", "a");
+			_sleep_ms(20);
+			std::vector<Directory_Watcher::File_Change> changes;
+			w.poll_file_changes(&changes);
+			CHECK(changes.size() == 1 && changes[0].filepath == root + "single.txt" && changes[0].change == FILE_ADDED);
+
+			changes.clear();
+			for (int i=0; i<3; ++i) {
+				write_file(root + "single.txt", "b");
+				_sleep_ms(20);
+				w.poll_file_changes(&changes);
+			}
+			CHECK(changes.size() == 0);
+
+			_sleep_ms(600);
+			w.poll_file_changes(&changes);
+			CHECK(changes.size() == 1 && changes[0].change == FILE_MODIFIED);
+
+			remove((root + "single.txt").c_str());
+		}
+
+		Directory_Watcher w (root);
+		CHECK(w.directory_is_valid());
+
+		std::vector<std::string> files;
+		{ // files created in dirs that did not exist yet, the dirs are watched only once we see them
+			std::map<std::string, int> counts;
+			for (int d=0; d<50; ++d) {
+				std::string dir = root + "pre/d" + std::to_string(d) + "/";
+				make_dir(dir);
+				for (int s=0; s<2; ++s) {
+					std::string sub = dir + "s" + std::to_string(s) + "/";
+					make_dir(sub);
+					for (int f=0; f<40; ++f) {
+						files.push_back(sub + "f" + std::to_string(f) + ".txt");
+						write_file(files.back(), "x");
+					}
+				}
+				if (d % 5 == 0) {
+					std::vector<Directory_Watcher::File_Change> changes;
+					w.poll_file_changes(&changes);
+					for (auto& c : changes)
+						counts[c.filepath]++;
+				}
+			}
+			_drain(w, &counts);
+			CHECK(_count_if(files, [&] (std::string const& f) { return counts.find(f) == counts.end(); }) == 0);
+		}
+
+		{ // every file written 3 times in a row
+			std::map<std::string, int> counts;
+			for (auto& f : files)
+				for (int i=0; i<3; ++i)
+					write_file(f, "y");
+			_drain(w, &counts);
+			CHECK(_count_if(files, [&] (std::string const& f) { return counts.find(f) == counts.end(); }) == 0);
+		}
+
+		{ // more events than the os queue holds (16384 by default for inotify, 64KB for ReadDirectoryChangesW), including removes, which only the rescan diff can report
+			make_dir(root + "many/");
+			_drain(w);
+
+			std::vector<std::string> many;
+			for (int i=0; i<20000; ++i) {
+				many.push_back(root + "many/m" + std::to_string(i));
+				write_file(many.back());
+			}
+			for (int i=0; i<100; ++i)
+				remove(files[i].c_str());
+
+			auto last = _drain(w);
+			CHECK(_count_if(many, [&] (std::string const& f) { return last.find(f) == last.end(); }) == 0);
+			CHECK(std::all_of(files.begin(), files.begin() +100, [&] (std::string const& f) { return last[f] == FILE_REMOVED; }));
+		}
+
+		{ // dir moved away: everything in it is removed, and changes in its new location are not reported with the old path
+			CHECK(rename((root + "pre/d10").c_str(), (outside + "d10").c_str()) == 0);
+
+			auto last = _drain(w);
+			CHECK(last[root + "pre/d10"] == FILE_REMOVED);
+			CHECK(last[root + "pre/d10/s1/f5.txt"] == FILE_REMOVED);
+
+			write_file(outside + "d10/s1/new.txt");
+			last = _drain(w);
+			CHECK(last.empty());
+		}
+
+		{ // dir moved within the tree: reported as a rename, everything in it removed under the old name and added under the new one, and watched under the new name
+			CHECK(rename((root + "pre/d20").c_str(), (root + "pre/moved").c_str()) == 0);
+
+			auto last = _drain(w);
+			CHECK(last[root + "pre/d20"] == FILE_RENAMED_OLD_NAME);
+			CHECK(last[root + "pre/moved"] == FILE_RENAMED_NEW_NAME);
+			CHECK(last[root + "pre/d20/s0/f0.txt"] == FILE_REMOVED);
+			CHECK(last[root + "pre/moved/s0/f0.txt"] == FILE_ADDED);
+
+			write_file(root + "pre/moved/s1/f0.txt", "z");
+			last = _drain(w);
+			CHECK(last.size() == 1 && last.find(root + "pre/moved/s1/f0.txt") != last.end());
+		}
+
+		{ // renamed file: old name directly followed by the new name
+			write_file(root + "a.txt");
+			_drain(w);
+			CHECK(rename((root + "a.txt").c_str(), (root + "b.txt").c_str()) == 0);
+			_sleep_ms(20);
+
+			std::vector<Directory_Watcher::File_Change> changes;
+			w.poll_file_changes(&changes);
+			CHECK(changes.size() == 2 && changes[0].filepath == root + "a.txt" && changes[0].change == FILE_RENAMED_OLD_NAME
+									  && changes[1].filepath == root + "b.txt" && changes[1].change == FILE_RENAMED_NEW_NAME);
+		}
+
+		{ // only the dirs passed to watch_dir, like the open dirs of a file browser
+			Directory_Watcher m;
+			CHECK(!m.directory_is_valid());
+
+			std::string dir = root + "pre/d30/";
+			m.watch_dir(dir);
+			CHECK(m.directory_is_valid());
+
+			write_file(dir + "new.txt");
+			write_file(dir + "s0/not_watched.txt");
+			auto last = _drain(m);
+			CHECK(last.size() == 1 && last[dir + "new.txt"] == FILE_ADDED);
+
+			m.watch_dir(dir + "s0");
+			write_file(dir + "s0/f1.txt", "w");
+			last = _drain(m);
+			CHECK(last.size() == 1 && last[dir + "s0/f1.txt"] == FILE_MODIFIED);
+
+			m.unwatch_dir(dir + "s0/");
+			write_file(dir + "s0/f2.txt", "w");
+			write_file(dir + "f.txt");
+			last = _drain(m);
+			CHECK(last.size() == 1 && last.find(dir + "f.txt") != last.end());
+
+			m.unwatch_all();
+			CHECK(!m.directory_is_valid());
+			write_file(dir + "g.txt");
+			CHECK(_drain(m).empty());
+		}
+
+		remove_tree(root);
+		remove_tree(outside);
+	}
+
+	void bench_directory_watcher () {
+		std::string root = "tests_tmp_directory_watcher_bench/";
+		remove_tree(root);
+		make_dir(root);
+
+		Directory_Watcher w (root);
+
+		int count = 10000;
+		u64 begin = profiler::now_ns();
+		for (int i=0; i<count; ++i)
+			write_file(root + "f" + std::to_string(i));
+		flt write_ms = (flt)(profiler::now_ns() -begin) * 1e-6f;
+
+		int reported = 0;
+		flt poll_ms = time_ms([&] () {
+			std::vector<Directory_Watcher::File_Change> changes;
+			w.poll_file_changes(&changes);
+			reported += (int)changes.size();
+		}, 1);
+
+		printf("directory_watcher: writing %d files %8.2f ms, polling their changes %8.2f ms (%d reported)\n", count, write_ms, poll_ms, reported);
+
+		remove_tree(root);
+	}
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "tests.hpp"
+#include "mylibs/find_files.hpp"
+
+#ifndef _WIN32
+	#include <unistd.h> // symlink
+#endif
+
+namespace tests {
+	using namespace n_find_files;
+
+	bool _same_tree (Directory_Tree const& a, Directory_Tree const& b) {
+		if (a.name != b.name || a.valid != b.valid || a.filenames != b.filenames || a.dirs.size() != b.dirs.size())
+			return false;
+		for (uptr i=0; i<a.dirs.size(); ++i)
+			if (!_same_tree(a.dirs[i], b.dirs[i]))
+				return false;
+		return true;
+	}
+
+	// the old recursive find_files, scan_files has to give the same result
+	void _find_files_serial (std::string const& path, std::string const& name, Directory_Tree* dir) {
+		dir->name = name;
+		std::vector<std::string> dirnames;
+		dir->valid = find_files(path, &dirnames, &dir->filenames);
+		for (auto& d : dirnames) {
+			dir->dirs.emplace_back();
+			_find_files_serial(path + d, d, &dir->dirs.back());
+		}
+	}
+
+	// dirs/files per level, depth levels
+	void _make_test_tree (std::string const& path, int dirs, int files, int depth) {
+		make_dir(path);
+		for (int i=0; i<files; ++i)
+			write_file(path + "file_" + std::to_string(i) + (i % 2 ? ".png" : ".txt"));
+		if (depth > 1)
+			for (int i=0; i<dirs; ++i)
+				_make_test_tree(path + "dir_" + std::to_string(i) + "/", dirs, files, depth -1);
+	}
+
+	void test_find_files () {
+		CHECK(match_filter("abc.png", "*.png"));
+		CHECK(!match_filter("abc.pn", "*.png"));
+		CHECK(match_filter("a", "?"));
+		CHECK(!match_filter("ab", "?"));
+		CHECK(match_filter("", "*"));
+		CHECK(match_filter("xaxb", "*a*b"));
+		CHECK(!match_filter("xaxbc", "*a*b"));
+
+		std::string root = "tests_tmp_find_files/";
+		remove_tree(root);
+		_make_test_tree(root, 3, 4, 3);
+		make_dir(root + "empty/");
+
+		{
+			std::vector<std::string> dirs, files;
+			CHECK(find_files(root, &dirs, &files));
+			CHECK(dirs == std::vector<std::string>({ "dir_0/", "dir_1/", "dir_2/", "empty/" })); // sorted, with trailing '/'
+			CHECK(files == std::vector<std::string>({ "file_0.txt", "file_1.png", "file_2.txt", "file_3.png" }));
+
+			CHECK(find_files(root, &dirs, &files, "*.png"));
+			CHECK(files == std::vector<std::string>({ "file_1.png", "file_3.png" }));
+		}
+
+	#ifndef _WIN32
+		// a link back to the root would recurse forever if links were followed (on windows the same goes for junctions, which are reparse points)
+		CHECK(symlink("..", (root + "dir_0/loop").c_str()) == 0);
+	#endif
+
+		Directory_Tree serial;
+		_find_files_serial(root, "x/", &serial);
+
+		for (int threads : { 1, 2, 8 }) {
+			auto tree = scan_files(root, threads);
+
+			// every dir has its children contiguous, dirs first, parents point back
+			bool ok = tree.nodes.size() > 0 && tree.nodes[0].valid;
+			for (u32 i=0; i<(u32)tree.nodes.size(); ++i) {
+				auto& n = tree.nodes[i];
+				if (!n.is_dir) continue;
+				for (u32 c=n.first_child; c<n.first_child +n.dir_count +n.file_count; ++c)
+					ok = ok && tree.nodes[c].parent == i && tree.nodes[c].is_dir == (c < n.first_child +n.dir_count);
+			}
+			CHECK(ok);
+
+			Directory_Tree converted;
+			to_directory_tree(tree, 0, "x/", &converted);
+			CHECK(_same_tree(converted, serial));
+
+			CHECK(tree.get_path((u32)tree.nodes.size() -1) == root + "dir_2/dir_2/file_3.png");
+		}
+
+		{
+			Directory_Tree dir;
+			CHECK(find_files_recursive(root, &dir, "*.png"));
+			CHECK(dir.dirs.size() == 4 && dir.filenames.size() == 2 && dir.dirs[3].dirs.size() == 0);
+		#ifndef _WIN32
+			CHECK(std::find(dir.dirs[0].filenames.begin(), dir.dirs[0].filenames.end(), "loop") == dir.dirs[0].filenames.end()); // link is a file, filtered out by *.png
+			std::vector<std::string> dirs, files;
+			find_files(root + "dir_0/", &dirs, &files);
+			CHECK(std::find(files.begin(), files.end(), "loop") != files.end());
+		#endif
+		}
+
+		{
+			Directory_Tree dir;
+			CHECK(!find_files_recursive(root + "does_not_exist/", &dir));
+			CHECK(!dir.valid);
+		}
+
+		remove_tree(root);
+		CHECK(!file_exists(root));
+	}
+
+	// ~100k files and dirs, scan_files with one thread vs all threads vs the old recursive find_files
+	void bench_find_files () {
+		std::string root = "tests_tmp_find_files_bench/";
+		remove_tree(root);
+		_make_test_tree(root, 8, 20, 5);
+
+		int threads = parallel::thread_count();
+
+		File_Tree tree;
+		flt single = time_ms([&] () { tree = scan_files(root, 1); }, 3);
+		flt multi  = time_ms([&] () { tree = scan_files(root, threads); }, 3);
+		flt serial = time_ms([&] () { Directory_Tree d; _find_files_serial(root, "x/", &d); }, 3);
+
+		printf("find_files %llu nodes:  scan_files 1 thread %8.2f ms  %d threads %8.2f ms  old recursive find_files %8.2f ms\n",
+			(unsigned long long)tree.nodes.size(), single, threads, multi, serial);
+
+		remove_tree(root);
+	}
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "tests.hpp"
+#include "mylibs/fixed_timestep.hpp"
+#include "mylibs/random.hpp"
+
+namespace tests {
+	// a falling ball, every tick integrates it, so the result only depends on the ticks that ran
+	struct _Ball {
+		flt		pos = 100;
+		flt		vel = 0;
+
+		void tick (flt dt) {
+			vel -= 9.81f * dt;
+			pos += vel * dt;
+		}
+	};
+
+	void test_fixed_timestep () {
+		{ // 10 s (plus half a tick, so float rounding of the frame times can not move a tick boundary) give the same ticks at any frame rate
+			flt half_tick = 0.5f / 60;
+
+			std::vector<Fixed_Timestep> steps;
+			std::vector<_Ball> balls;
+			for (int fps : { 17, 30, 60, 144 }) {
+				Fixed_Timestep ts;
+				ts.max_ticks_per_frame = 1000;
+				_Ball ball;
+
+				bool alpha_ok = true;
+				for (int i=0; i<fps * 10; ++i) {
+					ts.frame(1.0f / (flt)fps, [&] (flt dt) { ball.tick(dt); });
+					alpha_ok = alpha_ok && ts.alpha() >= 0 && ts.alpha() < 1;
+				}
+				ts.frame(half_tick, [&] (flt dt) { ball.tick(dt); });
+
+				CHECK(alpha_ok);
+				CHECK(ts.tick_i == 600 && ts.dropped_ticks == 0);
+				CHECK(fabsf(ts.alpha() -0.5f) < 0.01f);
+				steps.push_back(ts);
+				balls.push_back(ball);
+			}
+			for (uptr i=1; i<steps.size(); ++i) {
+				CHECK(steps[i].tick_i == steps[0].tick_i && steps[i].sim_time == steps[0].sim_time);
+				CHECK(balls[i].pos == balls[0].pos && balls[i].vel == balls[0].vel);
+			}
+			CHECK(fabs(steps[0].sim_time -10.0) < 1e-4);
+		}
+
+		{ // a long frame runs max_ticks_per_frame ticks and drops the rest of the time, except the leftover for alpha
+			Fixed_Timestep ts;
+			int ticks = 0;
+			auto tick = [&] (flt dt) { ticks++; };
+
+			CHECK(ts.frame(1.0f +0.5f / 60, tick) == 8 && ts.frame_ticks == 8 && ticks == 8);
+			CHECK(ts.tick_i == 8 && ts.dropped_ticks == 52);
+			CHECK(ts.accumulator >= 0 && ts.accumulator < ts.tick_dt() && fabsf(ts.alpha() -0.5f) < 0.01f);
+
+			CHECK(ts.frame(0.6f / 60, tick) == 1 && ts.dropped_ticks == 52); // back to normal
+
+			ts.reset();
+			CHECK(ts.accumulator == 0 && ts.alpha() == 0 && ts.tick_i == 9);
+		}
+
+		{ // alpha stays in [0,1] for any frame times, also when ticks are dropped
+			Fixed_Timestep ts;
+			n_random::Generator g (4);
+			bool ok = true;
+			for (int i=0; i<10000; ++i) {
+				flt real_dt = n_random::chance(g, 0.05f) ? n_random::uniform(g, 0.0f, 2.0f) : n_random::uniform(g, 0.0f, 0.05f);
+				int n = ts.frame(real_dt, [] (flt dt) {});
+				ok = ok && n >= 0 && n <= ts.max_ticks_per_frame && ts.alpha() >= 0 && ts.alpha() <= 1;
+			}
+			CHECK(ok && ts.dropped_ticks > 0);
+		}
+
+		{ // paused accumulates nothing, time_scale speeds up and slows down the sim
+			Fixed_Timestep ts;
+			ts.paused = true;
+			CHECK(ts.frame(1, [] (flt dt) {}) == 0 && ts.tick_i == 0 && ts.accumulator == 0);
+			ts.paused = false;
+
+			ts.time_scale = 2;
+			for (int i=0; i<60; ++i)
+				ts.frame(1.0f / 60, [] (flt dt) {});
+			ts.frame(0.25f / 60, [] (flt dt) {}); // half a tick of sim time
+			CHECK(ts.tick_i == 120 && ts.dropped_ticks == 0);
+
+			ts.time_scale = 0.5f;
+			for (int i=0; i<60; ++i)
+				ts.frame(1.0f / 60, [] (flt dt) {});
+			CHECK(ts.tick_i == 150);
+		}
+
+		{ // as fast as possible always ticks at least once and shows the newest state, headless runs exactly the asked ticks
+			Fixed_Timestep ts;
+			ts.mode = AS_FAST_AS_POSSIBLE;
+			ts.max_frame_seconds = 0;
+			CHECK(ts.frame(1, [] (flt dt) {}) >= 1 && ts.alpha() == 1);
+
+			Fixed_Timestep h;
+			_Ball a, b;
+			h.run_headless(600, [&] (flt dt) { a.tick(dt); });
+			for (int i=0; i<600; ++i)
+				b.tick(1.0f / 60);
+			CHECK(h.tick_i == 600 && a.pos == b.pos);
+		}
+
+		{ // interpolation between the last two ticks
+			Interpolated<flt> x (3);
+			CHECK(x.get(0) == 3 && x.get(1) == 3);
+
+			x.set(5);
+			CHECK(x.get(0) == 3 && x.get(1) == 5 && x.get(0.5f) == 4);
+			x.set(9);
+			CHECK(x.get(0) == 5 && x.get(0.25f) == 6);
+
+			x.teleport(-1);
+			CHECK(x.get(0) == -1 && x.get(0.5f) == -1 && x.get(1) == -1);
+		}
+	}
+
+	// overhead of the scheduler per tick, frames at 144 fps with a 1000x time scale vs headless
+	void bench_fixed_timestep () {
+		const int ticks = 10000000;
+		_Ball ball;
+
+		flt frames_ms = time_ms([&] () {
+			Fixed_Timestep ts;
+			ts.time_scale = 1000;
+			ts.max_ticks_per_frame = 1 << 20;
+			while (ts.tick_i < ticks)
+				ts.frame(1.0f / 144, [&] (flt dt) { ball.tick(dt); });
+		}, 1);
+		flt headless_ms = time_ms([&] () {
+			Fixed_Timestep ts;
+			ts.run_headless(ticks, [&] (flt dt) { ball.tick(dt); });
+		}, 1);
+
+		printf("fixed_timestep %d ticks: frames %.2f ms (%.2f ns/tick)  headless %.2f ms (%.2f ns/tick)  (ball %g)\n",
+			ticks, frames_ms, frames_ms * 1e6f / ticks, headless_ms, headless_ms * 1e6f / ticks, ball.pos);
+	}
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "tests.hpp"
+#include "3d_lib/frame_pipeline.hpp"
+
+#include <thread>
+
+namespace tests {
+	using engine::Gl_Command_Buffer;
+	using engine::Frame_Pipeline;
+	using engine::Mock_Gl_Backend;
+
+	void _busy_ms (flt ms) { // cpu work, unlike a sleep it competes for the cores
+		u64 end = profiler::now_ns() +(u64)(ms * 1e6f);
+		while (profiler::now_ns() < end);
+	}
+
+	// recorded commands only run in submit(), the list of a job is submitted after the next wait(), the job runs on the worker
+	void test_frame_pipeline () {
+		std::vector<int> executed;
+		Mock_Gl_Backend mock;
+
+		{ // serial: recorded and submitted directly
+			Frame_Pipeline p;
+			p.run_serial([&] (Gl_Command_Buffer& cmds) {
+				cmds.record([&] () { executed.push_back(1); });
+				cmds.record([&] () { executed.push_back(2); });
+				CHECK(executed.size() == 0);
+			}, mock);
+			CHECK(executed == std::vector<int>({ 1, 2 }));
+			CHECK(p.submitted_cmds == 2);
+		}
+
+		executed.clear();
+		{ // pipelined: nothing to submit on the first frame, afterwards always the list of the previous job
+			Frame_Pipeline p;
+			p.enabled = true;
+
+			auto main_thread = std::this_thread::get_id();
+			bool on_worker = true;
+
+			for (int frame=0; frame<4; ++frame) {
+				p.wait();
+
+				p.kick([&, frame] (Gl_Command_Buffer& cmds) {
+					on_worker = on_worker && std::this_thread::get_id() != main_thread;
+					cmds.record([&, frame] () { executed.push_back(frame); });
+				});
+
+				p.submit(mock);
+				CHECK((int)executed.size() == frame); // the job of this frame is not submitted yet
+			}
+			CHECK(on_worker);
+
+			p.wait();
+			p.submit(mock);
+			CHECK(executed == std::vector<int>({ 0, 1, 2, 3 }));
+
+			p.wait(); // nothing kicked, nothing submitted again
+			p.submit(mock);
+			CHECK(executed.size() == 4 && p.submitted_cmds == 0);
+		}
+
+		{ // the worker still running at destruction is finished first
+			bool done = false;
+			{
+				Frame_Pipeline p;
+				p.enabled = true;
+				p.kick([&] (Gl_Command_Buffer&) { _busy_ms(5); done = true; });
+			}
+			CHECK(done);
+		}
+	}
+
+	// ms per frame of a cpu heavy frame with and without the pipeline
+	//  sim_ms of tick and prepare work, 1 ms of frame() and a 6 ms sleeping submit that stands in for the driver and swap_buffers
+	//  the pipeline overlaps the sim with the submit, so it wins by about min(sim, submit) (less on a single core, where only the sleep overlaps)
+	void bench_frame_pipeline () {
+		const int frames = 60;
+		const flt frame_ms = 1, submit_ms = 6;
+
+		auto run = [&] (bool pipelined, flt sim_ms) {
+			Frame_Pipeline p;
+			Mock_Gl_Backend mock;
+			p.enabled = pipelined;
+
+			auto job = [&] (Gl_Command_Buffer& cmds) {
+				_busy_ms(sim_ms);
+				cmds.record([&] () { std::this_thread::sleep_for(std::chrono::microseconds((int)(submit_ms * 1000))); });
+			};
+
+			return time_ms([&] () {
+				for (int i=0; i<frames; ++i) {
+					p.wait();
+					_busy_ms(frame_ms);
+					if (pipelined) {
+						p.kick(job);
+						p.submit(mock);
+					} else {
+						p.run_serial(job, mock);
+					}
+				}
+				p.wait();
+			}, 1) / frames;
+		};
+
+		printf("frame_pipeline ms/frame (%u cores):", std::thread::hardware_concurrency());
+		for (flt sim_ms : { 2.0f, 6.0f, 12.0f })
+			printf("  sim %2.0f ms: serial %5.2f pipelined %5.2f", sim_ms, run(false, sim_ms), run(true, sim_ms));
+		printf("\n");
+	}
+}
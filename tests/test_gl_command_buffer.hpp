@@ -0,0 +1,197 @@
+#pragma once
+
+#include "tests.hpp"
+#include "3d_lib/gl_command_buffer.hpp"
+#include "mylibs/random.hpp"
+
+namespace tests {
+	using engine::Gl_Command_Buffer;
+	using engine::Mock_Gl_Backend;
+	using engine::Render_State;
+	using engine::Shader;
+	using engine::Gpu_Mesh;
+
+	// the buffer never dereferences shaders and meshes, addresses into these stand in for them
+	char _fake_shaders[64];
+	char _fake_meshes[64];
+	Shader* _shader (int i) {			return (Shader*)&_fake_shaders[i]; }
+	Gpu_Mesh const* _mesh (int i) {	return (Gpu_Mesh const*)&_fake_meshes[i]; }
+
+	static constexpr u32 _TRIANGLES = 4; // GL_TRIANGLES
+
+	int _shader_a_lookups = 0;
+	Shader* _shader_a () {		_shader_a_lookups++; return _shader(10); }
+	Shader* _shader_failed () {	return nullptr; } // like a shader that did not compile
+	Gpu_Mesh const* _mesh_a () {	return _mesh(10); }
+
+	bool _same_state (Render_State l, Render_State r) {
+		return l.blend == r.blend && l.depth_test == r.depth_test && l.depth_write == r.depth_write && l.cull == r.cull && l.scissor_test == r.scissor_test;
+	}
+
+	// the mesh of every draw in submit order
+	std::vector<Gpu_Mesh const*> _draw_meshes (Mock_Gl_Backend const& mock) {
+		std::vector<Gpu_Mesh const*> meshes;
+		for (auto& d : mock.draws)
+			meshes.push_back(d.mesh);
+		return meshes;
+	}
+
+	void test_gl_command_buffer () {
+		typedef Mock_Gl_Backend::Call Call;
+
+		Render_State opaque =	{ false, true, true, true, false };
+		Render_State blended =	{ true, true, false, false, false };
+
+		Gl_Command_Buffer cmds;
+		Mock_Gl_Backend mock;
+
+		{ // grouped by shader then texture, every draw still sees the state it was recorded with
+			Render_State states[8];
+			for (int i=0; i<8; ++i) {
+				states[i] = i % 3 == 0 ? blended : opaque;
+				cmds.draw(states[i], _shader(i % 2), _mesh(i), _TRIANGLES);
+				cmds.uniform("col", fv4(1));
+				cmds.texture("tex", 0, 0x0DE1, 100 +(i / 2) % 2); // GL_TEXTURE_2D
+			}
+			CHECK(cmds.size() == 8 && mock.calls.size() == 0); // recording makes no calls
+
+			cmds.submit(mock);
+			auto& s = cmds.stats;
+
+			CHECK(cmds.size() == 0); // submit clears
+			CHECK(s.draws == 8 && mock.draws.size() == 8);
+			CHECK(mock.count(Call::USE_SHADER) == 2 && s.shader == 2 && s.shader_elided == 6);
+			CHECK(mock.count(Call::BIND_TEXTURE) == s.texture && s.texture == 4); // 2 textures per shader group
+			CHECK(mock.count(Call::BIND_MESH) == 8); // all different meshes
+
+			// issued + elided is what setting the full state for every draw costs: 6 raster + shader + 1 texture + mesh per draw
+			CHECK(s.issued() +s.elided() == 8 * (6 +1 +1 +1));
+			CHECK(s.elided() > 0 && s.raster_elided > 0);
+			CHECK(mock.count(Call::SET_CAP) +mock.count(Call::DEPTH_MASK) +mock.count(Call::BLEND_FUNC) == s.raster);
+
+			for (int i=0; i<8; ++i) {
+				auto& d = mock.draws[i];
+				int recorded = (int)((char const*)d.mesh -_fake_meshes);
+				CHECK(d.shader == _shader(i < 4 ? 0 : 1));
+				CHECK(_same_state(d.state, states[recorded]));
+				CHECK(d.mesh_shader == d.shader);
+				CHECK(d.textures[0] == 100 +(u32)(recorded / 2) % 2);
+			}
+		}
+
+		mock.clear();
+		{ // uniforms are set after the shader and before the draw they belong to
+			cmds.draw(opaque, _shader(0), _mesh(0), _TRIANGLES);
+			cmds.uniform("a", 1.0f);
+			cmds.uniform("b", 2.0f);
+			cmds.draw(opaque, _shader(1), _mesh(1), _TRIANGLES);
+			cmds.uniform("c", 3);
+			cmds.submit(mock);
+
+			std::vector<Call::type_e> seq;
+			for (auto& c : mock.calls)
+				if (c.type == Call::USE_SHADER || c.type == Call::SET_UNIFORM || c.type == Call::DRAW)
+					seq.push_back(c.type);
+			CHECK(seq == std::vector<Call::type_e>({
+				Call::USE_SHADER, Call::SET_UNIFORM, Call::SET_UNIFORM, Call::DRAW,
+				Call::USE_SHADER, Call::SET_UNIFORM, Call::DRAW }));
+			CHECK(cmds.stats.uniforms == 3);
+		}
+
+		mock.clear();
+		{ // passes in order, front to back sorts by state first and depth second, back to front by depth only
+			cmds.set_pass_order(1, engine::BACK_TO_FRONT);
+
+			cmds.cur_pass = 1;
+			cmds.draw(blended, _shader(0), _mesh(11), _TRIANGLES, 1);
+			cmds.draw(blended, _shader(1), _mesh(15), _TRIANGLES, 5);
+			cmds.draw(blended, _shader(0), _mesh(13), _TRIANGLES, 3);
+
+			cmds.cur_pass = 0;
+			cmds.draw(opaque, _shader(1), _mesh(1), _TRIANGLES, 1);
+			cmds.draw(opaque, _shader(0), _mesh(5), _TRIANGLES, 5);
+			cmds.draw(opaque, _shader(0), _mesh(3), _TRIANGLES, 3);
+
+			cmds.submit(mock);
+			CHECK(_draw_meshes(mock) == std::vector<Gpu_Mesh const*>({ _mesh(3), _mesh(5), _mesh(1), _mesh(15), _mesh(13), _mesh(11) }));
+
+			cmds.set_pass_order(1, engine::FRONT_TO_BACK);
+		}
+
+		mock.clear();
+		{ // closures run in recording order, draws are not sorted across them and the cache forgets everything they could have changed
+			std::vector<uptr> closure_at; // draws submitted when the closure ran
+
+			cmds.draw(opaque, _shader(0), _mesh(5), _TRIANGLES, 5);
+			cmds.record([&] () { closure_at.push_back(mock.draws.size()); });
+			cmds.draw(opaque, _shader(1), _mesh(2), _TRIANGLES, 0);
+			cmds.draw(opaque, _shader(0), _mesh(1), _TRIANGLES, 1); // would sort before the first draw without the closure
+			cmds.record([&] () { closure_at.push_back(mock.draws.size()); });
+			CHECK(cmds.size() == 5 && closure_at.size() == 0);
+
+			cmds.submit(mock);
+			CHECK(closure_at == std::vector<uptr>({ 1, 3 }));
+			CHECK(_draw_meshes(mock) == std::vector<Gpu_Mesh const*>({ _mesh(5), _mesh(1), _mesh(2) })); // sorted only within the barrier
+			CHECK(cmds.stats.funcs == 2);
+			CHECK(mock.count(Call::USE_SHADER) == 3); // shader 0 is set again after the closure
+			CHECK(mock.count(Call::BLEND_FUNC) == 2); // full raster state after the closure
+		}
+
+		mock.clear();
+		{ // shader and mesh lookups run on submit, once per group of draws, a failed shader skips its draws
+			_shader_a_lookups = 0;
+
+			for (int i=0; i<3; ++i)
+				cmds.draw(opaque, _shader_a, _mesh_a, _TRIANGLES, (flt)i);
+			cmds.draw(opaque, _shader_failed, _mesh(1), _TRIANGLES);
+			cmds.draw(opaque, _shader(0), _mesh(0), _TRIANGLES);
+			CHECK(_shader_a_lookups == 0);
+
+			cmds.submit(mock);
+			CHECK(_shader_a_lookups == 1);
+			CHECK(cmds.stats.draws == 4 && mock.draws.size() == 4);
+			for (auto& d : mock.draws)
+				CHECK(d.mesh != _mesh(1));
+			CHECK(mock.draws[0].shader == _shader(10) && mock.draws[0].mesh == _mesh(10));
+		}
+	}
+
+	// submit of a frame worth of draws in random order, with few shaders, textures and meshes like a typical scene
+	void bench_gl_command_buffer () {
+		const int draws = 10000;
+
+		n_random::Generator g (0);
+		Render_State opaque =	{ false, true, true, true, false };
+		Render_State blended =	{ true, true, false, false, false };
+
+		Gl_Command_Buffer cmds;
+		Mock_Gl_Backend mock;
+		mock.calls.reserve(draws * 16);
+		mock.draws.reserve(draws);
+
+		struct Rand_Draw { int shader, tex, mesh; bool blend; flt depth; };
+		std::vector<Rand_Draw> scene (draws);
+		for (auto& d : scene)
+			d = { n_random::uniform(g, 0, 8), n_random::uniform(g, 0, 4), n_random::uniform(g, 0, 16), n_random::chance(g, 0.2f) != 0, n_random::uniform(g, 0.0f, 100.0f) };
+
+		auto record = [&] () {
+			for (auto& d : scene) {
+				cmds.draw(d.blend ? blended : opaque, _shader(d.shader), _mesh(d.mesh), _TRIANGLES, d.depth);
+				cmds.uniform("col", fv4(1));
+				cmds.texture("tex", 0, 0x0DE1, 100 +d.tex);
+			}
+		};
+
+		flt record_ms = time_ms([&] () { record(); cmds.clear(); });
+		flt submit_ms = time_ms([&] () {
+			mock.clear();
+			record();
+			cmds.submit(mock);
+		}) -record_ms;
+
+		auto& s = cmds.stats;
+		printf("gl_command_buffer %d draws: record %6.3f ms submit %6.3f ms, state changes issued %d elided %d (%.0f%%), use_shader %d bind_texture %d bind_mesh %d\n",
+			draws, record_ms, submit_ms, s.issued(), s.elided(), (flt)s.elided() / (flt)(s.issued() +s.elided()) * 100,
+			s.shader, s.texture, s.mesh);
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "tests.hpp"
+#include "mylibs/image_processing.hpp"
+
+namespace tests {
+	using namespace image_processing;
+
+	std::vector<u8> _test_image (s32v2 size, uptr pixel_size) {
+		std::vector<u8> img((uptr)size.x * size.y * pixel_size);
+		for (uptr i=0; i<img.size(); ++i)
+			img[i] = (u8)(i * 131 +7 +(i >> 8));
+		return img;
+	}
+
+	// dst(x,y) has to be src(get_src(x,y)) for every byte of every pixel
+	template <typename FUNC>
+	bool _matches (std::vector<u8> const& dst, std::vector<u8> const& src, uptr pixel_size, s32v2 src_size, s32v2 dst_size, FUNC get_src) {
+		for (int y=0; y<dst_size.y; ++y) {
+			for (int x=0; x<dst_size.x; ++x) {
+				s32v2 s = get_src(x, y);
+				if (memcmp(&dst[((uptr)y * dst_size.x +x) * pixel_size], &src[((uptr)s.y * src_size.x +s.x) * pixel_size], pixel_size) != 0)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// every kernel against the plain definition, for all specialized pixel sizes and some that use the generic path,
+	//  and sizes that are smaller than, equal to and not multiples of the sse2 blocks and the tiles
+	void test_image_processing () {
+		s32v2 sizes[] = { s32v2(1,1), s32v2(3,5), s32v2(7,9), s32v2(8,8), s32v2(16,16), s32v2(33,17), s32v2(100,37), s32v2(64,64), s32v2(129,250), s32v2(1000,1500) };
+		uptr pixel_sizes[] = { 1,2,3,4,5,6,8,12,16 };
+
+		for (s32v2 sz : sizes) {
+			for (uptr ps : pixel_sizes) {
+				int w = sz.x, h = sz.y;
+				auto src = _test_image(sz, ps);
+				std::vector<u8> dst (src.size());
+
+				copy_transpose(src.data(), dst.data(), ps, sz);
+				CHECK(_matches(dst, src, ps, sz, s32v2(h,w), [&] (int x, int y) { return s32v2(y, x); }));
+
+				copy_rotate_90(src.data(), dst.data(), ps, sz);
+				CHECK(_matches(dst, src, ps, sz, s32v2(h,w), [&] (int x, int y) { return s32v2(y, h -1 -x); }));
+
+				copy_rotate_270(src.data(), dst.data(), ps, sz);
+				CHECK(_matches(dst, src, ps, sz, s32v2(h,w), [&] (int x, int y) { return s32v2(w -1 -y, x); }));
+
+				dst = src;
+				inplace_rotate_180(dst.data(), ps, sz);
+				CHECK(_matches(dst, src, ps, sz, sz, [&] (int x, int y) { return s32v2(w -1 -x, h -1 -y); }));
+
+				dst = src;
+				flip_horizontal_inplace(dst.data(), ps, sz);
+				CHECK(_matches(dst, src, ps, sz, sz, [&] (int x, int y) { return s32v2(w -1 -x, y); }));
+
+				dst = src;
+				flip_vertical_inplace(dst.data(), (uptr)w * ps, h);
+				CHECK(_matches(dst, src, ps, sz, sz, [&] (int x, int y) { return s32v2(x, h -1 -y); }));
+
+				std::vector<u8> copy (src.size());
+				flip_vertical_copy(copy.data(), src.data(), (uptr)w * ps, h);
+				CHECK(copy == dst);
+			}
+		}
+	}
+
+	// 8K image, the common pixel sizes
+	void bench_image_processing () {
+		s32v2 sz = s32v2(7680, 4320);
+
+		for (uptr ps : { 1, 3, 4, 16 }) {
+			std::vector<u8> a ((uptr)sz.x * sz.y * ps, 1);
+			std::vector<u8> b (a.size(), 0);
+
+			printf("image_processing 8K %2llu byte pixels:  transpose %7.2f ms  rotate_90 %7.2f ms  rotate_270 %7.2f ms  rotate_180 %7.2f ms  flip_h %7.2f ms  flip_v %7.2f ms\n", (unsigned long long)ps,
+				time_ms([&] () { copy_transpose(a.data(), b.data(), ps, sz); }),
+				time_ms([&] () { copy_rotate_90(a.data(), b.data(), ps, sz); }),
+				time_ms([&] () { copy_rotate_270(a.data(), b.data(), ps, sz); }),
+				time_ms([&] () { inplace_rotate_180(a.data(), ps, sz); }),
+				time_ms([&] () { flip_horizontal_inplace(a.data(), ps, sz); }),
+				time_ms([&] () { flip_vertical_inplace(a.data(), (uptr)sz.x * ps, sz.y); }));
+		}
+	}
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "tests.hpp"
+#include "mylibs/intersect.hpp"
+#include "mylibs/random.hpp"
+
+namespace tests {
+	using namespace intersect;
+
+	// occupancy with and without the coarse mip plus a plain array for the callback raycast, sizes that are no multiple of the brick size on purpose
+	struct _Voxel_Scene {
+		iv3					size;
+		Voxel_Occupancy		occ, occ_no_mip;
+		std::vector<char>	voxels;
+
+		_Voxel_Scene (iv3 size, flt sphere_radius, flt noise, n_random::Generator& g): size{size} {
+			occ.init(size);
+			occ_no_mip.init(size, false);
+			voxels.assign((uptr)size.x * size.y * size.z, 0);
+
+			v3 center = (v3)size / 2;
+			iv3 p;
+			for (p.z=0; p.z<size.z; ++p.z)
+				for (p.y=0; p.y<size.y; ++p.y)
+					for (p.x=0; p.x<size.x; ++p.x) {
+						bool solid = (length((v3)p -center) < sphere_radius && n_random::chance(g, 0.3f)) || (p.y < 3 && n_random::chance(g, 0.5f)) || n_random::chance(g, noise);
+						if (solid) {
+							voxels[occ._index(p)] = 1;
+							occ.set(p, true);
+							occ_no_mip.set(p, true);
+						}
+					}
+		}
+		bool get (iv3 p) const {
+			return all(p >= 0 && p < size) && voxels[occ._index(p)];
+		}
+	};
+
+	// camera rays in 2x2 pixel tiles, so that every packet of 4 is coherent
+	void _camera_rays (v3 cam, v3 target, int res, flt max_dist, std::vector<v3>* pos, std::vector<v3>* dir, std::vector<flt>* dist) {
+		for (int i=0; i<res*res; ++i) {
+			int tile = i / 4, sub = i % 4;
+			int px = (tile % (res/2)) * 2 + sub % 2;
+			int py = (tile / (res/2)) * 2 + sub / 2;
+			pos->push_back(cam);
+			dir->push_back(normalize(target -cam + v3((flt)(px -res/2), (flt)(py -res/2), 0) * (64.0f / res)));
+			dist->push_back(max_dist);
+		}
+	}
+
+	bool _same_hit (Voxel_Hit const& a, bool hit, iv3 voxel, v3 pos, int face) {
+		return a.hit == hit && (!hit || (all(a.voxel == voxel) && all(a.pos == pos) && a.face == face));
+	}
+
+	// every Voxel_Occupancy raycast (scalar and packets, with and without skipping empty bricks) has to give exactly the result of the callback raycast
+	void test_intersect () {
+		n_random::Generator g (40);
+		_Voxel_Scene scene (iv3(61, 45, 58), 14, 0.001f, g);
+
+		std::vector<v3> pos, dir;
+		std::vector<flt> dist;
+		_camera_rays(v3(-10.5f, 60.3f, -20.1f), (v3)scene.size / 2, 64, 150, &pos, &dir, &dist);
+		_camera_rays(v3(30.2f, 40.7f, 20.5f), v3(30, 0, 40), 32, 150, &pos, &dir, &dist); // inside the grid
+
+		for (int i=0; i<20000; ++i) { // random rays, some starting on voxel boundaries or axis aligned
+			v3 p = v3(n_random::uniform(g, -10.0f, 70.0f), n_random::uniform(g, -10.0f, 55.0f), n_random::uniform(g, -10.0f, 70.0f));
+			v3 d = v3(n_random::uniform(g, -1.0f, 1.0f), n_random::uniform(g, -1.0f, 1.0f), n_random::uniform(g, -1.0f, 1.0f));
+			if (i % 5 == 0) d.y = 0;
+			if (i % 11 == 0) { d.x = 0; d.z = 0; }
+			if (i % 13 == 0) p = floor(p);
+			if (length(d) == 0) d = v3(1,0,0);
+			pos.push_back(p);
+			dir.push_back(d);
+			dist.push_back(i % 3 == 0 ? n_random::uniform(g, 0.0f, 40.0f) : 150);
+		}
+
+		uptr count = pos.size();
+		std::vector<Voxel_Hit> packets (count), packets_no_mip (count);
+		raycast_voxels(scene.occ, pos.data(), dir.data(), dist.data(), packets.data(), count);
+		raycast_voxels(scene.occ_no_mip, pos.data(), dir.data(), dist.data(), packets_no_mip.data(), count);
+
+		int hits = 0;
+		bool scalar = true, scalar_no_mip = true, packet = true, packet_no_mip = true;
+		for (uptr i=0; i<count; ++i) {
+			iv3 voxel = 0;
+			v3 hit_pos = 0;
+			int face = 0;
+			bool hit = raycast_voxels([&] (iv3 v, v3, int) { return scene.get(v); }, pos[i], dir[i], dist[i], &voxel, &hit_pos, &face);
+			hits += hit;
+
+			Voxel_Hit a, b;
+			raycast_voxels(scene.occ, pos[i], dir[i], dist[i], &a);
+			raycast_voxels(scene.occ_no_mip, pos[i], dir[i], dist[i], &b);
+			scalar = scalar && _same_hit(a, hit, voxel, hit_pos, face);
+			scalar_no_mip = scalar_no_mip && _same_hit(b, hit, voxel, hit_pos, face);
+			packet = packet && _same_hit(packets[i], hit, voxel, hit_pos, face);
+			packet_no_mip = packet_no_mip && _same_hit(packets_no_mip[i], hit, voxel, hit_pos, face);
+		}
+		CHECK(hits > (int)count / 10 && hits < (int)count * 9/10); // the scene is neither empty nor full
+		CHECK(scalar);
+		CHECK(scalar_no_mip);
+		CHECK(packet);
+		CHECK(packet_no_mip);
+
+		{ // partial packet at the end, the lanes past count are not written
+			std::vector<Voxel_Hit> partial (7);
+			partial[5].face = partial[6].face = 123;
+			raycast_voxels(scene.occ, pos.data(), dir.data(), dist.data(), partial.data(), 5);
+			bool same = true;
+			for (int i=0; i<5; ++i)
+				same = same && _same_hit(partial[i], packets[i].hit, packets[i].voxel, packets[i].pos, packets[i].face);
+			CHECK(same && partial[5].face == 123 && partial[6].face == 123);
+		}
+
+		{ // clearing voxels keeps the brick until update_mip
+			Voxel_Occupancy occ;
+			occ.init(iv3(9, 9, 9));
+			occ.set(iv3(5,1,1), true);
+			CHECK(!occ.brick_empty(iv3(4,0,0)) && occ.brick_empty(iv3(0,0,0)) && occ.brick_empty(iv3(8,8,8)));
+			occ.set(iv3(5,1,1), false);
+			CHECK(!occ.brick_empty(iv3(4,0,0)) && !occ.get(iv3(5,1,1)));
+			occ.update_mip();
+			CHECK(occ.brick_empty(iv3(4,0,0)));
+		}
+	}
+
+	// rays per second, mostly empty space with a sphere in the middle, like picking or shadow rays in a voxel world
+	void bench_intersect () {
+		n_random::Generator g (1);
+		_Voxel_Scene scene (iv3(128), 12, 0.00002f, g);
+
+		std::vector<v3> pos, dir;
+		std::vector<flt> dist;
+		_camera_rays(v3(3.5f, 100.3f, 2.1f), (v3)scene.size / 2, 256, 400, &pos, &dir, &dist);
+		uptr count = pos.size();
+		std::vector<Voxel_Hit> out (count);
+
+		volatile int sink = 0;
+		auto mrays = [&] (flt ms) { return (flt)count / ms * 1e-3f; };
+
+		flt callback = time_ms([&] () {
+			for (uptr i=0; i<count; ++i) {
+				iv3 voxel;
+				sink = sink + raycast_voxels([&] (iv3 v, v3, int) { return scene.get(v); }, pos[i], dir[i], dist[i], &voxel);
+			}
+		}, 3);
+		flt scalar_no_mip = time_ms([&] () {
+			for (uptr i=0; i<count; ++i)
+				raycast_voxels(scene.occ_no_mip, pos[i], dir[i], dist[i], &out[i]);
+		}, 3);
+		flt scalar = time_ms([&] () {
+			for (uptr i=0; i<count; ++i)
+				raycast_voxels(scene.occ, pos[i], dir[i], dist[i], &out[i]);
+		}, 3);
+		flt packet_no_mip = time_ms([&] () { raycast_voxels(scene.occ_no_mip, pos.data(), dir.data(), dist.data(), out.data(), count); }, 3);
+		flt packet = time_ms([&] () { raycast_voxels(scene.occ, pos.data(), dir.data(), dist.data(), out.data(), count); }, 3);
+
+		printf("intersect Mrays/s:  callback %5.2f  scalar %5.2f (no mip %5.2f)  packet %5.2f (no mip %5.2f)\n",
+			mrays(callback), mrays(scalar), mrays(scalar_no_mip), mrays(packet), mrays(packet_no_mip));
+	}
+}
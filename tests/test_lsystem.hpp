@@ -0,0 +1,124 @@
+#pragma once
+
+#include "tests.hpp"
+#include "mylibs/preprocessor_stuff.hpp"
+#include "mylibs/vector.hpp"
+#include "tiling_test/lsystem.hpp"
+
+namespace tests {
+	struct _Line_Vert { v3 pos; };
+
+	struct _Line {
+		v3	a, b;
+
+		bool operator< (_Line const& r) const {	return memcmp(this, &r, sizeof(_Line)) < 0; }
+		bool operator== (_Line const& r) const {	return memcmp(this, &r, sizeof(_Line)) == 0; }
+	};
+
+	// the recursive generation tiling_test used before Tree_Generator
+	void _lsystem_recurse (lsystem::Params const& p, std::vector<_Line>* lines, v2 pos, v2 dir, flt angle, flt size, int depth, int prev_dir=0) {
+		if (depth == p.max_depth) return;
+
+		flt ang_a = angle -p.angle_deg * p.factor;
+		flt ang_b = angle +p.angle_deg * p.factor;
+		flt ang_c = angle * (1 + p.factor);
+
+		v2 dir_a = rotate2(deg(+90 +ang_a)) * dir;
+		v2 dir_b = rotate2(deg(-90 +ang_b)) * dir;
+		v2 dir_c = rotate2(deg(ang_c)) * dir;
+
+		v2 pos_a = pos + dir_a * size * p.factor;
+		v2 pos_b = pos + dir_b * size * p.factor;
+		v2 pos_c = pos + dir_c * size * p.factor;
+
+		size *= p.factor;
+
+		if (prev_dir != -1) {
+			_lsystem_recurse(p, lines, pos_a, dir_a, ang_a, size, depth +1, -1);
+			lines->push_back({ v3(pos, 0), v3(pos_a, 0) });
+		}
+		if (prev_dir != +1) {
+			_lsystem_recurse(p, lines, pos_b, dir_b, ang_b, size, depth +1, +1);
+			lines->push_back({ v3(pos, 0), v3(pos_b, 0) });
+		}
+		_lsystem_recurse(p, lines, pos_c, dir_c, ang_c, size, depth +1, 0);
+		lines->push_back({ v3(pos, 0), v3(pos_c, 0) });
+	}
+
+	std::vector<_Line> _lsystem_reference (lsystem::Params const& p) {
+		std::vector<_Line> lines;
+		_lsystem_recurse(p, &lines, 0, v2(0,+1), 0, p.size, 0);
+		std::sort(lines.begin(), lines.end());
+		return lines;
+	}
+
+	// the lines in any order, the breadth first and parallel generation orders them differently than the recursion
+	std::vector<_Line> _lsystem_lines (std::vector<_Line_Vert> const& verts) {
+		std::vector<_Line> lines (verts.size() / 2);
+		for (uptr i=0; i<lines.size(); ++i)
+			lines[i] = { verts[i*2].pos, verts[i*2 +1].pos };
+		std::sort(lines.begin(), lines.end());
+		return lines;
+	}
+
+	void test_lsystem () {
+		lsystem::Params p;
+		p.angle_deg = 27;
+
+		// depth 3 stays on the calling thread, 14 (471k lines) expands its subtrees with parallel_for
+		for (int depth : { 0, 1, 3, 8, 14 }) {
+			p.max_depth = depth;
+
+			lsystem::Tree_Generator gen;
+			std::vector<_Line_Vert> verts;
+			CHECK(gen.generate(p, &verts));
+
+			auto ref = _lsystem_reference(p);
+			CHECK(gen.line_count == ref.size() && verts.size() == ref.size() * 2);
+			CHECK(_lsystem_lines(verts) == ref);
+		}
+
+		{ // same params hit the cache and do not touch the output, any changed param regenerates
+			p.max_depth = 5;
+
+			lsystem::Tree_Generator gen;
+			std::vector<_Line_Vert> verts;
+			CHECK(gen.generate(p, &verts));
+			uptr lines = gen.line_count;
+
+			std::vector<_Line_Vert> untouched (3, { v3(-1) });
+			CHECK(!gen.generate(p, &untouched));
+			CHECK(untouched.size() == 3 && untouched[0].pos.x == -1 && gen.line_count == lines);
+
+			p.factor = 0.5f;
+			CHECK(gen.generate(p, &verts) && _lsystem_lines(verts) == _lsystem_reference(p));
+
+			p.max_depth = 6;
+			CHECK(gen.generate(p, &verts) && gen.line_count > lines);
+		}
+	}
+
+	// generate vs the recursion at the depths the tiling_test ui allows
+	void bench_lsystem () {
+		lsystem::Params p;
+
+		for (int depth : { 12, 14, 16 }) {
+			p.max_depth = depth;
+
+			std::vector<_Line_Vert> verts;
+			flt gen_ms = time_ms([&] () {
+				lsystem::Tree_Generator gen; // new generator, so the cache never hits
+				gen.generate(p, &verts);
+			});
+
+			std::vector<_Line> lines;
+			flt recurse_ms = time_ms([&] () {
+				lines.clear();
+				_lsystem_recurse(p, &lines, 0, v2(0,+1), 0, p.size, 0);
+			});
+
+			printf("lsystem depth %2d (%8llu lines): generate %7.2f ms  recursive %7.2f ms\n",
+				depth, (unsigned long long)lines.size(), gen_ms, recurse_ms);
+		}
+	}
+}
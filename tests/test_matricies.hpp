@@ -0,0 +1,129 @@
+#pragma once
+
+#include "tests.hpp"
+#include "mylibs/vector.hpp"
+#include "mylibs/random.hpp"
+#include "test_vector_simd.hpp" // _rand_*
+
+namespace tests {
+
+	flt _max_diff (fm4 const& a, fm4 const& b) {
+		flt d = 0;
+		for (int i=0; i<4; ++i)
+			d = std::max(d, max_component(abs(a.arr[i] -b.arr[i])));
+		return d;
+	}
+	fhm _rand_affine (n_random::Generator& g) { // translation, rotation and non uniform scale
+		return translateH(_rand_v3(g) * 10) * convert_to_hm(_rand_quat(g)) * scaleH(fv3(0.2f) +abs(_rand_v3(g)) * 3);
+	}
+	fhm _rand_rigid (n_random::Generator& g) {
+		return translateH(_rand_v3(g) * 10) * convert_to_hm(_rand_quat(g));
+	}
+
+	// M * inverse(M) has to be the identity, for well conditioned random matricies
+	void test_matricies () {
+		n_random::Generator g (39);
+
+		flt err_m3 = 0, err_m4 = 0, err_hm = 0, err_affine = 0, err_rigid = 0, err_rigid_general = 0;
+		for (int i=0; i<10000; ++i) {
+			fm3 m = fm3::rows(_rand_v3(g), _rand_v3(g), _rand_v3(g));
+			if (fabsf(dot(m.arr[0], cross(m.arr[1], m.arr[2]))) > 0.1f) // skip nearly singular ones
+				err_m3 = std::max(err_m3, _max_diff(fm4(m * inverse(m)), fm4::ident()));
+
+			fm4 n = _rand_m4(g);
+			fm4 ni = inverse(n);
+			flt cond = 0; // max element of n times max element of its inverse, a cheap bound on the condition
+			{
+				flt a = 0, b = 0;
+				for (int c=0; c<4; ++c) {
+					a = std::max(a, max_component(abs(n.arr[c])));
+					b = std::max(b, max_component(abs(ni.arr[c])));
+				}
+				cond = a * b;
+			}
+			if (cond < 50)
+				err_m4 = std::max(err_m4, _max_diff(n * ni, fm4::ident()));
+
+			fhm h = _rand_affine(g);
+			err_hm = std::max(err_hm, _max_diff((h * inverse(h)).m4(), fm4::ident()));
+			err_affine = std::max(err_affine, _max_diff(h.m4() * inverse_affine(h.m4()), fm4::ident()));
+
+			fhm r = _rand_rigid(g);
+			err_rigid = std::max(err_rigid, _max_diff((r * inverse_rigid(r)).m4(), fm4::ident()));
+			err_rigid_general = std::max(err_rigid_general, _max_diff(inverse(r.m4()), inverse_rigid(r).m4()));
+		}
+		CHECK(err_m3 < 1e-4f);
+		CHECK(err_m4 < 1e-4f);
+		CHECK(err_hm < 1e-4f);
+		CHECK(err_affine < 1e-4f);
+		CHECK(err_rigid < 1e-5f);
+		CHECK(err_rigid_general < 1e-4f);
+
+		{
+			fm4 n = fm4::rows(1,2,3,4, 5,6,7,8, 9,10,11,12, 13,14,15,16);
+			fm4 t = transpose(n);
+			CHECK(t.arr[0].y == 2 && t.arr[1].x == 5 && t.arr[3].x == 13 && t.arr[0].w == 4);
+			fm3 m = fm3::rows(1,2,3, 4,5,6, 7,8,9);
+			CHECK(_max_diff(fm4(transpose(m)), fm4(fm3::rows(1,4,7, 2,5,8, 3,6,9))) == 0);
+		}
+
+		// batch inverse (4 at a time with VECTOR_SIMD) against the single one, counts around the blocks, and in place
+		for (uptr count : { 0, 1, 3, 4, 5, 1003 }) {
+			std::vector<fhm> hs (count), out (count);
+			for (auto& h : hs) h = _rand_affine(g);
+
+			inverse(hs.data(), out.data(), count);
+			flt err_batch = 0;
+			for (uptr i=0; i<count; ++i)
+				err_batch = std::max(err_batch, _max_diff(out[i].m4(), inverse(hs[i]).m4()));
+			CHECK(err_batch < 1e-4f);
+
+			auto in_place = hs;
+			inverse(in_place.data(), in_place.data(), count);
+			CHECK(memcmp(in_place.data(), out.data(), count * sizeof(fhm)) == 0);
+		}
+
+		{ // world_to_model of a rotated and translated model has to undo model_to_world (Ship::calc_matricies)
+			fv3 pos = fv3(3,-2,5);
+			fhm model_to_world = translateH(pos) * convert_to_hm(rotateQ_Z(deg(30)));
+			fhm world_to_model = inverse_rigid(model_to_world);
+			fv3 p = fv3(1,2,3);
+			CHECK(length(world_to_model * (model_to_world * p) -p) < 1e-5f);
+		}
+	}
+
+	void bench_matricies () {
+		n_random::Generator g (1);
+
+		std::vector<fm4> ms (64);
+		for (auto& m : ms) m = _rand_affine(g).m4();
+		std::vector<fhm> hs (1 << 14), out (1 << 14);
+		for (auto& h : hs) h = _rand_affine(g);
+
+		volatile flt sink = 0;
+		const int N = 1 << 21;
+		auto ns = [&] (flt ms, int count) { return ms * 1e6f / (flt)count; };
+
+		flt m4 = time_ms([&] () {
+			for (int i=0; i<N; ++i) { fm4 r = inverse(ms[i & 63]); sink = r.arr[0].x + r.arr[3].x; }
+		}, 3);
+		flt affine = time_ms([&] () {
+			for (int i=0; i<N; ++i) { fm4 r = inverse_affine(ms[i & 63]); sink = r.arr[0].x + r.arr[3].x; }
+		}, 3);
+		flt hm = time_ms([&] () {
+			for (int i=0; i<N; ++i) { fhm r = inverse(hs[i & 63]); sink = r.mat.arr[0].x + r.transl.x; }
+		}, 3);
+		flt rigid = time_ms([&] () {
+			for (int i=0; i<N; ++i) { fhm r = inverse_rigid(hs[i & 63]); sink = r.mat.arr[0].x + r.transl.x; }
+		}, 3);
+		flt batch = time_ms([&] () { inverse(hs.data(), out.data(), hs.size()); }, 20);
+		flt loop = time_ms([&] () {
+			for (uptr i=0; i<hs.size(); ++i)
+				out[i] = inverse(hs[i]);
+			sink = out[7].transl.x;
+		}, 20);
+
+		printf("matricies (VECTOR_SIMD %d) ns/op:  inverse m4 %5.2f  inverse_affine m4 %5.2f  inverse hm %5.2f  inverse_rigid hm %5.2f  batch inverse hm %5.2f (loop %5.2f)\n", VECTOR_SIMD,
+			ns(m4, N), ns(affine, N), ns(hm, N), ns(rigid, N), ns(batch, (int)hs.size()), ns(loop, (int)hs.size()));
+	}
+}
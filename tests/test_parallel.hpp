@@ -0,0 +1,70 @@
+#pragma once
+
+#include "tests.hpp"
+#include "mylibs/parallel.hpp"
+
+#include <atomic>
+#include <thread>
+
+namespace tests {
+
+	// every index has to be visited exactly once, also for nested and concurrent parallel_for calls
+	void test_parallel () {
+		for (sptr count : { 0, 1, 2, 7, 1000, 100000 }) {
+			for (sptr min_per_thread : { 1, 3, 100000 }) {
+				std::vector<int> visited (count, 0);
+				parallel_for(count, [&] (sptr begin, sptr end) {
+					for (sptr i=begin; i<end; ++i)
+						visited[i]++;
+				}, min_per_thread);
+				CHECK(std::all_of(visited.begin(), visited.end(), [] (int v) { return v == 1; }));
+			}
+		}
+
+		{ // nested
+			std::vector<std::atomic<int>> visited (64 * 64);
+			parallel_for(64, [&] (sptr begin, sptr end) {
+				for (sptr i=begin; i<end; ++i) {
+					parallel_for(64, [&] (sptr b, sptr e) {
+						for (sptr j=b; j<e; ++j)
+							visited[i * 64 +j]++;
+					});
+				}
+			});
+			CHECK(std::all_of(visited.begin(), visited.end(), [] (std::atomic<int> const& v) { return v == 1; }));
+		}
+
+		{ // concurrent from threads that are not workers
+			std::atomic<sptr> sum {0};
+			std::vector<std::thread> threads;
+			for (int t=0; t<4; ++t) {
+				threads.emplace_back([&] () {
+					for (int rep=0; rep<100; ++rep) {
+						parallel_for(1000, [&] (sptr begin, sptr end) {
+							sptr s = 0;
+							for (sptr i=begin; i<end; ++i)
+								s += i;
+							sum += s;
+						});
+					}
+				});
+			}
+			for (auto& t : threads)
+				t.join();
+			CHECK(sum == (sptr)4 * 100 * (999 * 1000 / 2));
+		}
+	}
+
+	// cost of handing a tiny job to the pool
+	void bench_parallel () {
+		int calls = 10000;
+		std::atomic<sptr> sink {0};
+
+		flt ms = time_ms([&] () {
+			for (int i=0; i<calls; ++i)
+				parallel_for(parallel::thread_count(), [&] (sptr begin, sptr end) { sink += end -begin; });
+		}, 3);
+
+		printf("parallel_for with %d threads: %.2f us per call\n", parallel::thread_count(), ms * 1000 / calls);
+	}
+}
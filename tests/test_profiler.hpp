@@ -0,0 +1,103 @@
+#pragma once
+
+#include "tests.hpp"
+#include "mylibs/profiler.hpp"
+
+#include <thread>
+
+namespace tests {
+
+	// tid and buffer index of a short lived thread that records one zone
+	struct _Zone_Thread {
+		u32		tid;
+		u32		indx;
+	};
+	_Zone_Thread _record_on_thread (cstr zone_name) {
+		_Zone_Thread res;
+		std::thread t ([&] () {
+			profiler::Zone z (zone_name);
+			res.tid = profiler::thread_buffer()->tid;
+			res.indx = profiler::thread_buffer()->indx;
+		});
+		t.join();
+		return res;
+	}
+
+	bool _has_zone (profiler::Thread_Zones const& tz, cstr name) {
+		return std::any_of(tz.nodes.begin(), tz.nodes.end(), [&] (profiler::Zone_Node const& n) { return n.name && strcmp(n.name, name) == 0; });
+	}
+
+	void test_profiler () {
+		auto& p = profiler::get_profiler();
+		profiler::frame(); // collect whatever other tests left in the buffers
+
+		p.start_recording();
+
+		{ // a buffer reused by the next thread gets a new tid, so the zones of both threads are not merged
+			auto a = _record_on_thread("zone a");
+			auto b = _record_on_thread("zone b"); // before frame(), so the events of a are still in the buffer
+			CHECK(a.indx == b.indx);
+			CHECK(a.tid != b.tid);
+
+			profiler::frame();
+
+			auto& tz = p.zones[b.indx];
+			CHECK(tz.tid == b.tid);
+			CHECK(_has_zone(tz, "zone b"));
+			CHECK(!_has_zone(tz, "zone a"));
+		}
+
+		{
+			PROFILE_SCOPED("quote \" backslash \\ tab \t");
+		}
+		profiler::set_thread_name("main \"thread\"");
+		profiler::frame();
+
+		std::string path = "tests_tmp_profiler_trace.json";
+		CHECK(p.write_chrome_trace(path.c_str()));
+
+		std::string json;
+		CHECK(simple_file_io::load_text_file(path.c_str(), &json));
+		remove(path.c_str());
+
+		CHECK(json.find("\"name\":\"quote \\\" backslash \\\\ tab \\u0009\"") != std::string::npos);
+		CHECK(json.find("\"name\":\"main \\\"thread\\\"\"") != std::string::npos);
+
+		{ // frame markers are on the thread that called frame()
+			std::string marker = "\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":" + std::to_string(profiler::thread_buffer()->tid) + ",";
+			CHECK(json.find(marker) != std::string::npos);
+		}
+
+		{ // every event of the two threads is on its own tid
+			auto a = std::string("{\"name\":\"zone a\",\"ph\":\"X\",\"pid\":0,\"tid\":");
+			auto b = std::string("{\"name\":\"zone b\",\"ph\":\"X\",\"pid\":0,\"tid\":");
+			uptr pa = json.find(a), pb = json.find(b);
+			CHECK(pa != std::string::npos && pb != std::string::npos);
+			if (pa != std::string::npos && pb != std::string::npos)
+				CHECK(atoi(json.c_str() +pa +a.size()) != atoi(json.c_str() +pb +b.size()));
+		}
+
+		// valid json as far as strings go: every quote that is not escaped opens or closes a string, so there is an even number of them
+		int quotes = 0;
+		for (uptr i=0; i<json.size(); ++i) {
+			if (json[i] == '\\') { ++i; continue; }
+			if (json[i] == '"') quotes++;
+		}
+		CHECK(quotes % 2 == 0);
+	}
+
+	// cost of a zone on the recording thread
+	void bench_profiler () {
+		int count = 1000000;
+		flt ms = time_ms([&] () {
+			for (int i=0; i<count; ++i) {
+				PROFILE_SCOPED("bench zone");
+				if ((i & 4095) == 0)
+					profiler::frame(); // keep the ring buffer from filling up
+			}
+		}, 3);
+		profiler::frame();
+
+		printf("profiler: %d zones %8.2f ms, %6.1f ns per zone\n", count, ms, ms * 1e6f / (flt)count);
+	}
+}
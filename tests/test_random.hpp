@@ -0,0 +1,217 @@
+#pragma once
+
+#include "tests.hpp"
+#include "mylibs/random.hpp"
+
+#include <climits>
+#include <cmath>
+
+namespace tests {
+
+	// chi squared of x[n] in [0,1) over 256 buckets (255 degrees of freedom, so ~255 expected, > 350 is very unlikely)
+	double _chi2_uniform (flt const* x, uptr n) {
+		std::vector<double> buckets (256, 0);
+		for (uptr i=0; i<n; ++i)
+			buckets[std::min((int)(x[i] * 256), 255)]++;
+		double expect = (double)n / 256, chi2 = 0;
+		for (double b : buckets)
+			chi2 += (b -expect) * (b -expect) / expect;
+		return chi2;
+	}
+	void _moments (flt const* x, uptr n, double* mean, double* var, double* kurtosis) {
+		double sum = 0, sum2 = 0, sum4 = 0;
+		for (uptr i=0; i<n; ++i)
+			sum += x[i];
+		*mean = sum / n;
+		for (uptr i=0; i<n; ++i) {
+			double d = x[i] -*mean;
+			sum2 += d*d;
+			sum4 += d*d*d*d;
+		}
+		*var = sum2 / n;
+		*kurtosis = sum4 / n / (*var * *var);
+	}
+	// normalized correlation of two uniform streams
+	double _correlation (n_random::Generator a, n_random::Generator b, int n=1000000) {
+		double sum = 0;
+		for (int i=0; i<n; ++i)
+			sum += (a.next_flt() -0.5) * (b.next_flt() -0.5);
+		return sum / (n / 12.0);
+	}
+	bool _all_in (flt const* x, uptr n, flt min, flt max) { // [min,max)
+		return std::all_of(x, x +n, [&] (flt f) { return f >= min && f < max; });
+	}
+
+	void test_random () {
+		const uptr N = 1 << 22;
+		std::vector<flt> a (N);
+
+		n_random::Generator g (123);
+
+		{ // uniform, scalar and batched
+			double mean, var, kurt;
+
+			for (uptr i=0; i<N; ++i)
+				a[i] = n_random::uniform(g, 0.0f, 1.0f);
+			_moments(a.data(), N, &mean, &var, &kurt);
+			CHECK(_chi2_uniform(a.data(), N) < 350 && fabs(mean -0.5) < 1e-3 && fabs(var -1/12.0) < 1e-3);
+
+			n_random::fill_uniform(g, a.data(), N);
+			_moments(a.data(), N, &mean, &var, &kurt);
+			CHECK(_all_in(a.data(), N, 0, 1));
+			CHECK(_chi2_uniform(a.data(), N) < 350 && fabs(mean -0.5) < 1e-3 && fabs(var -1/12.0) < 1e-3);
+
+			for (uptr lag : { 1, 8 }) {
+				double corr = 0;
+				for (uptr i=0; i +lag < N; ++i)
+					corr += (a[i] -0.5) * (a[i +lag] -0.5);
+				CHECK(fabs(corr / (N / 12.0)) < 3e-3);
+			}
+		}
+
+		{ // max is never returned, even where the multiply-add rounds up to it (here for ~3% of the values, the flt spacing around 1e6 is 1/16)
+			flt min = 1e6f, max = 1e6f +1;
+			bool ok = true;
+			for (int i=0; i<100000; ++i) {
+				flt f = n_random::uniform(g, min, max);
+				ok = ok && f >= min && f < max;
+			}
+			CHECK(ok);
+
+			n_random::fill_uniform(g, a.data(), 100000, min, max);
+			CHECK(_all_in(a.data(), 100000, min, max));
+
+			n_random::fill_uniform(g, a.data(), 100000, 0.1f, 0.3f);
+			CHECK(_all_in(a.data(), 100000, 0.1f, 0.3f));
+		}
+
+		{ // a count that is not a multiple of the block size does not write past the end
+			flt t[13];
+			for (auto& f : t) f = -1;
+			n_random::Generator h (5);
+			n_random::fill_uniform(h, t, 11, 2, 3);
+			CHECK(_all_in(t, 11, 2, 3) && t[11] == -1 && t[12] == -1);
+		}
+
+		{ // normal
+			double mean, var, kurt;
+
+			for (uptr i=0; i<N; ++i)
+				a[i] = n_random::normal(g, 1.0f);
+			_moments(a.data(), N, &mean, &var, &kurt);
+			CHECK(fabs(mean) < 3e-3 && fabs(var -1) < 5e-3 && fabs(kurt -3) < 3e-2);
+
+			n_random::fill_normal(g, a.data(), N -1, 2.0f, 1.0f); // odd count
+			_moments(a.data(), N -1, &mean, &var, &kurt);
+			CHECK(fabs(mean -1) < 6e-3 && fabs(var -4) < 2e-2 && fabs(kurt -3) < 3e-2);
+		}
+
+		{ // int
+			std::vector<double> buckets (7, 0);
+			const int M = 7000000;
+			bool in_range = true;
+			for (int i=0; i<M; ++i) {
+				int r = n_random::uniform(g, -3, 4);
+				in_range = in_range && r >= -3 && r < 4;
+				if (in_range) buckets[r +3]++;
+			}
+			double expect = M / 7.0, chi2 = 0;
+			for (double b : buckets)
+				chi2 += (b -expect) * (b -expect) / expect;
+			CHECK(in_range && chi2 < 25);
+
+			int negative = 0;
+			for (int i=0; i<1000000; ++i)
+				negative += n_random::uniform(g, INT_MIN, INT_MAX) < 0;
+			CHECK(abs(negative -500000) < 5000);
+
+			int hits = 0;
+			for (int i=0; i<1000000; ++i)
+				hits += n_random::chance(g, 0.25f);
+			CHECK(abs(hits -250000) < 3000);
+		}
+
+		// independent streams
+		CHECK(fabs(_correlation(n_random::Generator(1, 0), n_random::Generator(1, 1))) < 5e-3);
+		{
+			n_random::Generator base (7);
+			auto s0 = base.split();
+			auto s1 = base.split();
+			CHECK(fabs(_correlation(s0, s1)) < 5e-3);
+		}
+
+		{ // reproducible per seed and stream
+			n_random::Generator x (9, 3), y (9, 3), z (9, 4);
+			bool same = true;
+			for (int i=0; i<1000; ++i)
+				same = same && x.next() == y.next();
+			CHECK(same);
+			CHECK(z.next() != n_random::Generator(9, 3).next());
+		}
+
+		{ // any integer type seeds the same generator
+			long l = 5;
+			unsigned short us = 5;
+			CHECK(n_random::Generator(l).next() == n_random::Generator(5).next());
+			CHECK(n_random::Generator(us).next() == n_random::Generator(5u).next());
+			CHECK(n_random::Generator(5ull).next() == n_random::Generator(5).next());
+		}
+
+		{ // known answer of the xoshiro256** reference implementation for the state {1,2,3,4}
+			n_random::Generator x (0);
+			x.s[0] = 1; x.s[1] = 2; x.s[2] = 3; x.s[3] = 4;
+			CHECK(x.next() == 11520);
+			CHECK(x.next() == 0);
+			CHECK(x.next() == 1509978240);
+			CHECK(x.next() == 1215971899390074240ull);
+		}
+
+		{ // the sse2 and the scalar batch version give the same output (build with RANDOM_SSE2 0 to check the other one)
+			n_random::Generator x (42);
+			flt b[1000];
+			n_random::fill_uniform(x, b, 1000);
+			double checksum = 0;
+			for (int i=0; i<1000; ++i)
+				checksum += b[i] * (i +1);
+			CHECK(fabs(checksum -257947.315197825) < 1e-3);
+		}
+	}
+
+	// ns per value of std::default_random_engine with a distribution per call (what random.hpp used before), the scalar calls and the batch fill
+	void bench_random () {
+		const uptr N = 1 << 24;
+		std::vector<flt> a (N);
+		n_random::Generator g (1);
+		std::default_random_engine e (1);
+
+		volatile flt sink = 0;
+		auto ns = [&] (flt ms) { return ms * 1e6f / (flt)N; };
+
+		flt std_uniform = time_ms([&] () {
+			flt sum = 0;
+			for (uptr i=0; i<N; ++i) { std::uniform_real_distribution<flt> d (0, 1); sum += d(e); }
+			sink = sink + sum;
+		}, 1);
+		flt scalar_uniform = time_ms([&] () {
+			flt sum = 0;
+			for (uptr i=0; i<N; ++i) sum += n_random::uniform(g, 0.0f, 1.0f);
+			sink = sink + sum;
+		}, 1);
+		flt fill_uniform = time_ms([&] () { n_random::fill_uniform(g, a.data(), N); }, 1);
+
+		flt std_normal = time_ms([&] () {
+			flt sum = 0;
+			for (uptr i=0; i<N; ++i) { std::normal_distribution<flt> d (0, 1); sum += d(e); }
+			sink = sink + sum;
+		}, 1);
+		flt scalar_normal = time_ms([&] () {
+			flt sum = 0;
+			for (uptr i=0; i<N; ++i) sum += n_random::normal(g, 1.0f);
+			sink = sink + sum;
+		}, 1);
+		flt fill_normal = time_ms([&] () { n_random::fill_normal(g, a.data(), N); }, 1);
+
+		printf("random uniform ns/value:  std %6.2f  scalar %6.2f  fill %6.2f\n", ns(std_uniform), ns(scalar_uniform), ns(fill_uniform));
+		printf("random normal  ns/value:  std %6.2f  scalar %6.2f  fill %6.2f\n", ns(std_normal), ns(scalar_normal), ns(fill_normal));
+	}
+}
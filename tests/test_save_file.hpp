@@ -0,0 +1,207 @@
+#pragma once
+
+#include "tests.hpp"
+#include "mylibs/random.hpp"
+
+// save_file.hpp expects what engine_include.hpp provides, without the gl and window parts
+#include <memory>
+using std::unique_ptr;
+using std::make_unique;
+
+#include "mylibs/vector.hpp"
+#include "mylibs/simple_file_io.hpp"
+#include "mylibs/string.hpp"
+#include "mylibs/parse.hpp"
+
+static constexpr bool not_implemented = false;
+
+namespace engine {
+	using namespace basic_typedefs;
+	using namespace vector;
+	using namespace float_precision;
+	using namespace string;
+	using namespace simple_file_io;
+}
+#include "3d_lib/save_file.hpp"
+
+namespace tests {
+	using engine::Save;
+
+	// one of each value type, structs and arrays
+	struct _Save_Obj {
+		int					i;
+		iv3					iv;
+		flt					f;
+		v3					v;
+		v4					angles;
+		bool				b;
+		bv2					bb;
+		std::string			s;
+		std::vector<flt>	arr;
+
+		bool operator== (_Save_Obj const& r) const { // bit exact
+			return	i == r.i && all(iv == r.iv) && memcmp(&f, &r.f, sizeof(f)) == 0 && memcmp(&v, &r.v, sizeof(v)) == 0 && memcmp(&angles, &r.angles, sizeof(angles)) == 0 &&
+					b == r.b && bb.x == r.bb.x && bb.y == r.bb.y && s == r.s && arr == r.arr;
+		}
+	};
+
+	std::vector<_Save_Obj> _save_objs (int count, u64 seed) {
+		n_random::Generator g (seed);
+		std::vector<_Save_Obj> objs (count);
+		for (auto& o : objs) {
+			o.i = n_random::uniform(g, -100000, 100000);
+			o.iv = iv3(n_random::uniform(g, -1000, 1000), 7, -5);
+			o.f = n_random::uniform(g, -1000.0f, 1000.0f);
+			o.v = v3(n_random::uniform(g, -1.0f, 1.0f), 1.0f / 3, 1e-7f);
+			o.angles = v4(0.5f, -1, 3.14159f, n_random::uniform(g, -3.0f, 3.0f));
+			o.b = n_random::chance(g) != 0;
+			o.bb = bv2(true, n_random::chance(g) != 0);
+			o.s = "str " + std::to_string(n_random::uniform(g, 0, 1000));
+			o.arr.resize(n_random::uniform(g, 0, 8));
+			for (auto& a : o.arr)
+				a = n_random::uniform(g, -1.0f, 1.0f);
+		}
+		return objs;
+	}
+
+	// what an app does every frame, loads into objs if s.trigger_load
+	void _save_frame (Save& s, std::vector<_Save_Obj>& objs) {
+		s.begin_frame();
+		for (uptr k=0; k<objs.size(); ++k) {
+			auto& o = objs[k];
+			s.begin(("obj" + std::to_string(k)).c_str());
+				s.value("i", &o.i);
+				s.value("iv", &o.iv);
+				s.value("f", &o.f);
+				s.value("v", &o.v);
+				s.angle("angles", &o.angles);
+				s.value("b", &o.b);
+				s.value("bb", &o.bb);
+				s.value("s", &o.s);
+				s.begin_array("arr", &o.arr);
+				for (auto& a : o.arr)
+					s.value("e", &a);
+				s.end_array();
+			s.end();
+		}
+		s.end_frame();
+		s.trigger_load = false;
+	}
+
+	Save* _new_save (std::string const& filepath, Save::format_e format) {
+		auto* s = new Save; // Save is not movable (its writer thread)
+		s->filepath = filepath;
+		s->format = format;
+		s->trigger_load = false;
+		s->trigger_save = false;
+		return s;
+	}
+
+	// xml -> binary -> xml gives the same text, and loading either file gives back the exact values
+	void test_save_file () {
+		std::string root = "tests_tmp_save_file/";
+		remove_tree(root);
+		make_dir(root);
+
+		auto objs = _save_objs(50, 1);
+
+		unique_ptr<Save> a (_new_save(root +"a", Save::XML));
+		_save_frame(*a, objs);
+		CHECK(a->to_xml());
+		std::string xml = Save::print_xml(a->root_children);
+
+		{ // loaded xml (values still untyped strings) -> binary -> xml
+			unique_ptr<Save> b (_new_save(root +"a", Save::XML));
+			CHECK(b->from_xml());
+			CHECK(Save::print_xml(b->root_children) == xml);
+
+			std::vector<char> bin;
+			b->to_binary(&bin);
+
+			unique_ptr<Save> c (_new_save(root +"c", Save::BINARY));
+			CHECK(c->from_binary(bin.data(), bin.size()));
+			CHECK(Save::print_xml(c->root_children) == xml);
+		}
+
+		{ // typed tree -> binary file -> typed values, bit exact
+			a->filepath = root +"a";
+			CHECK(a->to_binary_file());
+
+			unique_ptr<Save> b (_new_save(root +"a", Save::BINARY));
+			b->trigger_load = true;
+			auto loaded = _save_objs(50, 2);
+			_save_frame(*b, loaded);
+			CHECK(loaded == objs);
+			CHECK(Save::print_xml(b->root_children) == xml);
+		}
+
+		{ // xml file -> typed values
+			unique_ptr<Save> b (_new_save(root +"a", Save::XML));
+			b->trigger_load = true;
+			auto loaded = _save_objs(50, 3);
+			_save_frame(*b, loaded);
+			for (uptr k=0; k<objs.size(); ++k) { // printed with %g, so floats are only close
+				CHECK(loaded[k].i == objs[k].i && loaded[k].s == objs[k].s && loaded[k].arr.size() == objs[k].arr.size());
+				CHECK(fabsf(loaded[k].f -objs[k].f) <= fabsf(objs[k].f) * 1e-5f);
+			}
+		}
+
+		{ // truncated and wrong files are rejected without touching the tree
+			std::vector<char> bin;
+			a->to_binary(&bin);
+
+			unique_ptr<Save> b (_new_save(root +"b", Save::BINARY));
+			CHECK(!b->from_binary(bin.data(), bin.size() / 2));
+			CHECK(!b->from_binary(xml.data(), xml.size() & ~(uptr)3));
+			CHECK(b->root_children.size() == 0);
+		}
+
+		remove_tree(root);
+	}
+
+	// save and load of a big file, xml vs binary, the first frame after a load includes converting the loaded values to their types
+	void bench_save_file () {
+		std::string root = "tests_tmp_save_file_bench/";
+		remove_tree(root);
+		make_dir(root);
+
+		const int count = 5000;
+		auto objs = _save_objs(count, 1);
+
+		unique_ptr<Save> s (_new_save(root +"save", Save::XML));
+		_save_frame(*s, objs);
+
+		flt save_ms[2], load_ms[2], first_frame_ms[2];
+		for (int binary=0; binary<2; ++binary) {
+			auto format = binary ? Save::BINARY : Save::XML;
+
+			save_ms[binary] = time_ms([&] () {
+				if (!(binary ? s->to_binary_file() : s->to_xml()))
+					errprint("save_file: save failed!\n");
+			});
+			load_ms[binary] = time_ms([&] () {
+				unique_ptr<Save> l (_new_save(root +"save", format));
+				if (!(binary ? l->from_binary_file() : l->from_xml()))
+					errprint("save_file: load failed!\n");
+			});
+			first_frame_ms[binary] = time_ms([&] () {
+				unique_ptr<Save> l (_new_save(root +"save", format));
+				l->trigger_load = true;
+				auto loaded = objs;
+				_save_frame(*l, loaded);
+			});
+		}
+
+		std::string xml;
+		simple_file_io::load_text_file((root +"save.xml").c_str(), &xml);
+		std::vector<char> bin;
+		s->to_binary(&bin);
+
+		printf("save_file %d objects (%llu bytes xml, %llu bytes binary):  xml / binary ms\n", count, (unsigned long long)xml.size(), (unsigned long long)bin.size());
+		printf("  save              %8.2f %8.2f\n", save_ms[0], save_ms[1]);
+		printf("  load              %8.2f %8.2f\n", load_ms[0], load_ms[1]);
+		printf("  load + 1st frame  %8.2f %8.2f\n", first_frame_ms[0], first_frame_ms[1]);
+
+		remove_tree(root);
+	}
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "tests.hpp"
+#include "mylibs/preprocessor_stuff.hpp"
+#include "snake/snake_env.hpp"
+
+namespace tests {
+	using snake::Snake_Batch;
+
+	// the body ring, the occupancy bits, the free list and the apple all describe the same world
+	bool _snake_consistent (Snake_Batch const& b, int g) {
+		if ((int)b.free_count[g] +(int)b.length[g] != b.cells)
+			return false;
+
+		std::vector<bool> body (b.cells, false);
+		for (int i=0; i<(int)b.length[g]; ++i) {
+			int c = b.cell(b.body_pos(g, i));
+			if (body[c])
+				return false; // body overlaps itself
+			body[c] = true;
+		}
+		if (!all(b.body_pos(g, 0) == b.head_pos[g]))
+			return false;
+
+		for (int c=0; c<b.cells; ++c)
+			if (b.is_occupied(g, c) != body[c])
+				return false;
+
+		u16 const* list = &b.free_cells[(uptr)g * b.cells];
+		u16 const* index = &b.free_index[(uptr)g * b.cells];
+		for (int i=0; i<(int)b.free_count[g]; ++i)
+			if (index[list[i]] != i || body[list[i]])
+				return false;
+
+		if (b.free_count[g] == 0)
+			return b.apple[g] == snake::NO_APPLE;
+		return b.apple[g] != snake::NO_APPLE && !body[b.apple[g]];
+	}
+
+	void test_snake_env () {
+		using namespace snake;
+
+		{ // random moves keep every game consistent
+			Snake_Batch b (64, 16, 1);
+			n_random::Generator policy (2);
+			std::vector<u8> actions (b.games);
+
+			bool ok = true;
+			for (int g=0; g<b.games; ++g)
+				ok = ok && _snake_consistent(b, g);
+			CHECK(ok);
+
+			for (int step=0; step<3000; ++step) {
+				for (auto& a : actions)
+					a = (u8)n_random::uniform(policy, 5); // 4 keeps the direction
+				b.step(actions.data());
+
+				for (int g=0; g<b.games; ++g)
+					ok = ok && _snake_consistent(b, g) && (b.reward[g] == 0 || b.reward[g] == 1 || (b.reward[g] == -1 && b.done[g]));
+			}
+			CHECK(ok);
+			CHECK(b.total_steps == 64 * 3000 && b.total_games > 0 && b.total_apples > 0);
+		}
+
+		// one game with scripted moves, apples are put where the script needs them (any free cell is a valid apple)
+		Snake_Batch b (1, 16, 3);
+		iv2 start = b.head_pos[0]; // (5,5) moving left, body to the right of it
+		u16 far_apple = b.cell(iv2(15,15));
+
+		auto step = [&] (dir_e d, iv2 apple_pos=-1) {
+			b.apple[0] = apple_pos.x >= 0 ? b.cell(apple_pos) : far_apple;
+			u8 a = d;
+			b.step(&a);
+			return _snake_consistent(b, 0);
+		};
+
+		{ // moving backwards is ignored, the wall kills and resets the game
+			CHECK(all(start == iv2(5,5)) && b.length[0] == 3);
+
+			CHECK(step(RIGHT) && all(b.head_pos[0] == start -iv2(1,0)) && b.reward[0] == 0 && !b.done[0]);
+			for (int i=0; i<start.x -1; ++i)
+				CHECK(step(LEFT) && b.reward[0] == 0 && !b.done[0]);
+			CHECK(b.head_pos[0].x == 0);
+
+			CHECK(step(LEFT) && b.reward[0] == -1 && b.done[0]);
+			CHECK(all(b.head_pos[0] == start) && b.length[0] == 3 && b.total_games == 1); // reset
+		}
+
+		{ // eating grows by one, moving into the cell the tail leaves is fine, into any other body cell kills
+			CHECK(step(LEFT, iv2(4,5)) && b.reward[0] == 1 && !b.done[0] && b.length[0] == 4);
+			CHECK(step(DOWN) && step(RIGHT) && step(UP) && b.reward[0] == 0 && !b.done[0]); // square of 4, the head follows the tail
+			CHECK(all(b.head_pos[0] == iv2(5,5)) && b.length[0] == 4);
+
+			CHECK(step(LEFT) && step(LEFT, iv2(3,5)) && b.reward[0] == 1 && b.length[0] == 5);
+			CHECK(step(DOWN) && step(RIGHT) && b.reward[0] == 0 && !b.done[0]);
+			CHECK(step(UP) && b.reward[0] == -1 && b.done[0]); // square of 5 bites the body
+			CHECK(all(b.head_pos[0] == start) && b.length[0] == 3 && b.total_games == 2);
+		}
+
+		{ // no apple for max_steps_without_apple steps finishes the game without a penalty
+			b.max_steps_without_apple = 3;
+			CHECK(step(LEFT) && step(LEFT) && !b.done[0]);
+			CHECK(step(LEFT) && b.reward[0] == 0 && b.done[0] && b.total_games == 3);
+		}
+	}
+
+	// batch steps with random moves
+	void bench_snake_env () {
+		const int games = 1024;
+		const u64 steps = 10000;
+
+		Snake_Batch batch (games);
+		n_random::Generator policy (1);
+		std::vector<u8> actions (games);
+
+		flt ms = time_ms([&] () {
+			for (u64 i=0; i<steps; ++i) {
+				for (auto& a : actions)
+					a = (u8)(policy.next() & 3);
+				batch.step(actions.data());
+			}
+		}, 1);
+
+		printf("snake_env %d games x %llu steps in %.3f s: %.2f M steps/s  (%llu games finished, %llu apples)\n",
+			games, (unsigned long long)steps, ms * 1e-3f, (flt)batch.total_steps / ms * 1e-3f, (unsigned long long)batch.total_games, (unsigned long long)batch.total_apples);
+	}
+}
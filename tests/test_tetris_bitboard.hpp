@@ -0,0 +1,184 @@
+#pragma once
+
+#include "tests.hpp"
+#include "tetris/tetris_bitboard.hpp"
+
+namespace tests {
+	struct _Tetromino { std::vector<iv2> blocks; };
+
+	// same offsets as in tetris.cpp
+	std::vector<_Tetromino> _tetrominos = {
+		{ { iv2(0,+1), iv2(0,0), iv2(0,-1), iv2(0,-2)	} }, // I
+		{ { iv2(0,0), iv2(+1,0), iv2(0,-1), iv2(+1,-1)	} }, // O
+		{ { iv2(0,0), iv2(-1,0), iv2(+1,0), iv2(0,+1)	} }, // T
+		{ { iv2(0,+1), iv2(0,0), iv2(+1,0), iv2(+1,-1)	} }, // S
+		{ { iv2(0,+1), iv2(0,0), iv2(-1,0), iv2(-1,-1)	} }, // Z
+		{ { iv2(0,+1), iv2(0,0), iv2(0,-1), iv2(-1,-1)	} }, // J
+		{ { iv2(0,+1), iv2(0,0), iv2(0,-1), iv2(+1,-1)	} }, // L
+	};
+	enum { _I=0, _O=1 };
+
+	void _set_cell (tetris::Board& b, int x, int y) {
+		b.rows[y +tetris::PAD] |= 1u << (x +tetris::PAD);
+		b.cells[y][x] = 1;
+	}
+	void _fill_row (tetris::Board& b, int y, std::initializer_list<int> holes) {
+		for (int x=0; x<tetris::BOARD_W; ++x)
+			if (std::find(holes.begin(), holes.end(), x) == holes.end())
+				_set_cell(b, x, y);
+	}
+
+	// the bits in rows and the cells used for drawing say the same, the padding is untouched
+	bool _board_in_sync (tetris::Board const& b) {
+		using namespace tetris;
+		for (int y=0; y<PAD +BOARD_H +PAD; ++y) {
+			bool pad_row = y < PAD || y >= PAD +BOARD_H;
+			if (pad_row ? b.rows[y] != FULL_ROW : (b.rows[y] & EMPTY_ROW) != EMPTY_ROW)
+				return false;
+		}
+		for (int y=0; y<BOARD_H; ++y)
+			for (int x=0; x<BOARD_W; ++x)
+				if (b.is_set(iv2(x,y)) != (b.cells[y][x] != 0))
+					return false;
+		return true;
+	}
+
+	void test_tetris_bitboard () {
+		using namespace tetris;
+
+		Piece_Masks pieces (_tetrominos);
+		CHECK(pieces.count == 7);
+
+		{ // masks match the rotated block offsets
+			bool ok = true;
+			for (int t=0; t<pieces.count; ++t) {
+				for (int ori=0; ori<4; ++ori) {
+					auto& m = pieces.get(t, ori);
+
+					int min_dy = +99, max_dy = -99, bits = 0;
+					for (int i=0; i<4; ++i) {
+						iv2 b = rotate2_90(_tetrominos[t].blocks[i], ori);
+						ok = ok && all(m.blocks[i] == b) && ((m.rows[b.y +2] >> (b.x +2)) & 1);
+						min_dy = MIN(min_dy, b.y);
+						max_dy = MAX(max_dy, b.y);
+					}
+					for (auto r : m.rows)
+						for (; r; r &= r -1)
+							bits++;
+					ok = ok && bits == 4 && m.min_dy == min_dy && m.max_dy == max_dy;
+				}
+			}
+			CHECK(ok);
+			CHECK(all(pieces.get(_I, 1).blocks[0] == iv2(-1,0))); // rotate2_90 is ccw
+		}
+
+		{ // walls, floor and ceiling of an empty board
+			Board b;
+			auto& i_vert = pieces.get(_I, 0); // x 0, y -2..+1
+			auto& i_horiz = pieces.get(_I, 1); // x -1..+2, y 0
+
+			CHECK( b.fits(i_vert, iv2(0, 2)) && b.fits(i_vert, iv2(BOARD_W -1, 2)));
+			CHECK(!b.fits(i_vert, iv2(-1, 2)) && !b.fits(i_vert, iv2(BOARD_W, 2)));
+			CHECK(!b.fits(i_vert, iv2(4, 1))); // lowest block below the floor
+			CHECK( b.fits(i_vert, iv2(4, BOARD_H -2)) && !b.fits(i_vert, iv2(4, BOARD_H -1)));
+
+			CHECK( b.fits(i_horiz, iv2(1, 0)) && b.fits(i_horiz, iv2(BOARD_W -3, 0)));
+			CHECK(!b.fits(i_horiz, iv2(0, 0)) && !b.fits(i_horiz, iv2(BOARD_W -2, 0)));
+			CHECK(!b.fits(i_horiz, iv2(4, -1)));
+
+			CHECK(all(b.drop_pos(i_vert, spawn_pos()) == iv2(spawn_pos().x, 2)));
+
+			_set_cell(b, 4, 0);
+			CHECK(!b.fits(i_vert, iv2(4, 2)) && b.fits(i_vert, iv2(4, 3)));
+			CHECK(all(b.drop_pos(i_vert, iv2(4, 18)) == iv2(4, 3)));
+			CHECK(_board_in_sync(b));
+		}
+
+		{ // a vertical I completes rows 0 and 2 but not 1, the rows above move down
+			Board b;
+			_fill_row(b, 0, { 0 });
+			_fill_row(b, 1, { 0, 5 });
+			_fill_row(b, 2, { 0 });
+			_set_cell(b, 9, 4);
+
+			int cleared = b.place(pieces.get(_I, 0), _I, iv2(0, 2)); // covers rows 0-3 at x 0
+			CHECK(cleared == 2);
+			CHECK(_board_in_sync(b));
+
+			bool row0_ok = true; // the old row 1, now with x 0 set by the I
+			for (int x=0; x<BOARD_W; ++x)
+				row0_ok = row0_ok && b.is_set(iv2(x,0)) == (x != 5);
+			CHECK(row0_ok);
+			CHECK(b.is_set(iv2(0,1)) && !b.is_set(iv2(1,1)) && !b.is_set(iv2(9,1))); // old row 3, only the top of the I
+			CHECK(b.is_set(iv2(9,2)) && !b.is_set(iv2(9,4))); // old row 4
+			CHECK(b.cells[0][0] == _I +1 && b.cells[0][1] == 1);
+
+			// 4 rows at once
+			Board c;
+			for (int y=0; y<4; ++y)
+				_fill_row(c, y, { 3 });
+			CHECK(c.place(pieces.get(_I, 0), _I, iv2(3, 2)) == 4);
+			CHECK(_board_in_sync(c) && memcmp(c.rows, Board().rows, sizeof(c.rows)) == 0);
+		}
+
+		{ // random games keep the cells in sync with the bits
+			Game g (&pieces, 7);
+			n_random::Generator policy (3);
+			bool in_sync = true;
+			int games = 0;
+			for (int i=0; i<200000; ++i) {
+				auto res = g.step((action_e)n_random::uniform(policy, ACTIONS));
+				if (res.placed)
+					in_sync = in_sync && _board_in_sync(g.board);
+				if (res.game_over) {
+					games++;
+					g.reset();
+				}
+			}
+			CHECK(in_sync);
+			CHECK(games > 0); // random moves rarely clear rows, that is tested above
+		}
+
+		{ // game over when the spawned piece does not fit
+			Game g (&pieces, 1);
+			CHECK(!g.game_over);
+
+			for (int y=14; y<BOARD_H; ++y)
+				_fill_row(g.board, y, { (y & 1) ? 0 : 9 }); // blocks the spawn area of every piece
+
+			CHECK(!g.spawn() && g.game_over);
+
+			g.reset();
+			CHECK(!g.game_over && g.lines == 0 && g.placed == 0 && g.board.fits(g.mask(), g.pos));
+		}
+	}
+
+	// headless steps with random moves
+	void bench_tetris_bitboard () {
+		using namespace tetris;
+
+		const u64 steps = 10000000;
+
+		Piece_Masks pieces (_tetrominos);
+		Game game (&pieces, 0);
+		n_random::Generator policy (1);
+
+		u64 games = 0;
+		u64 lines = 0;
+
+		flt ms = time_ms([&] () {
+			for (u64 i=0; i<steps; ++i) {
+				auto res = game.step((action_e)n_random::uniform(policy, ACTIONS));
+				lines += res.lines;
+
+				if (res.game_over) {
+					game.reset();
+					games++;
+				}
+			}
+		}, 1);
+
+		printf("tetris_bitboard %llu steps in %.3f s: %.2f M steps/s  (%llu games, %llu lines)\n",
+			(unsigned long long)steps, ms * 1e-3f, (flt)steps / ms * 1e-3f, (unsigned long long)games, (unsigned long long)lines);
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "tests.hpp"
+#include "upscaler/texture_filter_cpu.hpp"
+
+namespace tests {
+	using namespace texture_filter_cpu;
+
+	// circle and diagonal stripes, so there are edges in every direction, plus some noise
+	Image _filter_test_image (iv2 size) {
+		std::vector<srgba8> px ((uptr)size.x * size.y);
+		for (int y=0; y<size.y; ++y) {
+			for (int x=0; x<size.x; ++x) {
+				iv2 c = iv2(x, y) -size / 2;
+				bool in = c.x*c.x + c.y*c.y < (size.y/3)*(size.y/3) || ((x +y) / 20) % 3 == 0;
+				u8 v = in ? 230 : 30;
+				px[(uptr)y * size.x +x] = srgba8(v, (u8)(v/2 +(x * 7 + y * 13) % 20), (u8)(255 -v), (u8)(255 -(x % 5)));
+			}
+		}
+		Image img;
+		img.set(px.data(), size);
+		return img;
+	}
+
+	bool _same_pixels (std::vector<srgba8> const& a, std::vector<srgba8> const& b) {
+		return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(srgba8)) == 0;
+	}
+
+	// the cpu filter can not be compared against the gpu without a gl context, so check what can be checked headless:
+	//  the simd version against the scalar reference, and the nearest sampling the gpu comparison uses with filter_nearest
+	void test_texture_filter () {
+		{ // compare_images itself
+			srgba8 a[2] = { srgba8(10,20,30,40), srgba8(1,2,3,4) };
+			srgba8 b[2] = { srgba8(10,20,30,40), srgba8(1,2,3,9) };
+			auto same = compare_images(a, a, iv2(2,1));
+			auto diff = compare_images(a, b, iv2(2,1));
+			CHECK(same.max_abs == 0 && same.differing_pixels == 0 && same.psnr == INF);
+			CHECK(diff.max_abs == 5 && diff.differing_pixels == 1 && diff.psnr < INF);
+		}
+
+		for (iv2 size : { iv2(1,1), iv2(7,3), iv2(200,150) }) {
+			Image img = _filter_test_image(size);
+
+			for (flt scale : { 1.0f, 2.0f, 3.7f }) {
+				iv2 out_size = calc_out_size(size, scale);
+				u64 count = (u64)out_size.x * out_size.y;
+
+				Filter_Params params;
+				std::vector<srgba8> simd, ref;
+
+				filter_image(img, params, out_size, &simd, true);
+				filter_image(img, params, out_size, &ref, false);
+
+				// rounding differences can flip single pixels between edge and no edge, but not more than that
+				auto d = compare_images(simd.data(), ref.data(), out_size);
+				CHECK(d.differing_pixels <= count / 1000);
+
+				params.nearest = true;
+				std::vector<srgba8> nearest_simd, nearest_ref;
+				filter_image(img, params, out_size, &nearest_simd, true);
+				filter_image(img, params, out_size, &nearest_ref, false);
+
+				CHECK(_same_pixels(nearest_simd, nearest_ref)); // simd falls back to the scalar version
+				if (size.x > 1 && scale > 1)
+					CHECK(!_same_pixels(nearest_ref, ref));
+			}
+		}
+
+		{ // without edges nearest sampling is just the texel under the pixel center
+			iv2 size = iv2(13,9);
+			Image img = _filter_test_image(size);
+
+			Filter_Params params;
+			params.nearest = true;
+			params.threshold = 1000;
+
+			iv2 out_size = size * 3;
+			std::vector<srgba8> out;
+			filter_image(img, params, out_size, &out);
+
+			bool ok = true;
+			for (int y=0; y<out_size.y; ++y) {
+				for (int x=0; x<out_size.x; ++x) {
+					lrgba expect = img.pixels[(uptr)(y / 3) * size.x +x / 3];
+					ok = ok && all(out[(uptr)y * out_size.x +x].v == srgba8::from_linear(expect).v);
+				}
+			}
+			CHECK(ok);
+		}
+	}
+
+	void bench_texture_filter () {
+		iv2 size = iv2(960, 540);
+		Image img = _filter_test_image(size);
+		iv2 out_size = calc_out_size(size, 2);
+
+		Filter_Params params;
+		std::vector<srgba8> out;
+
+		for (bool use_simd : { false, true }) {
+			Filter_Stats s;
+			time_ms([&] () { s = filter_image(img, params, out_size, &out, use_simd); }, 3);
+			printf("texture_filter %dx%d -> %dx%d %-6s %8.2f ms  %6.2f MP/s\n", size.x, size.y, out_size.x, out_size.y, use_simd ? "simd" : "scalar",
+				s.seconds * 1000, s.mpix_per_sec());
+		}
+	}
+}
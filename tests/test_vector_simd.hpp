@@ -0,0 +1,135 @@
+#pragma once
+
+#include "tests.hpp"
+#include "mylibs/vector.hpp"
+#include "mylibs/random.hpp"
+
+namespace tests {
+
+	fv3 _rand_v3 (n_random::Generator& g) {	return fv3(n_random::uniform(g, -1.0f, 1.0f), n_random::uniform(g, -1.0f, 1.0f), n_random::uniform(g, -1.0f, 1.0f)); }
+	fv4 _rand_v4 (n_random::Generator& g) {	return fv4(_rand_v3(g), n_random::uniform(g, -1.0f, 1.0f)); }
+	fm4 _rand_m4 (n_random::Generator& g) {	return fm4::rows(_rand_v4(g), _rand_v4(g), _rand_v4(g), _rand_v4(g)); }
+	fhm _rand_hm (n_random::Generator& g) {	return fhm::rows(_rand_v4(g), _rand_v4(g), _rand_v4(g)); }
+	fquat _rand_quat (n_random::Generator& g) { // unit length, quat * v3 assumes that
+		fv4 v = normalize(_rand_v4(g));
+		return fquat(v.x, v.y, v.z, v.w);
+	}
+
+	// plain definitions, what the simd versions have to match
+	fv4 _ref_mul (fm4 const& m, fv4 v) {
+		fv4 r;
+		for (int i=0; i<4; ++i)
+			r[i] = m.arr[0][i] * v.x + m.arr[1][i] * v.y + m.arr[2][i] * v.z + m.arr[3][i] * v.w;
+		return r;
+	}
+	fv3 _ref_mul (fquat q, fv3 v) { // q * (v,0) * conjugate(q)
+		fquat p = fquat(v, 0);
+		fquat c = fquat(-q.x, -q.y, -q.z, q.w);
+		fquat r = q * p * c;
+		return fv3(r.x, r.y, r.z);
+	}
+	fv3 _ref_mul (fhm const& m, fv3 v) {
+		fv3 r;
+		for (int i=0; i<3; ++i)
+			r[i] = m.mat.arr[0][i] * v.x + m.mat.arr[1][i] * v.y + m.mat.arr[2][i] * v.z + m.transl[i];
+		return r;
+	}
+
+	// relative to the magnitude of the inputs, fused multiply-adds differ from the scalar code in the last bit
+	template <typename V>
+	bool _close (V a, V b, flt tolerance=1e-5f) {
+		return max_component(abs(a -b)) <= tolerance * std::max(max_component(abs(b)), 1.0f);
+	}
+
+	// the VECTOR_SIMD paths (on by default in the tests, see main.cpp) against the plain definitions, the batch versions against the single ones
+	void test_vector_simd () {
+		n_random::Generator g (38);
+
+		bool m4v4 = true, m4m4 = true, quatv3 = true;
+		for (int i=0; i<1000; ++i) {
+			fm4 a = _rand_m4(g), b = _rand_m4(g);
+			fv4 v = _rand_v4(g);
+			m4v4 = m4v4 && _close(a * v, _ref_mul(a, v));
+
+			fm4 ab = a * b;
+			for (int c=0; c<4; ++c)
+				m4m4 = m4m4 && _close(ab.arr[c], _ref_mul(a, b.arr[c]), 4e-5f);
+
+			fquat q = _rand_quat(g);
+			fv3 w = _rand_v3(g);
+			quatv3 = quatv3 && _close(q * w, _ref_mul(q, w), 4e-5f);
+		}
+		CHECK(m4v4);
+		CHECK(m4m4);
+		CHECK(quatv3);
+
+		// counts around the 4 wide blocks
+		for (uptr count : { 0, 1, 3, 4, 5, 8, 1003 }) {
+			fhm h = _rand_hm(g);
+			fm4 m = _rand_m4(g);
+
+			std::vector<fv3> pts (count), out (count);
+			for (auto& p : pts) p = _rand_v3(g);
+
+			transform_points(h, pts.data(), out.data(), count);
+			bool points = true;
+			for (uptr i=0; i<count; ++i)
+				points = points && _close(out[i], _ref_mul(h, pts[i]));
+			CHECK(points);
+
+			auto in_place = pts;
+			transform_points(h, in_place.data(), in_place.data(), count);
+			CHECK(memcmp(in_place.data(), out.data(), count * sizeof(fv3)) == 0);
+
+			transform_directions(h, pts.data(), out.data(), count);
+			bool dirs = true;
+			for (uptr i=0; i<count; ++i)
+				dirs = dirs && _close(out[i], h.m3() * pts[i]);
+			CHECK(dirs);
+
+			std::vector<fv4> pts4 (count), out4 (count);
+			for (auto& p : pts4) p = _rand_v4(g);
+			transform(m, pts4.data(), out4.data(), count);
+			bool v4s = true;
+			for (uptr i=0; i<count; ++i)
+				v4s = v4s && _close(out4[i], _ref_mul(m, pts4[i]));
+			CHECK(v4s);
+		}
+	}
+
+	// ns per op, the same ops with -DVECTOR_SIMD=0 give the scalar numbers
+	void bench_vector_simd () {
+		n_random::Generator g (1);
+
+		std::vector<fm4> ms (64);		for (auto& m : ms) m = _rand_m4(g);
+		std::vector<fquat> qs (64);		for (auto& q : qs) q = _rand_quat(g);
+		std::vector<fv3> vs (64);		for (auto& v : vs) v = _rand_v3(g);
+		fhm h = _rand_hm(g);
+
+		volatile flt sink = 0;
+		const int N = 1 << 22;
+		auto ns = [&] (flt ms, int count) { return ms * 1e6f / (flt)count; };
+
+		flt m4v4 = time_ms([&] () {
+			for (int i=0; i<N; ++i) { fv4 r = ms[i & 63] * fv4(vs[i & 63], 1); sink = r.x + r.w; }
+		}, 3);
+		flt m4m4 = time_ms([&] () {
+			for (int i=0; i<N; ++i) { fm4 r = ms[i & 63] * ms[(i +7) & 63]; sink = r.arr[0].x + r.arr[3].w; }
+		}, 3);
+		flt quatv3 = time_ms([&] () {
+			for (int i=0; i<N; ++i) { fv3 r = qs[i & 63] * vs[(i +3) & 63]; sink = r.x + r.z; }
+		}, 3);
+
+		std::vector<fv3> pts (1 << 16), out (1 << 16);
+		for (auto& p : pts) p = _rand_v3(g);
+		flt batch = time_ms([&] () { transform_points(h, pts.data(), out.data(), pts.size()); }, 20);
+		flt loop = time_ms([&] () {
+			for (uptr i=0; i<pts.size(); ++i)
+				out[i] = h * pts[i];
+			sink = out[7].x;
+		}, 20);
+
+		printf("vector_simd (VECTOR_SIMD %d) ns/op:  m4*v4 %5.2f  m4*m4 %5.2f  quat*v3 %5.2f  transform_points %5.2f (loop of hm*v3 %5.2f)\n", VECTOR_SIMD,
+			ns(m4v4, N), ns(m4m4, N), ns(quatv3, N), ns(batch, (int)pts.size()), ns(loop, (int)pts.size()));
+	}
+}
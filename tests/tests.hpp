@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdint.h> // before basic_typedefs.hpp, which includes it inside its namespace
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include "mylibs/basic_typedefs.hpp"
+#include "mylibs/float_precision.hpp"
+#include "mylibs/profiler.hpp"
+#include "mylibs/find_files.hpp"
+
+#ifdef _WIN32
+	#include "direct.h"
+#endif
+
+#ifndef errprint // engine_include.hpp defines it, the tests do not include the engine
+	#define errprint(...) fprintf(stderr, __VA_ARGS__)
+#endif
+
+// Minimal test harness, every test_*.hpp has a  void test_xxx ()  and a  void bench_xxx ()  that main.cpp runs
+//  CHECK() only counts and prints failures, so a test keeps going and reports everything that is wrong in one run
+namespace tests {
+	using namespace basic_typedefs;
+	using namespace float_precision;
+
+	int failures = 0;
+	int checks = 0;
+
+	bool check (bool cond, cstr expr, cstr file, int line) {
+		checks++;
+		if (!cond) {
+			failures++;
+			fprintf(stderr, "%s(%d): CHECK(%s) failed\n", file, line, expr);
+		}
+		return cond;
+	}
+
+	// best of runs, in ms
+	template <typename FUNC>
+	flt time_ms (FUNC func, int runs=5) {
+		u64 best = (u64)-1;
+		for (int i=0; i<runs; ++i) {
+			u64 begin = profiler::now_ns();
+			func();
+			best = std::min(best, profiler::now_ns() -begin);
+		}
+		return (flt)best * 1e-6f;
+	}
+
+	//// Scratch files for the tests that need a real directory tree, relative to the working directory
+
+	bool make_dir (std::string const& path) {
+	#ifdef _WIN32
+		return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+	#else
+		return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+	#endif
+	}
+
+	bool write_file (std::string const& path, cstr text="") {
+		FILE* f = fopen(path.c_str(), "wb");
+		if (!f)
+			return false;
+		fputs(text, f);
+		fclose(f);
+		return true;
+	}
+
+	// dir_path with trailing '/', symlinks are removed, not followed
+	void remove_tree (std::string const& dir_path) {
+		if (!n_find_files::file_exists(dir_path))
+			return;
+
+		std::vector<std::string> dirs, files;
+		n_find_files::find_files(dir_path, &dirs, &files);
+
+		for (auto& d : dirs)
+			remove_tree(dir_path + d);
+		for (auto& f : files)
+			remove((dir_path + f).c_str());
+
+	#ifdef _WIN32
+		_rmdir(dir_path.c_str());
+	#else
+		rmdir(dir_path.c_str());
+	#endif
+	}
+}
+
+#define CHECK(cond) ::tests::check(!!(cond), #cond, __FILE__, __LINE__)
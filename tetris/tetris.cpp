@@ -1,6 +1,8 @@
 
 #include "3d_lib/engine.hpp"
 #include "3d_lib/camera2D.hpp"
+#include "mylibs/random.hpp"
+#include "tetris_bitboard.hpp"
 namespace imgui = ImGui;
 using namespace engine;
 
@@ -60,176 +62,74 @@ std::vector<Tetromino_Type> tetromino_types = {
 	{ "L", { iv2(0,+1), iv2(0,0), iv2(0,-1), iv2(+1,-1)	}, yellow		},
 };
 
-struct Block {
-	Tetromino_Type*	type = nullptr; // nullptr is background
-};
-
-iv2 tetris_visible_cells = iv2(10,20);
-iv2 tetris_stored_cells = tetris_visible_cells +iv2(0,2);
-
-struct Placed_Blocks {
-	std::vector<Block> cells = std::vector<Block> (tetris_stored_cells.x * tetris_stored_cells.y);
-	
-	Block* get (iv2 pos_world) {
-		if (any(pos_world < 0 || pos_world >= tetris_stored_cells))
-			return nullptr;
-		return &cells[pos_world.y * tetris_stored_cells.x + pos_world.x];
-	}
-	void draw () {
+tetris::Piece_Masks piece_masks = tetris::Piece_Masks(tetromino_types);
 
-		iv2 pos;
-		for (pos.y=0; pos.y<tetris_visible_cells.y; ++pos.y) {
-			for (pos.x=0; pos.x<tetris_visible_cells.x; ++pos.x) {
-				auto* block = get(pos);
+iv2 tetris_visible_cells = iv2(tetris::BOARD_W, tetris::VISIBLE_H);
 
-				if (block->type) {
-					draw_rect((v2)pos +0.5f, 1, lrgba(block->type->col, 1));
-				}
-			}
-		}
-	}
+void draw_placed_blocks (tetris::Board const& board) {
 
-	void update (int* score) {
-		std::vector<int> rows_to_remove;
+	iv2 pos;
+	for (pos.y=0; pos.y<tetris_visible_cells.y; ++pos.y) {
+		for (pos.x=0; pos.x<tetris_visible_cells.x; ++pos.x) {
+			u8 cell = board.cells[pos.y][pos.x];
 
-		iv2 pos = 0;
-		for (pos.y=0; pos.y<tetris_stored_cells.y; ++pos.y) {
-			bool full_row = true;
-			for (pos.x=0; pos.x<tetris_stored_cells.x; ++pos.x) {
-				if (get(pos)->type == nullptr)
-					full_row = false;
+			if (cell) {
+				draw_rect((v2)pos +0.5f, 1, lrgba(tetromino_types[cell -1].col, 1));
 			}
-
-			if (full_row)
-				rows_to_remove.push_back(pos.y);
-		}
-
-		for (int i=(int)rows_to_remove.size()-1; i>=0; --i) {
-			int y = rows_to_remove[i];
-
-			for (pos.y=y; pos.y<tetris_stored_cells.y; ++pos.y) {
-				for (pos.x=0; pos.x<tetris_stored_cells.x; ++pos.x) {
-					auto* top = get(pos +iv2(0,+1));
-					get(pos)->type = top ? top->type : nullptr;
-				}
-			}
-
-			(*score)++;
-		}
-	}
-};
-
-flt base_move_interval = 1.7f;
-flt move_fast_multiplier = 6;
-flt speedup = 1;
-
-flt move_timer = base_move_interval;
-
-struct Active_Tetromino {
-	Tetromino_Type*	type;
-	iv2				pos_world;
-	int				ori = 0;
-
-	bool is_active () {
-		return type != nullptr;
-	}
-
-	std::vector<iv2> blocks_rotated_world;
-
-	void draw () {
-
-		for (iv2 pos : blocks_rotated_world) {
-			draw_rect((v2)pos +0.5f, 1, lrgba(type->col, 1));
 		}
 	}
+}
+void draw_active_tetromino (tetris::Game const& game) {
 
-	iv2 rotate (iv2 p, int ori) {
-		return rotate2_90(p, ori);
+	for (iv2 b : game.mask().blocks) {
+		draw_rect((v2)(b +game.pos) +0.5f, 1, lrgba(tetromino_types[game.type].col, 1));
 	}
+}
 
-	void rotate_blocks (int ori) {
-		blocks_rotated_world = type->blocks;
+struct App : public Application {
+	// tweakable in the Options header, saved to saves/options.xml
+	Option<flt>		base_move_interval		= options.add<flt>("base_move_interval", 1.7f);
+	Option<flt>		move_fast_multiplier	= options.add<flt>("move_fast_multiplier", 6);
+	Option<flt>		speedup_per_line		= options.add<flt>("speedup_per_line", 1.05f);
+	Option<lrgb>	bg_color				= options.add<lrgb>("bg_color", srgb8(7,14,32).to_lrgb());
 
-		for (auto& b : blocks_rotated_world)
-			b = rotate(b, ori) + pos_world;
-	}
+	flt				speedup = 1;
+	flt				move_timer = options[base_move_interval];
+	bool			move_fast = false; // sampled in frame(), tick() must not read inp
 
-	bool check_blocks_overlap (Placed_Blocks* blocks, iv2 pos_world, int ori) {
-		for (iv2 b : type->blocks) {
-			b = rotate(b, ori) + pos_world;
-			if (!blocks->get(b) || blocks->get(b)->type != nullptr)
-				return true;
-		}
-		return false;
-	}
-	void place_tetronimo (Placed_Blocks* blocks) {
-		for (auto& b : blocks_rotated_world) {
-			if (!(blocks->get(b) && blocks->get(b)->type == nullptr))
-				errprint("blocks->get(b) && blocks->get(b)->type == nullptr");
-			//assert(blocks->get(b) && blocks->get(b)->type == nullptr);
-			if (blocks->get(b))
-				blocks->get(b)->type = type;
-		}
-		type = nullptr;
-	}
+	tetris::Game	game {&piece_masks};
 
-	void update (Input& inp, flt dt, Placed_Blocks* blocks) {
-		bool move = false;
+	// moves and rotations react to every key press, so they stay in frame()
+	void update_active_tetromino () {
+		move_fast = inp.is_down('S');
 
-		if (move_timer <= 0) {
-			move = true;
-			move_timer = base_move_interval;
-		}
-
-		bool move_fast = inp.is_down('S');
 		int move_dir = 0;
 		move_dir -= inp.went_down_repeat('A') ? 1 : 0;
 		move_dir += inp.went_down_repeat('D') ? 1 : 0;
 
-		move_timer -= dt * speedup * (move_fast ? move_fast_multiplier : 1);
-
-		if (!check_blocks_overlap(blocks, pos_world +iv2(move_dir,0), ori)) {
-			pos_world += iv2(move_dir,0);
-		}
-
-		iv2 dropped_pos = pos_world + iv2(0,-1);
-
-		if (move && !check_blocks_overlap(blocks, dropped_pos, ori)) {
-			pos_world += iv2(0,-1); 
-		}
+		if (move_dir != 0)
+			game.apply(move_dir < 0 ? tetris::LEFT : tetris::RIGHT);
 
 		int rot = 0;
 		if (inp.went_down('Q'))	rot += 1;
 		if (inp.went_down('E'))	rot -= 1;
 
-		{
-			auto new_ori = ori + rot;
-			new_ori = (int)((uint)new_ori % 4);
+		if (rot != 0)
+			game.apply(rot > 0 ? tetris::ROTATE_CCW : tetris::ROTATE_CW);
+	}
 
-			rotate_blocks(new_ori);
+	// the piece falls on the fixed ticks, so the fall speed does not depend on the frame rate
+	void tick (flt dt) {
+		move_timer -= dt * speedup * (move_fast ? options[move_fast_multiplier] : 1);
 
-			if (!check_blocks_overlap(blocks, dropped_pos, new_ori)) {
-				ori = new_ori;
-			}
-		}
+		if (move_timer <= 0) {
+			move_timer = options[base_move_interval];
 
-		if (move && check_blocks_overlap(blocks, dropped_pos, ori)) {
-			place_tetronimo(blocks);
+			if (game.fall().game_over)
+				game.reset();
 		}
 	}
-};
-
-Active_Tetromino spawn_tetromino (Tetromino_Type* type) {
-	Active_Tetromino t;
-	t.type = type;
-	t.pos_world = iv2(tetris_visible_cells.x / 2, 18);
-	return t;
-}
-Active_Tetromino spawn_random_tetromino () {
-	return spawn_tetromino( &tetromino_types[ rand() % (int)tetromino_types.size() ] );
-}
 
-struct App : public Application {
 	void frame () {
 
 		static Camera2D cam = Camera2D::arcade_style_cam((v2)tetris_visible_cells);
@@ -237,29 +137,21 @@ struct App : public Application {
 		cam.update(inp, dt);
 		cam.draw_to();
 
-		static int score = 0;
-
-		static auto bg_color = srgb8(7,14,32).to_lrgb();
-		clear(bg_color);
+		clear(options[bg_color]);
 
-		speedup = pow(1.05f, score);
+		speedup = pow(options[speedup_per_line], game.lines);
 
-		static Placed_Blocks		blocks;
-		static Active_Tetromino		active_tetromino = spawn_random_tetromino();
-		if (inp.went_down('R') || !active_tetromino.is_active())
-			active_tetromino = spawn_random_tetromino();
+		if (inp.went_down('R') && !game.spawn())
+			game.reset();
 
-		if (active_tetromino.is_active())
-			active_tetromino.update(inp, dt, &blocks);
+		update_active_tetromino();
 
-		blocks.update(&score);
-		blocks.draw();
+		draw_placed_blocks(game.board);
 
-		imgui::Text("Score: %d", score * 10);
+		imgui::Text("Score: %d", game.lines * 10);
 		imgui::Text("Speed: %.2f", speedup);
 
-		if (active_tetromino.is_active())
-			active_tetromino.draw();
+		draw_active_tetromino(game);
 
 	}
 };
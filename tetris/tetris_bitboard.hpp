@@ -0,0 +1,263 @@
+#pragma once
+
+#include "mylibs/basic_typedefs.hpp"
+#include "mylibs/vector.hpp"
+#include "mylibs/float_precision.hpp"
+#include "mylibs/random.hpp"
+
+#include <cstring>
+#include "assert.h"
+
+// Tetris rules on a bitboard, without any rendering, so a game can be stepped headless millions of times per second (for AI / RL experiments)
+//  every row of the board is one u32 with a bit per cell, the board is surrounded by set bits (walls, floor and ceiling)
+//   so a collision test is 5 ands with the precomputed mask of the rotated piece and needs no bounds checks
+//  full rows can only appear in the rows the placed piece covers, so only those are tested, removing a row moves the words above it down
+namespace tetris {
+	using namespace basic_typedefs;
+	using namespace vector;
+	using namespace float_precision;
+
+	constexpr int BOARD_W = 10;
+	constexpr int BOARD_H = 22; // stored rows, the top 2 are above the visible area
+	constexpr int VISIBLE_H = 20;
+
+	constexpr int MAX_PIECES = 8;
+	constexpr int MASK_SIZE = 5; // pieces are masks of 5x5 cells around their origin, block offsets have to be in [-2,+2]
+
+	constexpr int PAD = 3; // set bits left of the board and set rows below and above it, the furthest a tested piece can reach outside
+	constexpr u32 FULL_ROW = 0xffffffffu;
+	constexpr u32 EMPTY_ROW = ~(((1u << BOARD_W) -1) << PAD); // only the walls set
+
+	inline iv2 spawn_pos () { return iv2(BOARD_W / 2, 18); }
+
+	// one piece in one rotation
+	struct Piece_Mask {
+		u32		rows[MASK_SIZE]; // bit (dx +2) in rows[dy +2] is set for the block at (dx,dy)
+		iv2		blocks[4]; // rotated block offsets
+		int		min_dy, max_dy;
+	};
+
+	// masks of all rotations of all piece types, computed once from the block offsets
+	struct Piece_Masks {
+		Piece_Mask	masks[MAX_PIECES][4];
+		int			count = 0;
+
+		// types: anything with .blocks (4 iv2 offsets around the rotation origin) per type, rotation is rotate2_90(offset, ori)
+		template <typename TYPES>
+		Piece_Masks (TYPES const& types) {
+			for (auto& t : types) {
+				assert(count < MAX_PIECES && t.blocks.size() == 4);
+
+				for (int ori=0; ori<4; ++ori) {
+					auto& m = masks[count][ori];
+					memset(m.rows, 0, sizeof(m.rows));
+					m.min_dy = +MASK_SIZE;
+					m.max_dy = -MASK_SIZE;
+
+					for (int i=0; i<4; ++i) {
+						iv2 b = rotate2_90(t.blocks[i], ori);
+						assert(all(b >= -2 && b <= +2));
+
+						m.blocks[i] = b;
+						m.rows[b.y +2] |= 1u << (b.x +2);
+						m.min_dy = MIN(m.min_dy, b.y);
+						m.max_dy = MAX(m.max_dy, b.y);
+					}
+				}
+
+				count++;
+			}
+		}
+
+		Piece_Mask const& get (int type, int ori) const {
+			return masks[type][ori];
+		}
+	};
+
+	struct Board {
+		u32		rows[PAD +BOARD_H +PAD]; // bit (x +PAD) of rows[y +PAD] is cell (x,y)
+		u8		cells[BOARD_H][BOARD_W]; // piece type +1 of every cell, 0 is empty, only needed for drawing
+
+		Board () {
+			clear();
+		}
+
+		void clear () {
+			for (int y=0; y<PAD +BOARD_H +PAD; ++y)
+				rows[y] = y < PAD || y >= PAD +BOARD_H ? FULL_ROW : EMPTY_ROW;
+			memset(cells, 0, sizeof(cells));
+		}
+
+		bool is_set (iv2 pos) const {
+			return (rows[pos.y +PAD] >> (pos.x +PAD)) & 1;
+		}
+
+		// pos can be at most one cell outside the board (one move from a position that fits)
+		bool fits (Piece_Mask const& m, iv2 pos) const {
+			assert(pos.x >= -1 && pos.x <= BOARD_W && pos.y >= -1 && pos.y <= BOARD_H);
+
+			u32 const* r = &rows[pos.y +PAD -2];
+			int shift = pos.x +PAD -2;
+
+			u32 hit =	(r[0] & (m.rows[0] << shift)) |
+						(r[1] & (m.rows[1] << shift)) |
+						(r[2] & (m.rows[2] << shift)) |
+						(r[3] & (m.rows[3] << shift)) |
+						(r[4] & (m.rows[4] << shift));
+			return hit == 0;
+		}
+
+		// lowest pos the piece can be dropped to from pos
+		iv2 drop_pos (Piece_Mask const& m, iv2 pos) const {
+			while (fits(m, pos -iv2(0,1)))
+				pos.y--;
+			return pos;
+		}
+
+		void _remove_row (int y) {
+			memmove(&rows[y +PAD], &rows[y +PAD +1], (BOARD_H -1 -y) * sizeof(u32));
+			rows[BOARD_H -1 +PAD] = EMPTY_ROW;
+
+			memmove(&cells[y], &cells[y +1], (BOARD_H -1 -y) * sizeof(cells[0]));
+			memset(&cells[BOARD_H -1], 0, sizeof(cells[0]));
+		}
+
+		// piece has to fit, returns the number of rows cleared
+		int place (Piece_Mask const& m, int type, iv2 pos) {
+			assert(fits(m, pos));
+
+			u32* r = &rows[pos.y +PAD -2];
+			int shift = pos.x +PAD -2;
+			for (int i=0; i<MASK_SIZE; ++i)
+				r[i] |= m.rows[i] << shift;
+
+			for (iv2 b : m.blocks) {
+				b += pos;
+				cells[b.y][b.x] = (u8)(type +1);
+			}
+
+			int cleared = 0;
+			for (int y=pos.y +m.max_dy; y>=pos.y +m.min_dy; --y) { // top down, so removing a row does not move the rows still to be tested
+				if (rows[y +PAD] == FULL_ROW) {
+					_remove_row(y);
+					cleared++;
+				}
+			}
+			return cleared;
+		}
+	};
+
+	enum action_e {
+		NONE,
+		LEFT,
+		RIGHT,
+		ROTATE_CCW,
+		ROTATE_CW,
+		SOFT_DROP, // same as NONE, the gravity of the step moves the piece down
+		HARD_DROP, // drop down and place immediately
+
+		ACTIONS,
+	};
+
+	struct Step_Result {
+		int		lines; // rows cleared
+		bool	placed; // the piece was placed and the next one spawned
+		bool	game_over; // the next piece did not fit, call reset()
+	};
+
+	// one game, step() is the headless api: apply one action, then gravity moves the piece down one row
+	//  the interactive game uses apply() and fall() separately, to drop on a timer
+	struct Game {
+		Piece_Masks const*	pieces;
+		Board				board;
+		n_random::Generator	rand;
+
+		int					type; // active piece
+		int					ori;
+		iv2					pos;
+
+		int					lines = 0; // rows cleared in total
+		u64					placed = 0; // pieces placed in total
+		bool				game_over = false;
+
+		Game (Piece_Masks const* pieces, u64 seed): pieces{pieces}, rand{seed} {
+			reset();
+		}
+		Game (Piece_Masks const* pieces): pieces{pieces} {
+			reset();
+		}
+
+		Piece_Mask const& mask () const {
+			return pieces->get(type, ori);
+		}
+
+		void reset () {
+			board.clear();
+			lines = 0;
+			placed = 0;
+			game_over = false;
+			spawn();
+		}
+
+		// replace the active piece with a random one, returns false (game over) if it does not fit
+		bool spawn () {
+			type = n_random::uniform(rand, pieces->count);
+			ori = 0;
+			pos = spawn_pos();
+
+			game_over = !board.fits(mask(), pos);
+			return !game_over;
+		}
+
+		// move or rotate the active piece if the result fits, returns false if not
+		bool apply (action_e action) {
+			iv2 new_pos = pos;
+			int new_ori = ori;
+
+			switch (action) {
+				case LEFT:			new_pos.x -= 1;				break;
+				case RIGHT:			new_pos.x += 1;				break;
+				case ROTATE_CCW:	new_ori = (ori +1) & 3;		break;
+				case ROTATE_CW:		new_ori = (ori +3) & 3;		break;
+				case HARD_DROP:		new_pos = board.drop_pos(mask(), pos);	break;
+				default:			return true;
+			}
+
+			if (!board.fits(pieces->get(type, new_ori), new_pos))
+				return false;
+
+			pos = new_pos;
+			ori = new_ori;
+			return true;
+		}
+
+		Step_Result _place () {
+			Step_Result res = {};
+			res.lines = board.place(mask(), type, pos);
+			res.placed = true;
+
+			lines += res.lines;
+			placed++;
+
+			res.game_over = !spawn();
+			return res;
+		}
+
+		// move the active piece down one row, or place it if it can not move down
+		Step_Result fall () {
+			if (board.fits(mask(), pos -iv2(0,1))) {
+				pos.y--;
+				return {};
+			}
+			return _place();
+		}
+
+		Step_Result step (action_e action) {
+			assert(!game_over);
+			apply(action);
+			if (action == HARD_DROP)
+				return _place();
+			return fall();
+		}
+	};
+}
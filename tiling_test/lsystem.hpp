@@ -0,0 +1,169 @@
+#pragma once
+
+#include "mylibs/basic_typedefs.hpp"
+#include "mylibs/vector.hpp"
+#include "mylibs/float_precision.hpp"
+#include "mylibs/parallel.hpp"
+#include "mylibs/profiler.hpp"
+
+#include <vector>
+#include "assert.h"
+
+// Branching tree of tiling_test (every branch splits into the children a, b and c, the child a has no a child and b no b child)
+//  generated iteratively breadth first instead of recursively, into output that is preallocated because the number of lines of a subtree is known from its type and depth
+//   the first levels are expanded on the calling thread until there are enough branches, then their subtrees are expanded in parallel, each into its own range of the output
+//  the result is cached, generating with the same params again does nothing
+namespace lsystem {
+	using namespace basic_typedefs;
+	using namespace vector;
+	using namespace float_precision;
+
+	struct Params {
+		flt		size = 1;
+		flt		factor = 0.617f;
+		int		max_depth = 3;
+		flt		angle_deg = 20;
+
+		bool operator== (Params const& r) const {
+			return size == r.size && factor == r.factor && max_depth == r.max_depth && angle_deg == r.angle_deg;
+		}
+		bool operator!= (Params const& r) const {	return !(*this == r); }
+	};
+
+	struct Branch {
+		v2		pos;
+		v2		dir;
+		flt		angle;
+		flt		size;
+		int		prev_dir; // -1 if this is an a child (it has no a child), +1 for b (no b child), 0 for c and the root
+	};
+
+	// writes the children of b and one line (2 vertices) from b to every child, returns the number of children
+	template <typename VERT>
+	inline int expand (Params const& p, Branch const& b, Branch* children, VERT* verts) {
+		flt ang_a = b.angle -p.angle_deg * p.factor;
+		flt ang_b = b.angle +p.angle_deg * p.factor;
+		flt ang_c = b.angle * (1 + p.factor);
+
+		int count = 0;
+		auto child = [&] (flt ang, v2 dir, int prev_dir) {
+			v2 pos = b.pos + dir * b.size * p.factor;
+
+			children[count] = { pos, dir, ang, b.size * p.factor, prev_dir };
+			verts[count*2   ] = { v3(b.pos, 0) };
+			verts[count*2 +1] = { v3(pos, 0) };
+			count++;
+		};
+
+		if (b.prev_dir != -1)	child(ang_a, rotate2(deg(+90 +ang_a)) * b.dir, -1);
+		if (b.prev_dir != +1)	child(ang_b, rotate2(deg(-90 +ang_b)) * b.dir, +1);
+								child(ang_c, rotate2(deg(ang_c)) * b.dir, 0);
+		return count;
+	}
+
+	// expand all branches of a level into the next level
+	template <typename VERT>
+	inline void expand_level (Params const& p, std::vector<Branch> const& level, std::vector<Branch>* next, VERT** verts) {
+		next->resize(level.size() * 3);
+
+		uptr count = 0;
+		for (auto& b : level) {
+			int c = expand(p, b, &(*next)[count], *verts);
+			count += c;
+			*verts += c * 2;
+		}
+
+		next->resize(count);
+	}
+
+	class Tree_Generator {
+		NO_MOVE_COPY_CLASS(Tree_Generator)
+
+		static constexpr uptr MIN_LINES_PER_THREAD = 16 * 1024; // smaller trees are generated on the calling thread
+
+		Params						params;
+		bool						valid = false;
+
+		std::vector<uptr>			subtree_lines[2]; // [prev_dir != 0][levels below]
+		std::vector<Branch>			level, next;
+		std::vector<uptr>			offsets; // of the subtrees in the output
+
+		void _count_lines (int max_depth) {
+			for (auto& l : subtree_lines)
+				l.resize(max_depth +1);
+
+			subtree_lines[0][0] = 0;
+			subtree_lines[1][0] = 0;
+			for (int i=1; i<=max_depth; ++i) {
+				subtree_lines[0][i] = 3 + subtree_lines[1][i-1] * 2 + subtree_lines[0][i-1]; // a, b and c
+				subtree_lines[1][i] = 2 + subtree_lines[1][i-1]     + subtree_lines[0][i-1]; // a or b, and c
+			}
+		}
+
+	public:
+		flt							gen_ms = 0; // of the last generate that did not hit the cache
+		uptr						line_count = 0;
+
+		// writes the lines (pairs of vertices) of the tree into *vertices, returns false and leaves *vertices alone if the params did not change since the last call
+		template <typename VERT>
+		bool generate (Params const& p, std::vector<VERT>* vertices) {
+			if (valid && p == params)
+				return false;
+			params = p;
+			valid = true;
+
+			u64 begin = profiler::now_ns();
+
+			int max_depth = MAX(p.max_depth, 0);
+			_count_lines(max_depth);
+
+			line_count = subtree_lines[0][max_depth];
+			vertices->resize(line_count * 2);
+
+			VERT* out = vertices->data();
+
+			// first levels breadth first on this thread
+			uptr split = (uptr)parallel::thread_count() * 16;
+
+			level.assign(1, { v2(0), v2(0,+1), 0, p.size, 0 });
+			int depth = 0;
+			for (; depth < max_depth && level.size() < split; ++depth) {
+				expand_level(p, level, &next, &out);
+				std::swap(level, next);
+			}
+
+			// the rest as one subtree per branch of the current level
+			int levels_below = max_depth -depth;
+			if (levels_below > 0) {
+				offsets.resize(level.size() +1);
+				offsets[0] = out -vertices->data();
+				for (uptr i=0; i<level.size(); ++i)
+					offsets[i+1] = offsets[i] + subtree_lines[level[i].prev_dir != 0][levels_below] * 2;
+				assert(offsets.back() == vertices->size());
+
+				uptr min_subtrees = MAX(MIN_LINES_PER_THREAD / subtree_lines[0][levels_below], (uptr)1);
+
+				parallel_for((sptr)level.size(), [&] (sptr begin, sptr end) {
+					std::vector<Branch> cur, nxt; // per thread
+
+					for (sptr i=begin; i<end; ++i) {
+						VERT* verts = vertices->data() + offsets[i];
+
+						cur.assign(1, level[i]);
+						for (int d=0; d<levels_below; ++d) {
+							expand_level(p, cur, &nxt, &verts);
+							std::swap(cur, nxt);
+						}
+
+						assert(verts == vertices->data() + offsets[i+1]);
+					}
+				}, (sptr)min_subtrees);
+			} else {
+				assert(out == vertices->data() + vertices->size());
+			}
+
+			gen_ms = (flt)(profiler::now_ns() -begin) * 1e-6f;
+			return true;
+		}
+	};
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "mylibs/basic_typedefs.hpp"
+#include "mylibs/vector.hpp"
+#include "mylibs/float_precision.hpp"
+#include "mylibs/parallel.hpp"
+#include "mylibs/profiler.hpp"
+
+#include "deps/jcash_voronoi/src/jc_voronoi.h"
+
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+// Lloyd relaxation: every iteration moves each point to the centroid of its voronoi cell (inside rect)
+//  the diagram is generated by jcv into a Jcv_Arena, so after the first iteration no memory is allocated anymore
+//  the centroids are area weighted (sum of the triangles site, edge start, edge end) and computed in parallel over the sites
+//  stats of every iteration (timings and how far the points moved) are kept, to see when the points converged
+namespace lloyd {
+	using namespace basic_typedefs;
+	using namespace vector;
+	using namespace float_precision;
+
+	// bump allocator for jcv_diagram_generate_useralloc, jcv frees everything at once in jcv_diagram_free, so free is a noop and reset() recycles the memory
+	class Jcv_Arena {
+		NO_MOVE_COPY_CLASS(Jcv_Arena)
+
+		struct Block {
+			char*	data;
+			uptr	size;
+		};
+		std::vector<Block>	blocks; // only the last one is allocated from
+		uptr				used = 0; // in the last block
+		uptr				total_used = 0; // over all blocks since the last reset
+
+		static constexpr uptr ALIGN = 16;
+		static constexpr uptr MIN_BLOCK = 1024 * 1024;
+
+		void _free_blocks () {
+			for (auto& b : blocks)
+				::free(b.data);
+			blocks.clear();
+		}
+
+	public:
+		~Jcv_Arena () {
+			_free_blocks();
+		}
+
+		void* alloc (uptr size) {
+			size = (size +ALIGN -1) & ~(ALIGN -1);
+
+			if (blocks.size() == 0 || used +size > blocks.back().size) {
+				uptr block_size = MAX(MAX(size, MIN_BLOCK), blocks.size() ? blocks.back().size * 2 : 0);
+				blocks.push_back({ (char*)::malloc(block_size), block_size });
+				used = 0;
+			}
+
+			void* ptr = blocks.back().data +used;
+			used += size;
+			total_used += size;
+			return ptr;
+		}
+
+		// everything allocated since the last reset is dead, if it did not fit into one block, replace the blocks with one that fits all of it
+		void reset () {
+			if (blocks.size() > 1) {
+				uptr size = total_used +total_used / 4;
+				_free_blocks();
+				blocks.push_back({ (char*)::malloc(size), size });
+			}
+			used = 0;
+			total_used = 0;
+		}
+
+		uptr capacity () const {
+			uptr size = 0;
+			for (auto& b : blocks)
+				size += b.size;
+			return size;
+		}
+
+		static void* jcv_alloc (void* ctx, size_t size) {	return ((Jcv_Arena*)ctx)->alloc(size); }
+		static void jcv_free (void* ctx, void* ptr) {}
+	};
+
+	struct Iteration_Stats {
+		flt		voronoi_ms; // jcv diagram
+		flt		centroid_ms;
+		flt		rms_move; // root mean square distance the points moved, relative to the average point spacing sqrt(area / points)
+		flt		max_move; // relative to the average point spacing
+	};
+
+	class Lloyd_Relaxation {
+		NO_MOVE_COPY_CLASS(Lloyd_Relaxation)
+
+		Jcv_Arena			arena;
+		jcv_diagram			diagram = {};
+
+		std::vector<flt>	moved_sqr; // per point, of the last iteration
+
+		void _free_diagram () {
+			if (diagram.internal)
+				jcv_diagram_free(&diagram);
+			memset(&diagram, 0, sizeof(diagram));
+			arena.reset();
+		}
+
+	public:
+		jcv_rect						rect = {{ -1, -1 }, { +1, +1 }};
+		std::vector<Iteration_Stats>	stats; // of every iteration since clear_stats()
+
+		Lloyd_Relaxation (v2 rect_min, v2 rect_max) {
+			set_rect(rect_min, rect_max);
+		}
+		~Lloyd_Relaxation () {
+			_free_diagram();
+		}
+
+		void set_rect (v2 rect_min, v2 rect_max) {
+			rect.min.x = rect_min.x;
+			rect.min.y = rect_min.y;
+			rect.max.x = rect_max.x;
+			rect.max.y = rect_max.y;
+		}
+
+		void clear_stats () {
+			stats.clear();
+		}
+
+		uptr arena_capacity () const {
+			return arena.capacity();
+		}
+
+		// voronoi diagram of points, valid until the next generate() or relax()
+		jcv_diagram const& generate (std::vector<v2> const& points) {
+			static_assert(sizeof(jcv_point) == sizeof(v2), "jcv_real has to be float");
+
+			_free_diagram();
+			jcv_diagram_generate_useralloc((int)points.size(), (jcv_point const*)points.data(), &rect,
+				&arena, &Jcv_Arena::jcv_alloc, &Jcv_Arena::jcv_free, &diagram);
+			return diagram;
+		}
+
+		// one lloyd iteration, points have to be inside rect
+		Iteration_Stats relax (std::vector<v2>* points) {
+			Iteration_Stats s = {};
+
+			u64 begin = profiler::now_ns();
+
+			generate(*points);
+
+			u64 voronoi_end = profiler::now_ns();
+
+			jcv_site const* sites = jcv_diagram_get_sites(&diagram);
+			v2* pts = points->data();
+
+			moved_sqr.assign(points->size(), 0); // duplicate points are dropped by jcv and do not move
+
+			parallel_for(diagram.numsites, [&] (sptr begin, sptr end) {
+				for (sptr i=begin; i<end; ++i) {
+					auto& site = sites[i];
+					v2 p = v2(site.p.x, site.p.y);
+
+					// fan of triangles from the site to every edge, the site is inside its cell so all triangles have positive area
+					//  (if an edge is missing, eg. along the rect in old jcv versions, its triangle is just missing instead of skewing the result)
+					flt area2 = 0; // times 2
+					v2 sum = 0; // centroids times area2, relative to p for precision
+
+					for (auto* edge = site.edges; edge; edge = edge->next) {
+						v2 a = v2(edge->pos[0].x, edge->pos[0].y) -p;
+						v2 b = v2(edge->pos[1].x, edge->pos[1].y) -p;
+
+						flt tri_area2 = a.x * b.y -a.y * b.x;
+						area2 += tri_area2;
+						sum += (a +b) * tri_area2; // centroid of (0, a, b) is (a + b) / 3
+					}
+
+					if (area2 <= 0)
+						continue; // degenerate cell, keep the point
+
+					v2 centroid = p +sum / (area2 * 3);
+
+					v2 offs = centroid -pts[site.index];
+					moved_sqr[site.index] = dot(offs, offs);
+
+					pts[site.index] = centroid;
+				}
+			}, 4096);
+
+			u64 centroid_end = profiler::now_ns();
+
+			double sum_sqr = 0;
+			flt max_sqr = 0;
+			for (flt d : moved_sqr) {
+				sum_sqr += d;
+				max_sqr = MAX(max_sqr, d);
+			}
+
+			flt area = (rect.max.x -rect.min.x) * (rect.max.y -rect.min.y);
+			flt spacing = sqrt(area / (flt)MAX(points->size(), (uptr)1));
+
+			s.voronoi_ms = (flt)(voronoi_end -begin) * 1e-6f;
+			s.centroid_ms = (flt)(centroid_end -voronoi_end) * 1e-6f;
+			s.rms_move = (flt)sqrt(sum_sqr / (double)MAX(points->size(), (uptr)1)) / spacing;
+			s.max_move = sqrt(max_sqr) / spacing;
+
+			stats.push_back(s);
+			return s;
+		}
+
+		// relax until the rms movement drops below tolerance (relative to the point spacing) or max_iterations were done, returns the iterations done
+		int relax (std::vector<v2>* points, int max_iterations, flt tolerance=0) {
+			for (int i=0; i<max_iterations; ++i) {
+				if (relax(points).rms_move <= tolerance)
+					return i +1;
+			}
+			return max_iterations;
+		}
+	};
+}
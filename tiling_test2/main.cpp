@@ -8,96 +8,103 @@ using namespace imgui;
 
 std::vector<v2> points;
 Cpu_Mesh<Vertex_Draw_Lines> lines;
+Gpu_Mesh lines_gpu;
 
 #define JC_VORONOI_IMPLEMENTATION 1
 #include "deps/jcash_voronoi/src/jc_voronoi.h"
 
+#include "lloyd_relaxation.hpp"
+
 // Gen points
 int points_count = 100;
 flt area = 1;
 int relaxations = 0;
+int relaxations_per_frame = 1; // so big point sets can be watched converging
+flt tolerance = 0; // stop early when the points move less than this (rms, relative to the point spacing)
+int draw_limit = 20000; // dont draw more points than this
 
-jcv_diagram clac_voronoi (std::vector<v2> const& points) { // need to jcv_diagram_free(&diagram); !
-	jcv_diagram diagram;
-	memset(&diagram, 0, sizeof(jcv_diagram));
-
-	jcv_rect rect;
-	rect.min.x = -area;
-	rect.min.y = -area;
-	rect.max.x = +area;
-	rect.max.y = +area;
+lloyd::Lloyd_Relaxation relaxation (-1, +1);
+int relaxations_done = 0;
+bool converged = false;
 
-	jcv_diagram_generate((int)points.size(), (jcv_point*)&points[0], &rect, &diagram); // calc voronoi diagram
+void voronoi_draw (std::vector<v2> const& points) {
+	lines.clear();
 
-	return diagram;
-}
+	if ((int)points.size() <= draw_limit) {
+		auto& diagram = relaxation.generate(points);
 
-void voronoi_relax (std::vector<v2>* points) {
-	jcv_diagram diagram = clac_voronoi(*points);
-	defer {
-		jcv_diagram_free(&diagram);
-	};
+		const jcv_site* cells = jcv_diagram_get_sites(&diagram);
 
-	const jcv_site* cells = jcv_diagram_get_sites(&diagram);
+		for (int cell_i=0; cell_i<diagram.numsites; ++cell_i) {
+			auto& cell = cells[cell_i];
 
-	// relax original points
-	for (int cell_i=0; cell_i<diagram.numsites; ++cell_i) {
-		auto& cell = cells[cell_i];
+			auto* edge = cell.edges;
+			while (edge) { // draw voronoi cells
 
-		jcv_point sum = cell.p;
-		int count = 1;
+				lines.vertices.push_back({ v3(edge->pos[0].x,edge->pos[0].y, 0) });
+				lines.vertices.push_back({ v3(edge->pos[1].x,edge->pos[1].y, 0) });
 
-		auto* edge = cell.edges;
-		while (edge) {
-			sum.x += edge->pos[0].x;
-			sum.y += edge->pos[0].y;
-			++count;
-			edge = edge->next;
+				edge = edge->next;
+			}
 		}
-
-		(*points)[cell.index].x = sum.x / count;
-		(*points)[cell.index].y = sum.y / count;
 	}
+
+	lines_gpu = lines.upload();
 }
-void voronoi_draw (std::vector<v2> const& points) {
-	jcv_diagram diagram = clac_voronoi(points);
-	defer {
-		jcv_diagram_free(&diagram);
-	};
-	
-	const jcv_site* cells = jcv_diagram_get_sites(&diagram);
 
-	for (int cell_i=0; cell_i<diagram.numsites; ++cell_i) {
-		auto& cell = cells[cell_i];
+void gen_points () {
+	bool regen = false;
+	regen = imgui::DragInt("points_count", &points_count) || regen;
+	regen = imgui::DragFloat("area", &area, 1.0f / 30) || regen;
+	regen = imgui::DragInt("relaxations", &relaxations, 1.0f / 20) || regen;
+	imgui::DragInt("relaxations_per_frame", &relaxations_per_frame, 1.0f / 20);
+	regen = imgui::DragFloat("tolerance", &tolerance, 0.0001f, 0, 1, "%.5f") || regen;
+	imgui::DragInt("draw_limit", &draw_limit, 100);
 
-		auto* edge = cell.edges;
-		while (edge) { // draw voronoi cells
+	static bool inited = false;
+	if (regen || !inited) {
+		inited = true;
 
-			lines.vertecies.push_back({ v2(edge->pos[0].x,edge->pos[0].y) });
-			lines.vertecies.push_back({ v2(edge->pos[1].x,edge->pos[1].y) });
+		points.clear();
 
-			edge = edge->next;
+		auto rand = n_random::Generator(0);
+
+		for (int i=0; i<points_count; ++i) {
+			points.push_back( n_random::uniform(rand, v2(-area),v2(+area)) );
 		}
-	}
-}
 
-void gen_points () {
-	imgui::DragInt("points_count", &points_count);
-	imgui::DragFloat("area", &area, 1.0f / 30);
-	imgui::DragInt("relaxations", &relaxations, 1.0f / 20);
+		relaxation.set_rect(-area, +area);
+		relaxation.clear_stats();
+		relaxations_done = 0;
+		converged = false;
 
-	points.clear();
-	lines.clear();
+		voronoi_draw(points);
+	}
 
-	auto rand = random::Generator(0);
+	if (relaxations_done < relaxations && !converged) {
+		for (int i=0; i<relaxations_per_frame && relaxations_done < relaxations && !converged; ++i) {
+			auto s = relaxation.relax(&points);
+			relaxations_done++;
+			converged = s.rms_move <= tolerance;
+		}
 
-	for (int i=0; i<points_count; ++i) {
-		points.push_back( random::uniform(rand, v2(-area),v2(+area)) );
+		voronoi_draw(points);
 	}
 
-	for (int i=0; i<relaxations; ++i)
-		voronoi_relax(&points);
-	voronoi_draw(points);
+	// stats
+	imgui::Text("relaxations done: %d%s", relaxations_done, converged ? " (converged)" : "");
+	if (relaxation.stats.size() > 0) {
+		auto& s = relaxation.stats.back();
+		imgui::Text("last iteration: voronoi %.2f ms  centroids %.2f ms", s.voronoi_ms, s.centroid_ms);
+		imgui::Text("moved: rms %.5f  max %.5f (of point spacing)", s.rms_move, s.max_move);
+		imgui::Text("jcv arena: %.2f MB", (flt)relaxation.arena_capacity() / (1024 * 1024));
+
+		static std::vector<flt> rms;
+		rms.clear();
+		for (auto& st : relaxation.stats)
+			rms.push_back(st.rms_move);
+		imgui::PlotLines("rms_move", rms.data(), (int)rms.size(), 0, nullptr, 0, FLT_MAX, ImVec2(0, 60));
+	}
 }
 
 struct App : public Application {
@@ -121,9 +128,11 @@ struct App : public Application {
 	
 		gen_points();
 
-		for (auto p : points)
-			draw_rect(p, 0.01f, lrgba(0,0,0,1));
-		draw_lines(lines, 0, 1, lrgba(1,0.5f,0.5f,1));
+		if ((int)points.size() <= draw_limit) {
+			for (auto p : points)
+				draw_rect(p, 0.01f, lrgba(0,0,0,1));
+			draw_lines(lines_gpu, 0, quat::ident(), 1, lrgba(1,0.5f,0.5f,1));
+		}
 	}
 };
 
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <unordered_set>
+
+#include "mylibs/parallel.hpp"
+#include "mylibs/simple_file_io.hpp"
+#include "mylibs/profiler.hpp"
+#include "texture_filter_cpu.hpp"
+
+// Headless batch mode: filter every image in a directory tree and write the results into out_dir, keeping the directory structure
+// decode -> filter -> encode run as a pipeline with bounded queues between the stages, so loading/saving files overlaps with filtering
+// (filter_image already uses all cores for one image, decode and encode get a few threads each since they are single threaded in stb)
+// every finished file is appended to a progress file in out_dir, rerunning the same batch skips those, so a killed job can just be restarted
+//  the progress file starts with the settings that affect the output, if they changed the batch starts over instead of skipping files that were filtered differently
+// files that stb can not decode (by extension) are ignored, the output keeps the source extension (a.jpg -> a.jpg.png) so a.jpg and a.png do not overwrite each other
+namespace batch {
+	using namespace texture_filter_cpu;
+
+	struct Batch_Settings {
+		std::string		in_dir; // with trailing '/'
+		std::string		out_dir; // with trailing '/'
+		Filter_Params	params;
+		flt				scale = 2;
+
+		int				decode_threads = 2;
+		int				encode_threads = 2;
+		int				queue_size = 4; // max images waiting between two stages, bounds memory use
+
+		bool			resume = true; // skip files listed in the progress file
+	};
+
+	struct Batch_Stats {
+		int		total = 0;
+		int		skipped = 0; // already done in a previous run
+		int		processed = 0;
+		int		failed = 0;
+		int		ignored = 0; // not an image file
+
+		u64		in_pixels = 0;
+		u64		out_pixels = 0;
+
+		flt		seconds = 0;
+
+		// time each stage spent working (summed over its threads), the stage with the highest busy time per thread is the bottleneck
+		flt		decode_seconds = 0;
+		flt		filter_seconds = 0;
+		flt		encode_seconds = 0;
+
+		void print_report (Batch_Settings const& s) const {
+			printf("batch: %d files, %d processed, %d failed, %d skipped (already done), %d ignored (not images)\n", total, processed, failed, skipped, ignored);
+			if (seconds <= 0)
+				return;
+			printf("  %8.3f s  %7.2f images/s  in: %7.2f MP/s  out: %7.2f MP/s\n",
+				seconds, (flt)processed / seconds, (flt)in_pixels / 1000000 / seconds, (flt)out_pixels / 1000000 / seconds);
+			printf("  busy per thread:  decode (%d): %8.3f s  filter (1): %8.3f s  encode (%d): %8.3f s\n",
+				s.decode_threads, decode_seconds / (flt)s.decode_threads, filter_seconds, s.encode_threads, encode_seconds / (flt)s.encode_threads);
+		}
+	};
+
+	static constexpr cstr PROGRESS_FILENAME = "batch_progress.txt";
+
+	// first line of the progress file
+	std::string _settings_line (Batch_Settings const& s) {
+		auto& p = s.params;
+		char buf[256];
+		snprintf(buf, sizeof(buf), "settings: scale %.9g step_size_px %.9g threshold %.9g gradient_normal_samples %d nearest %d",
+			s.scale, p.step_size_px, p.threshold, p.gradient_normal_samples, (int)p.nearest);
+		return buf;
+	}
+
+	// extensions stbi_load can decode
+	bool _is_image_file (std::string const& rel_path) {
+		auto ext = rel_path.find_last_of('.');
+		auto slash = rel_path.find_last_of('/');
+		if (ext == std::string::npos || (slash != std::string::npos && ext < slash))
+			return false;
+
+		std::string e = rel_path.substr(ext +1);
+		for (auto& c : e)
+			c = (char)tolower(c);
+
+		for (cstr img_ext : { "png", "jpg", "jpeg", "bmp", "tga", "gif", "psd", "hdr", "pic", "pnm", "ppm", "pgm" })
+			if (e == img_ext)
+				return true;
+		return false;
+	}
+
+	void _collect_files (Directory_Tree const& dir, std::string const& rel_path, std::vector<std::string>* files) {
+		for (auto& d : dir.dirs)
+			_collect_files(d, rel_path + d.name, files);
+		for (auto& f : dir.filenames)
+			files->push_back(rel_path + f);
+	}
+
+	// returns false if there is no progress file or it was written with other settings
+	bool _load_progress (std::string const& filepath, std::string const& settings_line, std::unordered_set<std::string>* done) {
+		std::string text;
+		if (!simple_file_io::load_text_file(filepath.c_str(), &text))
+			return false;
+
+		uptr begin = text.find('\n');
+		if (begin == std::string::npos || text.compare(0, begin, settings_line) != 0) {
+			printf("batch: \"%s\" was written with other settings, starting over\n", filepath.c_str());
+			return false;
+		}
+		begin++;
+
+		while (begin < text.size()) {
+			uptr end = text.find('\n', begin);
+			if (end == std::string::npos)
+				break; // last line was not finished writing, redo that file
+			if (end > begin)
+				done->insert(text.substr(begin, end -begin));
+			begin = end +1;
+		}
+		return true;
+	}
+
+	std::string _out_filepath (Batch_Settings const& s, std::string const& rel_path) {
+		return s.out_dir + rel_path + ".png";
+	}
+
+	// "" stays "" (current directory)
+	void add_trailing_slash (std::string* dir) {
+		if (!dir->empty() && dir->back() != '/' && dir->back() != '\\')
+			dir->push_back('/');
+	}
+
+	struct _Item {
+		std::string			rel_path;
+		Image				img;
+		iv2					out_size_px;
+		std::vector<srgba8>	out;
+	};
+
+	Batch_Stats run_batch (Batch_Settings const& s) {
+		Batch_Stats stats;
+
+		u64 begin = profiler::now_ns();
+
+		Directory_Tree tree;
+		find_files_recursive(s.in_dir, &tree);
+		if (!tree.valid) {
+			errprint("batch: could not read directory \"%s\"!\n", s.in_dir.c_str());
+			return stats;
+		}
+
+		if (!create_directories(s.out_dir)) {
+			errprint("batch: could not create directory \"%s\"!\n", s.out_dir.c_str());
+			return stats;
+		}
+
+		std::vector<std::string> all_files;
+		_collect_files(tree, "", &all_files);
+		stats.total = (int)all_files.size();
+
+		std::string progress_filepath = s.out_dir + PROGRESS_FILENAME;
+		std::string settings_line = _settings_line(s);
+
+		std::unordered_set<std::string> done;
+		bool resume = s.resume && _load_progress(progress_filepath, settings_line, &done);
+
+		std::vector<std::string> files;
+		for (auto& f : all_files) {
+			if (!_is_image_file(f))				stats.ignored++;
+			else if (done.find(f) != done.end())	stats.skipped++;
+			else								files.push_back(f);
+		}
+
+		FILE* progress_file = fopen(progress_filepath.c_str(), resume ? "ab" : "wb");
+		if (!progress_file)
+			errprint("batch: could not open \"%s\", progress will not be saved!\n", progress_filepath.c_str());
+		else if (!resume)
+			fprintf(progress_file, "%s\n", settings_line.c_str());
+
+		stbi_set_flip_vertically_on_load(true); // global in stb, so set it here and not by every decode or encode thread
+		stbi_flip_vertically_on_write(1);
+
+		std::mutex stats_mutex; // for stats and the progress file
+
+		Bounded_Queue<std::unique_ptr<_Item>> decoded (s.queue_size);
+		Bounded_Queue<std::unique_ptr<_Item>> filtered (s.queue_size);
+
+		std::atomic<uptr> next_file (0);
+
+		// decode
+		std::vector<std::thread> decoders;
+		for (int i=0; i<s.decode_threads; ++i) {
+			decoders.emplace_back([&] () {
+				for (;;) {
+					uptr indx = next_file++;
+					if (indx >= files.size())
+						break;
+
+					u64 t = profiler::now_ns();
+
+					auto item = std::make_unique<_Item>();
+					item->rel_path = files[indx];
+					bool ok = load_image(s.in_dir + item->rel_path, &item->img);
+
+					flt sec = (flt)(profiler::now_ns() -t) * 1e-9f;
+					{
+						std::lock_guard<std::mutex> lock(stats_mutex);
+						stats.decode_seconds += sec;
+						if (ok) stats.in_pixels += (u64)item->img.size_px.x * item->img.size_px.y;
+						else	stats.failed++;
+					}
+
+					if (ok)
+						decoded.push(std::move(item));
+				}
+			});
+		}
+
+		// filter
+		std::thread filterer ([&] () {
+			std::unique_ptr<_Item> item;
+			while (decoded.pop(&item)) {
+				u64 t = profiler::now_ns();
+
+				item->out_size_px = calc_out_size(item->img.size_px, s.scale);
+				filter_image(item->img, s.params, item->out_size_px, &item->out);
+
+				item->img = Image(); // free the input early, encode does not need it
+
+				flt sec = (flt)(profiler::now_ns() -t) * 1e-9f;
+				{
+					std::lock_guard<std::mutex> lock(stats_mutex);
+					stats.filter_seconds += sec;
+				}
+
+				filtered.push(std::move(item));
+			}
+		});
+
+		// encode
+		std::vector<std::thread> encoders;
+		for (int i=0; i<s.encode_threads; ++i) {
+			encoders.emplace_back([&] () {
+				std::unique_ptr<_Item> item;
+				while (filtered.pop(&item)) {
+					u64 t = profiler::now_ns();
+
+					std::string out_filepath = _out_filepath(s, item->rel_path);
+
+					bool ok = create_directories(out_filepath) && write_image_png(out_filepath, item->out.data(), item->out_size_px);
+
+					flt sec = (flt)(profiler::now_ns() -t) * 1e-9f;
+
+					std::lock_guard<std::mutex> lock(stats_mutex);
+					stats.encode_seconds += sec;
+
+					if (!ok) {
+						stats.failed++;
+						continue;
+					}
+
+					stats.processed++;
+					stats.out_pixels += (u64)item->out_size_px.x * item->out_size_px.y;
+
+					if (progress_file) { // only written once the file is complete, so a killed run never skips a half written file
+						fprintf(progress_file, "%s\n", item->rel_path.c_str());
+						fflush(progress_file);
+					}
+				}
+			});
+		}
+
+		for (auto& t : decoders)
+			t.join();
+		decoded.close();
+
+		filterer.join();
+		filtered.close();
+
+		for (auto& t : encoders)
+			t.join();
+
+		if (progress_file)
+			fclose(progress_file);
+
+		stats.seconds = (flt)(profiler::now_ns() -begin) * 1e-9f;
+		return stats;
+	}
+}
@@ -3,6 +3,8 @@
 #include "3d_lib/camera2D.hpp"
 #include "mylibs/find_files.hpp"
 #include "3d_lib/common_colors.hpp"
+#include "texture_filter_cpu.hpp"
+#include "batch.hpp"
 using namespace n_find_files;
 using namespace engine;
 using namespace common_colors;
@@ -142,7 +144,7 @@ struct Show_Dir {
 	}
 };
 
-bool file_select (Input& inp, Texture2D** tex, iv2* size_px) {
+bool file_select (Input& inp, Texture2D** tex, iv2* size_px, std::string* out_selected_file=nullptr, Directory_Tree const** out_dir=nullptr) {
 	static bool init = true;
 
 	static std::string folder = "images/";//"J:/upscaler_test";
@@ -164,11 +166,15 @@ bool file_select (Input& inp, Texture2D** tex, iv2* size_px) {
 		folder_ok = dw->directory_is_valid();
 	}
 
+	if (out_dir) *out_dir = folder_ok ? &dir : nullptr;
+
 	if (!folder_ok)
 		return false;
 
 	static std::string selected_file = "images/test.png";//"J:/upscaler_test/01.jpg";
 	bool selected_file_changed = Show_Dir::show(inp, dir, &selected_file);
+
+	if (out_selected_file) *out_selected_file = selected_file;
 	
 	if (selected_file.size() == 0)
 		*tex = nullptr;
@@ -178,10 +184,203 @@ bool file_select (Input& inp, Texture2D** tex, iv2* size_px) {
 	return selected_file_changed;
 }
 
+using texture_filter_cpu::Filter_Params;
+
+// sets gl state and uniforms for the texture_filter shader, caller still has to set model_to_world and draw the rect
+Shader* use_texture_filter_shader (bool disable_filter, Filter_Params const& params, Texture2D const& tex, iv2 size_px) {
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_TRUE);
+	glDisable(GL_CULL_FACE);
+	glDisable(GL_SCISSOR_TEST);
+
+	inline_shader("texture_filter_common.vert", R"_SHAD(
+		$include "common.vert"
+
+		in		vec2	pos_model;
+		in		vec2	uv;
+
+		out		vec2	vs_uv;
+
+		uniform	mat4	model_to_world;
+		uniform	mat4	view_world_to_cam;
+		uniform	mat4	view_cam_to_clip;
+
+		void vert () {
+			gl_Position = view_cam_to_clip * view_world_to_cam * model_to_world * vec4(pos_model, 0,1);
+			vs_uv = uv;
+		}
+	)_SHAD");
+	inline_shader("texture_filter_common.frag", R"_SHAD(
+		$include "common.frag"
+			
+		in		vec2		vs_uv;
+
+		uniform vec2		tex_size_px;
+		uniform sampler2D	tex;
+
+		vec4 filter ();
+
+		vec4 frag () {
+			return filter();
+		}
+	)_SHAD");
+
+	inline_shader("texture_filter_no_filter.vert", R"_SHAD(
+		$include "texture_filter_common.vert"
+	)_SHAD");
+	inline_shader("texture_filter_no_filter.frag", R"_SHAD(
+		$include "texture_filter_common.frag"
+				
+		vec4 filter () { return texture(tex, vs_uv); }
+	)_SHAD");
+
+	inline_shader("texture_filter.vert", R"_SHAD(
+		$include "texture_filter_common.vert"
+	)_SHAD");
+
+	auto* s = use_shader(disable_filter ? "texture_filter_no_filter" : "texture_filter");
+	if (s) {
+		set_uniform(s, "tex_size_px", (v2)size_px);
+		bind_texture(s, "tex", 0, tex);
+
+		set_uniform(s, "step_size_px", params.step_size_px);
+		set_uniform(s, "threshold", params.threshold);
+		set_uniform(s, "gradient_normal_samples", params.gradient_normal_samples);
+	}
+	return s;
+}
+
+Gpu_Mesh& texture_draw_rect () {
+	static auto rect = engine::gen_rect<Texture_Draw_Rect>([] (v2 p, v2 uv) { return Texture_Draw_Rect{p, uv}; }).upload();
+	return rect;
+}
+
+// render the filter into a texture of out_size_px and read it back, so we can compare the cpu version against it
+// messes with the framebuffer binding and the shared view uniforms, so call before drawing anything else
+//  the target texture and fbo are kept and only reallocated when out_size_px changes
+bool render_texture_filter_gpu (Filter_Params const& params, Texture2D const& tex, iv2 size_px, iv2 out_size_px, std::vector<srgba8>* out) {
+	static Texture2D target;
+	static FBO fbo;
+	static iv2 target_size_px = 0;
+
+	if (target.is_null() || any(target_size_px != out_size_px)) {
+		target = alloc_texture(out_size_px, { PF_SRGBA8, NO_MIPMAPS, FILTER_NEAREST, BORDER_CLAMP });
+		fbo = create_fbo(target, out_size_px);
+		target_size_px = out_size_px;
+	}
+
+	draw_to_texture(fbo, { 0, out_size_px });
+
+	set_shared_uniform("view", "world_to_cam", m4::ident());
+	set_shared_uniform("view", "cam_to_clip", m4::ident());
+	set_shared_uniform("common", "mcursor_pos_window", v2(-1)); // shader shows the unfiltered image left of the mouse cursor (dbg_left)
+
+	auto* s = use_texture_filter_shader(false, params, tex, size_px);
+	if (!s) {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return false;
+	}
+
+	glDisable(GL_BLEND); // want the raw shader output, including alpha
+
+	set_uniform(s, "model_to_world", scaleH(v3(2,2,1)).m4()); // rect is -0.5 to +0.5, cover all of clip space
+	texture_draw_rect().draw(*s);
+
+	out->resize((uptr)out_size_px.x * out_size_px.y);
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0,0, out_size_px.x,out_size_px.y, GL_RGBA, GL_UNSIGNED_BYTE, out->data());
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	return true;
+}
+
+struct Cpu_Filter_Gui {
+	flt			scale = 2;
+	std::string	out_folder = "filtered/";
+
+	bool							have_batch_stats = false;
+	batch::Batch_Stats				batch_stats;
+
+	bool							have_compare = false;
+	iv2								compare_size_px;
+	texture_filter_cpu::Filter_Stats	simd_stats, ref_stats;
+	texture_filter_cpu::Image_Diff		simd_vs_ref, cpu_vs_gpu;
+
+	void imgui (Input& inp, Filter_Params const& params, Directory_Tree const* dir, std::string const& selected_file, Texture2D const* tex, iv2 size_px) {
+		if (!imgui::CollapsingHeader("CPU filter"))
+			return;
+
+		imgui::DragFloat("scale", &scale, 0.01f);
+		scale = MAX(scale, 1.0f); // cpu version does not do mipmapping
+
+		imgui::InputText_str("out folder", &out_folder);
+
+		static bool resume = false;
+		imgui::Checkbox("resume", &resume);
+		imgui::SameLine();
+		if (imgui::Button("filter folder") && dir) {
+			batch::Batch_Settings s;
+			s.in_dir = dir->name;
+			s.out_dir = out_folder;
+			batch::add_trailing_slash(&s.in_dir);
+			batch::add_trailing_slash(&s.out_dir);
+			s.params = params;
+			s.scale = scale;
+			s.resume = resume;
+
+			batch_stats = batch::run_batch(s);
+			batch_stats.print_report(s);
+			have_batch_stats = true;
+		}
+		if (have_batch_stats) {
+			auto& b = batch_stats;
+			imgui::Text("%d images (%d failed, %d skipped)  %8.3f s", b.processed, b.failed, b.skipped, b.seconds);
+			imgui::Text("%6.2f images/s  out: %6.2f MP/s", (flt)b.processed / MAX(b.seconds, 0.000001f), (flt)b.out_pixels / 1000000 / MAX(b.seconds, 0.000001f));
+		}
+
+		if (imgui::Button("compare cpu vs gpu (selected image)") && tex && selected_file.size() > 0) {
+			texture_filter_cpu::Image img;
+			stbi_set_flip_vertically_on_load(true);
+			stbi_flip_vertically_on_write(1);
+			if (texture_filter_cpu::load_image(selected_file, &img)) {
+				compare_size_px = texture_filter_cpu::calc_out_size(img.size_px, scale);
+
+				std::vector<srgba8> simd, ref, gpu;
+				simd_stats = texture_filter_cpu::filter_image(img, params, compare_size_px, &simd, true);
+				ref_stats = texture_filter_cpu::filter_image(img, params, compare_size_px, &ref, false);
+
+				simd_vs_ref = texture_filter_cpu::compare_images(simd.data(), ref.data(), compare_size_px);
+
+				if (render_texture_filter_gpu(params, *tex, size_px, compare_size_px, &gpu))
+					cpu_vs_gpu = texture_filter_cpu::compare_images(simd.data(), gpu.data(), compare_size_px);
+
+				set_shared_uniform("common", "mcursor_pos_window", inp.mouse_cursor_pos_px());
+				have_compare = true;
+			}
+		}
+		if (have_compare) {
+			auto show_diff = [] (cstr name, texture_filter_cpu::Image_Diff const& d) {
+				imgui::Text("%-12s max: %3d mean: %8.5f psnr: %6.2f dB differing pixels: %llu", name, d.max_abs, d.mean_abs, d.psnr, (unsigned long long)d.differing_pixels);
+			};
+
+			imgui::Text("%d x %d", compare_size_px.x, compare_size_px.y);
+			imgui::Text("simd: %8.3f ms  %6.2f MP/s", simd_stats.seconds * 1000, simd_stats.mpix_per_sec());
+			imgui::Text("ref:  %8.3f ms  %6.2f MP/s", ref_stats.seconds * 1000, ref_stats.mpix_per_sec());
+			show_diff("simd vs ref", simd_vs_ref);
+			show_diff("cpu vs gpu", cpu_vs_gpu);
+		}
+	}
+};
+
 struct App : public Application {
 
 	Camera2D cam;
 
+	Cpu_Filter_Gui cpu_filter;
+
 	void frame () {
 
 		static bool wireframe_enable = false;
@@ -191,7 +390,14 @@ struct App : public Application {
 
 		static iv2 size_px;
 		static Texture2D* tex;
-		bool tex_changed = file_select(inp, &tex, &size_px);
+		std::string selected_file;
+		Directory_Tree const* dir = nullptr;
+		bool tex_changed = file_select(inp, &tex, &size_px, &selected_file, &dir);
+
+		static bool disable_filter = false;
+		static Filter_Params filter_params;
+
+		cpu_filter.imgui(inp, filter_params, dir, selected_file, tex, size_px);
 
 		//
 		engine::draw_to_screen(inp.wnd_size_px);
@@ -227,99 +433,62 @@ struct App : public Application {
 				cam.size_world = cam_size_world;
 			}*/
 
-			static bool filter_nearest = false;
-			if (imgui::Checkbox("filter_nearest", &filter_nearest) || tex_changed)
-				tex->set_minmag_filtering(filter_nearest ? FILTER_NEAREST : FILTER_LINEAR, USE_MIPMAPS);
+			if (imgui::Checkbox("filter_nearest", &filter_params.nearest) || tex_changed) // in the params so the cpu filter samples the same way
+				tex->set_minmag_filtering(filter_params.nearest ? FILTER_NEAREST : FILTER_LINEAR, USE_MIPMAPS);
 		
-			static bool disable_filter = false;
 			imgui::Checkbox("disable_filter", &disable_filter);
 
+			imgui::DragFloat("step_size_px", &filter_params.step_size_px, 0.1f / 40);
+			imgui::DragFloat("threshold", &filter_params.threshold, 0.01f / 30);
+			imgui::DragInt("gradient_normal_samples", &filter_params.gradient_normal_samples, 1.0f / 20);
 
-			static flt step_size_px = 1;
-			imgui::DragFloat("step_size_px", &step_size_px, 0.1f / 40);
-
-			static flt threshold = 0.2f;
-			imgui::DragFloat("threshold", &threshold, 0.01f / 30);
-
-			static int gradient_normal_samples = 8;
-			imgui::DragInt("gradient_normal_samples", &gradient_normal_samples, 1.0f / 20);
-
-			{
-				glEnable(GL_BLEND);
-				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-				glDisable(GL_DEPTH_TEST);
-				glDepthMask(GL_TRUE);
-				glDisable(GL_CULL_FACE);
-				glDisable(GL_SCISSOR_TEST);
-
-				inline_shader("texture_filter_common.vert", R"_SHAD(
-					$include "common.vert"
-
-					in		vec2	pos_model;
-					in		vec2	uv;
-
-					out		vec2	vs_uv;
-
-					uniform	mat4	model_to_world;
-					uniform	mat4	view_world_to_cam;
-					uniform	mat4	view_cam_to_clip;
-
-					void vert () {
-						gl_Position = view_cam_to_clip * view_world_to_cam * model_to_world * vec4(pos_model, 0,1);
-						vs_uv = uv;
-					}
-				)_SHAD");
-				inline_shader("texture_filter_common.frag", R"_SHAD(
-					$include "common.frag"
-			
-					in		vec2		vs_uv;
-
-					uniform vec2		tex_size_px;
-					uniform sampler2D	tex;
-
-					vec4 filter ();
-
-					vec4 frag () {
-						return filter();
-					}
-				)_SHAD");
-
-				inline_shader("texture_filter_no_filter.vert", R"_SHAD(
-					$include "texture_filter_common.vert"
-				)_SHAD");
-				inline_shader("texture_filter_no_filter.frag", R"_SHAD(
-					$include "texture_filter_common.frag"
-				
-					vec4 filter () { return texture(tex, vs_uv); }
-				)_SHAD");
-
-				inline_shader("texture_filter.vert", R"_SHAD(
-					$include "texture_filter_common.vert"
-				)_SHAD");
+			auto* s = use_texture_filter_shader(disable_filter, filter_params, *tex, size_px);
+			if (s) {
+				hm model_to_world = scaleH(v3(tex_size_world,1));
+				set_uniform(s, "model_to_world", model_to_world.m4());
 
-				auto* s = use_shader(disable_filter ? "texture_filter_no_filter" : "texture_filter");
-				if (s) {
+				texture_draw_rect().draw(*s);
+			}
+		}
+	}
+};
 
-					hm model_to_world = scaleH(v3(tex_size_world,1));
-					set_uniform(s, "model_to_world", model_to_world.m4());
+// upscaler --batch <in_dir> <out_dir> [--scale <scale>] [--restart]
+//  filters every image in in_dir without opening a window, see batch.hpp
+int run_batch_from_args (int argc, char** argv) {
+	batch::Batch_Settings s;
+
+	int positional = 0;
+	for (int i=2; i<argc; ++i) {
+		std::string arg = argv[i];
+
+		if (		arg == "--scale" && i+1 < argc )	s.scale = MAX((flt)atof(argv[++i]), 1.0f);
+		else if (	arg == "--restart" )				s.resume = false;
+		else if (	positional == 0 )					{ s.in_dir = arg; positional++; }
+		else if (	positional == 1 )					{ s.out_dir = arg; positional++; }
+		else {
+			errprint("unknown argument \"%s\"\n", arg.c_str());
+			return 1;
+		}
+	}
+	if (positional != 2 || s.in_dir.empty() || s.out_dir.empty()) {
+		errprint("usage: upscaler --batch <in_dir> <out_dir> [--scale <scale>] [--restart]\n");
+		return 1;
+	}
 
-					set_uniform(s, "tex_size_px", (v2)size_px);
-					bind_texture(s, "tex", 0, *tex);
+	batch::add_trailing_slash(&s.in_dir);
+	batch::add_trailing_slash(&s.out_dir);
 
+	auto stats = batch::run_batch(s);
+	stats.print_report(s);
 
-					set_uniform(s, "step_size_px", step_size_px);
-					set_uniform(s, "threshold", threshold);
-					set_uniform(s, "gradient_normal_samples", gradient_normal_samples);
+	return stats.failed == 0 ? 0 : 1;
+}
 
-					static auto rect = engine::gen_rect<Texture_Draw_Rect>([] (v2 p, v2 uv) { return Texture_Draw_Rect{p, uv}; }).upload();
-					rect.draw(*s);
-				}
-			}
-		}
-	}
-};
+int main (int argc, char** argv) {
+	if (argc >= 2 && strcmp(argv[1], "--batch") == 0)
+		return run_batch_from_args(argc, argv);
 
-int main () {
 	App app;
 	app.open(MSVC_PROJECT_NAME);
 	app.run();
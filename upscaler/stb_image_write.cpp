@@ -0,0 +1,3 @@
+// the one TU that compiles the stb_image_write implementation, texture_filter_cpu.hpp only includes the declarations
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "deps/stb/stb_image_write.h"
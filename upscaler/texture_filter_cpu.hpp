@@ -0,0 +1,420 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "mylibs/basic_typedefs.hpp"
+#include "mylibs/vector.hpp"
+#include "mylibs/colors.hpp"
+#include "mylibs/parallel.hpp"
+#include "mylibs/profiler.hpp"
+#include "mylibs/find_files.hpp"
+
+#include "deps/stb/stb_image.h"
+#include "deps/stb/stb_image_write.h" // implementation is compiled in stb_image_write.cpp
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+	#define TEXTURE_FILTER_SSE2 1
+	#include "emmintrin.h"
+#else
+	#define TEXTURE_FILTER_SSE2 0
+#endif
+
+#ifdef _WIN32
+	#include "windows.h"
+#else
+	#include <sys/stat.h>
+	#include <errno.h>
+#endif
+
+#ifndef errprint
+	#define errprint(...) fprintf(stderr, __VA_ARGS__)
+#endif
+
+// CPU version of shaders/texture_filter.frag, so we can filter without a gl context (batch processing, checking the gpu output)
+// produces what the shader renders when the texture (FILTER_LINEAR or FILTER_NEAREST with Filter_Params::nearest, BORDER_CLAMP) is drawn onto a rect covering a framebuffer of out_size_px
+// only magnification is handled (out_size_px >= size_px), the gpu would start sampling mipmaps otherwise
+namespace texture_filter_cpu {
+	using namespace basic_typedefs;
+	using namespace vector;
+	using namespace colors;
+	using namespace float_precision;
+	using namespace n_find_files;
+
+	struct Filter_Params {
+		flt		step_size_px = 1;
+		flt		threshold = 0.2f;
+		int		gradient_normal_samples = 8;
+
+		bool	nearest = false; // texture is sampled with FILTER_NEAREST instead of FILTER_LINEAR (only the scalar version implements this)
+	};
+
+	static constexpr int	EDGE_STEPS = 32; // int steps = 32; in calc_edge_distance
+
+	// linear float pixels, rows bottom-up like our textures
+	struct Image {
+		iv2					size_px = 0;
+		std::vector<lrgba>	pixels;
+		std::vector<flt>	luma; // the gradient only needs luma, and bilinear(luma) == luma(bilinear), so we sample this instead of the rgb
+
+		void set (srgba8 const* srgb_pixels, iv2 size) {
+			static struct To_Linear_Table {
+				flt v[256];
+				To_Linear_Table () {
+					for (int i=0; i<256; ++i)
+						v[i] = to_linear((flt)i / 255);
+				}
+			} to_linear_table;
+
+			size_px = size;
+			pixels.resize((uptr)size.x * size.y);
+			luma.resize((uptr)size.x * size.y);
+
+			for (uptr i=0; i<pixels.size(); ++i) {
+				u8v4 c = srgb_pixels[i].v;
+				lrgba l = lrgba(to_linear_table.v[c.x], to_linear_table.v[c.y], to_linear_table.v[c.z], (flt)c.w / 255); // alpha is always linear in opengl
+				pixels[i] = l;
+				luma[i] = l.x * 0.2126f +l.y * 0.7152f +l.z * 0.0722f;
+			}
+		}
+	};
+
+	// expects stbi_set_flip_vertically_on_load(true), that is global state in stb, so the caller sets it once instead of every (possibly concurrent) load
+	bool load_image (std::string const& filepath, Image* img) {
+		iv2 size;
+		int channels;
+		auto* pixels = (srgba8*)stbi_load(filepath.c_str(), &size.x,&size.y, &channels, 4);
+		if (!pixels) {
+			errprint("Image \"%s\" could not be loaded!\n", filepath.c_str());
+			return false;
+		}
+
+		img->set(pixels, size);
+
+		stbi_image_free(pixels);
+		return true;
+	}
+
+	// expects stbi_flip_vertically_on_write(1), global state in stb like the load flag, so the caller sets it once instead of every (possibly concurrent) write
+	bool write_image_png (std::string const& filepath, srgba8 const* pixels, iv2 size_px) {
+		if (!stbi_write_png(filepath.c_str(), size_px.x,size_px.y, 4, pixels, size_px.x * (int)sizeof(srgba8))) {
+			errprint("Image \"%s\" could not be written!\n", filepath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	// create every directory in a path like "a/b/c/" (or "a/b/c/file.png", the part after the last slash is ignored), existing directories are fine
+	bool create_directories (std::string const& path) {
+		for (uptr i=0; i<path.size(); ++i) {
+			if (path[i] != '/' || i == 0)
+				continue;
+
+			std::string dir = path.substr(0, i);
+		#ifdef _WIN32
+			if (!CreateDirectoryA(dir.c_str(), NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+				return false;
+		#else
+			if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+				return false;
+		#endif
+		}
+		return true;
+	}
+
+	//// Scalar version, follows the shader line by line, this is the reference the simd version is compared against
+
+	// pos in texels, texel centers are at +0.5 like in gl
+	template <typename T>
+	T _sample_bilinear (T const* data, iv2 size, v2 pos) {
+		v2 p = pos -0.5f;
+		v2 p0 = floor(p);
+		v2 t = p -p0;
+
+		iv2 a = clamp((iv2)p0,		0, size -1); // BORDER_CLAMP
+		iv2 b = clamp((iv2)p0 +1,	0, size -1);
+
+		T v00 = data[(uptr)a.y * size.x +a.x];
+		T v10 = data[(uptr)a.y * size.x +b.x];
+		T v01 = data[(uptr)b.y * size.x +a.x];
+		T v11 = data[(uptr)b.y * size.x +b.x];
+
+		return lerp(lerp(v00, v10, t.x), lerp(v01, v11, t.x), t.y);
+	}
+	template <typename T>
+	T _sample_nearest (T const* data, iv2 size, v2 pos) {
+		iv2 p = clamp((iv2)floor(pos), 0, size -1);
+		return data[(uptr)p.y * size.x +p.x];
+	}
+
+	struct _Filter {
+		Image const&		img;
+		Filter_Params		params;
+		std::vector<v2>		dirs; // dir of every gradient sample, already scaled by step_size_px
+		v2					half_texel_uv;
+
+		_Filter (Image const& img, Filter_Params const& params): img{img}, params{params} {
+			for (int i=0; i<params.gradient_normal_samples; ++i) {
+				flt ang = deg(360.0f) * (flt)i / (flt)params.gradient_normal_samples;
+				dirs.push_back(v2(cos(ang), sin(ang)) * params.step_size_px);
+			}
+			half_texel_uv = 0.5f / (v2)img.size_px;
+		}
+
+		template <typename T>
+		T sample (T const* data, v2 pos) const {
+			return params.nearest ? _sample_nearest(data, img.size_px, pos) : _sample_bilinear(data, img.size_px, pos);
+		}
+
+		v2 gradient_normal (v2 pos) const {
+			flt a = sample(img.luma.data(), pos);
+
+			v2 total = 0;
+			for (auto dir : dirs) {
+				flt b = sample(img.luma.data(), pos +dir);
+				flt d = MAX(b -a -params.threshold, 0.0f);
+				total += dir * (d*d);
+			}
+
+			return total * (4 * PI / (flt)params.gradient_normal_samples);
+		}
+
+		lrgba filter_pixel (v2 pos) const {
+			lrgba col = sample(img.pixels.data(), pos);
+
+			v2 gradient = gradient_normal(pos);
+			if (length(gradient) < 0.001f)
+				return col;
+
+			gradient = normalize(gradient);
+
+			flt step_size = 1.5f / (flt)EDGE_STEPS;
+			flt dist = 0;
+
+			int i;
+			for (i=0; i<EDGE_STEPS; ++i) {
+				v2 offs = -gradient * (dist +half_texel_uv); // the shader mixes texel and uv units here, keep it that way so we match
+
+				v2 gradient_b = gradient_normal(pos +offs);
+				if (dot(gradient, gradient_b) < 0.001f)
+					break;
+
+				dist += step_size;
+			}
+
+			flt edge = (flt)i / (flt)EDGE_STEPS > 0.5f ? 1.0f : 0.0f;
+			return lrgba(edge, edge, edge, col.w);
+		}
+
+	#if TEXTURE_FILTER_SSE2
+		//// simd version, 4 horizontally adjacent pixels per lane
+
+		static FORCEINLINE __m128 floor4 (__m128 x) {
+			__m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x)); // truncates towards zero
+			return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1)));
+		}
+
+		FORCEINLINE __m128 sample_luma4 (__m128 pos_x, __m128 pos_y) const {
+			__m128 px = _mm_sub_ps(pos_x, _mm_set1_ps(0.5f));
+			__m128 py = _mm_sub_ps(pos_y, _mm_set1_ps(0.5f));
+			__m128 x0 = floor4(px);
+			__m128 y0 = floor4(py);
+			__m128 tx = _mm_sub_ps(px, x0);
+			__m128 ty = _mm_sub_ps(py, y0);
+
+			__m128 zero = _mm_setzero_ps();
+			__m128 max_x = _mm_set1_ps((flt)(img.size_px.x -1));
+			__m128 max_y = _mm_set1_ps((flt)(img.size_px.y -1));
+			__m128 one = _mm_set1_ps(1);
+
+			alignas(16) s32 ax[4], bx[4], ay[4], by[4];
+			_mm_store_si128((__m128i*)ax, _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(x0, zero), max_x)));
+			_mm_store_si128((__m128i*)bx, _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(x0, one), zero), max_x)));
+			_mm_store_si128((__m128i*)ay, _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(y0, zero), max_y)));
+			_mm_store_si128((__m128i*)by, _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(y0, one), zero), max_y)));
+
+			// no gather in sse2
+			alignas(16) flt v00[4], v10[4], v01[4], v11[4];
+			flt const* luma = img.luma.data();
+			uptr w = (uptr)img.size_px.x;
+			for (int l=0; l<4; ++l) {
+				flt const* row_a = luma +(uptr)ay[l] * w;
+				flt const* row_b = luma +(uptr)by[l] * w;
+				v00[l] = row_a[ax[l]];
+				v10[l] = row_a[bx[l]];
+				v01[l] = row_b[ax[l]];
+				v11[l] = row_b[bx[l]];
+			}
+
+			__m128 a = _mm_load_ps(v00), b = _mm_load_ps(v10), c = _mm_load_ps(v01), d = _mm_load_ps(v11);
+			__m128 ab = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), tx));
+			__m128 cd = _mm_add_ps(c, _mm_mul_ps(_mm_sub_ps(d, c), tx));
+			return _mm_add_ps(ab, _mm_mul_ps(_mm_sub_ps(cd, ab), ty));
+		}
+
+		FORCEINLINE void gradient_normal4 (__m128 pos_x, __m128 pos_y, __m128* out_x, __m128* out_y) const {
+			__m128 a = sample_luma4(pos_x, pos_y);
+			__m128 a_plus_threshold = _mm_add_ps(a, _mm_set1_ps(params.threshold));
+
+			__m128 total_x = _mm_setzero_ps();
+			__m128 total_y = _mm_setzero_ps();
+
+			for (auto dir : dirs) {
+				__m128 dx = _mm_set1_ps(dir.x);
+				__m128 dy = _mm_set1_ps(dir.y);
+
+				__m128 b = sample_luma4(_mm_add_ps(pos_x, dx), _mm_add_ps(pos_y, dy));
+				__m128 d = _mm_max_ps(_mm_sub_ps(b, a_plus_threshold), _mm_setzero_ps());
+				__m128 d2 = _mm_mul_ps(d, d);
+
+				total_x = _mm_add_ps(total_x, _mm_mul_ps(dx, d2));
+				total_y = _mm_add_ps(total_y, _mm_mul_ps(dy, d2));
+			}
+
+			__m128 norm = _mm_set1_ps(4 * PI / (flt)params.gradient_normal_samples);
+			*out_x = _mm_mul_ps(total_x, norm);
+			*out_y = _mm_mul_ps(total_y, norm);
+		}
+
+		// returns for each lane: -1 if not an edge pixel (keep col), otherwise the step count i of calc_edge_distance
+		FORCEINLINE __m128 edge_steps4 (__m128 pos_x, __m128 pos_y) const {
+			__m128 gx, gy;
+			gradient_normal4(pos_x, pos_y, &gx, &gy);
+
+			__m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy)));
+			__m128 is_edge = _mm_cmpge_ps(len, _mm_set1_ps(0.001f));
+
+			__m128 inv_len = _mm_div_ps(_mm_set1_ps(1), _mm_max_ps(len, _mm_set1_ps(0.001f)));
+			gx = _mm_mul_ps(gx, inv_len);
+			gy = _mm_mul_ps(gy, inv_len);
+
+			// lanes only ever go from active to inactive, so dist is the same for all active lanes
+			__m128 active = is_edge;
+			__m128 steps = _mm_setzero_ps();
+			flt step_size = 1.5f / (flt)EDGE_STEPS;
+
+			for (int i=0; i<EDGE_STEPS && _mm_movemask_ps(active); ++i) {
+				flt dist = (flt)i * step_size;
+
+				__m128 offs_x = _mm_mul_ps(gx, _mm_set1_ps(-(dist +half_texel_uv.x)));
+				__m128 offs_y = _mm_mul_ps(gy, _mm_set1_ps(-(dist +half_texel_uv.y)));
+
+				__m128 gbx, gby;
+				gradient_normal4(_mm_add_ps(pos_x, offs_x), _mm_add_ps(pos_y, offs_y), &gbx, &gby);
+
+				__m128 d = _mm_add_ps(_mm_mul_ps(gx, gbx), _mm_mul_ps(gy, gby));
+				active = _mm_and_ps(active, _mm_cmpge_ps(d, _mm_set1_ps(0.001f)));
+
+				steps = _mm_add_ps(steps, _mm_and_ps(active, _mm_set1_ps(1)));
+			}
+
+			return _mm_or_ps(_mm_and_ps(is_edge, steps), _mm_andnot_ps(is_edge, _mm_set1_ps(-1)));
+		}
+	#endif
+
+		void filter_rows (iv2 out_size_px, srgba8* out, int y_begin, int y_end, bool use_simd) const {
+			v2 scale = (v2)img.size_px / (v2)out_size_px;
+
+			auto pos_of = [&] (int x, int y) {
+				return (v2((flt)x, (flt)y) +0.5f) * scale; // vs_uv * tex_size_px
+			};
+
+			for (int y=y_begin; y<y_end; ++y) {
+				srgba8* row = out +(uptr)y * out_size_px.x;
+				int x = 0;
+
+			#if TEXTURE_FILTER_SSE2
+				if (use_simd && !params.nearest) { // the simd version only does bilinear
+					for (; x+4 <= out_size_px.x; x += 4) {
+						__m128 pos_x = _mm_mul_ps(_mm_add_ps(_mm_setr_ps((flt)x, (flt)x+1, (flt)x+2, (flt)x+3), _mm_set1_ps(0.5f)), _mm_set1_ps(scale.x));
+						__m128 pos_y = _mm_set1_ps(((flt)y +0.5f) * scale.y);
+
+						alignas(16) flt steps[4];
+						_mm_store_ps(steps, edge_steps4(pos_x, pos_y));
+
+						for (int l=0; l<4; ++l) {
+							lrgba col = _sample_bilinear(img.pixels.data(), img.size_px, pos_of(x +l, y));
+							if (steps[l] >= 0) {
+								flt edge = steps[l] / (flt)EDGE_STEPS > 0.5f ? 1.0f : 0.0f;
+								col = lrgba(edge, edge, edge, col.w);
+							}
+							row[x +l] = srgba8::from_linear(col);
+						}
+					}
+				}
+			#endif
+
+				for (; x<out_size_px.x; ++x)
+					row[x] = srgba8::from_linear(filter_pixel(pos_of(x, y)));
+			}
+		}
+	};
+
+	struct Filter_Stats {
+		flt		seconds = 0;
+		u64		out_pixels = 0;
+
+		flt mpix_per_sec () const {
+			return seconds > 0 ? (flt)out_pixels / 1000000 / seconds : 0;
+		}
+	};
+
+	// out is resized to out_size_px, use_simd=false runs the scalar reference version
+	Filter_Stats filter_image (Image const& img, Filter_Params const& params, iv2 out_size_px, std::vector<srgba8>* out, bool use_simd=true) {
+		u64 begin = profiler::now_ns();
+
+		out->resize((uptr)out_size_px.x * out_size_px.y);
+
+		_Filter f (img, params);
+
+		parallel_for(out_size_px.y, [&] (sptr begin, sptr end) {
+			f.filter_rows(out_size_px, out->data(), (int)begin, (int)end, use_simd);
+		}, 8);
+
+		Filter_Stats s;
+		s.seconds = (flt)(profiler::now_ns() -begin) * 1e-9f;
+		s.out_pixels = (u64)out_size_px.x * out_size_px.y;
+		return s;
+	}
+
+	iv2 calc_out_size (iv2 size_px, flt scale) {
+		return MAX((iv2)round((v2)size_px * scale), iv2(1));
+	}
+
+	//// Error metric to compare two filter outputs (simd vs reference, cpu vs gpu readback)
+
+	struct Image_Diff {
+		int		max_abs = 0; // largest difference of any channel, in 0-255
+		flt		mean_abs = 0; // over all channels
+		flt		psnr = INF; // in dB, over all channels
+		u64		differing_pixels = 0;
+	};
+
+	Image_Diff compare_images (srgba8 const* a, srgba8 const* b, iv2 size_px) {
+		Image_Diff d;
+
+		u64 count = (u64)size_px.x * size_px.y;
+		u64 sum_abs = 0;
+		u64 sum_sqr = 0;
+
+		for (u64 i=0; i<count; ++i) {
+			bool differs = false;
+			for (int c=0; c<4; ++c) {
+				int diff = abs((int)a[i].v[c] -(int)b[i].v[c]);
+				d.max_abs = MAX(d.max_abs, diff);
+				sum_abs += diff;
+				sum_sqr += diff * diff;
+				differs = differs || diff != 0;
+			}
+			if (differs) d.differing_pixels++;
+		}
+
+		if (count > 0) {
+			d.mean_abs = (flt)((double)sum_abs / (count * 4));
+			double mse = (double)sum_sqr / (count * 4);
+			if (mse > 0)
+				d.psnr = (flt)(10 * log10(255.0 * 255.0 / mse));
+		}
+		return d;
+	}
+}
@@ -27,6 +27,10 @@ public:
 	v3					pos_world;
 	quat				ori_world;
 
+	// cached by calc_matricies()
+	hm					model_to_world;
+	hm					world_to_model;
+
 	iv3					size;
 	unique_ptr<Block[]> blocks; // 3d blocks array of size
 
@@ -151,10 +155,12 @@ public:
 		mesh = cpu_mesh.upload();
 	}
 
+	void calc_matricies () {
+		model_to_world = translateH(pos_world) * convert_to_hm(ori_world);
+		world_to_model = inverse_rigid(model_to_world);
+	}
+
 	bool raycast (v3 ray_pos, v3 ray_dir, iv3* hit_block=0, v3* hit_pos=0, iv3* hit_face_normal=0) {
-		
-		hm model_to_world = translateH(pos_world) * convert_to_hm(ori_world);
-		hm world_to_model = translateH(-pos_world) * convert_to_hm(inverse(ori_world));
 
 		ray_pos = world_to_model * ray_pos;
 		ray_dir = world_to_model.m3() * ray_dir;
@@ -195,6 +201,8 @@ public:
 		s->pos_world = 0;
 		s->ori_world = 0 ? rotateQ_Z(deg(30)) : quat::ident(); // TODO: Fix rotation
 
+		s->calc_matricies();
+
 		s->allocate_blocks(iv3(1,1,1));
 
 		s->get_block(0)->type = Block::WOOD;
@@ -207,8 +215,10 @@ public:
 	bool	highlight_block;
 	iv3		highlight_block_pos;
 
-	void build_update (Input& inp, flt dt, Camera const& cam) {
+	void build_update (Input& inp, flt dt, Camera const& cam, Gl_Command_Buffer& cmds) {
 		
+		calc_matricies();
+
 		auto ray = cam.get_mouse_ray_world(inp);
 		
 		iv3 hit_block;
@@ -236,19 +246,17 @@ public:
 				mirror_pos = (v3)size / 2;
 			}
 
-			hm world_to_model = translateH(-pos_world) * convert_to_hm(inverse(ori_world));
-
-			int mirror_axis = biggest_comp(world_to_model * cam.forw_dir_world());
+			int mirror_axis = biggest_comp(world_to_model.m3() * cam.forw_dir_world());
 			
 			v3 size = 0.05f;
 
 			size[mirror_axis] = 0.95f;
 
-			draw_box_outline(pos_world + mirror_pos, quat::ident(), size, lrgba(0.5f,0.5f,1,1));
+			draw_box_outline(cmds, pos_world + mirror_pos, quat::ident(), size, lrgba(0.5f,0.5f,1,1));
 		}
 	}
 
-	void update (Input& inp, flt dt, Camera const& cam) {
+	void update (Input& inp, flt dt, Camera const& cam, Gl_Command_Buffer& cmds) {
 		
 		if (imgui::TreeNodeEx(prints("%s###%p", name.c_str(), this).c_str(), ImGuiTreeNodeFlags_DefaultOpen)) {
 			
@@ -263,17 +271,17 @@ public:
 			imgui::TreePop();
 		}
 
-		build_update(inp, dt, cam);
+		build_update(inp, dt, cam, cmds);
 	}
 
-	void draw () {
+	void draw (Gl_Command_Buffer& cmds) {
 
-		draw_box_outline(pos_world, quat::ident(), (v3)size, lrgba(1,0,0,1));
+		draw_box_outline(cmds, pos_world, quat::ident(), (v3)size, lrgba(1,0,0,1));
 		
-		draw_simple(mesh, pos_world, ori_world, v3(1), srgb8(122,71,36).to_lrgba());
+		draw_simple(cmds, mesh, pos_world, ori_world, v3(1), srgb8(122,71,36).to_lrgba());
 
 		if (highlight_block)
-			draw_box_outline(pos_world + voxel_pos_to_model((v3)highlight_block_pos) + 0.5f, quat::ident(), 0.99f, lrgba(0.5f, 1, 0.5f, 1));
+			draw_box_outline(cmds, pos_world + voxel_pos_to_model((v3)highlight_block_pos) + 0.5f, quat::ident(), 0.99f, lrgba(0.5f, 1, 0.5f, 1));
 	}
 };
 
@@ -282,13 +290,13 @@ public:
 	
 	std::vector<unique_ptr<Ship>> ships;
 
-	void update (Input& inp, flt dt, Camera const& cam) {
+	void update (Input& inp, flt dt, Camera const& cam, Gl_Command_Buffer& cmds) {
 		
 		if (imgui::Button("New Ship"))
 			ships.emplace_back( Ship::new_empty_ship() );
 
 		for (auto s = ships.begin(); s!=ships.end();) {
-			(*s)->update(inp, dt, cam);
+			(*s)->update(inp, dt, cam, cmds);
 
 			if ((*s)->dead)
 				s = ships.erase(s);
@@ -296,22 +304,25 @@ public:
 				s++;
 		}
 	}
-	void draw () {
+	void draw (Gl_Command_Buffer& cmds) {
 		for (auto& s : ships)
-			s->draw();
+			s->draw(cmds);
 	}
 };
 
 class App : public Application {
 
 	Ship_Manager ships;
+
+	Gl_Command_Buffer cmds; // draws of the frame, sorted by shader and state on submit
 	
 	void frame () {
 		
 		imgui::Separator();
 
 		static bool wireframe_enable = false;
-		save->value("wireframe_enable", &wireframe_enable);
+		static Save::Cache wireframe_cache;
+		save->value("wireframe_enable", &wireframe_enable, &wireframe_cache);
 		imgui::Checkbox("wireframe_enable", &wireframe_enable);
 		engine::set_shared_uniform("wireframe", "enable", wireframe_enable);
 
@@ -324,10 +335,20 @@ class App : public Application {
 		engine::draw_to_screen(inp.wnd_size_px);
 		engine::clear(0);
 
-		draw_skybox_gradient();
+		cmds.view_pos = cam.pos_world;
+
+		cmds.cur_pass = 0;
+		draw_skybox_gradient(cmds);
 
-		ships.update(inp, dt, cam);
-		ships.draw();
+		cmds.cur_pass = 1;
+		ships.update(inp, dt, cam, cmds);
+		ships.draw(cmds);
+
+		{ // one gpu zone for the whole recorded pass, not one per draw
+			GPU_PROFILE_SCOPED("draw_ships");
+			cmds.submit(gl_backend);
+		}
+		imgui::Text("%s", cmds.stats.to_string().c_str());
 	}
 } app;
 